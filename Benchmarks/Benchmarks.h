@@ -0,0 +1,64 @@
+#pragma once
+
+// Every benchmark takes the command line arguments after its name and returns the process exit code
+
+// Tokens per second of the borrowing (string_view) TokenStream mode against the copying one.
+// Optional argument: a text file to tokenize, otherwise an OBJ like text is generated
+int RunTokenStreamBenchmark(int argc, char** argv);
+
+// Time of every HeightMap operation (the TerrainMesh generators and modifiers and the vertex build of Regenerate)
+// per resolution and thread count, in ns per texel (or particle) and GB/s, written as JSON (terrain_benchmark.json).
+// HeightMap does not use Direct3D, so this benchmark also builds on Linux with the DirectXMath headers:
+// g++ -O2 -std=c++17 -pthread -DDISABLE_PROFILER -I<DirectXMath>/Inc -I../CMP305_Base -I../DXFramework Main.cpp TerrainBenchmark.cpp
+//     PreviewBenchmark.cpp TokenStreamBenchmark.cpp ../CMP305_Base/HeightMap.cpp ../CMP305_Base/Utils.cpp
+//     HydrologyBenchmark.cpp ../CMP305_Base/TerrainPreview.cpp ../CMP305_Base/HorizonBaker.cpp
+//     ../CMP305_Base/Hydrology.cpp ../CMP305_Base/PngWriter.cpp ../DXFramework/TokenStream.cpp
+//     ErosionBenchmark.cpp ../CMP305_Base/StreamPowerErosion.cpp ConstraintBenchmark.cpp ../CMP305_Base/ConstraintSolver.cpp
+//     PackingTest.cpp ../CMP305_Base/TerrainVertexPacking.cpp MeshBenchmark.cpp ../DXFramework/MeshOptimizer.cpp
+//     ../DXFramework/ObjParser.cpp ../DXFramework/MappedFile.cpp TextureCacheTest.cpp ../DXFramework/TextureCache.cpp
+//     UploadRingTest.cpp ../DXFramework/UploadRing.cpp ../DXFramework/RecordingUploadBackend.cpp
+//     HeadlessBenchmark.cpp ../DXFramework/FrameReport.cpp ../DXFramework/NullRenderDevice.cpp ../DXFramework/RenderDevice.cpp
+//     ../DXFramework/BaseMesh.cpp ../DXFramework/PlaneMesh.cpp ../DXFramework/GeometryBuilder.cpp ../DXFramework/IndexBufferBuilder.cpp
+//     ../CMP305_Base/TerrainMesh.cpp ../CMP305_Base/Emitter.cpp ../CMP305_Base/PropScatter.cpp ../CMP305_Base/HeightQuery.cpp
+//     ../CMP305_Base/CompressedHeightMap.cpp ../CMP305_Base/RowBandPool.cpp
+int RunTerrainBenchmark(int argc, char** argv);
+
+// Generation, CPU render (TerrainPreview) and PNG encoding time of terrain previews, and the previews per minute,
+// written as JSON (preview_benchmark.json). With -d the previews are saved in a directory. Fails if a preview differs
+// from the render without node skipping
+int RunPreviewBenchmark(int argc, char** argv);
+
+// Time of the hydrology analysis (Hydrology: depression filling, flow directions and accumulation) of a Diamond-Square
+// terrain with D8 and D-infinity routing, written as JSON (hydrology_benchmark.json)
+int RunHydrologyBenchmark(int argc, char** argv);
+
+// Time per iteration of the stream power erosion (StreamPowerErosion) of a Diamond-Square terrain and the height change
+// left after every block of iterations, written as JSON (erosion_benchmark.json)
+int RunErosionBenchmark(int argc, char** argv);
+
+// Time and conjugate gradient iterations of the multigrid solve (ConstraintSolver) of a terrain through a sketch of
+// pinned heights, with the thin plate and membrane fills, against HeightMap::Smooth passes relaxing the membrane,
+// written as JSON (constraint_benchmark.json)
+int RunConstraintBenchmark(int argc, char** argv);
+
+// Vertex counts and ACMR of an OBJ file (or a shuffled triangle soup grid) before and after the import optimisation
+// of the models (MeshOptimizer), and the optimisation time, written as JSON (mesh_benchmark.json)
+int RunMeshBenchmark(int argc, char** argv);
+
+// Test of the compact terrain vertex (TerrainVertexPacking): octahedral normals within their error bound, positions
+// and UVs rebuilt exactly from the vertex index, and the SSE2 encoding equal to the scalar one bit for bit.
+// Returns 1 if a check fails
+int RunPackingTest(int argc, char** argv);
+
+// Test of the texture cache (TextureCache) without a device: LRU eviction order, pinned textures, byte accounting and
+// names sharing a texture. Returns 1 if a check fails
+int RunTextureCacheTest(int argc, char** argv);
+
+// Test of the upload ring (UploadRing) with the recording backend: the frame budget is kept, the ring wraps around
+// without overwriting the ranges in use, and the data arrives intact after the wraps. Returns 1 if a check fails
+int RunUploadRingTest(int argc, char** argv);
+
+// Frames of the terrain on the null render device (NullRenderDevice) as in a headless run of App1: modified and
+// regenerated every few frames, streamed through the upload ring and drawn. CPU time, draw calls, bindings and bytes
+// uploaded per frame, written as JSON (headless.json) in the format of HeadlessSystem. Returns 1 if objects leak
+int RunHeadlessBenchmark(int argc, char** argv);
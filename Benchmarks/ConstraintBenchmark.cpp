@@ -0,0 +1,203 @@
+// Constraint benchmark
+// Solves the terrain through a sketch (pinned points and a ridge curve) with ConstraintSolver, with the membrane and the
+// thin plate fill, and compares the membrane with the same surface relaxed by repeated HeightMap::Smooth passes that
+// put the pinned heights back after every pass. Writes the results as JSON.
+#include "Benchmarks.h"
+#include "HeightMap.h"
+#include "ConstraintSolver.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// One solve of the sketch
+	struct ConstraintRun
+	{
+		const char* fill;
+		double ms;
+		int cycles;
+		float residual;
+		int pinned;
+	};
+
+	// The sketch in points of a grid of the resolution: 4 peaks and pits and a ridge through 3 control points
+	void BuildSketch(int resolution, std::vector<ControlPoint>& points, std::vector<ControlPoint>& ridge)
+	{
+		const float scale = (float)(resolution - 1) / 100.0f;
+		points.clear();
+		points.push_back(ControlPoint(20.0f * scale, 20.0f * scale, 12.0f));
+		points.push_back(ControlPoint(80.0f * scale, 30.0f * scale, -6.0f));
+		points.push_back(ControlPoint(50.0f * scale, 75.0f * scale, 4.0f));
+		points.push_back(ControlPoint(10.0f * scale, 90.0f * scale, -2.0f));
+		ridge.clear();
+		ridge.push_back(ControlPoint(30.0f * scale, 50.0f * scale, 8.0f));
+		ridge.push_back(ControlPoint(55.0f * scale, 45.0f * scale, 14.0f));
+		ridge.push_back(ControlPoint(85.0f * scale, 70.0f * scale, 6.0f));
+	}
+
+	// Pin the nearest points along the segment from 'start' to 'end' as ConstraintSolver does, for the relaxation
+	void PinSegment(int resolution, const ControlPoint& start, const ControlPoint& end, std::vector<float>& sums, std::vector<int>& counts)
+	{
+		const float dx = end.x - start.x;
+		const float dz = end.z - start.z;
+		const int steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dz)) * 2.0f);
+		for (int step = 0; step <= steps; step++)
+		{
+			const float t = steps > 0 ? (float)step / (float)steps : 0.0f;
+			const int n = (int)floorf(start.x + dx * t + 0.5f);
+			const int m = (int)floorf(start.z + dz * t + 0.5f);
+			if (m >= 0 && m < resolution && n >= 0 && n < resolution)
+			{
+				sums[(size_t)m * resolution + n] += start.height + (end.height - start.height) * t;
+				counts[(size_t)m * resolution + n]++;
+			}
+		}
+	}
+}
+
+int RunConstraintBenchmark(int argc, char** argv)
+{
+	int resolution = 1025;
+	int cycles = 30;
+	int threads = 0;
+	int passes = 500;
+	const char* output = "constraint_benchmark.json";
+	const char* label = "";
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-r") == 0 && hasValue) resolution = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && hasValue) cycles = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && hasValue) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && hasValue) passes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else
+		{
+			cycles = 0;
+			break;
+		}
+	}
+	if (cycles <= 0 || resolution < 3 || threads < 0 || passes < 0)
+	{
+		printf("Usage: Benchmarks constraint [-r resolution] [-c max cycles] [-t threads] [-s smooth passes] [-o output.json] [-l label]\n");
+		printf("  threads 0 uses one per hardware thread, the smooth passes relax the membrane without multigrid\n");
+		return 1;
+	}
+
+	std::vector<ControlPoint> points;
+	std::vector<ControlPoint> ridge;
+	BuildSketch(resolution, points, ridge);
+	ConstraintSolver solver;
+	solver.SetThreadCount(threads);
+	for (const ControlPoint& point : points)
+	{
+		solver.AddPoint(point.x, point.z, point.height);
+	}
+	solver.AddCurve(ridge);
+
+	HeightMap map;
+	map.SetThreadCount(threads);
+	map.Resize(resolution);
+	ConstraintSettings settings;
+	settings.maxCycles = cycles;
+	const ConstraintFill fills[2] = { ConstraintFill::ThinPlate, ConstraintFill::Membrane };
+	ConstraintRun runs[2];
+	for (int f = 0; f < 2; f++)
+	{
+		settings.fill = fills[f];
+		auto start = std::chrono::steady_clock::now();
+		solver.Solve(map, settings);
+		runs[f].ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		runs[f].fill = fills[f] == ConstraintFill::ThinPlate ? "thin_plate" : "membrane";
+		runs[f].cycles = solver.GetCycles();
+		runs[f].residual = solver.GetResidual();
+		runs[f].pinned = solver.GetPinnedCount();
+	}
+	// The map keeps the membrane, the last solve
+	const size_t count = (size_t)resolution * resolution;
+	std::vector<float> membrane(map.GetData(), map.GetData() + count);
+
+	// Relaxation from 0: a smoothing pass, then the pinned heights again
+	std::vector<float> sums(count, 0.0f);
+	std::vector<int> counts(count, 0);
+	for (const ControlPoint& point : points)
+	{
+		PinSegment(resolution, point, point, sums, counts);
+	}
+	for (size_t p = 0; p + 1 < ridge.size(); p++)
+	{
+		PinSegment(resolution, ridge[p], ridge[p + 1], sums, counts);
+	}
+	std::vector<size_t> pinned;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (counts[i] > 0)
+		{
+			sums[i] /= (float)counts[i];
+			pinned.push_back(i);
+		}
+	}
+	map.Flatten();
+	float* heights = map.GetData();
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (size_t i : pinned)
+		{
+			heights[i] = sums[i];
+		}
+		map.Smooth();
+	}
+	for (size_t i : pinned)
+	{
+		heights[i] = sums[i];
+	}
+	const double relaxMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	double difference = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		difference += fabs((double)heights[i] - membrane[i]);
+	}
+	difference /= (double)count;
+
+	printf("Terrain %d x %d, %d pinned points, %d threads\n", resolution, resolution, runs[0].pinned,
+		threads > 0 ? threads : (int)std::thread::hardware_concurrency());
+	printf("%12s %10s %10s %12s\n", "fill", "ms", "cycles", "residual");
+	for (const ConstraintRun& run : runs)
+	{
+		printf("%12s %10.1f %10d %12.2e\n", run.fill, run.ms, run.cycles, run.residual);
+	}
+	printf("%d smooth passes: %.1f ms, mean difference to the membrane %.4f\n", passes, relaxMs, difference);
+
+	std::ofstream file(output, std::ios::binary);
+	char text[512];
+	snprintf(text, sizeof(text),
+		"{\n\t\"benchmark\": \"constraint\",\n\t\"label\": \"%s\",\n\t\"hardware_threads\": %u,\n\t\"threads\": %d,\n"
+		"\t\"resolution\": %d, \"pinned\": %d, \"max_cycles\": %d,\n\t\"solves\": [\n",
+		label, std::thread::hardware_concurrency(), threads, resolution, runs[0].pinned, cycles);
+	file << text;
+	for (int f = 0; f < 2; f++)
+	{
+		snprintf(text, sizeof(text), "\t\t{ \"fill\": \"%s\", \"ms\": %.3f, \"cycles\": %d, \"residual\": %.3e }%s\n",
+			runs[f].fill, runs[f].ms, runs[f].cycles, runs[f].residual, f == 0 ? "," : "");
+		file << text;
+	}
+	snprintf(text, sizeof(text), "\t],\n\t\"relaxation\": { \"passes\": %d, \"ms\": %.3f, \"mean_difference\": %.5f }\n}\n",
+		passes, relaxMs, difference);
+	file << text;
+	if (!file.good())
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return 0;
+}
@@ -0,0 +1,128 @@
+// Erosion benchmark
+// Generates a Diamond-Square terrain and erodes it with StreamPowerErosion in blocks of iterations, timing every block
+// and recording how far the terrain is from the balance of uplift and erosion, and writes the results as JSON.
+#include "Benchmarks.h"
+#include "HeightMap.h"
+#include "StreamPowerErosion.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// One block of iterations
+	struct ErosionBlock
+	{
+		int iterations;		// iterations done after the block
+		int count;			// iterations of the block
+		double ms;
+		float change;
+		int basins;
+		int pits;
+	};
+}
+
+int RunErosionBenchmark(int argc, char** argv)
+{
+	int resolution = 2049;
+	int iterations = 40;
+	int block = 10;
+	int threads = 0;
+	StreamPowerSettings settings;
+	const char* output = "erosion_benchmark.json";
+	const char* label = "";
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-r") == 0 && hasValue) resolution = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-i") == 0 && hasValue) iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-b") == 0 && hasValue) block = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && hasValue) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0 && hasValue) settings.erodibility = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && hasValue) settings.diffusion = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else
+		{
+			iterations = 0;
+			break;
+		}
+	}
+	if (iterations <= 0 || block <= 0 || resolution < 3 || ((resolution - 1) & (resolution - 2)) != 0 || threads < 0
+		|| settings.erodibility < 0.0f || settings.diffusion < 0.0f)
+	{
+		printf("Usage: Benchmarks erosion [-r resolution (2^n)+1] [-i iterations] [-b block] [-t threads] [-k erodibility] [-d diffusion]\n");
+		printf("                          [-o output.json] [-l label]\n");
+		printf("  threads 0 uses one per hardware thread, every block of iterations starts by filling the depressions\n");
+		return 1;
+	}
+
+	HeightMap map;
+	map.Resize(resolution);
+	Range range;
+	range.min = -15.0f;
+	range.max = 15.0f;
+	map.DiamondSquare(range);
+	map.Smooth();
+	// a terrain 100 units wide, as TerrainMesh
+	const float spacing = 100.0f / (float)(resolution - 1);
+
+	StreamPowerErosion erosion;
+	erosion.SetThreadCount(threads);
+	std::vector<ErosionBlock> blocks;
+	double totalMs = 0.0;
+	for (int done = 0; done < iterations; done += block)
+	{
+		settings.iterations = iterations - done < block ? iterations - done : block;
+		auto start = std::chrono::steady_clock::now();
+		erosion.Erode(map, spacing, settings);
+		ErosionBlock result;
+		result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		result.iterations = done + settings.iterations;
+		result.count = settings.iterations;
+		result.change = erosion.GetLastChange();
+		result.basins = erosion.GetBasinCount();
+		result.pits = erosion.GetPitCount();
+		blocks.push_back(result);
+		totalMs += result.ms;
+	}
+
+	printf("Terrain %d x %d, uplift %g, erodibility %g, diffusion %g, %d threads\n", resolution, resolution, settings.uplift,
+		settings.erodibility, settings.diffusion, threads > 0 ? threads : (int)std::thread::hardware_concurrency());
+	printf("%10s %14s %10s %10s %10s\n", "iteration", "ms/iteration", "change", "basins", "pits");
+	for (const ErosionBlock& result : blocks)
+	{
+		printf("%10d %14.1f %10.4f %10d %10d\n", result.iterations, result.ms / result.count, result.change, result.basins, result.pits);
+	}
+	printf("Total %.1f ms\n", totalMs);
+
+	std::ofstream file(output, std::ios::binary);
+	char text[512];
+	snprintf(text, sizeof(text),
+		"{\n\t\"benchmark\": \"erosion\",\n\t\"label\": \"%s\",\n\t\"hardware_threads\": %u,\n\t\"threads\": %d,\n"
+		"\t\"resolution\": %d, \"uplift\": %g, \"erodibility\": %g, \"diffusion\": %g, \"total_ms\": %.3f,\n\t\"blocks\": [\n",
+		label, std::thread::hardware_concurrency(), threads, resolution, settings.uplift, settings.erodibility,
+		settings.diffusion, totalMs);
+	file << text;
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		snprintf(text, sizeof(text),
+			"\t\t{ \"iterations\": %d, \"ms_per_iteration\": %.3f, \"change\": %.5f, \"basins\": %d, \"pits\": %d }%s\n",
+			blocks[b].iterations, blocks[b].ms / blocks[b].count, blocks[b].change, blocks[b].basins, blocks[b].pits,
+			b + 1 < blocks.size() ? "," : "");
+		file << text;
+	}
+	file << "\t]\n}\n";
+	if (!file.good())
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return 0;
+}
@@ -0,0 +1,146 @@
+// Headless benchmark
+// Runs the frames of the terrain on the null render device (NullRenderDevice) the way a headless run of App1 does
+// (HeadlessSystem with App1's script): the terrain is modified and regenerated every few frames, the vertex rows are
+// streamed through the upload ring within its frame budget, and every index chunk is drawn. Records the CPU time,
+// the work submitted to the device and the bytes uploaded per frame, and checks that every object created is released.
+// Writes the frame records as JSON with FrameReport, as HeadlessSystem::writeReport does.
+#include "Benchmarks.h"
+#include "FrameReport.h"
+#include "NullRenderDevice.h"
+#include "TerrainMesh.h"
+#include "UploadRing.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// The sizes of BaseApplication: screen, depth range and upload ring
+	const int kScreenWidth = 1200;
+	const int kScreenHeight = 675;
+	const float kScreenDepth = 200.0f;
+	const float kScreenNear = 0.1f;
+	const size_t kUploadRingSize = 16 * 1024 * 1024;
+	const size_t kUploadFrameBudget = 4 * 1024 * 1024;
+
+	// The operations of the UI buttons in turn, as App1::modifyTerrain
+	void ModifyTerrain(TerrainMesh& terrain, RenderDevice* device, int step)
+	{
+		switch (step % 5)
+		{
+		case 0:
+			terrain.BuildRandomHeightMap();
+			break;
+		case 1:
+			terrain.Smooth();
+			break;
+		case 2:
+			terrain.Fault();
+			break;
+		case 3:
+			terrain.ParticleDeposition();
+			break;
+		default:
+			terrain.DiamondSquareAlgorithm();
+			break;
+		}
+		terrain.Regenerate(device);
+	}
+
+	// The terrain part of App1::render, without the shaders
+	void RenderTerrain(TerrainMesh& terrain, RenderDevice* device)
+	{
+		device->beginScene(0.39f, 0.58f, 0.92f, 1.0f);
+		terrain.sendData(device);
+		for (const IndexChunk& chunk : terrain.GetIndexChunks())
+		{
+			device->drawIndexed(chunk.indexCount, chunk.indexStart, chunk.baseVertex);
+		}
+		device->endScene();
+	}
+}
+
+int RunHeadlessBenchmark(int argc, char** argv)
+{
+	int frameCount = 600;
+	int resolution = 257;
+	int modifyEvery = 10;
+	const char* output = "headless.json";
+	const char* label = "";
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-f") == 0 && hasValue) frameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && hasValue) resolution = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-m") == 0 && hasValue) modifyEvery = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else
+		{
+			frameCount = 0;
+			break;
+		}
+	}
+	if (frameCount <= 0 || resolution < 2 || modifyEvery <= 0)
+	{
+		printf("Usage: Benchmarks headless [-f frames] [-r resolution] [-m frames between modifications] [-o output.json] [-l label]\n");
+		return 1;
+	}
+
+	std::vector<FrameRecord> frames;
+	int liveObjects = 0;
+	size_t liveBufferBytes = 0;
+	{
+		NullRenderDevice device(kScreenWidth, kScreenHeight, kScreenDepth, kScreenNear);
+		UploadRing ring(device.createUploadBackend(), kUploadRingSize, kUploadFrameBudget);
+		{
+			// App1::resizeTerrain
+			TerrainMesh terrain(&device, resolution, &ring);
+			terrain.Resize(resolution);
+			terrain.Flatten();
+			terrain.Regenerate(&device);
+
+			frames.reserve(frameCount);
+			for (int i = 0; i < frameCount; i++)
+			{
+				unsigned long long uploaded = ring.getTotalBytes();
+				auto start = std::chrono::steady_clock::now();
+
+				ring.beginFrame();
+				if (i % modifyEvery == 0)
+				{
+					ModifyTerrain(terrain, &device, i / modifyEvery);
+				}
+				terrain.StreamVertices();
+				RenderTerrain(terrain, &device);
+
+				FrameRecord record;
+				record.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				record.stats = device.getLastFrameStats();
+				record.uploadBytes = (size_t)(ring.getTotalBytes() - uploaded);
+				frames.push_back(record);
+			}
+		}
+		// Everything the terrain created is released with it
+		liveObjects = device.getLiveObjectCount();
+		liveBufferBytes = device.getLiveBufferBytes();
+	}
+
+	const FrameReport::Summary summary = FrameReport::summarise(frames);
+	printf("Terrain %d x %d, %d frames on the null device, modified every %d frames\n", resolution, resolution, frameCount, modifyEvery);
+	printf("CPU ms per frame: mean %.3f, p50 %.3f, p95 %.3f, max %.3f\n", summary.meanMs, summary.p50Ms, summary.p95Ms, summary.maxMs);
+	printf("%.2f draw calls and %.2f bindings per frame, %llu bytes uploaded\n", summary.drawCallsPerFrame, summary.bindingsPerFrame,
+		summary.uploadBytes);
+	printf("%d objects and %zu buffer bytes left alive after the terrain is released\n", liveObjects, liveBufferBytes);
+
+	if (!FrameReport::write(output, label, frames, liveObjects, liveBufferBytes))
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return liveObjects == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// Hydrology benchmark
+// Generates a Diamond-Square terrain and analyses it with Hydrology (depression filling, flow directions and flow
+// accumulation) with both routings, timing the analysis, and writes the results as JSON.
+#include "Benchmarks.h"
+#include "HeightMap.h"
+#include "Hydrology.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+	// Times and results of one routing over every run
+	struct RoutingResult
+	{
+		RoutingResult() : totalMs(0.0), bestMs(0.0), worstMs(0.0), runs(0), raisedPoints(0), largestAccumulation(0.0f) {}
+
+		void Add(double ms)
+		{
+			bestMs = runs == 0 || ms < bestMs ? ms : bestMs;
+			worstMs = ms > worstMs ? ms : worstMs;
+			totalMs += ms;
+			runs++;
+		}
+		double MeanMs()const { return runs > 0 ? totalMs / runs : 0.0; }
+
+		double totalMs;
+		double bestMs;
+		double worstMs;
+		int runs;
+		size_t raisedPoints;
+		float largestAccumulation;
+	};
+}
+
+int RunHydrologyBenchmark(int argc, char** argv)
+{
+	int resolution = 4097;
+	int runs = 3;
+	int threads = 0;
+	float epsilon = HydrologySettings().epsilon;
+	const char* output = "hydrology_benchmark.json";
+	const char* label = "";
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-r") == 0 && hasValue) resolution = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && hasValue) runs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && hasValue) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-e") == 0 && hasValue) epsilon = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else
+		{
+			runs = 0;
+			break;
+		}
+	}
+	if (runs <= 0 || resolution < 3 || ((resolution - 1) & (resolution - 2)) != 0 || threads < 0 || epsilon < 0.0f)
+	{
+		printf("Usage: Benchmarks hydrology [-r resolution (2^n)+1] [-c runs] [-t threads] [-e epsilon] [-o output.json] [-l label]\n");
+		printf("  threads 0 uses one per hardware thread, epsilon 0 fills the depressions flat\n");
+		return 1;
+	}
+
+	HeightMap map;
+	map.Resize(resolution);
+	Range range;
+	range.min = -15.0f;
+	range.max = 15.0f;
+	map.DiamondSquare(range);
+	map.Smooth();
+
+	Hydrology hydrology;
+	hydrology.SetThreadCount(threads);
+	const FlowRouting routings[2] = { FlowRouting::D8, FlowRouting::DInfinity };
+	const char* routingNames[2] = { "d8", "dinfinity" };
+	RoutingResult results[2];
+	for (int r = 0; r < 2; r++)
+	{
+		HydrologySettings settings;
+		settings.epsilon = epsilon;
+		settings.routing = routings[r];
+		for (int run = 0; run < runs; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			hydrology.Analyse(map, settings);
+			results[r].Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		// What the analysis found, to tell the terrains apart
+		const std::vector<float>& filled = hydrology.GetFilledHeights();
+		const std::vector<float>& accumulation = hydrology.GetFlowAccumulation();
+		for (size_t i = 0; i < filled.size(); i++)
+		{
+			results[r].raisedPoints += filled[i] > map.GetData()[i] ? 1 : 0;
+			results[r].largestAccumulation = accumulation[i] > results[r].largestAccumulation ? accumulation[i] : results[r].largestAccumulation;
+		}
+	}
+
+	const double points = (double)resolution * resolution;
+	printf("Terrain %d x %d, epsilon %g, %d runs, %d threads\n", resolution, resolution, epsilon, runs,
+		threads > 0 ? threads : (int)std::thread::hardware_concurrency());
+	printf("%-10s %10s %10s %10s %12s %12s\n", "routing", "mean ms", "best ms", "worst ms", "Mpoints/s", "raised");
+	for (int r = 0; r < 2; r++)
+	{
+		printf("%-10s %10.1f %10.1f %10.1f %12.2f %12zu\n", routingNames[r], results[r].MeanMs(), results[r].bestMs, results[r].worstMs,
+			points / (results[r].bestMs * 1000.0), results[r].raisedPoints);
+	}
+
+	std::ofstream file(output, std::ios::binary);
+	char text[512];
+	snprintf(text, sizeof(text),
+		"{\n\t\"benchmark\": \"hydrology\",\n\t\"label\": \"%s\",\n\t\"hardware_threads\": %u,\n\t\"threads\": %d,\n"
+		"\t\"resolution\": %d, \"epsilon\": %g, \"runs\": %d,\n\t\"routings\": [\n",
+		label, std::thread::hardware_concurrency(), threads, resolution, epsilon, runs);
+	file << text;
+	for (int r = 0; r < 2; r++)
+	{
+		snprintf(text, sizeof(text),
+			"\t\t{ \"routing\": \"%s\", \"mean_ms\": %.3f, \"best_ms\": %.3f, \"worst_ms\": %.3f, \"mpoints_per_s\": %.3f, "
+			"\"raised_points\": %zu, \"largest_accumulation\": %.0f }%s\n",
+			routingNames[r], results[r].MeanMs(), results[r].bestMs, results[r].worstMs, points / (results[r].bestMs * 1000.0),
+			results[r].raisedPoints, results[r].largestAccumulation, r == 0 ? "," : "");
+		file << text;
+	}
+	file << "\t]\n}\n";
+	if (!file.good())
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return 0;
+}
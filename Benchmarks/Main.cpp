@@ -0,0 +1,50 @@
+// Main.cpp
+// Command line benchmarks: Benchmarks <name> [arguments]
+#include "Benchmarks.h"
+#include <cstdio>
+#include <cstring>
+
+struct Benchmark
+{
+	const char* name;
+	const char* description;
+	int (*run)(int argc, char** argv);
+};
+
+static const Benchmark benchmarks[] =
+{
+	{ "tokens", "TokenStream string_view mode against the copying mode [file]", RunTokenStreamBenchmark },
+	{ "terrain", "Height map operations across resolutions and thread counts [-r -t -o -l -s -m]", RunTerrainBenchmark },
+	{ "preview", "CPU terrain previews rendered and encoded as PNG [-c -r -s -t -o -d -l -b]", RunPreviewBenchmark },
+	{ "hydrology", "Depression filling and flow accumulation of a large terrain [-r -c -t -e -o -l]", RunHydrologyBenchmark },
+	{ "erosion", "Stream power erosion of a large terrain towards the balance with uplift [-r -i -b -t -k -d -o -l]", RunErosionBenchmark },
+	{ "constraint", "Multigrid terrain through a sketch of pinned heights against smoothing passes [-r -c -t -s -o -l]", RunConstraintBenchmark },
+	{ "mesh", "Import mesh optimisation: welded vertices and ACMR before and after [-f -r -o -l]", RunMeshBenchmark },
+	{ "packing", "Test: round trip of the compact terrain vertex, SSE2 against scalar [-n]", RunPackingTest },
+	{ "texturecache", "Test: texture cache eviction order, pins and byte accounting", RunTextureCacheTest },
+	{ "uploadring", "Test: upload ring frame budget, wrap-around and data after the wraps [-b -c -f -s]", RunUploadRingTest },
+	{ "headless", "Terrain frames on the null render device: CPU time, draws and uploads per frame [-f -r -m -o -l]", RunHeadlessBenchmark },
+};
+
+int main(int argc, char** argv)
+{
+	const int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+	if (argc >= 2)
+	{
+		for (int i = 0; i < benchmarkCount; i++)
+		{
+			if (strcmp(argv[1], benchmarks[i].name) == 0)
+			{
+				return benchmarks[i].run(argc - 2, argv + 2);
+			}
+		}
+	}
+
+	printf("Usage: Benchmarks <name> [arguments]\n");
+	for (int i = 0; i < benchmarkCount; i++)
+	{
+		printf("  %-10s %s\n", benchmarks[i].name, benchmarks[i].description);
+	}
+	return argc >= 2 ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// Mesh benchmark
+// Runs the import mesh optimisation (MeshOptimizer: weld, vertex cache and vertex fetch order) on an OBJ file, or on a
+// generated grid imported as an unwelded triangle soup in random order, and reports the vertex counts and the ACMR
+// (vertex shader runs per triangle with a 16 entry FIFO cache) before and after, written as JSON.
+#include "Benchmarks.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+	// A grid of resolution * resolution vertices as the faces of an OBJ without shared vertices: every triangle has
+	// its own 3 vertices, and the triangles are shuffled
+	void BuildTriangleSoup(int resolution, ObjMesh& mesh)
+	{
+		std::vector<int> triangles;
+		for (int quad = 0; quad < (resolution - 1) * (resolution - 1); quad++)
+		{
+			triangles.push_back(2 * quad);
+			triangles.push_back(2 * quad + 1);
+		}
+		srand(1);
+		for (int i = (int)triangles.size() - 1; i > 0; i--)
+		{
+			std::swap(triangles[i], triangles[rand() % (i + 1)]);
+		}
+
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		for (int triangle : triangles)
+		{
+			int quad = triangle / 2;
+			int m = quad / (resolution - 1);
+			int n = quad % (resolution - 1);
+			// the corners of the two triangles of the quad, as PlaneMesh
+			const int corners[2][3][2] = { { { 0, 0 }, { 1, 0 }, { 0, 1 } }, { { 1, 0 }, { 1, 1 }, { 0, 1 } } };
+			for (const int* corner : corners[triangle % 2])
+			{
+				ObjVertex vertex;
+				vertex.position = XMFLOAT3((float)(n + corner[1]), 0.0f, (float)(m + corner[0]));
+				vertex.texture = XMFLOAT2((float)(n + corner[1]) / resolution, (float)(m + corner[0]) / resolution);
+				vertex.normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				mesh.indices.push_back((uint32_t)mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+			}
+		}
+	}
+}
+
+int RunMeshBenchmark(int argc, char** argv)
+{
+	const char* filename = nullptr;
+	int resolution = 257;
+	const char* output = "mesh_benchmark.json";
+	const char* label = "";
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-f") == 0 && hasValue) filename = argv[++i];
+		else if (strcmp(argv[i], "-r") == 0 && hasValue) resolution = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else
+		{
+			resolution = 0;
+			break;
+		}
+	}
+	if (resolution < 2)
+	{
+		printf("Usage: Benchmarks mesh [-f model.obj] [-r grid resolution] [-o output.json] [-l label]\n");
+		printf("  without a file, a grid is optimised from a shuffled triangle soup\n");
+		return 1;
+	}
+
+	ObjMesh mesh;
+	double loadMs = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	if (filename != nullptr)
+	{
+		if (!ObjParser::load(filename, mesh))
+		{
+			printf("Cannot load %s\n", filename);
+			return 1;
+		}
+	}
+	else
+	{
+		BuildTriangleSoup(resolution, mesh);
+	}
+	loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	MeshOptimizerStats stats = MeshOptimizer::optimize(mesh.vertices, mesh.indices);
+	double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const char* source = filename != nullptr ? filename : "triangle soup grid";
+	printf("Mesh: %s, %d triangles (%s %.1f ms)\n", source, stats.indexCount / 3, filename != nullptr ? "parsed in" : "built in", loadMs);
+	printf("%10s %10s %10s\n", "", "vertices", "ACMR");
+	printf("%10s %10d %10.3f\n", "before", stats.verticesBefore, stats.acmrBefore);
+	printf("%10s %10d %10.3f\n", "after", stats.verticesAfter, stats.acmrAfter);
+	printf("Optimised in %.1f ms\n", optimizeMs);
+
+	std::ofstream file(output, std::ios::binary);
+	char text[1024];
+	snprintf(text, sizeof(text),
+		"{\n\t\"benchmark\": \"mesh\",\n\t\"label\": \"%s\",\n\t\"source\": \"%s\",\n\t\"triangles\": %d,\n"
+		"\t\"vertices_before\": %d, \"vertices_after\": %d,\n\t\"acmr_before\": %.4f, \"acmr_after\": %.4f,\n"
+		"\t\"load_ms\": %.3f, \"optimize_ms\": %.3f\n}\n",
+		label, source, stats.indexCount / 3, stats.verticesBefore, stats.verticesAfter, stats.acmrBefore, stats.acmrAfter,
+		loadMs, optimizeMs);
+	file << text;
+	if (!file.good())
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return 0;
+}
@@ -0,0 +1,147 @@
+// Packing test
+// Round trip of the compact terrain vertex (TerrainVertexPacking): the octahedral normals decode within the error
+// bound of 16 bit snorm, the heights, positions and UVs rebuilt from the vertex index match the full vertices, and
+// the SSE2 paths of EncodeNormals and PackVertices give the same bits as the scalar EncodeNormal.
+#include "Benchmarks.h"
+#include "HeightMap.h"
+#include "TerrainVertexPacking.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Largest angle between a normal and its decoded encoding, in degrees. 16 bit snorm steps are 3e-5 on the
+	// octahedron, a few thousandths of a degree on the sphere
+	const float kMaxNormalErrorDegrees = 0.01f;
+
+	int failures = 0;
+
+	void Check(bool passed, const char* what)
+	{
+		printf("%s %s\n", passed ? "  ok  " : "  FAIL", what);
+		if (!passed)
+		{
+			failures++;
+		}
+	}
+
+	XMFLOAT3 Normalize(float x, float y, float z)
+	{
+		float length = sqrtf(x * x + y * y + z * z);
+		return XMFLOAT3(x / length, y / length, z / length);
+	}
+
+	// Angle between two directions from the cross and the dot product, acos of the dot loses the small angles
+	float AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		double crossX = (double)a.y * b.z - (double)a.z * b.y;
+		double crossY = (double)a.z * b.x - (double)a.x * b.z;
+		double crossZ = (double)a.x * b.y - (double)a.y * b.x;
+		double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+		return (float)(atan2(sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot) * 180.0 / 3.14159265358979323846);
+	}
+}
+
+int RunPackingTest(int argc, char** argv)
+{
+	int count = 100000;
+	if (argc >= 2 && strcmp(argv[0], "-n") == 0)
+	{
+		count = atoi(argv[1]);
+	}
+	else if (argc != 0)
+	{
+		count = 0;
+	}
+	if (count < 4)
+	{
+		printf("Usage: Benchmarks packing [-n normals (4 or more)]\n");
+		return 1;
+	}
+	failures = 0;
+
+	// Random unit normals over the whole sphere, then the axes and the folds of the octahedron
+	srand(1);
+	std::vector<XMFLOAT3> normals;
+	for (int i = 0; i < count; i++)
+	{
+		float x = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+		float y = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+		float z = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+		if (x * x + y * y + z * z < 1e-6f)
+		{
+			y = 1.0f;
+		}
+		normals.push_back(Normalize(x, y, z));
+	}
+	const float special[][3] = { { 0, 1, 0 }, { 0, -1, 0 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 0, 1 }, { -1, 0, -1 }, { 1, -1, 0 }, { 0, -1, -1 }, { 1, -1, 1 }, { -1, -1, 1 } };
+	for (const float* n : special)
+	{
+		normals.push_back(Normalize(n[0], n[1], n[2]));
+	}
+	const int total = (int)normals.size();
+
+	// Scalar round trip
+	float maxError = 0.0f;
+	std::vector<int16_t> scalar(2 * (size_t)total);
+	for (int i = 0; i < total; i++)
+	{
+		TerrainVertexPacking::EncodeNormal(normals[i], &scalar[2 * (size_t)i]);
+		float error = AngleDegrees(normals[i], TerrainVertexPacking::DecodeNormal(&scalar[2 * (size_t)i]));
+		maxError = error > maxError ? error : maxError;
+	}
+	printf("%d normals, largest decode error %.5f degrees\n", total, maxError);
+	Check(maxError <= kMaxNormalErrorDegrees, "octahedral normals decode within the error bound");
+
+	// SSE2 batch against the scalar encoding, with a stride and a count that leaves a remainder
+	std::vector<int16_t> batch(2 * (size_t)total);
+	TerrainVertexPacking::EncodeNormals(normals.data(), sizeof(XMFLOAT3), total, batch.data());
+	Check(memcmp(batch.data(), scalar.data(), batch.size() * sizeof(int16_t)) == 0, "EncodeNormals matches EncodeNormal bit for bit");
+
+	// A terrain packed into compact vertices and rebuilt as terrain_vs does
+	const int resolution = 129;
+	const float spacing = 100.0f / (float)resolution;
+	const float uvIncrement = 10.0f / (float)resolution;
+	HeightMap map;
+	map.Resize(resolution);
+	Range range;
+	range.min = -20.0f;
+	range.max = 20.0f;
+	map.DiamondSquare(range);
+	const int vertexCount = resolution * resolution;
+	std::vector<TerrainVertex> vertices(vertexCount);
+	map.BuildVertices(vertices.data(), spacing, uvIncrement);
+	std::vector<CompactTerrainVertex> packed(vertexCount);
+	TerrainVertexPacking::PackVertices(map.GetData(), &vertices[0].normal, sizeof(TerrainVertex), vertexCount, packed.data());
+
+	bool packedMatches = true;
+	bool positionsMatch = true;
+	bool uvsMatch = true;
+	float maxVertexError = 0.0f;
+	for (int i = 0; i < vertexCount; i++)
+	{
+		int16_t normal[2];
+		TerrainVertexPacking::EncodeNormal(vertices[i].normal, normal);
+		packedMatches = packedMatches && memcmp(&packed[i].height, &map.GetData()[i], sizeof(float)) == 0
+			&& packed[i].normal[0] == normal[0] && packed[i].normal[1] == normal[1];
+
+		TerrainVertex unpacked = TerrainVertexPacking::UnpackVertex(packed[i], i, resolution, spacing, uvIncrement);
+		positionsMatch = positionsMatch && unpacked.position.x == vertices[i].position.x
+			&& unpacked.position.y == vertices[i].position.y && unpacked.position.z == vertices[i].position.z;
+		uvsMatch = uvsMatch && unpacked.texture.x == vertices[i].texture.x && unpacked.texture.y == vertices[i].texture.y;
+		float error = AngleDegrees(unpacked.normal, vertices[i].normal);
+		maxVertexError = error > maxVertexError ? error : maxVertexError;
+	}
+	Check(packedMatches, "PackVertices matches the scalar packing bit for bit");
+	Check(positionsMatch, "positions rebuilt from the vertex index and height are exact");
+	Check(uvsMatch, "UVs rebuilt from the vertex index are exact");
+	printf("%d vertices, largest normal error %.5f degrees\n", vertexCount, maxVertexError);
+	Check(maxVertexError <= kMaxNormalErrorDegrees, "terrain normals decode within the error bound");
+
+	printf(failures == 0 ? "All checks passed\n" : "%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
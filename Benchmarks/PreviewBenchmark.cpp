@@ -0,0 +1,220 @@
+// Preview benchmark
+// Generates terrains and renders a CPU preview of each one (TerrainPreview), timing the generation, the render and the
+// PNG encoding, and writes the results as JSON. The previews can also be saved to look at them.
+// With -b the ambient occlusion and sun shadow of every terrain are baked (HorizonBaker) and lit in the previews.
+// Every preview is also rendered without skipping the nodes of the height pyramid, outside the timings, and the two
+// images have to be identical.
+#include "Benchmarks.h"
+#include "HeightMap.h"
+#include "HorizonBaker.h"
+#include "PngWriter.h"
+#include "TerrainPreview.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const float kTerrainSize = 100.0f;	// world size of the terrain, the same as TerrainMesh
+
+	// Times of one stage over every preview
+	struct Stage
+	{
+		Stage() : totalMs(0.0), bestMs(0.0), worstMs(0.0), count(0) {}
+
+		void Add(double ms)
+		{
+			bestMs = count == 0 || ms < bestMs ? ms : bestMs;
+			worstMs = ms > worstMs ? ms : worstMs;
+			totalMs += ms;
+			count++;
+		}
+		double MeanMs()const { return count > 0 ? totalMs / count : 0.0; }
+
+		double totalMs;
+		double bestMs;
+		double worstMs;
+		int count;
+	};
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// A different terrain for every preview: Diamond-Square when the resolution allows it, waves otherwise
+	void Generate(HeightMap& map, int index)
+	{
+		Range range;
+		range.min = -15.0f;
+		range.max = 15.0f;
+		if (map.DiamondSquare(range))
+		{
+			map.Smooth();
+			return;
+		}
+		WavesData waves;
+		waves.frequency = XMFLOAT3(0.05f + 0.01f * (index % 7), 0.0f, 0.04f + 0.013f * (index % 5));
+		waves.amplitude = XMFLOAT3(6.0f, 0.0f, 4.0f);
+		map.BuildWaves(waves, kTerrainSize / (float)map.GetResolution());
+	}
+}
+
+int RunPreviewBenchmark(int argc, char** argv)
+{
+	int count = 100;
+	int resolution = 257;
+	int size = 512;
+	int threads = 0;
+	const char* output = "preview_benchmark.json";
+	const char* directory = nullptr;
+	const char* label = "";
+	bool bake = false;
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-c") == 0 && hasValue) count = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && hasValue) resolution = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && hasValue) size = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && hasValue) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-d") == 0 && hasValue) directory = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else if (strcmp(argv[i], "-b") == 0) bake = true;
+		else
+		{
+			count = 0;
+			break;
+		}
+	}
+	if (count <= 0 || resolution < 2 || size <= 0 || threads < 0)
+	{
+		printf("Usage: Benchmarks preview [-c previews] [-r resolution] [-s image size] [-t threads] [-o output.json] [-d png directory] [-l label] [-b]\n");
+		printf("  threads 0 uses one per hardware thread, the PNG files are only written with -d, -b bakes the lighting\n");
+		return 1;
+	}
+
+	HeightMap map;
+	map.Resize(resolution);
+	const float spacing = kTerrainSize / (float)resolution;
+	TerrainPreview preview;
+	preview.SetThreadCount(threads);
+	TerrainPreview reference;
+	reference.SetThreadCount(threads);
+	reference.SetNodeSkipping(false);
+	PreviewSettings settings;
+	settings.width = size;
+	settings.height = size;
+	std::vector<unsigned char> png;
+	HorizonBaker baker;
+	baker.SetThreadCount(threads);
+	HorizonBakeSettings bakeSettings;
+	bakeSettings.sunDirection = settings.lightDirection;
+	if (bake)
+	{
+		settings.ambientColour = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
+	}
+
+	Stage generateStage, bakeStage, renderStage, encodeStage;
+	size_t pngBytes = 0;
+	int differentViews = 0;
+	size_t differentPixels = 0;
+	for (int i = 0; i < count; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Generate(map, i);
+		generateStage.Add(Milliseconds(start));
+
+		if (bake)
+		{
+			start = std::chrono::steady_clock::now();
+			baker.Bake(map, spacing, bakeSettings);
+			bakeStage.Add(Milliseconds(start));
+			settings.ambientOcclusion = baker.GetAmbientOcclusion().data();
+			settings.sunShadow = baker.GetSunShadow().data();
+		}
+
+		// Go around the terrain, a different view every preview
+		start = std::chrono::steady_clock::now();
+		settings.camera = TerrainPreview::OrbitCamera(map, spacing, (float)((i * 37) % 360), 35.0f, 1.0f);
+		preview.Render(map, spacing, settings);
+		renderStage.Add(Milliseconds(start));
+
+		reference.Render(map, spacing, settings);
+		size_t different = 0;
+		for (size_t p = 0; p < preview.GetPixels().size(); p += 3)
+		{
+			different += memcmp(&preview.GetPixels()[p], &reference.GetPixels()[p], 3) != 0 ? 1 : 0;
+		}
+		differentViews += different > 0 ? 1 : 0;
+		differentPixels += different;
+
+		start = std::chrono::steady_clock::now();
+		PngWriter::Encode(preview.GetPixels().data(), size, size, 3, png);
+		encodeStage.Add(Milliseconds(start));
+		pngBytes += png.size();
+
+		if (directory)
+		{
+			char filename[512];
+			snprintf(filename, sizeof(filename), "%s/preview_%04d.png", directory, i);
+			std::ofstream file(filename, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(png.data()), (std::streamsize)png.size());
+			if (!file.good())
+			{
+				printf("Cannot write %s\n", filename);
+				return 1;
+			}
+		}
+	}
+
+	// A preview is rendered and encoded, the terrain generation and the bake are not part of it
+	const double previewMs = renderStage.MeanMs() + encodeStage.MeanMs();
+	const double previewsPerMinute = 60000.0 / previewMs;
+	const double nsPerPixel = renderStage.MeanMs() * 1e6 / ((double)size * size);
+	printf("%d previews of %d x %d, terrain %d x %d, %d threads\n", count, size, size, resolution, resolution,
+		threads > 0 ? threads : (int)std::thread::hardware_concurrency());
+	printf("%-10s %10s %10s %10s\n", "stage", "mean ms", "best ms", "worst ms");
+	printf("%-10s %10.3f %10.3f %10.3f\n", "generate", generateStage.MeanMs(), generateStage.bestMs, generateStage.worstMs);
+	if (bake)
+	{
+		printf("%-10s %10.3f %10.3f %10.3f\n", "bake", bakeStage.MeanMs(), bakeStage.bestMs, bakeStage.worstMs);
+	}
+	printf("%-10s %10.3f %10.3f %10.3f\n", "render", renderStage.MeanMs(), renderStage.bestMs, renderStage.worstMs);
+	printf("%-10s %10.3f %10.3f %10.3f\n", "encode", encodeStage.MeanMs(), encodeStage.bestMs, encodeStage.worstMs);
+	printf("%.1f previews per minute, %.1f ns per pixel, %.1f KB per PNG\n", previewsPerMinute, nsPerPixel, pngBytes / 1024.0 / count);
+	printf("%s %zu pixels in %d views differ from the render without node skipping\n", differentPixels == 0 ? "  ok  " : "  FAIL",
+		differentPixels, differentViews);
+
+	std::ofstream file(output, std::ios::binary);
+	char text[2048];
+	snprintf(text, sizeof(text),
+		"{\n\t\"benchmark\": \"preview\",\n\t\"label\": \"%s\",\n\t\"hardware_threads\": %u,\n\t\"threads\": %d,\n"
+		"\t\"previews\": %d, \"image_size\": %d, \"resolution\": %d,\n"
+		"\t\"generate_ms\": { \"mean\": %.4f, \"best\": %.4f, \"worst\": %.4f },\n"
+		"\t\"bake\": %s, \"bake_ms\": { \"mean\": %.4f, \"best\": %.4f, \"worst\": %.4f },\n"
+		"\t\"render_ms\": { \"mean\": %.4f, \"best\": %.4f, \"worst\": %.4f },\n"
+		"\t\"encode_ms\": { \"mean\": %.4f, \"best\": %.4f, \"worst\": %.4f },\n"
+		"\t\"render_ns_per_pixel\": %.4f, \"png_bytes_mean\": %.0f, \"previews_per_minute\": %.2f,\n"
+		"\t\"reference_different_pixels\": %zu, \"reference_different_views\": %d\n}\n",
+		label, std::thread::hardware_concurrency(), threads, count, size, resolution,
+		generateStage.MeanMs(), generateStage.bestMs, generateStage.worstMs,
+		bake ? "true" : "false", bakeStage.MeanMs(), bakeStage.bestMs, bakeStage.worstMs,
+		renderStage.MeanMs(), renderStage.bestMs, renderStage.worstMs,
+		encodeStage.MeanMs(), encodeStage.bestMs, encodeStage.worstMs,
+		nsPerPixel, (double)pngBytes / count, previewsPerMinute, differentPixels, differentViews);
+	file << text;
+	if (!file.good())
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return differentPixels == 0 ? 0 : 1;
+}
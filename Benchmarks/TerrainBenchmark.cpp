@@ -0,0 +1,294 @@
+// Terrain benchmark
+// Times every HeightMap operation over a range of resolutions and thread counts and writes the results as JSON,
+// so runs from different commits can be compared.
+#include "Benchmarks.h"
+#include "HeightMap.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const int kParticles = 100000;		// particles dropped by one run of the particle operations
+	const int kMaxRuns = 50;			// runs of one measurement, if they are shorter than the minimum time
+
+	struct Context
+	{
+		HeightMap map;
+		std::vector<TerrainVertex> vertices;
+		std::vector<int> particleRows;
+		std::vector<int> particleColumns;
+		WavesData waves;
+		Range range;
+	};
+
+	struct Operation
+	{
+		const char* name;
+		const char* unit;	// what an item is, the time and the bandwidth are given per item
+		bool threaded;		// false if the thread count does not change anything
+		int bytesPerItem;	// memory read and written for one item, assuming the neighbourhoods come from the cache
+		bool (*run)(Context& context);
+	};
+
+	float Spacing(const Context& context)
+	{
+		return 100.0f / (float)context.map.GetResolution();
+	}
+
+	bool RunBuildWaves(Context& context) { context.map.BuildWaves(context.waves, Spacing(context)); return true; }
+	bool RunBuildRandom(Context& context) { context.map.BuildRandom(context.range); return true; }
+	bool RunFlatten(Context& context) { context.map.Flatten(); return true; }
+	bool RunFault(Context& context) { context.map.Fault(context.range); return true; }
+	bool RunSmooth(Context& context) { context.map.Smooth(); return true; }
+	bool RunDiamondSquare(Context& context) { return context.map.DiamondSquare(context.range); }
+
+	bool RunParticleDeposition(Context& context)
+	{
+		for (int i = 0; i < kParticles; i++)
+		{
+			context.map.ParticleDeposition(context.particleRows[i], context.particleColumns[i], 2.0f);
+		}
+		return true;
+	}
+
+	bool RunAntiParticleDeposition(Context& context)
+	{
+		for (int i = 0; i < kParticles; i++)
+		{
+			context.map.AntiParticleDeposition(context.particleRows[i], context.particleColumns[i], 2.0f);
+		}
+		return true;
+	}
+
+	bool RunBuildVertices(Context& context)
+	{
+		int resolution = context.map.GetResolution();
+		context.map.BuildVertices(context.vertices.data(), Spacing(context), 10.0f / (float)resolution);
+		return true;
+	}
+
+	// TerrainMesh::BuildCustomHeightMap, BuildRandomHeightMap, ..., and the vertex and normal part of Regenerate
+	const Operation operations[] =
+	{
+		{ "BuildWaves", "texel", true, 4, RunBuildWaves },
+		{ "BuildRandom", "texel", true, 4, RunBuildRandom },
+		{ "Flatten", "texel", true, 4, RunFlatten },
+		{ "Fault", "texel", true, 8, RunFault },
+		{ "Smooth", "texel", true, 8, RunSmooth },
+		{ "DiamondSquare", "texel", true, 8, RunDiamondSquare },
+		{ "ParticleDeposition", "particle", false, 40, RunParticleDeposition },
+		{ "AntiParticleDeposition", "particle", false, 40, RunAntiParticleDeposition },
+		{ "BuildVertices", "texel", true, 4 + (int)sizeof(TerrainVertex), RunBuildVertices },
+	};
+
+	struct Result
+	{
+		const Operation* operation;
+		int resolution;
+		int threads;
+		double items;
+		int runs;
+		double bestMs;
+		double meanMs;
+	};
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Comma separated list of integers, returns false if it is not one
+	bool ParseList(const char* text, std::vector<int>& values)
+	{
+		values.clear();
+		while (*text)
+		{
+			char* end;
+			long value = strtol(text, &end, 10);
+			if (end == text || value <= 0)
+			{
+				return false;
+			}
+			values.push_back((int)value);
+			text = *end == ',' ? end + 1 : end;
+			if (*end != ',' && *end != '\0')
+			{
+				return false;
+			}
+		}
+		return !values.empty();
+	}
+
+	bool WriteJson(const char* filename, const char* label, const std::vector<Result>& results)
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		char line[512];
+		snprintf(line, sizeof(line), "{\n\t\"benchmark\": \"terrain\",\n\t\"label\": \"%s\",\n\t\"hardware_threads\": %u,\n\t\"results\": [\n",
+			label, std::thread::hardware_concurrency());
+		file << line;
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& result = results[i];
+			double nsPerItem = result.bestMs * 1e6 / result.items;
+			double gbPerSecond = result.operation->bytesPerItem * result.items / (result.bestMs * 1e6);
+			snprintf(line, sizeof(line),
+				"\t\t{ \"op\": \"%s\", \"resolution\": %d, \"threads\": %d, \"unit\": \"%s\", \"items\": %.0f, \"runs\": %d, "
+				"\"best_ms\": %.4f, \"mean_ms\": %.4f, \"ns_per_item\": %.4f, \"gb_per_s\": %.4f }%s\n",
+				result.operation->name, result.resolution, result.threads, result.operation->unit, result.items, result.runs,
+				result.bestMs, result.meanMs, nsPerItem, gbPerSecond, i + 1 < results.size() ? "," : "");
+			file << line;
+		}
+		file << "\t]\n}\n";
+		return file.good();
+	}
+}
+
+int RunTerrainBenchmark(int argc, char** argv)
+{
+	std::vector<int> resolutions = { 33, 65, 129, 257, 513, 1025, 2049, 4097, 8193 };
+	std::vector<int> threadCounts;
+	const char* output = "terrain_benchmark.json";
+	const char* label = "";
+	double minMs = 200.0;	// measure for at least this long
+	double maxMs = 10000.0;	// skip runs expected to take longer than this
+
+	int hardwareThreads = (int)std::thread::hardware_concurrency();
+	for (int threads = 1; threads < hardwareThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads > 0 ? hardwareThreads : 1);
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-r") == 0 && hasValue && ParseList(argv[i + 1], resolutions)) i++;
+		else if (strcmp(argv[i], "-t") == 0 && hasValue && ParseList(argv[i + 1], threadCounts)) i++;
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) output = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0 && hasValue) label = argv[++i];
+		else if (strcmp(argv[i], "-s") == 0 && hasValue) minMs = atof(argv[++i]) * 1000.0;
+		else if (strcmp(argv[i], "-m") == 0 && hasValue) maxMs = atof(argv[++i]) * 1000.0;
+		else
+		{
+			printf("Usage: Benchmarks terrain [-r resolutions] [-t threads] [-o output.json] [-l label] [-s min seconds] [-m max seconds]\n");
+			printf("  resolutions and threads are comma separated lists, e.g. -r 129,1025 -t 1,4\n");
+			return 1;
+		}
+	}
+
+	const int operationCount = sizeof(operations) / sizeof(operations[0]);
+	std::vector<Result> results;
+	// Best time per item at the previous resolution, to skip the runs that would take too long
+	std::vector<double> msPerItem(operationCount * threadCounts.size(), 0.0);
+
+	printf("%-24s %10s %8s %12s %12s %10s\n", "operation", "resolution", "threads", "best ms", "ns/item", "GB/s");
+	for (int resolution : resolutions)
+	{
+		Context context;
+		context.waves.frequency = XMFLOAT3(0.3f, 0.0f, 0.2f);
+		context.waves.amplitude = XMFLOAT3(4.0f, 0.0f, 3.0f);
+		context.range.min = -5.0f;
+		context.range.max = 5.0f;
+
+		try
+		{
+			context.map.Resize(resolution);
+			context.vertices.resize((size_t)resolution * resolution);
+		}
+		catch (const std::bad_alloc&)
+		{
+			printf("%d x %d: out of memory, skipped\n", resolution, resolution);
+			continue;
+		}
+		context.map.BuildWaves(context.waves, Spacing(context));
+
+		// The same particles for every run, so the random numbers are not timed
+		unsigned int seed = 12345;
+		for (int i = 0; i < kParticles; i++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			context.particleRows.push_back((int)((seed >> 8) % (unsigned int)resolution));
+			seed = seed * 1664525u + 1013904223u;
+			context.particleColumns.push_back((int)((seed >> 8) % (unsigned int)resolution));
+		}
+
+		for (int o = 0; o < operationCount; o++)
+		{
+			const Operation& operation = operations[o];
+			double items = strcmp(operation.unit, "particle") == 0 ? (double)kParticles : (double)resolution * resolution;
+
+			for (size_t t = 0; t < threadCounts.size(); t++)
+			{
+				if (!operation.threaded && t > 0)
+				{
+					break;
+				}
+				int threads = operation.threaded ? threadCounts[t] : 1;
+				double& previousMsPerItem = msPerItem[o * threadCounts.size() + t];
+				if (previousMsPerItem * items > maxMs)
+				{
+					printf("%-24s %10d %8d     skipped (about %.0f ms per run)\n", operation.name, resolution, threads, previousMsPerItem * items);
+					continue;
+				}
+
+				context.map.SetThreadCount(threads);
+				Result result = { &operation, resolution, threads, items, 0, 0.0, 0.0 };
+				double totalMs = 0.0;
+				bool supported = true;
+				while (result.runs < kMaxRuns && (result.runs == 0 || totalMs < minMs))
+				{
+					auto start = std::chrono::steady_clock::now();
+					supported = operation.run(context);
+					double ms = Milliseconds(start);
+					if (!supported)
+					{
+						break;
+					}
+					if (result.runs == 0 || ms < result.bestMs)
+					{
+						result.bestMs = ms;
+					}
+					totalMs += ms;
+					result.runs++;
+				}
+				if (!supported)
+				{
+					printf("%-24s %10d %8d     not supported at this resolution\n", operation.name, resolution, threads);
+					break;
+				}
+
+				result.meanMs = totalMs / result.runs;
+				previousMsPerItem = result.bestMs / items;
+				results.push_back(result);
+				printf("%-24s %10d %8d %12.3f %12.3f %10.2f\n", operation.name, resolution, threads, result.bestMs,
+					result.bestMs * 1e6 / items, operation.bytesPerItem * items / (result.bestMs * 1e6));
+
+				// Keep the heights in a sensible range for the next operations
+				if (operation.run == RunFault || operation.run == RunParticleDeposition || operation.run == RunAntiParticleDeposition)
+				{
+					context.map.BuildWaves(context.waves, Spacing(context));
+				}
+			}
+		}
+	}
+
+	if (!WriteJson(output, label, results))
+	{
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	printf("Results written to %s\n", output);
+	return 0;
+}
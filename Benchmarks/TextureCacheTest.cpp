@@ -0,0 +1,149 @@
+// Texture cache test
+// TextureCache without a device: the textures are plain integers and the release function records the order they are
+// released in. Checks the LRU eviction order, the pins of names (also taken before the name is bound), the byte
+// accounting through inserts, replacements, evictions and clear, and names sharing one texture.
+#include "Benchmarks.h"
+#include "TextureCache.h"
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool passed, const char* what)
+	{
+		printf("%s %s\n", passed ? "  ok  " : "  FAIL", what);
+		if (!passed)
+		{
+			failures++;
+		}
+	}
+
+	// Textures are the addresses of these, so a released texture tells which one it was
+	int textures[8];
+
+	void* Texture(int index)
+	{
+		return &textures[index];
+	}
+
+	void RecordRelease(void* texture, void* user)
+	{
+		static_cast<std::vector<int>*>(user)->push_back((int)(static_cast<int*>(texture) - textures));
+	}
+
+	// Insert texture 'index' under content key index + 1 and bind the name index + 100 to it
+	void Load(TextureCache& cache, int index, size_t bytes)
+	{
+		cache.insert((TextureCache::Key)index + 1, Texture(index), bytes);
+		cache.bind((TextureCache::Key)index + 100, (TextureCache::Key)index + 1);
+	}
+
+	TextureCache::Key Name(int index)
+	{
+		return (TextureCache::Key)index + 100;
+	}
+}
+
+int RunTextureCacheTest(int argc, char** argv)
+{
+	(void)argv;
+	if (argc != 0)
+	{
+		printf("Usage: Benchmarks texturecache\n");
+		return 1;
+	}
+	failures = 0;
+
+	// Eviction order: 4 textures of 100 bytes in a 300 byte budget, texture 0 is used again before the 4th is loaded
+	{
+		std::vector<int> released;
+		TextureCache cache(300, RecordRelease, &released);
+		Load(cache, 0, 100);
+		Load(cache, 1, 100);
+		Load(cache, 2, 100);
+		Check(cache.getUsedBytes() == 300 && cache.getTextureCount() == 3 && released.empty(), "textures within the budget are kept");
+		cache.get(Name(0));
+		Load(cache, 3, 100);
+		Check(released.size() == 1 && released[0] == 1, "the least recently used texture is evicted first");
+		Check(cache.get(Name(1)) == nullptr && cache.get(Name(0)) == Texture(0), "an evicted name reads nullptr, the used one is kept");
+		Check(cache.getUsedBytes() == 300 && cache.getEvictionCount() == 1, "bytes and evictions after an eviction");
+
+		// A budget of a single texture: 2 and 3 were used least recently (0 was read above)
+		cache.setBudget(100);
+		Check(released.size() == 3 && released[1] == 2 && released[2] == 3, "a smaller budget evicts in LRU order");
+		Check(cache.getUsedBytes() == 100 && cache.getTextureCount() == 1, "bytes after the budget change");
+
+		// The name of an evicted texture stays bound to its content
+		cache.setBudget(300);
+		Load(cache, 1, 50);
+		cache.insert(3, Texture(2), 100);
+		Check(cache.get(Name(2)) == Texture(2), "reinserting evicted content makes its name valid again");
+		Check(cache.getUsedBytes() == 250, "bytes after reinsertion");
+	}
+
+	// Pins: a pinned texture is skipped, even when it is the least recently used
+	{
+		std::vector<int> released;
+		TextureCache cache(200, RecordRelease, &released);
+		Load(cache, 0, 100);
+		Load(cache, 1, 100);
+		cache.acquire(Name(0));
+		Load(cache, 2, 100);
+		Check(released.size() == 1 && released[0] == 1, "a pinned texture is not evicted");
+		cache.acquire(Name(0));
+		cache.release(Name(0));
+		Check(released.size() == 1, "pins are counted per acquire");
+
+		// Nothing else can be evicted: the texture just inserted is kept over the budget
+		cache.acquire(Name(2));
+		Load(cache, 3, 100);
+		Check(released.size() == 1 && cache.getUsedBytes() == 300, "pinned textures can go over the budget");
+		cache.release(Name(0));
+		Check(released.size() == 2 && released[1] == 0 && cache.getUsedBytes() == 200, "releasing the last pin evicts down to the budget");
+
+		// A name pinned before it is bound pins the texture it is bound to
+		cache.acquire(Name(5));
+		Load(cache, 5, 100);
+		Check(released.size() == 3 && released[2] == 3 && cache.get(Name(5)) == Texture(5), "a pin taken before the bind holds the texture");
+
+		// Extra releases are ignored, so the pin taken after them still holds
+		cache.release(Name(2));
+		cache.release(Name(5));
+		cache.release(Name(5));
+		cache.acquire(Name(5));
+		cache.setBudget(0);
+		Check(cache.get(Name(5)) == Texture(5) && cache.getUsedBytes() == 100, "releasing more than acquired is ignored");
+	}
+
+	// Byte accounting: replacing content releases the old texture, shared content is stored once, clear releases all
+	{
+		std::vector<int> released;
+		TextureCache cache(1000, RecordRelease, &released);
+		Load(cache, 0, 100);
+		cache.insert(1, Texture(0), 400);
+		Check(cache.getUsedBytes() == 100 && released.empty(), "inserting the same texture again changes nothing");
+		cache.insert(1, Texture(1), 250);
+		Check(cache.getUsedBytes() == 250 && released.size() == 1 && released[0] == 0, "replaced content releases the old texture");
+		Check(cache.get(Name(0)) == Texture(1), "the name reads the replacement");
+
+		cache.bind(Name(7), 1);
+		Check(cache.get(Name(7)) == Texture(1) && cache.getTextureCount() == 1 && cache.getUsedBytes() == 250, "two names share one texture");
+		cache.acquire(Name(7));
+		cache.bind(Name(7), 3);
+		Load(cache, 2, 100);
+		cache.setBudget(100);
+		Check(cache.get(Name(0)) == nullptr && cache.get(Name(7)) == Texture(2), "a rebound name moves its pins to the new texture");
+
+		cache.clear();
+		Check(cache.getUsedBytes() == 0 && cache.getTextureCount() == 0 && released.size() == 3, "clear releases every texture");
+	}
+
+	// Path keys ignore case and slash direction, and differ from the name of the same string
+	Check(TextureCache::hashPath(L"res/Grass.PNG") == TextureCache::hashPath(L"RES\\grass.png"), "paths hash the same whatever the case and slashes");
+	Check(TextureCache::hashPath(L"res/grass.png") != TextureCache::hashName(L"res/grass.png"), "a path and a uid of the same text differ");
+
+	printf(failures == 0 ? "All checks passed\n" : "%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+// TokenStream benchmark
+// Tokenizes the same text with the copying and the borrowing TokenStream modes and reports tokens per second.
+#include "Benchmarks.h"
+#include "TokenStream.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// About 'size' bytes of OBJ like text (vertices, texture coordinates, normals and faces)
+	std::string GenerateText(size_t size)
+	{
+		std::string text;
+		text.reserve(size + 128);
+		char line[128];
+		unsigned int seed = 12345;
+		for (int i = 0; text.size() < size; i++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			float r = (seed >> 8) / 16777216.0f;
+			switch (i % 4)
+			{
+			case 0: snprintf(line, sizeof(line), "v %f %f %f\n", r * 100.0f, r * 5.0f - 2.5f, 100.0f - r * 100.0f); break;
+			case 1: snprintf(line, sizeof(line), "vt %f %f\n", r, 1.0f - r); break;
+			case 2: snprintf(line, sizeof(line), "vn %f %f %f\n", r - 0.5f, 0.7f, 0.5f - r); break;
+			default: snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\r\n", i, i, i, i + 1, i + 1, i + 1, i + 2, i + 2, i + 2); break;
+			}
+			text += line;
+		}
+		return text;
+	}
+
+	double Seconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+int RunTokenStreamBenchmark(int argc, char** argv)
+{
+	std::string text;
+	if (argc >= 1)
+	{
+		std::ifstream file(argv[0], std::ios::binary);
+		if (!file)
+		{
+			printf("Cannot open %s\n", argv[0]);
+			return 1;
+		}
+		std::stringstream contents;
+		contents << file.rdbuf();
+		text = contents.str();
+	}
+	else
+	{
+		text = GenerateText(32 << 20);
+	}
+
+	char delimiters[] = { ' ', '\n', '\r', '/', '\t' };
+	const int totalDelimiters = sizeof(delimiters) / sizeof(delimiters[0]);
+	const double megabytes = text.size() / (1024.0 * 1024.0);
+	printf("Tokenizing %.1f MB\n", megabytes);
+
+	// Copying mode: the whole text is copied and every token is copied into a std::string
+	TokenStream copying;
+	std::string token;
+	size_t copyingTokens = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	copying.SetTokenStream(&text[0]);
+	while (copying.GetNextToken(&token, delimiters, totalDelimiters))
+	{
+		copyingTokens++;
+	}
+	double copyingTime = Seconds(start);
+
+	// Borrowing mode: tokens are views into the text
+	TokenStream borrowing;
+	std::string_view view;
+	size_t borrowingTokens = 0;
+	start = std::chrono::high_resolution_clock::now();
+	borrowing.SetTokenStream(std::string_view(text));
+	borrowing.SetDelimiters(delimiters, totalDelimiters);
+	while (borrowing.GetNextToken(&view))
+	{
+		borrowingTokens++;
+	}
+	double borrowingTime = Seconds(start);
+
+	// Lines with the borrowing mode
+	size_t lines = 0;
+	start = std::chrono::high_resolution_clock::now();
+	borrowing.SetTokenStream(std::string_view(text));
+	while (borrowing.MoveToNextLine(&view))
+	{
+		lines++;
+	}
+	double lineTime = Seconds(start);
+
+	printf("%-22s %12s %14s %10s\n", "", "tokens", "tokens/s", "MB/s");
+	printf("%-22s %12zu %14.0f %10.1f\n", "copying std::string", copyingTokens, copyingTokens / copyingTime, megabytes / copyingTime);
+	printf("%-22s %12zu %14.0f %10.1f\n", "borrowing string_view", borrowingTokens, borrowingTokens / borrowingTime, megabytes / borrowingTime);
+	printf("Speedup: %.2fx\n", copyingTime / borrowingTime);
+	printf("Lines (string_view): %zu in %.3f s, %.1f MB/s\n", lines, lineTime, megabytes / lineTime);
+
+	if (copyingTokens != borrowingTokens)
+	{
+		printf("Token counts differ\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,155 @@
+// Upload ring test
+// Streams data through UploadRing with the recording backend (system memory, no device) as the terrain does: as many
+// chunks every frame as the frame budget allows, the rest in the next frames. Checks that no frame goes over the budget,
+// that the ring wraps around with a discard and never overwrites a range used since the last discard, and that the
+// bytes arrive intact after the wraps.
+#include "Benchmarks.h"
+#include "UploadRing.h"
+#include "RecordingUploadBackend.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool passed, const char* what)
+	{
+		printf("%s %s\n", passed ? "  ok  " : "  FAIL", what);
+		if (!passed)
+		{
+			failures++;
+		}
+	}
+}
+
+int RunUploadRingTest(int argc, char** argv)
+{
+	// 2500 bytes in chunks of 100 with a budget of 300 bytes per frame, through a ring of 1 KB that wraps every 9 chunks
+	size_t totalBytes = 2500;
+	size_t chunkBytes = 100;
+	size_t frameBudget = 300;
+	size_t ringSize = 1024;
+
+	for (int i = 0; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-b") == 0 && hasValue) totalBytes = (size_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && hasValue) chunkBytes = (size_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-f") == 0 && hasValue) frameBudget = (size_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && hasValue) ringSize = (size_t)atoi(argv[++i]);
+		else
+		{
+			chunkBytes = 0;
+			break;
+		}
+	}
+	if (chunkBytes == 0 || chunkBytes > frameBudget || chunkBytes > ringSize || totalBytes == 0)
+	{
+		printf("Usage: Benchmarks uploadring [-b bytes] [-c chunk bytes] [-f frame budget] [-s ring size]\n");
+		printf("  a chunk has to fit the frame budget and the ring\n");
+		return 1;
+	}
+	failures = 0;
+
+	std::vector<unsigned char> source(totalBytes);
+	for (size_t i = 0; i < totalBytes; i++)
+	{
+		source[i] = (unsigned char)(i * 7 + i / 251);
+	}
+
+	RecordingUploadBackend* backend = new RecordingUploadBackend();
+	UploadRing ring(backend, ringSize, frameBudget);
+	// The recording backend copies into vectors, passed as buffers as NullRenderDevice does
+	std::vector<unsigned char> destination;
+	GpuBuffer* destinationBuffer = reinterpret_cast<GpuBuffer*>(&destination);
+
+	// Every frame uploads chunks until the budget is used, as TerrainMesh::StreamVertices does
+	size_t uploaded = 0;
+	int frames = 0;
+	bool budgetKept = true;
+	bool oneAllocation = true;
+	while (uploaded < totalBytes && frames < 10000)
+	{
+		ring.beginFrame();
+		frames++;
+		while (uploaded < totalBytes)
+		{
+			size_t bytes = totalBytes - uploaded < chunkBytes ? totalBytes - uploaded : chunkBytes;
+			void* memory = ring.allocate(bytes);
+			if (!memory)
+			{
+				break;
+			}
+			oneAllocation = oneAllocation && ring.allocate(bytes, false) == nullptr;
+			memcpy(memory, source.data() + uploaded, bytes);
+			ring.upload(destinationBuffer, uploaded);
+			uploaded += bytes;
+		}
+		budgetKept = budgetKept && ring.getFrameBytes() <= frameBudget;
+	}
+	ring.beginFrame();
+
+	const size_t chunksPerFrame = frameBudget / chunkBytes;
+	const int expectedFrames = (int)((totalBytes + chunksPerFrame * chunkBytes - 1) / (chunksPerFrame * chunkBytes));
+	printf("%zu bytes in chunks of %zu, budget %zu, ring %zu: %d frames, peak %zu bytes, %u discards\n",
+		totalBytes, chunkBytes, frameBudget, ring.getSize(), frames, ring.getPeakFrameBytes(), ring.getDiscardCount());
+	Check(uploaded == totalBytes && ring.getTotalBytes() == totalBytes, "every byte is uploaded");
+	Check(budgetKept && ring.getPeakFrameBytes() <= frameBudget, "no frame goes over the budget");
+	Check(frames == expectedFrames, "each frame uses as much of the budget as whole chunks allow");
+	Check(oneAllocation, "there is one allocation at a time");
+
+	// Walk the log: copies are aligned and inside the ring, and between two discards they never share a byte
+	const std::vector<UploadRecord>& records = backend->getRecords();
+	unsigned int discards = 0;
+	size_t epochEnd = 0;
+	bool aligned = true;
+	bool noOverwrite = true;
+	bool balanced = true;
+	int maps = 0;
+	for (size_t r = 0; r < records.size(); r++)
+	{
+		const UploadRecord& record = records[r];
+		switch (record.type)
+		{
+		case UploadRecord::kMapDiscard:
+			discards++;
+			epochEnd = 0;
+			// fall through
+		case UploadRecord::kMapNoOverwrite:
+			balanced = balanced && maps == 0;
+			maps++;
+			break;
+		case UploadRecord::kUnmap:
+			balanced = balanced && maps == 1;
+			maps--;
+			break;
+		case UploadRecord::kCopy:
+			aligned = aligned && record.ringOffset % UploadRing::alignment == 0 && record.ringOffset + record.size <= ring.getSize();
+			noOverwrite = noOverwrite && record.ringOffset >= epochEnd;
+			epochEnd = record.ringOffset + record.size;
+			break;
+		}
+	}
+	Check(balanced && !backend->isMapped(), "every map is unmapped before the next one");
+	Check(discards == ring.getDiscardCount() && discards >= 2, "the ring wraps around with a discard");
+	Check(records.empty() == false && records[0].type == UploadRecord::kMapDiscard, "the first map discards the ring");
+	Check(aligned, "allocations are aligned and inside the ring");
+	Check(noOverwrite, "no range is written twice between two discards");
+	Check(destination.size() == totalBytes && memcmp(destination.data(), source.data(), totalBytes) == 0, "the bytes are intact after the wraps");
+
+	// Limits: an unbudgeted allocation ignores the budget left, nothing larger than the ring fits
+	void* unbudgeted = ring.allocate(frameBudget + 1 <= ring.getSize() ? frameBudget + 1 : ring.getSize(), false);
+	if (unbudgeted)
+	{
+		ring.upload(destinationBuffer, 0);
+	}
+	Check(unbudgeted != nullptr, "an unbudgeted allocation can go over the budget");
+	Check(ring.allocate(1) == nullptr || frameBudget >= ring.getSize(), "a budgeted allocation fails once the budget is used");
+	Check(ring.allocate(ring.getSize() + 1, false) == nullptr, "an allocation larger than the ring fails");
+
+	printf(failures == 0 ? "All checks passed\n" : "%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
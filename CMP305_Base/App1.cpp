@@ -4,6 +4,21 @@ App1::App1()
 {
 	m_Terrain = nullptr;
 	shader = nullptr;
+	terrainShader = nullptr;
+	showProfiler = false;
+	walkOnTerrain = false;
+	scatterMs = 0.0;
+	previewYaw = 30.0f;
+	previewPitch = 35.0f;
+	previewMs = 0.0;
+	previewBakedLighting = false;
+	bakeMs = 0.0;
+	hydrologyMs = 0.0;
+	erosionMs = 0.0;
+	constraintX = 50.0f;
+	constraintZ = 50.0f;
+	constraintHeight = 10.0f;
+	constraintMs = 0.0;
 }
 
 void App1::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeight, Input *in, bool VSYNC, bool FULL_SCREEN)
@@ -11,27 +26,27 @@ void App1::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeigh
 	// Call super/parent init function (required!)
 	BaseApplication::init(hinstance, hwnd, screenWidth, screenHeight, in, VSYNC, FULL_SCREEN);
 
-	// Load textures
-	textureMgr->loadTexture(L"grass", L"res/grass.png");
-	textureMgr->loadTexture(L"white", L"res/DefaultDiffuse.png");
+	// Load textures in the background, the default white texture is used until they are ready
+	assetLoader->loadTexture(L"grass", L"res/grass.png");
+	assetLoader->loadTexture(L"white", L"res/DefaultDiffuse.png");
 
 	// Create Mesh object and shader object
-	m_Terrain = new TerrainMesh(renderer->getDevice(), renderer->getDeviceContext(), 5);
-	shader = new LightShader(renderer->getDevice(), hwnd);
+	m_Terrain = new TerrainMesh(renderer, 5, uploadRing);
+	shader = new LightShader(renderer, hwnd);
+	terrainShader = new TerrainShader(renderer, hwnd);
 	
 	// Initialise light
 	light = new Light();
 	light->setDiffuseColour(1.0f, 1.0f, 1.0f, 1.0f);
+	light->setAmbientColour(0.3f, 0.3f, 0.3f, 1.0f);
 	light->setDirection(1.0f, -1.0f, 0.0f);
 
 }
 
 
+// The base application destructor runs afterwards, the meshes and shaders are released before the renderer
 App1::~App1()
 {
-	// Run base application deconstructor
-	BaseApplication::~BaseApplication();
-
 	// Release the Direct3D object.
 	if (m_Terrain)
 	{
@@ -44,6 +59,12 @@ App1::~App1()
 		delete shader;
 		shader = 0;
 	}
+
+	if (terrainShader)
+	{
+		delete terrainShader;
+		terrainShader = 0;
+	}
 }
 
 
@@ -56,6 +77,16 @@ bool App1::frame()
 	{
 		return false;
 	}
+
+	// Continue uploading the terrain vertices changed in the previous frames
+	m_Terrain->StreamVertices();
+
+	// Follow the ground, the camera has already moved this frame
+	if (walkOnTerrain) {
+		XMFLOAT3 position = camera->getPosition();
+		float ground = m_Terrain->GetGroundHeight(position.x, position.z);
+		camera->setPosition(position.x, ground + 2.0f, position.z);
+	}
 	
 	// Render the graphics.
 	result = render();
@@ -69,6 +100,7 @@ bool App1::frame()
 
 bool App1::render()
 {
+	PROFILE_FUNCTION();
 	XMMATRIX worldMatrix, viewMatrix, projectionMatrix;
 
 	// Clear the scene. (default blue colour)
@@ -83,25 +115,45 @@ bool App1::render()
 	projectionMatrix = renderer->getProjectionMatrix();
 
 	// Send geometry data, set shader parameters, render object with shader
-	m_Terrain->sendData(renderer->getDeviceContext());
-	shader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"grass"), light);
-	shader->render(renderer->getDeviceContext(), m_Terrain->getIndexCount());
+	m_Terrain->sendData(renderer);
+	BaseShader* terrainRenderShader;
+	if (m_Terrain->GetCompactVertices())
+	{
+		// the compact vertices only hold height and normal, terrain_vs rebuilds the rest
+		terrainShader->setShaderParameters(renderer, worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"grass"), light,
+			m_Terrain->GetResolution(), m_Terrain->GetVertexSpacing(), m_Terrain->GetUVIncrement());
+		terrainRenderShader = terrainShader;
+	}
+	else
+	{
+		shader->setShaderParameters(renderer, worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"grass"), light);
+		terrainRenderShader = shader;
+	}
+	// the terrain indices are relative to the first vertex of each chunk
+	for (const IndexChunk& chunk : m_Terrain->GetIndexChunks())
+	{
+		terrainRenderShader->render(renderer, chunk.indexCount, chunk.indexStart, chunk.baseVertex);
+	}
 
 	// Render GUI
 	gui();
 
 	// Swap the buffers
-	renderer->endScene();
+	{
+		PROFILE_ZONE("Present");
+		renderer->endScene();
+	}
 
 	return true;
 }
 
 void App1::gui()
 {
+	PROFILE_FUNCTION();
 	// Force turn off unnecessary shader stages.
-	renderer->getDeviceContext()->GSSetShader(NULL, NULL, 0);
-	renderer->getDeviceContext()->HSSetShader(NULL, NULL, 0);
-	renderer->getDeviceContext()->DSSetShader(NULL, NULL, 0);
+	renderer->setShader(kGeometryShader, nullptr);
+	renderer->setShader(kHullShader, nullptr);
+	renderer->setShader(kDomainShader, nullptr);
 
 	// Build UI //
 	// FPS
@@ -111,10 +163,39 @@ void App1::gui()
 	XMFLOAT3 cameraPos = camera->getPosition();
 	ImGui::Text("Camera Pos: (%.2f, %.2f, %.2f)", cameraPos.x, cameraPos.y, cameraPos.z);
 
+	// Texture memory
+	const TextureCache& textures = textureMgr->getCache();
+	ImGui::Text("Textures: %d, %.1f / %.0f MB (%d evicted)", (int)textures.getTextureCount(),
+		textures.getUsedBytes() / (1024.0f * 1024.0f), textures.getBudget() / (1024.0f * 1024.0f), (int)textures.getEvictionCount());
+
+	// CPU profiler
+	ImGui::Checkbox("Profiler", &showProfiler);
+	if (showProfiler) {
+		Profiler::drawGui(&showProfiler);
+	}
+
 	// Title for terrain general settings
 	ImGui::Text("\nTerrain General Settings:");
 	// Wireframe mode
 	ImGui::Checkbox("Wireframe mode", &wireframeToggle);
+	// Camera ground following
+	ImGui::Checkbox("Walk on terrain", &walkOnTerrain);
+	// Compact vertex format
+	bool compactVertices = m_Terrain->GetCompactVertices();
+	if (ImGui::Checkbox("Compact vertices", &compactVertices)) {
+		m_Terrain->SetCompactVertices(compactVertices);
+		m_Terrain->Regenerate(renderer);
+	}
+	ImGui::Text("Vertex buffer: %.1f KB", m_Terrain->GetVertexBufferSize() / 1024.0f);
+	ImGui::Text("Uploaded: %.1f KB last frame, %.1f KB peak, budget %.1f KB%s", uploadRing->getLastFrameBytes() / 1024.0f,
+		uploadRing->getPeakFrameBytes() / 1024.0f, uploadRing->getFrameBudget() / 1024.0f, m_Terrain->IsStreaming() ? " (streaming)" : "");
+	// Index topology
+	bool triangleStrips = m_Terrain->GetTriangleStrips();
+	if (ImGui::Checkbox("Triangle strips", &triangleStrips)) {
+		m_Terrain->SetTriangleStrips(triangleStrips);
+		m_Terrain->Regenerate(renderer);
+	}
+	ImGui::Text("Index buffer: %.1f KB (%d chunks)", m_Terrain->GetIndexBufferSize() / 1024.0f, (int)m_Terrain->GetIndexChunks().size());
 	// Resolution
 	int resolution = m_Terrain->GetResolution();
 	ImGui::Text("(2^n)+1: 3, 5, 9, 17, 33, 65, 129, 257, 513, 1025");
@@ -122,7 +203,7 @@ void App1::gui()
 	if (resolution != m_Terrain->GetResolution()) {
 		m_Terrain->Resize(resolution);
 		m_Terrain->Flatten();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 	// Set Height Offset Range
 	Range heightOffsetRange = m_Terrain->GetHeightOffsetRange();
@@ -159,20 +240,20 @@ void App1::gui()
 	if (ImGui::Button("Create Waves"))
 	{
 		m_Terrain->BuildCustomHeightMap();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 
 	// Apply Random Height
 	if (ImGui::Button("Random Height")) {
 		// build map height
 		m_Terrain->BuildRandomHeightMap();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 
 	// Diamond
 	if (ImGui::Button("Diamond-Square Algorithm")) {
 		m_Terrain->DiamondSquareAlgorithm();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 
 	// Regenerate completely the height map 
@@ -181,32 +262,196 @@ void App1::gui()
 	// Smooth
 	if (ImGui::Button("Smooth")) {
 		m_Terrain->Smooth();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 	// Fault
 	if (ImGui::Button("Fault")) {
 		m_Terrain->Fault();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 	// Flatten
 	if (ImGui::Button("Flatten")) {
 		m_Terrain->Flatten();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 	// Particle Deposition
 	if (ImGui::Button("Particle Deposition")) {
 		m_Terrain->ParticleDeposition();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
 	}
 	// Anti-Particle Deposition
 	if (ImGui::Button("Anti-Particle Deposition")) {
 		m_Terrain->AntiParticleDeposition();
-		m_Terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+		m_Terrain->Regenerate(renderer);
+	}
+
+	// Prop placement
+	ImGui::Text("\n\nProp Placement:\n");
+	ImGui::SliderFloat("Prop spacing", &scatterRules.minSpacing, 0.25f, 10.0f);
+	ImGui::SliderFloat("Max slope (degrees)", &scatterRules.maxSlope, 0.0f, 90.0f);
+	float propHeights[2] = { scatterRules.height.min, scatterRules.height.max };
+	ImGui::SliderFloat2("Prop heights (min-max)", propHeights, -50.0f, 50.0f);
+	scatterRules.height.min = propHeights[0];
+	scatterRules.height.max = propHeights[1];
+	int seed = (int)scatterRules.seed;
+	ImGui::InputInt("Prop seed", &seed);
+	scatterRules.seed = (unsigned int)seed;
+	if (ImGui::Button("Scatter Props")) {
+		uint64_t start = Profiler::now();
+		m_Terrain->ScatterProps(scatterRules, props);
+		scatterMs = (double)(Profiler::now() - start) / 1e6;
+	}
+	ImGui::Text("%d props of %d samples (%.2f ms)", (int)props.size(), m_Terrain->GetScatterSampleCount(), scatterMs);
+
+	// CPU preview, lit by the scene light
+	ImGui::Text("\n\nPreview:\n");
+	ImGui::SliderFloat("Preview yaw", &previewYaw, 0.0f, 360.0f);
+	ImGui::SliderFloat("Preview pitch", &previewPitch, 5.0f, 90.0f);
+	ImGui::Checkbox("Preview baked lighting", &previewBakedLighting);
+	if (ImGui::Button("Save Preview")) {
+		PreviewSettings previewSettings;
+		previewSettings.lightDirection = light->getDirection();
+		previewSettings.diffuseColour = light->getDiffuseColour();
+		uint64_t start = Profiler::now();
+		if (previewBakedLighting) {
+			// bake again, the terrain or the light may have changed since the last bake
+			HorizonBakeSettings bakeSettings;
+			bakeSettings.sunDirection = light->getDirection();
+			m_Terrain->BakeLighting(bakeSettings);
+			previewSettings.ambientColour = light->getAmbientColour();
+			previewSettings.ambientOcclusion = m_Terrain->GetLightingBake().GetAmbientOcclusion().data();
+			previewSettings.sunShadow = m_Terrain->GetLightingBake().GetSunShadow().data();
+		}
+		m_Terrain->SavePreview("res/preview.png", previewSettings, previewYaw, previewPitch);
+		previewMs = (double)(Profiler::now() - start) / 1e6;
+	}
+	ImGui::Text("res/preview.png (%.2f ms)", previewMs);
+
+	// Ambient occlusion and sun shadow baked on the CPU
+	if (ImGui::Button("Bake Lighting")) {
+		HorizonBakeSettings bakeSettings;
+		bakeSettings.sunDirection = light->getDirection();
+		uint64_t start = Profiler::now();
+		m_Terrain->BakeLighting(bakeSettings);
+		bakeMs = (double)(Profiler::now() - start) / 1e6;
+		m_Terrain->GetLightingBake().SaveAmbientOcclusion("res/ambient_occlusion.png");
+		m_Terrain->GetLightingBake().SaveSunShadow("res/sun_shadow.png");
+	}
+	ImGui::Text("res/ambient_occlusion.png, res/sun_shadow.png (%.2f ms)", bakeMs);
+
+	// Hydrology: depressions, flow directions and flow accumulation
+	ImGui::Text("\n\nHydrology:\n");
+	ImGui::SliderFloat("Fill epsilon", &hydrologySettings.epsilon, 0.0f, 0.01f, "%.5f");
+	bool dInfinity = hydrologySettings.routing == FlowRouting::DInfinity;
+	ImGui::Checkbox("D-infinity routing", &dInfinity);
+	hydrologySettings.routing = dInfinity ? FlowRouting::DInfinity : FlowRouting::D8;
+	if (ImGui::Button("Analyse Hydrology")) {
+		uint64_t start = Profiler::now();
+		m_Terrain->AnalyseHydrology(hydrologySettings);
+		hydrologyMs = (double)(Profiler::now() - start) / 1e6;
+		m_Terrain->GetHydrology().SaveFlowAccumulation("res/flow_accumulation.png");
+	}
+	ImGui::Text("res/flow_accumulation.png (%.2f ms)", hydrologyMs);
+	if (ImGui::Button("Fill Depressions")) {
+		if (m_Terrain->FillDepressions()) {
+			m_Terrain->Regenerate(renderer);
+		}
+	}
+
+	// Stream power erosion: uplift against river incision
+	ImGui::Text("\n\nStream Power Erosion:\n");
+	ImGui::SliderInt("Erosion iterations", &erosionSettings.iterations, 1, 100);
+	ImGui::SliderFloat("Uplift", &erosionSettings.uplift, 0.0f, 1.0f);
+	ImGui::SliderFloat("Erodibility", &erosionSettings.erodibility, 0.0f, 5.0f);
+	ImGui::SliderFloat("Area exponent", &erosionSettings.areaExponent, 0.3f, 0.7f);
+	ImGui::SliderFloat("Hillslope diffusion", &erosionSettings.diffusion, 0.0f, 1.0f);
+	if (ImGui::Button("Stream Power Erode")) {
+		uint64_t start = Profiler::now();
+		m_Terrain->StreamPowerErode(erosionSettings);
+		erosionMs = (double)(Profiler::now() - start) / 1e6;
+		m_Terrain->Regenerate(renderer);
+	}
+	ImGui::Text("Change %.4f per unit of time (%.2f ms)", m_Terrain->GetStreamPowerErosion().GetLastChange(), erosionMs);
+
+	// Sketch constraints: smooth terrain through pinned heights
+	ImGui::Text("\n\nSketch Constraints:\n");
+	ImGui::SliderFloat("Pin X", &constraintX, 0.0f, 100.0f);
+	ImGui::SliderFloat("Pin Z", &constraintZ, 0.0f, 100.0f);
+	ImGui::SliderFloat("Pin height", &constraintHeight, -20.0f, 20.0f);
+	if (ImGui::Button("Add Pin")) {
+		m_Terrain->AddHeightConstraint(constraintX, constraintZ, constraintHeight);
+	}
+	if (ImGui::Button("Clear Pins")) {
+		m_Terrain->ClearHeightConstraints();
+	}
+	bool thinPlate = constraintSettings.fill == ConstraintFill::ThinPlate;
+	ImGui::Checkbox("Thin plate", &thinPlate);
+	constraintSettings.fill = thinPlate ? ConstraintFill::ThinPlate : ConstraintFill::Membrane;
+	ImGui::SliderFloat("Keep detail", &constraintSettings.detail, 0.0f, 1.0f);
+	if (ImGui::Button("Solve Constraints")) {
+		uint64_t start = Profiler::now();
+		bool solved = m_Terrain->SolveHeightConstraints(constraintSettings);
+		constraintMs = (double)(Profiler::now() - start) / 1e6;
+		if (solved) {
+			m_Terrain->Regenerate(renderer);
+		}
+	}
+	const ConstraintSolver& constraintSolver = m_Terrain->GetConstraintSolver();
+	ImGui::Text("%d pins, %d cycles, residual %.1e (%.2f ms)", constraintSolver.GetConstraintCount(), constraintSolver.GetCycles(),
+		constraintSolver.GetResidual(), constraintMs);
+
+	// Height map storage
+	ImGui::Text("\n\nHeight Map Storage:\n");
+	if (ImGui::Button("Compress Height Map")) {
+		m_Terrain->CompressHeightMap();
+	}
+	if (ImGui::Button("Save Height Map")) {
+		m_Terrain->SaveHeightMap("res/heightmap.chm");
+	}
+	if (ImGui::Button("Load Height Map")) {
+		if (m_Terrain->LoadHeightMap("res/heightmap.chm")) {
+			m_Terrain->Regenerate(renderer);
+		}
+	}
+	const CompressedHeightMap* compressed = m_Terrain->GetCompressedHeightMap();
+	if (!compressed->IsEmpty()) {
+		ImGui::Text("Compressed: %.1f KB of %.1f KB (max error %.5f)%s",
+			compressed->GetCompressedSize() / 1024.0f, compressed->GetUncompressedSize() / 1024.0f,
+			compressed->GetMaxError(), m_Terrain->IsHeightMapCompressed() ? " [float map released]" : "");
 	}
 
 
 	// Render UI
-	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	renderGui();
+}
+
+void App1::resizeTerrain(int resolution)
+{
+	m_Terrain->Resize(resolution);
+	m_Terrain->Flatten();
+	m_Terrain->Regenerate(renderer);
+}
+
+void App1::modifyTerrain(int step)
+{
+	// The operations of the UI buttons, in turn
+	switch (step % 5) {
+	case 0:
+		m_Terrain->BuildRandomHeightMap();
+		break;
+	case 1:
+		m_Terrain->Smooth();
+		break;
+	case 2:
+		m_Terrain->Fault();
+		break;
+	case 3:
+		m_Terrain->ParticleDeposition();
+		break;
+	default:
+		m_Terrain->DiamondSquareAlgorithm();
+		break;
+	}
+	m_Terrain->Regenerate(renderer);
 }
 
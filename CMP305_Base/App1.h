@@ -5,6 +5,7 @@
 // Includes
 #include "DXF.h"	// include dxframework
 #include "LightShader.h"
+#include "TerrainShader.h"
 #include "TerrainMesh.h"
 
 
@@ -18,15 +19,54 @@ public:
 
 	bool frame();
 
+	// Scripted terrain changes, for headless runs (see HeadlessSystem)
+	// Resize and flatten the terrain, as the resolution slider
+	void resizeTerrain(int resolution);
+	// Apply one of the height map operations of the UI, chosen by 'step', and regenerate the terrain
+	void modifyTerrain(int step);
+
 protected:
 	bool render();
 	void gui();
 
 private:
 	LightShader* shader;
+	TerrainShader* terrainShader;
 	TerrainMesh* m_Terrain;
 
 	Light* light;
+
+	bool showProfiler;
+	// Keep the camera at eye height above the terrain
+	bool walkOnTerrain;
+
+	// Props placed on the terrain by the last scatter
+	ScatterRules scatterRules;
+	std::vector<PropInstance> props;
+	double scatterMs;
+
+	// View of the CPU preview, in degrees
+	float previewYaw;
+	float previewPitch;
+	double previewMs;
+	// Light the preview with the ambient occlusion and sun shadow baked from the scene light
+	bool previewBakedLighting;
+	double bakeMs;
+
+	// Hydrology analysis of the terrain
+	HydrologySettings hydrologySettings;
+	double hydrologyMs;
+
+	// Stream power erosion of the terrain
+	StreamPowerSettings erosionSettings;
+	double erosionMs;
+
+	// Sketched height constraints: the pin being placed (world units) and the solver settings
+	float constraintX;
+	float constraintZ;
+	float constraintHeight;
+	ConstraintSettings constraintSettings;
+	double constraintMs;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,529 @@
+#include "CompressedHeightMap.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// Unary codes longer than this are replaced by an escape followed by the raw 16 bit value
+	const uint32_t kRiceEscape = 20;
+	const uint32_t kQuantizedMax = 65535;
+	const char kFileMagic[4] = { 'C', 'H', 'M', '1' };
+
+	inline uint32_t CountTrailingZeros(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanForward64(&index, value) ? (uint32_t)index : 64;
+#else
+		return value ? (uint32_t)__builtin_ctzll(value) : 64;
+#endif
+	}
+
+	// Writes variable length codes into a byte array (LSB first)
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<uint8_t>& lout) : out(lout), acc(0), count(0) {}
+
+		void Put(uint32_t bits, int numBits)
+		{
+			acc |= (uint64_t)bits << count;
+			count += numBits;
+			while (count >= 8)
+			{
+				out.push_back((uint8_t)acc);
+				acc >>= 8;
+				count -= 8;
+			}
+		}
+
+		void Flush()
+		{
+			if (count > 0)
+			{
+				out.push_back((uint8_t)acc);
+			}
+			acc = 0;
+			count = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& out;
+		uint64_t acc;
+		int count;
+	};
+
+	// Reads back the codes written by BitWriter
+	class BitReader
+	{
+	public:
+		BitReader(const std::vector<uint8_t>& lin) : in(lin.data()), size(lin.size()), pos(0), acc(0), count(0) {}
+
+		uint32_t Get(int numBits)
+		{
+			Refill();
+			uint32_t bits = (uint32_t)(acc & ((1ull << numBits) - 1));
+			acc >>= numBits;
+			count -= numBits;
+			return bits;
+		}
+
+		// Count (and consume) the ones before the next zero, up to 'limit' ones
+		uint32_t GetUnary(uint32_t limit)
+		{
+			Refill();
+			uint32_t ones = std::min(CountTrailingZeros(~acc), limit);
+			if (ones < limit)
+			{
+				// consume the terminating zero too
+				acc >>= ones + 1;
+				count -= ones + 1;
+			}
+			else
+			{
+				acc >>= ones;
+				count -= ones;
+			}
+			return ones;
+		}
+
+	private:
+		void Refill()
+		{
+			while (count <= 56)
+			{
+				uint64_t byte = pos < size ? in[pos] : 0;
+				pos++;
+				acc |= byte << count;
+				count += 8;
+			}
+		}
+
+		const uint8_t* in;
+		size_t size;
+		size_t pos;
+		uint64_t acc;
+		int count;
+	};
+
+	inline int PaethPredict(int a, int b, int c)
+	{
+		// a = left, b = up, c = up-left
+		int p = a + b - c;
+		int pa = abs(p - a);
+		int pb = abs(p - b);
+		int pc = abs(p - c);
+		if (pa <= pb && pa <= pc)
+		{
+			return a;
+		}
+		return (pb <= pc) ? b : c;
+	}
+
+	inline int PlanarPredict(int a, int b, int c)
+	{
+		int p = a + b - c;
+		return p < 0 ? 0 : (p > (int)kQuantizedMax ? (int)kQuantizedMax : p);
+	}
+
+	// Predict the quantized value at (m, n) of a tile from its already decoded neighbours
+	inline int Predict(const uint16_t* q, int width, int m, int n, int predictor)
+	{
+		if (m == 0)
+		{
+			return n == 0 ? 0 : q[n - 1];
+		}
+		if (n == 0)
+		{
+			return q[(m - 1) * width];
+		}
+		int a = q[m * width + n - 1];
+		int b = q[(m - 1) * width + n];
+		int c = q[(m - 1) * width + n - 1];
+		return predictor == kPaeth ? PaethPredict(a, b, c) : PlanarPredict(a, b, c);
+	}
+
+	// Wrap the residual to 16 bits and interleave positive and negative values (0, -1, 1, -2, ...)
+	inline uint32_t ZigZag(int residual)
+	{
+		int16_t r = (int16_t)(uint16_t)residual;
+		return (uint16_t)((r << 1) ^ (r >> 15));
+	}
+
+	inline int UnZigZag(uint32_t value)
+	{
+		return (int16_t)((value >> 1) ^ (0u - (value & 1)));
+	}
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		file.read(reinterpret_cast<char*>(&value), sizeof(T));
+		return file.good();
+	}
+}
+
+CompressedHeightMap::CompressedHeightMap(int ltileSize, int lcacheCapacity)
+	: tileSize(ltileSize), tilesPerSide(0), resolution(0), cacheCapacity(lcacheCapacity)
+{
+	if (tileSize < 2)
+	{
+		tileSize = 2;
+	}
+	if (cacheCapacity < 1)
+	{
+		cacheCapacity = 1;
+	}
+}
+
+CompressedHeightMap::~CompressedHeightMap()
+{
+	Clear();
+}
+
+void CompressedHeightMap::Clear()
+{
+	tiles.clear();
+	lruOrder.clear();
+	cache.clear();
+	tilesPerSide = 0;
+	resolution = 0;
+}
+
+void CompressedHeightMap::Compress(const float* heightMap, int lresolution)
+{
+	Clear();
+
+	resolution = lresolution;
+	tilesPerSide = (resolution + tileSize - 1) / tileSize;
+	tiles.resize(tilesPerSide * tilesPerSide);
+
+	for (int tileM = 0; tileM < tilesPerSide; tileM++)
+	{
+		for (int tileN = 0; tileN < tilesPerSide; tileN++)
+		{
+			CompressTile(heightMap, tileM, tileN, tiles[tileM * tilesPerSide + tileN]);
+		}
+	}
+}
+
+void CompressedHeightMap::CompressTile(const float* heightMap, int tileM, int tileN, CompressedTile& tile)
+{
+	int mStart = tileM * tileSize;
+	int nStart = tileN * tileSize;
+	tile.width = std::min(tileSize, resolution - nStart);
+	tile.height = std::min(tileSize, resolution - mStart);
+
+	// Find the height range of the tile
+	tile.minHeight = heightMap[mStart * resolution + nStart];
+	tile.maxHeight = tile.minHeight;
+	for (int m = 0; m < tile.height; m++)
+	{
+		const float* row = heightMap + (mStart + m) * resolution + nStart;
+		for (int n = 0; n < tile.width; n++)
+		{
+			tile.minHeight = std::min(tile.minHeight, row[n]);
+			tile.maxHeight = std::max(tile.maxHeight, row[n]);
+		}
+	}
+
+	// Quantize to 16 bits against the tile range
+	std::vector<uint16_t> quantized(tile.width * tile.height);
+	float range = tile.maxHeight - tile.minHeight;
+	float toQuantized = range > 0.0f ? (float)kQuantizedMax / range : 0.0f;
+	for (int m = 0; m < tile.height; m++)
+	{
+		const float* row = heightMap + (mStart + m) * resolution + nStart;
+		for (int n = 0; n < tile.width; n++)
+		{
+			float q = (row[n] - tile.minHeight) * toQuantized + 0.5f;
+			quantized[m * tile.width + n] = (uint16_t)std::min(q, (float)kQuantizedMax);
+		}
+	}
+
+	// Pick the predictor with the smallest residuals for this tile
+	std::vector<uint32_t> residuals[2];
+	uint64_t residualSum[2] = { 0, 0 };
+	for (int predictor = kPaeth; predictor <= kLastPredictor; predictor++)
+	{
+		residuals[predictor].resize(quantized.size());
+		for (int m = 0; m < tile.height; m++)
+		{
+			for (int n = 0; n < tile.width; n++)
+			{
+				int index = m * tile.width + n;
+				uint32_t z = ZigZag(quantized[index] - Predict(quantized.data(), tile.width, m, n, predictor));
+				residuals[predictor][index] = z;
+				residualSum[predictor] += z;
+			}
+		}
+	}
+	tile.predictor = residualSum[kPlanar] < residualSum[kPaeth] ? kPlanar : kPaeth;
+	const std::vector<uint32_t>& best = residuals[tile.predictor];
+
+	// Rice parameter ~ log2 of the mean residual
+	uint64_t mean = residualSum[tile.predictor] / best.size();
+	int k = 0;
+	while (k < 15 && (1ull << (k + 1)) <= mean)
+	{
+		k++;
+	}
+	tile.riceK = (uint8_t)k;
+
+	// Entropy code the residuals
+	tile.bits.clear();
+	tile.bits.reserve(best.size() * (k + 2) / 8 + 8);
+	BitWriter writer(tile.bits);
+	for (size_t i = 0; i < best.size(); i++)
+	{
+		uint32_t quotient = best[i] >> k;
+		if (quotient < kRiceEscape)
+		{
+			writer.Put((1u << quotient) - 1, quotient + 1); // unary quotient terminated by a zero
+			if (k > 0)
+			{
+				writer.Put(best[i] & ((1u << k) - 1), k);
+			}
+		}
+		else
+		{
+			writer.Put((1u << kRiceEscape) - 1, kRiceEscape); // escape, then the raw value
+			writer.Put(best[i], 16);
+		}
+	}
+	writer.Flush();
+	tile.bits.shrink_to_fit();
+}
+
+void CompressedHeightMap::DecompressTile(const CompressedTile& tile, float* out)
+{
+	std::vector<uint16_t> quantized(tile.width * tile.height);
+	BitReader reader(tile.bits);
+	int k = tile.riceK;
+
+	for (int m = 0; m < tile.height; m++)
+	{
+		for (int n = 0; n < tile.width; n++)
+		{
+			uint32_t quotient = reader.GetUnary(kRiceEscape);
+			uint32_t z;
+			if (quotient < kRiceEscape)
+			{
+				z = (quotient << k) | (k > 0 ? reader.Get(k) : 0);
+			}
+			else
+			{
+				z = reader.Get(16);
+			}
+			int prediction = Predict(quantized.data(), tile.width, m, n, tile.predictor);
+			quantized[m * tile.width + n] = (uint16_t)(prediction + UnZigZag(z));
+		}
+	}
+
+	float toHeight = (tile.maxHeight - tile.minHeight) / (float)kQuantizedMax;
+	for (size_t i = 0; i < quantized.size(); i++)
+	{
+		out[i] = tile.minHeight + (float)quantized[i] * toHeight;
+	}
+}
+
+void CompressedHeightMap::Decompress(float* heightMap)
+{
+	std::vector<float> tileData(tileSize * tileSize);
+
+	for (int tileM = 0; tileM < tilesPerSide; tileM++)
+	{
+		for (int tileN = 0; tileN < tilesPerSide; tileN++)
+		{
+			const CompressedTile& tile = tiles[tileM * tilesPerSide + tileN];
+			DecompressTile(tile, tileData.data());
+
+			// copy the tile rows into the full height map
+			for (int m = 0; m < tile.height; m++)
+			{
+				float* row = heightMap + (tileM * tileSize + m) * resolution + tileN * tileSize;
+				memcpy(row, tileData.data() + m * tile.width, sizeof(float) * tile.width);
+			}
+		}
+	}
+}
+
+const float* CompressedHeightMap::GetTile(int tileM, int tileN)
+{
+	int key = tileM * tilesPerSide + tileN;
+
+	auto found = cache.find(key);
+	if (found != cache.end())
+	{
+		// move the tile to the front of the LRU list
+		lruOrder.splice(lruOrder.begin(), lruOrder, found->second.first);
+		return found->second.second.data();
+	}
+
+	// evict the least recently used tile if the cache is full
+	if ((int)cache.size() >= cacheCapacity)
+	{
+		cache.erase(lruOrder.back());
+		lruOrder.pop_back();
+	}
+
+	const CompressedTile& tile = tiles[key];
+	lruOrder.push_front(key);
+	auto& entry = cache[key];
+	entry.first = lruOrder.begin();
+	entry.second.resize(tile.width * tile.height);
+	DecompressTile(tile, entry.second.data());
+
+	return entry.second.data();
+}
+
+float CompressedHeightMap::GetHeight(int m, int n)
+{
+	int tileM = m / tileSize;
+	int tileN = n / tileSize;
+	const float* tileData = GetTile(tileM, tileN);
+	int width = tiles[tileM * tilesPerSide + tileN].width;
+	return tileData[(m - tileM * tileSize) * width + (n - tileN * tileSize)];
+}
+
+void CompressedHeightMap::ReadRegion(int firstM, int firstN, int rows, int columns, float* heights)
+{
+	// copy the part of every tile the region covers, a tile at a time
+	for (int tileM = firstM / tileSize; tileM * tileSize < firstM + rows; tileM++)
+	{
+		for (int tileN = firstN / tileSize; tileN * tileSize < firstN + columns; tileN++)
+		{
+			const float* tileData = GetTile(tileM, tileN);
+			const CompressedTile& tile = tiles[tileM * tilesPerSide + tileN];
+			int startM = std::max(firstM, tileM * tileSize);
+			int endM = std::min(firstM + rows, tileM * tileSize + tile.height);
+			int startN = std::max(firstN, tileN * tileSize);
+			int endN = std::min(firstN + columns, tileN * tileSize + tile.width);
+			for (int m = startM; m < endM; m++)
+			{
+				const float* row = tileData + (m - tileM * tileSize) * tile.width + (startN - tileN * tileSize);
+				memcpy(heights + (m - firstM) * columns + (startN - firstN), row, sizeof(float) * (endN - startN));
+			}
+		}
+	}
+}
+
+size_t CompressedHeightMap::GetCompressedSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		size += sizeof(float) * 2 + sizeof(int) * 2 + 2 + tiles[i].bits.size();
+	}
+	return size;
+}
+
+float CompressedHeightMap::GetMaxError() const
+{
+	float maxError = 0.0f;
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		// rounding to the nearest step gives at most half a step of error
+		maxError = std::max(maxError, 0.5f * (tiles[i].maxHeight - tiles[i].minHeight) / (float)kQuantizedMax);
+	}
+	return maxError;
+}
+
+bool CompressedHeightMap::Save(const char* filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file.write(kFileMagic, sizeof(kFileMagic));
+	WriteValue(file, resolution);
+	WriteValue(file, tileSize);
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		const CompressedTile& tile = tiles[i];
+		WriteValue(file, tile.minHeight);
+		WriteValue(file, tile.maxHeight);
+		WriteValue(file, tile.width);
+		WriteValue(file, tile.height);
+		WriteValue(file, tile.predictor);
+		WriteValue(file, tile.riceK);
+		uint32_t numBytes = (uint32_t)tile.bits.size();
+		WriteValue(file, numBytes);
+		file.write(reinterpret_cast<const char*>(tile.bits.data()), numBytes);
+	}
+
+	return file.good();
+}
+
+bool CompressedHeightMap::Load(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	char magic[4];
+	file.read(magic, sizeof(magic));
+	if (!file.good() || memcmp(magic, kFileMagic, sizeof(magic)) != 0)
+	{
+		return false;
+	}
+
+	Clear();
+	int fileResolution, fileTileSize;
+	if (!ReadValue(file, fileResolution) || !ReadValue(file, fileTileSize) || fileResolution <= 0 || fileTileSize < 2)
+	{
+		return false;
+	}
+	resolution = fileResolution;
+	tileSize = fileTileSize;
+	tilesPerSide = (resolution + tileSize - 1) / tileSize;
+	tiles.resize(tilesPerSide * tilesPerSide);
+
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		CompressedTile& tile = tiles[i];
+		uint32_t numBytes = 0;
+		if (!ReadValue(file, tile.minHeight) || !ReadValue(file, tile.maxHeight) ||
+			!ReadValue(file, tile.width) || !ReadValue(file, tile.height) ||
+			!ReadValue(file, tile.predictor) || !ReadValue(file, tile.riceK) || !ReadValue(file, numBytes))
+		{
+			Clear();
+			return false;
+		}
+		// tiles must cover the map exactly as Compress() would have laid them out
+		int tileM = (int)i / tilesPerSide;
+		int tileN = (int)i % tilesPerSide;
+		if (tile.width != std::min(tileSize, resolution - tileN * tileSize) || tile.height != std::min(tileSize, resolution - tileM * tileSize) || tile.riceK > 15 ||
+			tile.predictor > kLastPredictor)
+		{
+			Clear();
+			return false;
+		}
+		tile.bits.resize(numBytes);
+		file.read(reinterpret_cast<char*>(tile.bits.data()), numBytes);
+		if (!file.good())
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
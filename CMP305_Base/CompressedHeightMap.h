@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+// Which predictor was used to turn the quantized heights of a tile into residuals
+enum HeightPredictor
+{
+	kPaeth = 0, // PNG style Paeth predictor (left, up or up-left, whichever is closest to the gradient)
+	kPlanar = 1, // left + up - upLeft (exact for planar slopes)
+	kLastPredictor = kPlanar // highest known predictor, files with a higher one are rejected
+};
+
+// Header of a single compressed tile
+struct CompressedTile
+{
+	float minHeight = 0.0f; // lowest height in the tile (maps to quantized 0)
+	float maxHeight = 0.0f; // highest height in the tile (maps to quantized 65535)
+	int width = 0; // number of texels along x-axis (n)
+	int height = 0; // number of texels along z-axis (m)
+	uint8_t predictor = kPaeth; // HeightPredictor used for the residuals
+	uint8_t riceK = 0; // Rice parameter used by the entropy coder
+	std::vector<uint8_t> bits; // Rice coded residuals
+};
+
+// Tiled, compressed storage for a square height map.
+// Every tile is quantized to 16 bits against its own min/max height, turned into residuals
+// with a Paeth or planar predictor and Rice coded.
+// Tiles are decompressed on demand and kept in a small LRU cache.
+class CompressedHeightMap
+{
+public:
+	// constructor
+	CompressedHeightMap(int tileSize = 64, int cacheCapacity = 16);
+
+	// destructor
+	~CompressedHeightMap();
+
+	// Compress a resolution*resolution height map (row major, m(rows) == z, n(columns) == x)
+	void Compress(const float* heightMap, int resolution);
+	// Decompress every tile into heightMap, which must hold resolution*resolution floats
+	void Decompress(float* heightMap);
+	// Return the decompressed tile (tileM, tileN), decoding it if it is not in the cache.
+	// The pointer is valid until the tile is evicted from the cache
+	const float* GetTile(int tileM, int tileN);
+	// Return the height at the point (m, n), decoding its tile if needed
+	float GetHeight(int m, int n);
+	// Copy the rows [firstM, firstM + rows) and columns [firstN, firstN + columns) into 'heights' (row major,
+	// 'columns' wide), decoding only the tiles they cover through the cache
+	void ReadRegion(int firstM, int firstN, int rows, int columns, float* heights);
+
+	// Write/read the compressed tiles to/from a file. Return false on failure
+	bool Save(const char* filename) const;
+	bool Load(const char* filename);
+
+	// Remove all the tiles and cached data
+	void Clear();
+
+	bool IsEmpty() const { return tiles.empty(); }
+	int GetResolution() const { return resolution; }
+	int GetTileSize() const { return tileSize; }
+	int GetTilesPerSide() const { return tilesPerSide; }
+	// Size in bytes of the compressed tiles (headers and coded residuals)
+	size_t GetCompressedSize() const;
+	// Size in bytes of the uncompressed float height map
+	size_t GetUncompressedSize() const { return (size_t)resolution * (size_t)resolution * sizeof(float); }
+	// Biggest quantization error of the tiles, in world units
+	float GetMaxError() const;
+
+private:
+	void CompressTile(const float* heightMap, int tileM, int tileN, CompressedTile& tile);
+	void DecompressTile(const CompressedTile& tile, float* out);
+
+	int tileSize;
+	int tilesPerSide;
+	int resolution;
+	std::vector<CompressedTile> tiles;
+
+	// LRU cache of decompressed tiles, most recently used at the front
+	int cacheCapacity;
+	std::list<int> lruOrder;
+	std::unordered_map<int, std::pair<std::list<int>::iterator, std::vector<float>>> cache;
+};
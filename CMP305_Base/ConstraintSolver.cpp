@@ -0,0 +1,810 @@
+#include "ConstraintSolver.h"
+#include "RowBandPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+	const size_t kThreadedTexels = 128 * 128; // smaller grids are processed on one thread
+	const float kPinWeight = 1e4f;				// weight of the constrained points, against a diagonal of 4 (membrane) or 20 (thin plate)
+	const int kCoarsestResolution = 4;			// the pyramid stops at this resolution or below
+	const int kCoarsestSweeps = 100;			// the coarsest grid is solved by relaxation alone, forwards and backwards
+
+	// Offset of corner 0 to 3 of a cell (top left, top right, bottom left, bottom right) from its top left point
+	inline int CornerOffset(int corner, int resolution)
+	{
+		return (corner & 1) + (corner >> 1) * resolution;
+	}
+
+	// Sum of the 4 neighbours of point (m, n) of a grid, and how many there are inside the grid
+	inline float NeighbourSum(const float* values, int index, int m, int n, int resolution, int& degree)
+	{
+		const int last = resolution - 1;
+		float sum = 0.0f;
+		degree = 0;
+		if (m > 0) { sum += values[index - resolution]; degree++; }
+		if (m < last) { sum += values[index + resolution]; degree++; }
+		if (n > 0) { sum += values[index - 1]; degree++; }
+		if (n < last) { sum += values[index + 1]; degree++; }
+		return sum;
+	}
+
+	// The thin plate energy x_xx^2 + 2 x_xz^2 + x_zz^2 is the sum of the squares of the second differences D x along
+	// the rows (at the points with both neighbours in the row), the columns and the cells (x_xz, at the top left point
+	// of every cell). D^T c at point (m, n): the terms of the differences c that the point is part of, and the sum of
+	// the squares of its coefficients (the diagonal of D^T D)
+	inline float BendingSum(const float* curvatureX, const float* curvatureZ, const float* twist, int index, int m, int n,
+		int resolution, float& diagonal)
+	{
+		const int last = resolution - 1;
+		float sum = 0.0f;
+		float twistSum = 0.0f;
+		diagonal = 0.0f;
+		if (n >= 2) { sum += curvatureX[index - 1]; diagonal += 1.0f; }
+		if (n >= 1 && n < last) { sum -= 2.0f * curvatureX[index]; diagonal += 4.0f; }
+		if (n + 2 <= last) { sum += curvatureX[index + 1]; diagonal += 1.0f; }
+		if (m >= 2) { sum += curvatureZ[index - resolution]; diagonal += 1.0f; }
+		if (m >= 1 && m < last) { sum -= 2.0f * curvatureZ[index]; diagonal += 4.0f; }
+		if (m + 2 <= last) { sum += curvatureZ[index + resolution]; diagonal += 1.0f; }
+		if (m > 0 && n > 0) { twistSum += twist[index - resolution - 1]; diagonal += 2.0f; }
+		if (m > 0 && n < last) { twistSum -= twist[index - resolution]; diagonal += 2.0f; }
+		if (m < last && n > 0) { twistSum -= twist[index - 1]; diagonal += 2.0f; }
+		if (m < last && n < last) { twistSum += twist[index]; diagonal += 2.0f; }
+		return sum + 2.0f * twistSum;
+	}
+
+	// Add 'amount' times the coefficients of point (m, n) to the differences it is part of, after the point moved
+	inline void AddBending(float* curvatureX, float* curvatureZ, float* twist, int index, int m, int n, int resolution,
+		float amount)
+	{
+		const int last = resolution - 1;
+		if (n >= 2) curvatureX[index - 1] += amount;
+		if (n >= 1 && n < last) curvatureX[index] -= 2.0f * amount;
+		if (n + 2 <= last) curvatureX[index + 1] += amount;
+		if (m >= 2) curvatureZ[index - resolution] += amount;
+		if (m >= 1 && m < last) curvatureZ[index] -= 2.0f * amount;
+		if (m + 2 <= last) curvatureZ[index + resolution] += amount;
+		if (m > 0 && n > 0) twist[index - resolution - 1] += amount;
+		if (m > 0 && n < last) twist[index - resolution] -= amount;
+		if (m < last && n > 0) twist[index - 1] -= amount;
+		if (m < last && n < last) twist[index] += amount;
+	}
+
+	// Points of the coarser grid that fine point j (of a row or a column) is interpolated from, and their weights.
+	// The even points are on the coarse grid, the odd ones halfway, or on the last coarse point if there is no next one
+	inline int ProlongationTaps(int j, int coarseResolution, int taps[2], float weights[2])
+	{
+		taps[0] = j / 2;
+		if ((j & 1) == 0)
+		{
+			weights[0] = 1.0f;
+			return 1;
+		}
+		taps[1] = std::min(j / 2 + 1, coarseResolution - 1);
+		weights[0] = 0.5f;
+		weights[1] = 0.5f;
+		return 2;
+	}
+
+	// Fine points that coarse point i gathers from in the restriction (the transpose of the prolongation)
+	inline int RestrictionTaps(int i, int fineResolution, int coarseResolution, int taps[3], float weights[3])
+	{
+		int count = 0;
+		if (2 * i - 1 >= 0)
+		{
+			taps[count] = 2 * i - 1;
+			weights[count++] = 0.5f;
+		}
+		taps[count] = 2 * i;
+		weights[count++] = 1.0f;
+		if (2 * i + 1 < fineResolution)
+		{
+			taps[count] = 2 * i + 1;
+			weights[count++] = i + 1 < coarseResolution ? 0.5f : 1.0f;
+		}
+		return count;
+	}
+}
+
+ConstraintSolver::ConstraintSolver()
+{
+	threadCount = 0;
+	fill = ConstraintFill::ThinPlate;
+	smoothingSteps = 2;
+	pinnedCount = 0;
+	cycles = 0;
+	residual = 0.0f;
+}
+
+void ConstraintSolver::Release()
+{
+	std::vector<Level>().swap(levels);
+	std::vector<float>().swap(pinHeights);
+	std::vector<int>().swap(pinCounts);
+	std::vector<int>().swap(pinnedPoints);
+	std::vector<float>().swap(solution);
+	std::vector<float>().swap(search);
+	std::vector<float>().swap(product);
+	std::vector<double>().swap(rowSums);
+}
+
+void ConstraintSolver::AddPoint(float x, float z, float height)
+{
+	Segment segment;
+	segment.start = ControlPoint(x, z, height);
+	segment.end = segment.start;
+	segments.push_back(segment);
+}
+
+void ConstraintSolver::AddCurve(const std::vector<ControlPoint>& curve)
+{
+	if (curve.size() == 1)
+	{
+		AddPoint(curve[0].x, curve[0].z, curve[0].height);
+	}
+	for (size_t i = 1; i < curve.size(); i++)
+	{
+		Segment segment;
+		segment.start = curve[i - 1];
+		segment.end = curve[i];
+		segments.push_back(segment);
+	}
+}
+
+bool ConstraintSolver::Solve(HeightMap& map, const ConstraintSettings& settings)
+{
+	pinnedCount = 0;
+	cycles = 0;
+	residual = 0.0f;
+	if (map.IsEmpty() || map.GetResolution() < 3 || segments.empty())
+	{
+		return false;
+	}
+
+	fill = settings.fill;
+	smoothingSteps = settings.smoothingSteps > 0 ? settings.smoothingSteps : 1;
+	BuildLevels(map.GetResolution());
+	float* heights = map.GetData();
+	PinConstraints(heights, settings.detail);
+	if (pinnedCount == 0)
+	{
+		return false;
+	}
+
+	// The pins and the right hand side W c of every level, for the full multigrid pass
+	for (int level = 0; level < (int)levels.size(); level++)
+	{
+		BuildPins(level);
+		if (level + 1 < (int)levels.size())
+		{
+			Restrict(level, levels[level].rhs, levels[level + 1].rhs);
+		}
+	}
+
+	// Full multigrid: the coarsest solution, prolonged to every finer level as the first guess of its V-cycle
+	const int coarsest = (int)levels.size() - 1;
+	std::fill(levels[coarsest].x.begin(), levels[coarsest].x.end(), 0.0f);
+	Smooth(coarsest, kCoarsestSweeps, false);
+	Smooth(coarsest, kCoarsestSweeps, true);
+	for (int level = coarsest - 1; level >= 0; level--)
+	{
+		std::fill(levels[level].x.begin(), levels[level].x.end(), 0.0f);
+		Prolong(level);
+		VCycle(level);
+	}
+
+	// Conjugate gradients preconditioned by the V-cycle, from the full multigrid solution. The first level then holds
+	// the residual r as its right hand side and the preconditioned residual z = M r as its solution
+	Level& finest = levels[0];
+	ComputeResidual(0);
+	solution.resize(finest.x.size());
+	solution.swap(finest.x);
+	finest.rhs.swap(finest.residual);
+	Precondition();
+	search = finest.x;
+	product.resize(search.size());
+	double rz = Dot(finest.rhs, finest.x);
+	const double initialRz = rz;
+	while (cycles < settings.maxCycles && rz > initialRz * (double)settings.tolerance * settings.tolerance)
+	{
+		ApplyOperator(0, search.data(), product.data());
+		const double searchProduct = Dot(search, product);
+		if (searchProduct <= 0.0)
+		{
+			break;
+		}
+		const float alpha = (float)(rz / searchProduct);
+		const size_t count = solution.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			solution[i] += alpha * search[i];
+			finest.rhs[i] -= alpha * product[i];
+		}
+
+		Precondition();
+		const double nextRz = Dot(finest.rhs, finest.x);
+		const float beta = (float)(nextRz / rz);
+		rz = nextRz;
+		for (size_t i = 0; i < count; i++)
+		{
+			search[i] = finest.x[i] + beta * search[i];
+		}
+		cycles++;
+	}
+	residual = initialRz > 0.0 && rz > 0.0 ? (float)sqrt(rz / initialRz) : 0.0f;
+
+	const size_t count = solution.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		heights[i] = solution[i] + settings.detail * heights[i];
+	}
+	return true;
+}
+
+void ConstraintSolver::PinConstraints(const float* heights, float detail)
+{
+	Level& finest = levels[0];
+	const int resolution = finest.resolution;
+	const size_t count = (size_t)resolution * resolution;
+	pinHeights.assign(count, 0.0f);
+	pinCounts.assign(count, 0);
+	pinnedPoints.clear();
+
+	// Every segment is sampled twice per point, so it pins a connected line of points
+	for (const Segment& segment : segments)
+	{
+		const float dx = segment.end.x - segment.start.x;
+		const float dz = segment.end.z - segment.start.z;
+		const int steps = (int)ceilf(std::max(fabsf(dx), fabsf(dz)) * 2.0f);
+		for (int step = 0; step <= steps; step++)
+		{
+			const float t = steps > 0 ? (float)step / (float)steps : 0.0f;
+			const int n = (int)floorf(segment.start.x + dx * t + 0.5f);
+			const int m = (int)floorf(segment.start.z + dz * t + 0.5f);
+			if (m >= 0 && m < resolution && n >= 0 && n < resolution)
+			{
+				pinHeights[(size_t)m * resolution + n] += segment.start.height + (segment.end.height - segment.start.height) * t;
+				pinCounts[(size_t)m * resolution + n]++;
+			}
+		}
+	}
+
+	// The smooth surface goes through the constraints minus the detail layer
+	for (size_t i = 0; i < count; i++)
+	{
+		finest.x[i] = 0.0f;
+		finest.rhs[i] = 0.0f;
+		if (pinCounts[i] > 0)
+		{
+			const float height = pinHeights[i] / (float)pinCounts[i];
+			finest.rhs[i] = kPinWeight * (height - detail * heights[i]);
+			pinnedPoints.push_back((int)i);
+		}
+	}
+	pinnedCount = (int)pinnedPoints.size();
+}
+
+void ConstraintSolver::BuildPins(int levelIndex)
+{
+	Level& level = levels[levelIndex];
+	const int resolution = level.resolution;
+	const int fineResolution = levels[0].resolution;
+	const int last = resolution - 1;
+	const float scale = 1.0f / (float)(1 << levelIndex);
+
+	// A pinned point of the first level falls between the points of a coarser one, where it pins the bilinear
+	// interpolation t of the 4 points around it, w (t . x - height)^2. This is the Galerkin coarse operator of the pin:
+	// pinning the points around it instead would stop the coarse grid from tilting the surface about the pin. The
+	// pins in a cell add up to one matrix, the sum of their w t t^T
+	level.pinCells.clear();
+	level.cellPins.assign((size_t)resolution * resolution, -1);
+	for (int point : pinnedPoints)
+	{
+		const float x = std::min((float)(point % fineResolution) * scale, (float)last);
+		const float z = std::min((float)(point / fineResolution) * scale, (float)last);
+		const int n = std::min((int)x, last - 1);
+		const int m = std::min((int)z, last - 1);
+		const float tx = x - (float)n;
+		const float tz = z - (float)m;
+		const float taps[4] = { (1.0f - tx) * (1.0f - tz), tx * (1.0f - tz), (1.0f - tx) * tz, tx * tz };
+
+		const int index = m * resolution + n;
+		if (level.cellPins[index] < 0)
+		{
+			level.cellPins[index] = (int)level.pinCells.size();
+			PinCell cell;
+			cell.index = index;
+			std::fill(&cell.matrix[0][0], &cell.matrix[0][0] + 16, 0.0f);
+			level.pinCells.push_back(cell);
+		}
+		PinCell& cell = level.pinCells[level.cellPins[index]];
+		for (int k = 0; k < 4; k++)
+		{
+			for (int l = 0; l < 4; l++)
+			{
+				cell.matrix[k][l] += kPinWeight * taps[k] * taps[l];
+			}
+		}
+	}
+}
+
+void ConstraintSolver::BuildLevels(int resolution)
+{
+	if (levels.empty() || levels[0].resolution != resolution)
+	{
+		levels.clear();
+		for (int levelResolution = resolution; ; levelResolution = (levelResolution + 1) / 2)
+		{
+			Level level;
+			level.resolution = levelResolution;
+			const size_t count = (size_t)levelResolution * levelResolution;
+			level.x.resize(count);
+			level.rhs.resize(count);
+			level.residual.resize(count);
+			levels.push_back(level);
+			if (levelResolution <= kCoarsestResolution)
+			{
+				break;
+			}
+		}
+	}
+
+	// The second differences of the coarse grid are 4 times those of the fine one over a quarter of the points, so the
+	// Galerkin coarse operator of the thin plate is a quarter of the one of the coarse grid
+	float scale = 1.0f;
+	for (Level& level : levels)
+	{
+		level.scale = scale;
+		if (fill == ConstraintFill::ThinPlate)
+		{
+			level.curvatureX.resize(level.x.size());
+			level.curvatureZ.resize(level.x.size());
+			level.twist.resize(level.x.size());
+			scale *= 0.25f;
+		}
+		else
+		{
+			std::vector<float>().swap(level.curvatureX);
+			std::vector<float>().swap(level.curvatureZ);
+			std::vector<float>().swap(level.twist);
+		}
+	}
+}
+
+int ConstraintSolver::GetThreads(int resolution)const
+{
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	if (threads < 1 || (size_t)resolution * resolution < kThreadedTexels)
+	{
+		threads = 1;
+	}
+	return threads;
+}
+
+void ConstraintSolver::ComputeBending(int levelIndex, const float* values)
+{
+	Level& level = levels[levelIndex];
+	const int resolution = level.resolution;
+	const int last = resolution - 1;
+	const float scale = level.scale;
+	ForEachRowBand(resolution, GetThreads(resolution), [&](int firstRow, int lastRow)
+	{
+		for (int m = firstRow; m < lastRow; m++)
+		{
+			for (int n = 0; n < resolution; n++)
+			{
+				const int index = m * resolution + n;
+				const float value = values[index];
+				level.curvatureX[index] = n > 0 && n < last ? scale * (values[index - 1] - 2.0f * value + values[index + 1]) : 0.0f;
+				level.curvatureZ[index] = m > 0 && m < last
+					? scale * (values[index - resolution] - 2.0f * value + values[index + resolution]) : 0.0f;
+				level.twist[index] = m < last && n < last
+					? scale * (value - values[index + 1] - values[index + resolution] + values[index + resolution + 1]) : 0.0f;
+			}
+		}
+	});
+}
+
+float ConstraintSolver::PinSum(const Level& level, const float* values, int m, int n, float& diagonal)const
+{
+	// The cells of the point, and the corner the point is in each
+	const int resolution = level.resolution;
+	float sum = 0.0f;
+	diagonal = 0.0f;
+	for (int corner = 0; corner < 4; corner++)
+	{
+		const int cellM = m - (corner >> 1);
+		const int cellN = n - (corner & 1);
+		if (cellM < 0 || cellN < 0 || cellM >= resolution - 1 || cellN >= resolution - 1)
+		{
+			continue;
+		}
+		const int pinCell = level.cellPins[cellM * resolution + cellN];
+		if (pinCell < 0)
+		{
+			continue;
+		}
+
+		const PinCell& cell = level.pinCells[pinCell];
+		for (int l = 0; l < 4; l++)
+		{
+			sum += cell.matrix[corner][l] * values[cell.index + CornerOffset(l, resolution)];
+		}
+		diagonal += cell.matrix[corner][corner];
+	}
+	return sum;
+}
+
+void ConstraintSolver::ApplyOperator(int levelIndex, const float* values, float* result)
+{
+	Level& level = levels[levelIndex];
+	const int resolution = level.resolution;
+	const bool thinPlate = fill == ConstraintFill::ThinPlate;
+	if (thinPlate)
+	{
+		ComputeBending(levelIndex, values);
+	}
+
+	ForEachRowBand(resolution, GetThreads(resolution), [&](int firstRow, int lastRow)
+	{
+		for (int m = firstRow; m < lastRow; m++)
+		{
+			for (int n = 0; n < resolution; n++)
+			{
+				const int index = m * resolution + n;
+				float diagonal;
+				float value;
+				if (thinPlate)
+				{
+					value = BendingSum(level.curvatureX.data(), level.curvatureZ.data(), level.twist.data(), index, m, n,
+						resolution, diagonal);
+				}
+				else
+				{
+					int degree;
+					const float sum = NeighbourSum(values, index, m, n, resolution, degree);
+					value = degree * values[index] - sum;
+				}
+				result[index] = value + PinSum(level, values, m, n, diagonal);
+			}
+		}
+	});
+}
+
+void ConstraintSolver::Smooth(int levelIndex, int sweeps, bool backwards)
+{
+	Level& level = levels[levelIndex];
+	const int resolution = level.resolution;
+	const int threads = GetThreads(resolution);
+	float* x = level.x.data();
+	const float* rhs = level.rhs.data();
+
+	if (fill == ConstraintFill::Membrane)
+	{
+		// 4 colours, by the parity of the row and the column: the points of a colour are not neighbours and are not in
+		// the same cell, which the pins tie together
+		for (int sweep = 0; sweep < sweeps; sweep++)
+		{
+			if (backwards)
+			{
+				RelaxPins(levelIndex, true);
+			}
+			for (int step = 0; step < 4; step++)
+			{
+				const int colour = backwards ? 3 - step : step;
+				ForEachRowBand(resolution, threads, [&](int firstRow, int lastRow)
+				{
+					for (int m = firstRow + ((firstRow ^ (colour >> 1)) & 1); m < lastRow; m += 2)
+					{
+						for (int n = colour & 1; n < resolution; n += 2)
+						{
+							const int index = m * resolution + n;
+							int degree;
+							float pinDiagonal;
+							const float sum = NeighbourSum(x, index, m, n, resolution, degree);
+							const float pinSum = PinSum(level, x, m, n, pinDiagonal);
+							x[index] += (rhs[index] - degree * x[index] + sum - pinSum) / ((float)degree + pinDiagonal);
+						}
+					}
+				});
+			}
+			if (!backwards)
+			{
+				RelaxPins(levelIndex, false);
+			}
+		}
+		return;
+	}
+
+	// Thin plate: 5 colours, (n + 3m) % 5, so the points of a colour are more than 2 points apart and the second
+	// differences (kept up to date with every update) they change do not overlap
+	float* curvatureX = level.curvatureX.data();
+	float* curvatureZ = level.curvatureZ.data();
+	float* twist = level.twist.data();
+	const float scale = level.scale;
+	ComputeBending(levelIndex, x);
+	for (int sweep = 0; sweep < sweeps; sweep++)
+	{
+		if (backwards)
+		{
+			RelaxPins(levelIndex, true);
+		}
+		for (int step = 0; step < 5; step++)
+		{
+			const int colour = backwards ? 4 - step : step;
+			ForEachRowBand(resolution, threads, [&](int firstRow, int lastRow)
+			{
+				for (int m = firstRow; m < lastRow; m++)
+				{
+					for (int n = ((colour - 3 * m) % 5 + 5) % 5; n < resolution; n += 5)
+					{
+						const int index = m * resolution + n;
+						float diagonal;
+						float pinDiagonal;
+						const float sum = BendingSum(curvatureX, curvatureZ, twist, index, m, n, resolution, diagonal);
+						const float pinSum = PinSum(level, x, m, n, pinDiagonal);
+						const float delta = (rhs[index] - sum - pinSum) / (scale * diagonal + pinDiagonal);
+						x[index] += delta;
+						AddBending(curvatureX, curvatureZ, twist, index, m, n, resolution, scale * delta);
+					}
+				}
+			});
+		}
+		if (!backwards)
+		{
+			RelaxPins(levelIndex, false);
+		}
+	}
+}
+
+void ConstraintSolver::RelaxPins(int levelIndex, bool backwards)
+{
+	Level& level = levels[levelIndex];
+	const int resolution = level.resolution;
+	const int last = resolution - 1;
+	const bool thinPlate = fill == ConstraintFill::ThinPlate;
+	const float scale = level.scale;
+	float* x = level.x.data();
+	const int cellCount = (int)level.pinCells.size();
+	for (int step = 0; step < cellCount; step++)
+	{
+		// Pins on the points of the level do not tie points together, the point sweeps relax them
+		const PinCell& cell = level.pinCells[backwards ? cellCount - 1 - step : step];
+		if (cell.matrix[0][1] == 0.0f && cell.matrix[0][2] == 0.0f && cell.matrix[0][3] == 0.0f
+			&& cell.matrix[1][2] == 0.0f && cell.matrix[1][3] == 0.0f && cell.matrix[2][3] == 0.0f)
+		{
+			continue;
+		}
+
+		// The block of A of the 4 corners, and their residuals
+		const int m0 = cell.index / resolution;
+		const int n0 = cell.index % resolution;
+		int corners[4];
+		float block[4][5];
+		for (int k = 0; k < 4; k++)
+		{
+			corners[k] = cell.index + CornerOffset(k, resolution);
+			const int m = m0 + (k >> 1);
+			const int n = n0 + (k & 1);
+			float diagonal;
+			float pinDiagonal;
+			float value;
+			if (thinPlate)
+			{
+				value = BendingSum(level.curvatureX.data(), level.curvatureZ.data(), level.twist.data(), corners[k], m, n,
+					resolution, diagonal);
+				diagonal *= scale;
+			}
+			else
+			{
+				int degree;
+				const float sum = NeighbourSum(x, corners[k], m, n, resolution, degree);
+				value = degree * x[corners[k]] - sum;
+				diagonal = (float)degree;
+			}
+			value += PinSum(level, x, m, n, pinDiagonal);
+			block[k][k] = diagonal + pinDiagonal;
+			block[k][4] = level.rhs[corners[k]] - value;
+		}
+
+		// Corners along a row (k ^ 1) or a column (k ^ 2) are neighbours, the thin plate also ties the corners across
+		// the cell (k ^ 3), through the second differences both are part of. The pins tie them in this cell and, for
+		// neighbours, in the cell on the other side of their edge
+		for (int k = 0; k < 4; k++)
+		{
+			const int m = m0 + (k >> 1);
+			const int n = n0 + (k & 1);
+			for (int l = k + 1; l < 4; l++)
+			{
+				float coupling = cell.matrix[k][l];
+				int otherCell = -1;
+				if ((k ^ l) == 1)
+				{
+					// the cell above the top corners or below the bottom ones
+					const int otherM = m == m0 ? m0 - 1 : m0 + 1;
+					otherCell = otherM >= 0 && otherM < last ? level.cellPins[otherM * resolution + n0] : -1;
+					coupling += thinPlate ? -2.0f * ((n0 >= 1) + (n0 + 1 < last) + (m > 0) + (m < last)) * scale : -1.0f;
+				}
+				else if ((k ^ l) == 2)
+				{
+					// the cell left of the left corners or right of the right ones
+					const int otherN = n == n0 ? n0 - 1 : n0 + 1;
+					otherCell = otherN >= 0 && otherN < last ? level.cellPins[m0 * resolution + otherN] : -1;
+					coupling += thinPlate ? -2.0f * ((m0 >= 1) + (m0 + 1 < last) + (n > 0) + (n < last)) * scale : -1.0f;
+				}
+				else if (thinPlate)
+				{
+					coupling += 2.0f * scale;
+				}
+				if (otherCell >= 0)
+				{
+					// the corners swap rows (k ^ 2) or columns (k ^ 1) in the other cell
+					const int flip = (k ^ l) == 1 ? 2 : 1;
+					coupling += level.pinCells[otherCell].matrix[k ^ flip][l ^ flip];
+				}
+				block[k][l] = coupling;
+				block[l][k] = coupling;
+			}
+		}
+
+		// Solve the block (symmetric positive definite) by elimination, and move the corners
+		for (int k = 0; k < 4; k++)
+		{
+			for (int l = k + 1; l < 4; l++)
+			{
+				const float factor = block[l][k] / block[k][k];
+				for (int c = k; c < 5; c++)
+				{
+					block[l][c] -= factor * block[k][c];
+				}
+			}
+		}
+		float delta[4];
+		for (int k = 3; k >= 0; k--)
+		{
+			float value = block[k][4];
+			for (int l = k + 1; l < 4; l++)
+			{
+				value -= block[k][l] * delta[l];
+			}
+			delta[k] = value / block[k][k];
+		}
+		for (int k = 0; k < 4; k++)
+		{
+			x[corners[k]] += delta[k];
+			if (thinPlate)
+			{
+				AddBending(level.curvatureX.data(), level.curvatureZ.data(), level.twist.data(), corners[k], m0 + (k >> 1),
+					n0 + (k & 1), resolution, scale * delta[k]);
+			}
+		}
+	}
+}
+
+void ConstraintSolver::ComputeResidual(int levelIndex)
+{
+	Level& level = levels[levelIndex];
+	ApplyOperator(levelIndex, level.x.data(), level.residual.data());
+	const size_t count = level.residual.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		level.residual[i] = level.rhs[i] - level.residual[i];
+	}
+}
+
+void ConstraintSolver::Restrict(int levelIndex, const std::vector<float>& source, std::vector<float>& target)
+{
+	const int fineResolution = levels[levelIndex].resolution;
+	const int coarseResolution = levels[levelIndex + 1].resolution;
+	ForEachRowBand(coarseResolution, GetThreads(coarseResolution), [&](int firstRow, int lastRow)
+	{
+		int rowTaps[3];
+		float rowWeights[3];
+		int columnTaps[3];
+		float columnWeights[3];
+		for (int i = firstRow; i < lastRow; i++)
+		{
+			const int rowCount = RestrictionTaps(i, fineResolution, coarseResolution, rowTaps, rowWeights);
+			for (int j = 0; j < coarseResolution; j++)
+			{
+				const int columnCount = RestrictionTaps(j, fineResolution, coarseResolution, columnTaps, columnWeights);
+				float sum = 0.0f;
+				for (int a = 0; a < rowCount; a++)
+				{
+					const float* row = &source[(size_t)rowTaps[a] * fineResolution];
+					for (int b = 0; b < columnCount; b++)
+					{
+						sum += rowWeights[a] * columnWeights[b] * row[columnTaps[b]];
+					}
+				}
+				target[(size_t)i * coarseResolution + j] = sum;
+			}
+		}
+	});
+}
+
+void ConstraintSolver::Prolong(int levelIndex)
+{
+	Level& fine = levels[levelIndex];
+	const Level& coarse = levels[levelIndex + 1];
+	const int fineResolution = fine.resolution;
+	const int coarseResolution = coarse.resolution;
+	ForEachRowBand(fineResolution, GetThreads(fineResolution), [&](int firstRow, int lastRow)
+	{
+		int rowTaps[2];
+		float rowWeights[2];
+		int columnTaps[2];
+		float columnWeights[2];
+		for (int m = firstRow; m < lastRow; m++)
+		{
+			const int rowCount = ProlongationTaps(m, coarseResolution, rowTaps, rowWeights);
+			for (int n = 0; n < fineResolution; n++)
+			{
+				const int columnCount = ProlongationTaps(n, coarseResolution, columnTaps, columnWeights);
+				float value = 0.0f;
+				for (int a = 0; a < rowCount; a++)
+				{
+					const float* row = &coarse.x[(size_t)rowTaps[a] * coarseResolution];
+					for (int b = 0; b < columnCount; b++)
+					{
+						value += rowWeights[a] * columnWeights[b] * row[columnTaps[b]];
+					}
+				}
+				fine.x[(size_t)m * fineResolution + n] += value;
+			}
+		}
+	});
+}
+
+void ConstraintSolver::VCycle(int levelIndex)
+{
+	if (levelIndex == (int)levels.size() - 1)
+	{
+		Smooth(levelIndex, kCoarsestSweeps, false);
+		Smooth(levelIndex, kCoarsestSweeps, true);
+		return;
+	}
+
+	// Smooth, solve the residual equation on the coarser grid for the error left, correct and smooth again in the
+	// reverse order, so the cycle is symmetric
+	Smooth(levelIndex, smoothingSteps, false);
+	ComputeResidual(levelIndex);
+	Level& coarse = levels[levelIndex + 1];
+	Restrict(levelIndex, levels[levelIndex].residual, coarse.rhs);
+	std::fill(coarse.x.begin(), coarse.x.end(), 0.0f);
+	VCycle(levelIndex + 1);
+	Prolong(levelIndex);
+	Smooth(levelIndex, smoothingSteps, true);
+}
+
+void ConstraintSolver::Precondition()
+{
+	std::fill(levels[0].x.begin(), levels[0].x.end(), 0.0f);
+	VCycle(0);
+}
+
+double ConstraintSolver::Dot(const std::vector<float>& a, const std::vector<float>& b)
+{
+	const int resolution = levels[0].resolution;
+	rowSums.assign(resolution, 0.0);
+	ForEachRowBand(resolution, GetThreads(resolution), [&](int firstRow, int lastRow)
+	{
+		for (int m = firstRow; m < lastRow; m++)
+		{
+			double sum = 0.0;
+			for (size_t i = (size_t)m * resolution; i < (size_t)(m + 1) * resolution; i++)
+			{
+				sum += (double)a[i] * b[i];
+			}
+			rowSums[m] = sum;
+		}
+	});
+	double sum = 0.0;
+	for (double rowSum : rowSums)
+	{
+		sum += rowSum;
+	}
+	return sum;
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <vector>
+#include "HeightMap.h"
+
+// How the heights between the constraints are filled
+enum class ConstraintFill
+{
+	Membrane,	// Laplace equation, the smoothest surface in slope: flat between the constraints, creased at them
+	ThinPlate	// biharmonic equation, the smoothest surface in curvature: round hills and valleys through the constraints
+};
+
+// A height pinned at a position of the grid, in points: x along the columns (n) and z along the rows (m)
+struct ControlPoint
+{
+	ControlPoint() : x(0.0f), z(0.0f), height(0.0f) {}
+	ControlPoint(float px, float pz, float pheight) : x(px), z(pz), height(pheight) {}
+
+	float x;
+	float z;
+	float height;
+};
+
+// How ConstraintSolver solves the heights
+struct ConstraintSettings
+{
+	ConstraintSettings()
+	{
+		fill = ConstraintFill::ThinPlate;
+		detail = 0.0f;
+		maxCycles = 30;
+		tolerance = 1e-3f;
+		smoothingSteps = 2;
+	}
+
+	ConstraintFill fill;
+	// Amount of the current heights kept as a detail layer on top of the smooth surface, which goes through the
+	// constraints minus the detail so the sum still meets them. 0 replaces the heights
+	float detail;
+	// Conjugate gradient iterations after the full multigrid pass, at most, each preconditioned by a V-cycle
+	int maxCycles;
+	// The iterations stop when the preconditioned residual falls to this fraction of the one after the full multigrid
+	// pass
+	float tolerance;
+	// Gauss-Seidel sweeps before and after the coarse grid correction of every level
+	int smoothingSteps;
+};
+
+// Smooth terrain through heights pinned at points and along curves (a sketch), with a geometric multigrid solver.
+// The constrained points are pulled to their heights with a large weight w, and the heights h minimise the membrane
+// energy |grad h|^2 (the squared differences of the 4 neighbours) or the thin plate one h_xx^2 + 2 h_xz^2 + h_zz^2
+// (the squared second differences) plus w (h - height)^2. The borders are free, and the minimum is the solution of
+// the linear system (A + W) h = W c.
+// Relaxation alone needs thousands of sweeps, as the heights only travel a point per sweep. The multigrid V-cycle
+// smooths on every level of a pyramid of grids, each half the resolution of the last, and corrects the finer level
+// with the solution of the coarser one, which removes the error at every scale in O(n) per cycle:
+// - the coarse grids use the Galerkin operator of the fine one: the residual is restricted with the transpose of
+//   the bilinear prolongation, the membrane operator keeps its scale and the thin plate one is divided by 4 per
+//   level. A pin between the points of a coarse grid pins the bilinear interpolation of the 4 points around it
+// - the smoother is Gauss-Seidel in 4 colours (membrane) or 5 (thin plate, whose stencil reaches 2 points away),
+//   so the points of a colour do not depend on each other and each colour is split in row bands across threads.
+//   The 4 points around a pin are then solved together
+// - the first solution comes from a full multigrid pass (solved on the coarsest grid, then prolonged and cycled on
+//   every finer one). Conjugate gradients preconditioned by one V-cycle per iteration then correct it, which
+//   converges much faster than repeating the V-cycles where the pins dominate the thin plate on the coarse grids
+class ConstraintSolver
+{
+public:
+	ConstraintSolver();
+
+	// Threads used by the row passes, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+
+	// Pin a height at a position of the grid (the nearest point)
+	void AddPoint(float x, float z, float height);
+	// Pin the heights along the polyline through the control points, interpolated linearly between them
+	void AddCurve(const std::vector<ControlPoint>& curve);
+	void ClearConstraints() { segments.clear(); }
+	// Points and curve segments added
+	int GetConstraintCount()const { return (int)segments.size(); }
+
+	// Replace the heights of the map with the smooth surface through the constraints (plus the detail layer).
+	// Returns false if the map is empty or no constraint falls inside it
+	bool Solve(HeightMap& map, const ConstraintSettings& settings);
+
+	// Points of the map pinned by the last Solve
+	int GetPinnedCount()const { return pinnedCount; }
+	// Conjugate gradient iterations (V-cycles after the full multigrid pass) of the last Solve
+	int GetCycles()const { return cycles; }
+	// Preconditioned residual left by the last Solve, as a fraction of the one after the full multigrid pass
+	float GetResidual()const { return residual; }
+
+	// Release the grids kept for the next Solve
+	void Release();
+
+private:
+	// A constraint is a segment between two control points, a point is a segment of length 0
+	struct Segment
+	{
+		ControlPoint start;
+		ControlPoint end;
+	};
+
+	// The pins of a cell of a grid, which pull the bilinear interpolation of its 4 corners (top left, top right,
+	// bottom left, bottom right) to the heights: the sum of w t t^T, with t the interpolation weights of every pin
+	struct PinCell
+	{
+		int index;			// top left corner
+		float matrix[4][4];
+	};
+
+	// A grid of the multigrid pyramid, the finest is the first
+	struct Level
+	{
+		int resolution;
+		// Scale of the thin plate operator, the Galerkin coarse operator is smaller on every level
+		float scale;
+		std::vector<float> x;			// solution (the heights on the finest level, a correction on the others)
+		std::vector<float> rhs;			// right hand side, W c or the restricted residual of the finer level
+		std::vector<float> residual;
+		// The cells with pins, and the one of every cell (by its top left corner) or -1
+		std::vector<PinCell> pinCells;
+		std::vector<int> cellPins;
+		// Second differences of x along the rows and the columns and across the cells (the thin plate), scaled
+		std::vector<float> curvatureX;
+		std::vector<float> curvatureZ;
+		std::vector<float> twist;
+	};
+
+	// Pin the points along the segments: the pinned points and the right hand side of the first level
+	void PinConstraints(const float* heights, float detail);
+	// The pin cells of a level, from the pinned points of the first level
+	void BuildPins(int level);
+	void BuildLevels(int resolution);
+
+	// The scaled second differences of v of a level into 'curvatureX', 'curvatureZ' and 'twist'
+	void ComputeBending(int level, const float* values);
+	// W v at point (m, n) of a level, and the diagonal of W
+	float PinSum(const Level& level, const float* values, int m, int n, float& diagonal)const;
+	// A v of a level, the thin plate overwrites the second differences
+	void ApplyOperator(int level, const float* values, float* result);
+	// Gauss-Seidel sweeps of a level, the colours in reverse order if 'backwards'
+	void Smooth(int level, int sweeps, bool backwards);
+	// Solve the 4 corners of every cell with pins between the points of a level together, as the pins tie them much
+	// more than the operator and the point sweeps barely move them apart. In reverse order if 'backwards'
+	void RelaxPins(int level, bool backwards);
+	// rhs - A x of a level into 'residual'
+	void ComputeResidual(int level);
+	// Restrict 'source' of a level into 'target' of the next coarser one, with the transpose of the prolongation
+	void Restrict(int level, const std::vector<float>& source, std::vector<float>& target);
+	// Add the solution of the next coarser level to the solution of a level, interpolated bilinearly
+	void Prolong(int level);
+	void VCycle(int level);
+	// One V-cycle from 0 on the first level, its solution is the preconditioned right hand side
+	void Precondition();
+	// Dot product of two vectors of the first level
+	double Dot(const std::vector<float>& a, const std::vector<float>& b);
+	int GetThreads(int resolution)const;
+
+	int threadCount;
+	ConstraintFill fill;
+	int smoothingSteps;
+
+	std::vector<Segment> segments;
+	std::vector<Level> levels;
+	// Sum of the heights pinned to every point of the first level and how many there are, and the pinned points
+	std::vector<float> pinHeights;
+	std::vector<int> pinCounts;
+	std::vector<int> pinnedPoints;
+	// Conjugate gradients on the first level: the heights, the search direction and the operator applied to it
+	std::vector<float> solution;
+	std::vector<float> search;
+	std::vector<float> product;
+	// Sums of the rows of a dot product
+	std::vector<double> rowSums;
+
+	int pinnedCount;
+	int cycles;
+	float residual;
+};
@@ -0,0 +1,359 @@
+#include "HeightMap.h"
+#include "RowBandPool.h"
+
+#define _USE_MATH_DEFINES // it has to be set the first thing before any include <>
+#include <cmath>
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+
+namespace
+{
+	const size_t kThreadedTexels = 128 * 128; // smaller maps are processed on one thread
+
+	// Average of the 3x3 neighbourhood of the rows [firstRow, lastRow), the border through the boundary policy
+	template <class Boundary>
+	void SmoothRows(const float* heights, float* smoothed, int resolution, int firstRow, int lastRow)
+	{
+		Stencil<NeighbourhoodTaps, Boundary>::ApplyRows(heights, smoothed, resolution, firstRow, lastRow, AverageKernel());
+	}
+
+	// Normals of the first triangle of every quad between the point rows 'row' and 'nextRow'.
+	// The triangle corners are a = (i, row), b = (i + 1, row) and c = (i, nextRow), the normal is (c - a) x (b - a)
+	void FaceNormals(const float* row, const float* nextRow, int quads, float spacing, XMFLOAT3* normals)
+	{
+		for (int i = 0; i < quads; i++)
+		{
+			// (0, dz, spacing) x (spacing, dx, 0) = spacing * (-dx, spacing, -dz)
+			float dx = row[i + 1] - row[i];
+			float dz = nextRow[i] - row[i];
+			float invLength = 1.0f / sqrtf(dx * dx + spacing * spacing + dz * dz);
+			normals[i] = XMFLOAT3(-dx * invLength, spacing * invLength, -dz * invLength);
+		}
+	}
+}
+
+HeightMap::HeightMap()
+{
+	resolution = 0;
+	threadCount = 0;
+}
+
+void HeightMap::Resize(int newResolution)
+{
+	resolution = newResolution;
+	heights.assign((size_t)resolution * resolution, 0.0f);
+	std::vector<float>().swap(scratch);
+}
+
+void HeightMap::Release()
+{
+	std::vector<float>().swap(heights);
+	std::vector<float>().swap(scratch);
+}
+
+int HeightMap::GetThreads(size_t texels)const
+{
+	if (texels < kThreadedTexels)
+	{
+		return 1;
+	}
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	return threads > 0 ? threads : 1;
+}
+
+
+//////////////////////////////// BUILD HEIGHT MAP FROM 0 FUNCTIONS ////////////////////////////////
+
+void HeightMap::BuildWaves(const WavesData& wavesData, float scale)
+{
+	// The number inside the sin or cos modify the frequency and the number outside is the Amplitude.
+	// Every wave has half the amplitude and double the frequency of the previous one
+	ForEachRowBand(resolution, GetThreads(heights.size()), [&](int firstRow, int lastRow)
+	{
+		for (int k = firstRow; k < lastRow; k++)
+		{
+			// Waves along z-axis are the same for the whole row
+			float rowHeight = (cos((float)k * wavesData.frequency.z * scale + wavesData.offset.z)) * wavesData.amplitude.z;
+			rowHeight += (cos((float)k * wavesData.frequency.z * 2.0f * scale + wavesData.offset.z)) * wavesData.amplitude.z * 0.5f;
+			rowHeight += (cos((float)k * wavesData.frequency.z * 4.0f * scale + wavesData.offset.z)) * wavesData.amplitude.z * 0.25f;
+
+			float* row = &heights[GetIndex(k, 0)];
+			for (int i = 0; i < resolution; i++)
+			{
+				// Waves along x-axis
+				float height = (sin((float)i * wavesData.frequency.x * scale + wavesData.offset.x)) * wavesData.amplitude.x;
+				height += (sin((float)i * wavesData.frequency.x * 2.0f * scale + wavesData.offset.x)) * wavesData.amplitude.x * 0.5f;
+				height += (sin((float)i * wavesData.frequency.x * 4.0f * scale + wavesData.offset.x)) * wavesData.amplitude.x * 0.25f;
+				row[i] = height + rowHeight;
+			}
+		}
+	});
+}
+
+void HeightMap::BuildRandom(Range range)
+{
+	ForEachRowBand(resolution, GetThreads(heights.size()), [&](int firstRow, int lastRow)
+	{
+		for (int k = firstRow; k < lastRow; k++)
+		{
+			for (int i = 0; i < resolution; i++)
+			{
+				heights[GetIndex(k, i)] = Utils::GetRandom(range); // random number in the range [min, max]
+			}
+		}
+	});
+}
+
+
+//////////////////////////////// MODIFY HEIGHT MAP FUNCTIONS ////////////////////////////////
+
+void HeightMap::Flatten()
+{
+	// A fill runs at memory speed on one thread, more threads were slower at every resolution of the terrain benchmark
+	std::fill(heights.begin(), heights.end(), 0.0f);
+}
+
+void HeightMap::Fault(Range heightOffsetRange)
+{
+	// A random point in the map and a random direction of the fault line through it
+	float pointX = (float)(rand() % resolution);
+	float pointZ = (float)(rand() % resolution);
+	float angle = (float)(((rand() % 360) * M_PI) / 180);
+	float lineX = sinf(angle);
+	float lineZ = cosf(angle);
+
+	// get the offset to move up and move down
+	float heightOffset = Utils::GetRandom(heightOffsetRange);
+
+	ForEachRowBand(resolution, GetThreads(heights.size()), [&](int firstRow, int lastRow)
+	{
+		for (int k = firstRow; k < lastRow; k++)
+		{
+			float* row = &heights[GetIndex(k, 0)];
+			for (int i = 0; i < resolution; i++)
+			{
+				// y of the cross product between the fault line and the line from the point to the current vertex
+				// tells on which side of the fault line the vertex is
+				float side = lineZ * ((float)i - pointX) - lineX * ((float)k - pointZ);
+				row[i] += side > 0 ? heightOffset : -heightOffset;
+			}
+		}
+	});
+}
+
+void HeightMap::Smooth(StencilBoundary boundary)
+{
+	scratch.resize(heights.size());
+
+	ForEachRowBand(resolution, GetThreads(heights.size()), [&](int firstRow, int lastRow)
+	{
+		switch (boundary)
+		{
+		case StencilBoundary::Clamp:
+			SmoothRows<ClampBoundary>(heights.data(), scratch.data(), resolution, firstRow, lastRow);
+			break;
+		case StencilBoundary::Wrap:
+			SmoothRows<WrapBoundary>(heights.data(), scratch.data(), resolution, firstRow, lastRow);
+			break;
+		case StencilBoundary::Mirror:
+			SmoothRows<MirrorBoundary>(heights.data(), scratch.data(), resolution, firstRow, lastRow);
+			break;
+		default:
+			SmoothRows<SkipBoundary>(heights.data(), scratch.data(), resolution, firstRow, lastRow);
+			break;
+		}
+	});
+
+	// replace the old height map with the filtered one
+	heights.swap(scratch);
+}
+
+void HeightMap::ParticleDeposition(int m, int n, float height)
+{
+	int lowest = GetIndex(m, n);
+
+	// look throught the neighbours of the point, the first lowest one wins
+	int taps[NeighbourhoodTaps::kCount];
+	const int count = Stencil<NeighbourhoodTaps, SkipBoundary>::Gather(resolution, m, n, 1, taps);
+	for (int t = 0; t < count; t++)
+	{
+		lowest = heights[taps[t]] < heights[lowest] ? taps[t] : lowest;
+	}
+
+	// add height to the map
+	heights[lowest] += height;
+}
+
+void HeightMap::AntiParticleDeposition(int m, int n, float height)
+{
+	int highest = GetIndex(m, n);
+
+	// look throught the neighbours of the point, the first highest one wins
+	int taps[NeighbourhoodTaps::kCount];
+	const int count = Stencil<NeighbourhoodTaps, SkipBoundary>::Gather(resolution, m, n, 1, taps);
+	for (int t = 0; t < count; t++)
+	{
+		highest = heights[taps[t]] > heights[highest] ? taps[t] : highest;
+	}
+
+	// substract height to the map
+	heights[highest] -= height;
+}
+
+bool HeightMap::DiamondSquare(Range heightOffsetRange)
+{
+	// The height maps needs to be (2^n)+1 where n>0
+	// By taking log2 of N and then pass it to floor and ceil if both gives same result then N is power of 2
+	// as we are checking 2^n+1 then we neeed to substract 1 from the resolution to check this
+	if (resolution < 3 || ceil(log2(resolution - 1)) != floor(log2(resolution - 1)))
+	{
+		return false;
+	}
+
+	// Asign a random height to each corner
+	heights[GetIndex(0, 0)] = Utils::GetRandom(heightOffsetRange);
+	heights[GetIndex(0, resolution - 1)] = Utils::GetRandom(heightOffsetRange);
+	heights[GetIndex(resolution - 1, 0)] = Utils::GetRandom(heightOffsetRange);
+	heights[GetIndex(resolution - 1, resolution - 1)] = Utils::GetRandom(heightOffsetRange);
+
+	int chunkSize = resolution - 1; // portion we are working on
+
+	while (chunkSize > 1)
+	{
+		// get the half of the portion we are working on
+		int half = chunkSize / 2;
+
+		SquareStep(chunkSize, half, heightOffsetRange);
+		DiamondStep(chunkSize, half, heightOffsetRange);
+
+		chunkSize /= 2;
+		// halve the height offset
+		heightOffsetRange.min /= 2.0f;
+		heightOffsetRange.max /= 2.0f;
+	}
+	return true;
+}
+
+void HeightMap::SquareStep(int chunkSize, int half, Range range)
+{
+	// The centers of the squares only read the corners, so the rows of squares are independent
+	int rows = (resolution - 1) / chunkSize;
+	ForEachRowBand(rows, GetThreads((size_t)rows * rows), [&](int firstRow, int lastRow)
+	{
+		for (int k = firstRow * chunkSize; k < lastRow * chunkSize; k += chunkSize)
+		{
+			for (int i = 0; i < resolution - 1; i += chunkSize)
+			{
+				// calculate the average of the four corners
+				float cornersAvg = (heights[GetIndex(k, i)] + heights[GetIndex(k, i + chunkSize)] +
+					heights[GetIndex(k + chunkSize, i)] + heights[GetIndex(k + chunkSize, i + chunkSize)]) / 4.0f;
+
+				// set the height to the square center point
+				heights[GetIndex(k + half, i + half)] = cornersAvg + Utils::GetRandom(range);
+			}
+		}
+	});
+}
+
+void HeightMap::DiamondStep(int chunkSize, int half, Range range)
+{
+	// The diamond centers only read corners and square centers, so the rows are independent
+	int rows = (resolution - 1) / half + 1;
+	ForEachRowBand(rows, GetThreads((size_t)rows * rows / 2), [&](int firstRow, int lastRow)
+	{
+		for (int k = firstRow * half; k < lastRow * half; k += half)
+		{
+			for (int i = (k + half) % chunkSize; i < resolution; i += chunkSize)
+			{
+				// average the top, left, right and bottom corners inside the map
+				AverageKernel average;
+				int corners[DiamondTaps::kCount];
+				const int count = Stencil<DiamondTaps, SkipBoundary>::Gather(resolution, k, i, half, corners);
+				float cornersSum = average.Start();
+				for (int c = 0; c < count; c++)
+				{
+					cornersSum = average.Add(cornersSum, heights[corners[c]]);
+				}
+
+				// set the average plus a random offset to the diamond center point
+				heights[GetIndex(k, i)] = average.Finish(cornersSum, count) + Utils::GetRandom(range);
+			}
+		}
+	});
+}
+
+
+//////////////////////////////// VERTICES ////////////////////////////////
+
+void HeightMap::BuildVertices(TerrainVertex* vertices, float spacing, float uvIncrement)const
+{
+	BuildVertexRows(0, resolution, vertices, spacing, uvIncrement);
+}
+
+void HeightMap::BuildVertexRows(int firstMapRow, int lastMapRow, TerrainVertex* vertices, float spacing, float uvIncrement)const
+{
+	const int quads = resolution - 1;
+	const int rows = lastMapRow - firstMapRow;
+
+	ForEachRowBand(rows, GetThreads((size_t)rows * resolution), [&](int firstBandRow, int lastBandRow)
+	{
+		const int firstRow = firstMapRow + firstBandRow;
+		const int lastRow = firstMapRow + lastBandRow;
+
+		// Normals of the triangles below and above the current row of points
+		std::vector<XMFLOAT3> faceNormals(2 * (size_t)quads);
+		XMFLOAT3* below = faceNormals.data();
+		XMFLOAT3* above = below + quads;
+		if (firstRow > 0)
+		{
+			FaceNormals(&heights[GetIndex(firstRow - 1, 0)], &heights[GetIndex(firstRow, 0)], quads, spacing, below);
+		}
+
+		for (int j = firstRow; j < lastRow; j++)
+		{
+			if (j < quads)
+			{
+				FaceNormals(&heights[GetIndex(j, 0)], &heights[GetIndex(j + 1, 0)], quads, spacing, above);
+			}
+
+			TerrainVertex* vertex = &vertices[GetIndex(j - firstMapRow, 0)];
+			const float* row = &heights[GetIndex(j, 0)];
+			for (int i = 0; i < resolution; i++, vertex++)
+			{
+				vertex->position = XMFLOAT3((float)i * spacing, row[i], (float)j * spacing);
+				vertex->texture = XMFLOAT2((float)i * uvIncrement, (float)j * uvIncrement);
+
+				// Smooth the normals by averaging the normals of the surrounding triangles
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				if (j > 0)
+				{
+					if (i > 0)
+					{
+						x += below[i - 1].x; y += below[i - 1].y; z += below[i - 1].z;
+					}
+					if (i < quads)
+					{
+						x += below[i].x; y += below[i].y; z += below[i].z;
+					}
+				}
+				if (j < quads)
+				{
+					if (i > 0)
+					{
+						x += above[i - 1].x; y += above[i - 1].y; z += above[i - 1].z;
+					}
+					if (i < quads)
+					{
+						x += above[i].x; y += above[i].y; z += above[i].z;
+					}
+				}
+				float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+				vertex->normal = XMFLOAT3(x * invLength, y * invLength, z * invLength);
+			}
+			std::swap(below, above);
+		}
+	});
+}
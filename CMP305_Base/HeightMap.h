@@ -0,0 +1,101 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Utils.h"
+#include "Stencil.h"
+
+using namespace DirectX;
+
+// Frecuency, amplitude and all the data for Waves
+struct WavesData
+{
+	WavesData()
+	{
+		// initialise values to 0
+		frequency = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		amplitude = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		offset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
+
+	XMFLOAT3 frequency;
+	XMFLOAT3 amplitude;
+	XMFLOAT3 offset;
+};
+
+// Terrain vertex built from the height map, the same layout as BaseMesh::VertexType
+struct TerrainVertex
+{
+	XMFLOAT3 position;
+	XMFLOAT2 texture;
+	XMFLOAT3 normal;
+};
+
+// Square grid of heights and the operations that generate or modify it.
+// It does not depend on Direct3D, TerrainMesh wraps it and uploads the result, and the benchmarks run it headless.
+// Operations working row by row are split between threads on large maps (see SetThreadCount), the threads are
+// kept in the RowBandPool shared with the other grid operations
+class HeightMap
+{
+public:
+	HeightMap();
+
+	// Allocate resolution * resolution heights, all 0
+	void Resize(int newResolution);
+	// Release the heights (the resolution is kept), IsEmpty() is true until the next Resize
+	void Release();
+
+	bool IsEmpty()const { return heights.empty(); }
+	int GetResolution()const { return resolution; }
+	float* GetData() { return heights.data(); }
+	const float* GetData()const { return heights.data(); }
+	// Height of the point in row m (z-axis) and column n (x-axis)
+	float GetHeight(int m, int n)const { return heights[GetIndex(m, n)]; }
+
+	// Threads used by the row operations, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+
+	// BUILD HEIGHT MAP FROM 0 FUNCTIONS //
+	// Sine waves along the x-axis and cosine waves along the z-axis, 'scale' is the distance between two points
+	void BuildWaves(const WavesData& wavesData, float scale);
+	// Random heights in the range
+	void BuildRandom(Range range);
+
+	// MODIFY HEIGHT MAP FUNCTIONS //
+	// Set to 0 the height of every point
+	void Flatten();
+	// Raise one side of a random line by a random offset in the range and lower the other side
+	void Fault(Range heightOffsetRange);
+	// Replace every height with the average of its 3x3 neighbourhood, the border points average the neighbours
+	// inside the map (Skip) or read outside it through the boundary policy (see Stencil.h)
+	void Smooth(StencilBoundary boundary = StencilBoundary::Skip);
+	// Add 'height' to the lowest point of the 3x3 neighbourhood of (m, n)
+	void ParticleDeposition(int m, int n, float height);
+	// Subtract 'height' from the highest point of the 3x3 neighbourhood of (m, n)
+	void AntiParticleDeposition(int m, int n, float height);
+	// Diamond-Square (Midpoint Displacement), the resolution has to be (2^n)+1. Returns false otherwise
+	bool DiamondSquare(Range heightOffsetRange);
+
+	// Fill resolution * resolution vertices: positions 'spacing' apart, UVs 'uvIncrement' apart
+	// and normals averaged from the surrounding triangles
+	void BuildVertices(TerrainVertex* vertices, float spacing, float uvIncrement)const;
+	// Fill the vertices of the rows [firstRow, lastRow) only, 'vertices' receives the first vertex of firstRow
+	void BuildVertexRows(int firstRow, int lastRow, TerrainVertex* vertices, float spacing, float uvIncrement)const;
+
+	// check if a point is in the map
+	bool InBounds(int m, int n)const { return m >= 0 && m < resolution && n >= 0 && n < resolution; }
+	// m(rows) == k == z, n(columns) == i == x
+	int GetIndex(int m, int n)const { return (m * resolution) + n; }
+
+private:
+	// Number of threads for an operation over 'texels' points
+	int GetThreads(size_t texels)const;
+	void SquareStep(int chunkSize, int half, Range range);
+	void DiamondStep(int chunkSize, int half, Range range);
+
+	int resolution;
+	int threadCount;
+	std::vector<float> heights;
+	// Destination of Smooth, swapped with the heights
+	std::vector<float> scratch;
+};
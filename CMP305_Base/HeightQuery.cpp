@@ -0,0 +1,361 @@
+#include "HeightQuery.h"
+
+#define _USE_MATH_DEFINES // it has to be set the first thing before any include <>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define HEIGHT_QUERY_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float kDegrees = (float)(180.0 / M_PI);
+
+#ifdef HEIGHT_QUERY_SSE2
+	// Four floats with the arithmetic operators of a float, so the single and the batched queries share the
+	// interpolation code below and round exactly the same way
+	struct Float4
+	{
+		Float4() {}
+		Float4(float value) : v(_mm_set1_ps(value)) {}
+		Float4(__m128 value) : v(value) {}
+
+		__m128 v;
+	};
+
+	inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+	inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+	inline Float4 operator-(Float4 a) { return _mm_sub_ps(_mm_setzero_ps(), a.v); }
+	inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+	inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+	inline Float4 Sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+#endif
+
+	inline float Sqrt(float a) { return sqrtf(a); }
+
+	// Catmull-Rom weights of the 4 points around a position 't' (0 to 1) between the second and the third,
+	// and the derivatives of the weights
+	template <class T>
+	inline void CubicWeights(T t, T weights[4], T derivatives[4])
+	{
+		T t2 = t * t;
+		T t3 = t2 * t;
+		weights[0] = T(0.5f) * ((T(2.0f) * t2 - t3) - t);
+		weights[1] = T(0.5f) * ((T(3.0f) * t3 - T(5.0f) * t2) + T(2.0f));
+		weights[2] = T(0.5f) * ((T(4.0f) * t2 - T(3.0f) * t3) + t);
+		weights[3] = T(0.5f) * (t3 - t2);
+		derivatives[0] = T(0.5f) * ((T(4.0f) * t - T(3.0f) * t2) - T(1.0f));
+		derivatives[1] = T(0.5f) * (T(9.0f) * t2 - T(10.0f) * t);
+		derivatives[2] = T(0.5f) * ((T(8.0f) * t - T(9.0f) * t2) + T(1.0f));
+		derivatives[3] = T(0.5f) * (T(3.0f) * t2 - T(2.0f) * t);
+	}
+
+	// Bilinear height of the cell with the corners h = {(0, 0), (0, 1), (1, 0), (1, 1)} (row, column),
+	// and its derivatives along the columns (du) and the rows (dv)
+	template <class T>
+	inline T Bilinear(const T h[4], T fx, T fz, T& du, T& dv)
+	{
+		T gx = T(1.0f) - fx;
+		T gz = T(1.0f) - fz;
+		du = (h[1] - h[0]) * gz + (h[3] - h[2]) * fz;
+		dv = (h[2] - h[0]) * gx + (h[3] - h[1]) * fx;
+		return (h[0] * gx + h[1] * fx) * gz + (h[2] * gx + h[3] * fx) * fz;
+	}
+
+	// Bicubic height of the 4x4 points h (row major) at (fx, fz) inside the centre cell, and its derivatives
+	template <class T>
+	inline T Bicubic(const T h[16], T fx, T fz, T& du, T& dv)
+	{
+		T wx[4], dx[4], wz[4], dz[4];
+		CubicWeights(fx, wx, dx);
+		CubicWeights(fz, wz, dz);
+
+		T height = T(0.0f);
+		du = T(0.0f);
+		dv = T(0.0f);
+		for (int row = 0; row < 4; row++)
+		{
+			const T* p = h + row * 4;
+			T value = ((p[0] * wx[0] + p[1] * wx[1]) + p[2] * wx[2]) + p[3] * wx[3];
+			T slope = ((p[0] * dx[0] + p[1] * dx[1]) + p[2] * dx[2]) + p[3] * dx[3];
+			height = height + value * wz[row];
+			du = du + slope * wz[row];
+			dv = dv + value * dz[row];
+		}
+		return height;
+	}
+
+	// Unit normal of a surface with the gradient (gradientX, gradientZ)
+	template <class T>
+	inline void Normal(T gradientX, T gradientZ, T& x, T& y, T& z)
+	{
+		T length = Sqrt((gradientX * gradientX + T(1.0f)) + gradientZ * gradientZ);
+		x = -gradientX / length;
+		y = T(1.0f) / length;
+		z = -gradientZ / length;
+	}
+
+	// Cell (m, n) containing the grid position of (x, z), clamped to the grid, and the position inside the cell
+	inline void FindCell(float x, float z, float invSpacing, int resolution, int& m, int& n, float& fx, float& fz)
+	{
+		const float maxCoordinate = (float)(resolution - 1);
+		const float maxCell = (float)(resolution - 2);
+		float u = x * invSpacing;
+		float v = z * invSpacing;
+		u = u > 0.0f ? (u < maxCoordinate ? u : maxCoordinate) : 0.0f;
+		v = v > 0.0f ? (v < maxCoordinate ? v : maxCoordinate) : 0.0f;
+		float cellU = (float)(int)u;
+		float cellV = (float)(int)v;
+		cellU = cellU < maxCell ? cellU : maxCell;
+		cellV = cellV < maxCell ? cellV : maxCell;
+		n = (int)cellU;
+		m = (int)cellV;
+		fx = u - cellU;
+		fz = v - cellV;
+	}
+
+	// The corners of cell (m, n)
+	inline void LoadCell(const float* values, int resolution, int m, int n, float h[4])
+	{
+		const float* p = values + (size_t)m * resolution + n;
+		h[0] = p[0];
+		h[1] = p[1];
+		h[2] = p[resolution];
+		h[3] = p[resolution + 1];
+	}
+
+	// The 4x4 points around cell (m, n), the ones outside the grid replaced by the nearest border point
+	inline void LoadPatch(const float* values, int resolution, int m, int n, float h[16])
+	{
+		int columns[4] = { n > 0 ? n - 1 : 0, n, n + 1, n + 2 < resolution ? n + 2 : resolution - 1 };
+		int rows[4] = { m > 0 ? m - 1 : 0, m, m + 1, m + 2 < resolution ? m + 2 : resolution - 1 };
+		for (int row = 0; row < 4; row++)
+		{
+			const float* p = values + (size_t)rows[row] * resolution;
+			for (int column = 0; column < 4; column++)
+			{
+				h[row * 4 + column] = p[columns[column]];
+			}
+		}
+	}
+
+#ifdef HEIGHT_QUERY_SSE2
+	// Heights and gradients of four positions, the same operations as HeightQuery::Sample
+	Float4 SampleFour(const float* values, int resolution, float invSpacing, HeightInterpolation interpolation,
+		const float* x, const float* z, Float4& gradientX, Float4& gradientZ)
+	{
+		const __m128 maxCoordinate = _mm_set1_ps((float)(resolution - 1));
+		const __m128 maxCell = _mm_set1_ps((float)(resolution - 2));
+		__m128 u = _mm_mul_ps(_mm_loadu_ps(x), _mm_set1_ps(invSpacing));
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(z), _mm_set1_ps(invSpacing));
+		u = _mm_min_ps(_mm_max_ps(u, _mm_setzero_ps()), maxCoordinate);
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), maxCoordinate);
+		__m128 cellU = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(u)), maxCell);
+		__m128 cellV = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(v)), maxCell);
+		Float4 fx = _mm_sub_ps(u, cellU);
+		Float4 fz = _mm_sub_ps(v, cellV);
+
+		int n[4], m[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(n), _mm_cvttps_epi32(cellU));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(m), _mm_cvttps_epi32(cellV));
+
+		// Gather the points of every lane, then transpose them into one Float4 per point
+		Float4 du, dv, height;
+		if (interpolation == kBicubic)
+		{
+			float lanes[4][16];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				LoadPatch(values, resolution, m[lane], n[lane], lanes[lane]);
+			}
+			Float4 h[16];
+			for (int k = 0; k < 16; k++)
+			{
+				h[k] = _mm_set_ps(lanes[3][k], lanes[2][k], lanes[1][k], lanes[0][k]);
+			}
+			height = Bicubic(h, fx, fz, du, dv);
+		}
+		else
+		{
+			float lanes[4][4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				LoadCell(values, resolution, m[lane], n[lane], lanes[lane]);
+			}
+			Float4 h[4];
+			for (int k = 0; k < 4; k++)
+			{
+				h[k] = _mm_set_ps(lanes[3][k], lanes[2][k], lanes[1][k], lanes[0][k]);
+			}
+			height = Bilinear(h, fx, fz, du, dv);
+		}
+
+		gradientX = du * Float4(invSpacing);
+		gradientZ = dv * Float4(invSpacing);
+		return height;
+	}
+#endif
+}
+
+HeightQuery::HeightQuery()
+{
+	values = nullptr;
+	resolution = 0;
+	spacing = 1.0f;
+	invSpacing = 1.0f;
+	interpolation = kBilinear;
+}
+
+void HeightQuery::SetGrid(const float* newValues, int newResolution, float newSpacing)
+{
+	values = newValues;
+	resolution = newResolution;
+	spacing = newSpacing;
+	invSpacing = 1.0f / newSpacing;
+}
+
+float HeightQuery::Sample(float x, float z, float& gradientX, float& gradientZ)const
+{
+	int m, n;
+	float fx, fz, du, dv, height;
+	FindCell(x, z, invSpacing, resolution, m, n, fx, fz);
+
+	if (interpolation == kBicubic)
+	{
+		float h[16];
+		LoadPatch(values, resolution, m, n, h);
+		height = Bicubic(h, fx, fz, du, dv);
+	}
+	else
+	{
+		float h[4];
+		LoadCell(values, resolution, m, n, h);
+		height = Bilinear(h, fx, fz, du, dv);
+	}
+
+	gradientX = du * invSpacing;
+	gradientZ = dv * invSpacing;
+	return height;
+}
+
+float HeightQuery::GetHeight(float x, float z, XMFLOAT2* gradient)const
+{
+	if (!IsValid())
+	{
+		return 0.0f;
+	}
+
+	float gradientX, gradientZ;
+	float height = Sample(x, z, gradientX, gradientZ);
+	if (gradient)
+	{
+		*gradient = XMFLOAT2(gradientX, gradientZ);
+	}
+	return height;
+}
+
+XMFLOAT3 HeightQuery::GetNormal(float x, float z)const
+{
+	if (!IsValid())
+	{
+		return XMFLOAT3(0.0f, 1.0f, 0.0f);
+	}
+
+	float gradientX, gradientZ;
+	Sample(x, z, gradientX, gradientZ);
+	XMFLOAT3 normal;
+	Normal(gradientX, gradientZ, normal.x, normal.y, normal.z);
+	return normal;
+}
+
+float HeightQuery::GetSlope(float x, float z)const
+{
+	if (!IsValid())
+	{
+		return 0.0f;
+	}
+
+	float gradientX, gradientZ;
+	Sample(x, z, gradientX, gradientZ);
+	return atanf(sqrtf(gradientX * gradientX + gradientZ * gradientZ)) * kDegrees;
+}
+
+void HeightQuery::GetHeights(const float* x, const float* z, size_t count, float* heights)const
+{
+	SurfaceQueryResults results;
+	results.heights = heights;
+	GetSurface(x, z, count, results);
+}
+
+void HeightQuery::GetSurface(const float* x, const float* z, size_t count, const SurfaceQueryResults& results)const
+{
+	const bool normals = results.normalX || results.normalY || results.normalZ;
+	if (!IsValid())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (results.heights) results.heights[i] = 0.0f;
+			if (results.normalX) results.normalX[i] = 0.0f;
+			if (results.normalY) results.normalY[i] = 1.0f;
+			if (results.normalZ) results.normalZ[i] = 0.0f;
+			if (results.slopes) results.slopes[i] = 0.0f;
+		}
+		return;
+	}
+
+	size_t i = 0;
+
+#ifdef HEIGHT_QUERY_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		Float4 gradientX, gradientZ;
+		Float4 height = SampleFour(values, resolution, invSpacing, interpolation, x + i, z + i, gradientX, gradientZ);
+		if (results.heights)
+		{
+			_mm_storeu_ps(results.heights + i, height.v);
+		}
+		if (normals)
+		{
+			Float4 normalX, normalY, normalZ;
+			Normal(gradientX, gradientZ, normalX, normalY, normalZ);
+			if (results.normalX) _mm_storeu_ps(results.normalX + i, normalX.v);
+			if (results.normalY) _mm_storeu_ps(results.normalY + i, normalY.v);
+			if (results.normalZ) _mm_storeu_ps(results.normalZ + i, normalZ.v);
+		}
+		if (results.slopes)
+		{
+			// There is no SSE2 arc tangent, only the gradient length is vectorised
+			float lengths[4];
+			_mm_storeu_ps(lengths, Sqrt(gradientX * gradientX + gradientZ * gradientZ).v);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				results.slopes[i + lane] = atanf(lengths[lane]) * kDegrees;
+			}
+		}
+	}
+#endif
+
+	// remaining queries
+	for (; i < count; i++)
+	{
+		float gradientX, gradientZ;
+		float height = Sample(x[i], z[i], gradientX, gradientZ);
+		if (results.heights)
+		{
+			results.heights[i] = height;
+		}
+		if (normals)
+		{
+			float normalX, normalY, normalZ;
+			Normal(gradientX, gradientZ, normalX, normalY, normalZ);
+			if (results.normalX) results.normalX[i] = normalX;
+			if (results.normalY) results.normalY[i] = normalY;
+			if (results.normalZ) results.normalZ[i] = normalZ;
+		}
+		if (results.slopes)
+		{
+			results.slopes[i] = atanf(sqrtf(gradientX * gradientX + gradientZ * gradientZ)) * kDegrees;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include "HeightMap.h"
+
+using namespace DirectX;
+
+enum HeightInterpolation
+{
+	kBilinear = 0, // interpolate the 4 surrounding points, the surface of the terrain mesh triangles (almost)
+	kBicubic = 1 // Catmull-Rom spline through the 16 surrounding points, smooth heights and normals
+};
+
+// Results of a batch of surface queries, one array per component (SoA). Any of them can be null
+struct SurfaceQueryResults
+{
+	SurfaceQueryResults()
+	{
+		heights = nullptr;
+		normalX = nullptr;
+		normalY = nullptr;
+		normalZ = nullptr;
+		slopes = nullptr;
+	}
+
+	float* heights;
+	float* normalX;
+	float* normalY;
+	float* normalZ;
+	float* slopes; // in degrees, 0 is flat
+};
+
+// Height, normal and slope of a grid of heights at any world position, one at a time or in batches.
+// Point (m, n) of the grid is at x = n * spacing, z = m * spacing, the same as the terrain vertices,
+// and positions outside the grid are clamped to its border.
+// The batches work on arrays of x and z (SoA) and process 4 queries at a time with SSE2 when it is available,
+// giving the same results as the single queries. The grid is not copied, it has to outlive the queries
+class HeightQuery
+{
+public:
+	HeightQuery();
+
+	// Query the heights of a height map
+	void SetHeightMap(const HeightMap& map, float spacing) { SetGrid(map.GetData(), map.GetResolution(), spacing); }
+	// Query any grid of resolution * resolution values (a height map, a density mask...)
+	void SetGrid(const float* values, int resolution, float spacing);
+	void SetInterpolation(HeightInterpolation mode) { interpolation = mode; }
+	HeightInterpolation GetInterpolation()const { return interpolation; }
+	// True if there is a grid of at least 2 * 2 values to query
+	bool IsValid()const { return values != nullptr && resolution >= 2; }
+
+	// Height at (x, z). If 'gradient' is not null it receives the change in height per world unit along x and z
+	float GetHeight(float x, float z, XMFLOAT2* gradient = nullptr)const;
+	// Unit normal of the surface at (x, z)
+	XMFLOAT3 GetNormal(float x, float z)const;
+	// Angle between the surface at (x, z) and the horizontal, in degrees
+	float GetSlope(float x, float z)const;
+
+	// Heights at 'count' positions
+	void GetHeights(const float* x, const float* z, size_t count, float* heights)const;
+	// Heights, normals and slopes at 'count' positions, only the arrays set in 'results' are written
+	void GetSurface(const float* x, const float* z, size_t count, const SurfaceQueryResults& results)const;
+
+private:
+	// Height at (x, z) and its change per world unit along x and z
+	float Sample(float x, float z, float& gradientX, float& gradientZ)const;
+
+	const float* values;
+	int resolution;
+	float spacing;
+	float invSpacing;
+	HeightInterpolation interpolation;
+};
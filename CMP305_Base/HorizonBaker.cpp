@@ -0,0 +1,235 @@
+#include "HorizonBaker.h"
+#include "PngWriter.h"
+#include "RowBandPool.h"
+
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+	const size_t kThreadedTexels = 128 * 128; // smaller maps are swept on one thread
+
+	// A point already passed by a sweep line, on the upper convex hull of the line so far
+	struct HullPoint
+	{
+		double distance;	// along the line
+		float height;
+	};
+
+	unsigned char ToByte(float value)
+	{
+		return (unsigned char)((value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value)) * 255.0f + 0.5f);
+	}
+
+	bool SaveMap(const char* filename, const std::vector<float>& values, int resolution)
+	{
+		if (values.empty())
+		{
+			return false;
+		}
+		std::vector<unsigned char> bytes(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			bytes[i] = ToByte(values[i]);
+		}
+		return PngWriter::Write(filename, bytes.data(), resolution, resolution, 1);
+	}
+}
+
+HorizonBaker::HorizonBaker()
+{
+	threadCount = 0;
+	heights = nullptr;
+	resolution = 0;
+	spacing = 1.0f;
+}
+
+void HorizonBaker::Release()
+{
+	std::vector<float>().swap(ambientOcclusion);
+	std::vector<float>().swap(sunShadow);
+}
+
+template <class Visit>
+void HorizonBaker::Sweep(float directionX, float directionZ, const Visit& visit)
+{
+	// Every step of a line moves one point along the major axis and 'slope' points along the minor one
+	const bool alongX = fabsf(directionX) >= fabsf(directionZ);
+	const float major = alongX ? directionX : directionZ;
+	const double slope = (alongX ? directionZ : directionX) / fabs(major);
+	const bool forward = major > 0.0f;
+	const int last = resolution - 1;
+	const double stepLength = spacing * sqrt(1.0 + slope * slope);
+
+	// Line 'o' is at minor = o + step * slope, and every point is the nearest point of exactly one line
+	const double drift = slope * last;
+	const int firstLine = (int)floor(drift < 0.0 ? 0.0 : -drift) - 1;
+	const int lastLine = last + (int)ceil(drift < 0.0 ? -drift : 0.0) + 1;
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	if (threads < 1 || (size_t)resolution * resolution < kThreadedTexels)
+	{
+		threads = 1;
+	}
+
+	ForEachRowBand(lastLine - firstLine + 1, threads, [&](int firstBand, int lastBand)
+	{
+		std::vector<HullPoint> hull;
+		hull.reserve(resolution);
+		for (int line = firstLine + firstBand; line < firstLine + lastBand; line++)
+		{
+			hull.clear();
+
+			// Steps of the line over the grid (minor in [-0.5, last + 0.5)), one step wider for the rounding
+			int firstStep = 0;
+			int lastStep = last;
+			if (slope != 0.0)
+			{
+				double enter = (-0.5 - line) / slope;
+				double leave = (last + 0.5 - line) / slope;
+				if (enter > leave)
+				{
+					double swap = enter;
+					enter = leave;
+					leave = swap;
+				}
+				firstStep = enter > 1.0 ? (int)enter - 1 : 0;
+				lastStep = leave < last - 1 ? (int)leave + 1 : last;
+			}
+
+			for (int step = firstStep; step <= lastStep; step++)
+			{
+				// Nearest point, the minor position is above -2 here so truncating it after a bias rounds it
+				int minorIndex = (int)(line + step * slope + 2.5) - 2;
+				if (minorIndex < 0 || minorIndex > last)
+				{
+					// the line is not over the grid yet, or not anymore
+					continue;
+				}
+				int majorIndex = forward ? step : last - step;
+				int index = alongX ? minorIndex * resolution + majorIndex : majorIndex * resolution + minorIndex;
+				const double distance = step * stepLength;
+				const float height = heights[index];
+
+				// Pop the hull points below the line from this point to the one before them, they can never be
+				// the horizon of this point or the ones after it
+				while (hull.size() >= 2)
+				{
+					const HullPoint& a = hull[hull.size() - 2];
+					const HullPoint& b = hull.back();
+					// tangent to a >= tangent to b, multiplied by the (positive) distances
+					if ((double)(a.height - height) * (distance - b.distance) >= (double)(b.height - height) * (distance - a.distance))
+					{
+						hull.pop_back();
+					}
+					else
+					{
+						break;
+					}
+				}
+
+				float tangent = -FLT_MAX;
+				if (!hull.empty())
+				{
+					tangent = (float)((hull.back().height - height) / (distance - hull.back().distance));
+				}
+				visit(index, tangent);
+
+				HullPoint point = { distance, height };
+				hull.push_back(point);
+			}
+		}
+	});
+}
+
+bool HorizonBaker::Bake(const HeightMap& map, float pointSpacing, const HorizonBakeSettings& settings)
+{
+	if (map.IsEmpty() || map.GetResolution() < 2 || pointSpacing <= 0.0f)
+	{
+		return false;
+	}
+
+	heights = map.GetData();
+	resolution = map.GetResolution();
+	spacing = pointSpacing;
+	const size_t count = (size_t)resolution * resolution;
+
+	// Ambient occlusion: add up the sine of the horizon angle of every direction, the directions looking down are open
+	ambientOcclusion.assign(count, 0.0f);
+	const int directions = settings.directions > 0 ? settings.directions : 1;
+	for (int k = 0; k < directions; k++)
+	{
+		float angle = XM_2PI * (float)k / (float)directions;
+		Sweep(cosf(angle), sinf(angle), [this](int index, float tangent)
+		{
+			if (tangent > 0.0f)
+			{
+				ambientOcclusion[index] += tangent / sqrtf(1.0f + tangent * tangent);
+			}
+		});
+	}
+	const float invDirections = 1.0f / (float)directions;
+	for (float& occlusion : ambientOcclusion)
+	{
+		occlusion = 1.0f - occlusion * invDirections;
+	}
+
+	// Sun shadow: sweeping along the sunlight leaves the points towards the sun behind every point
+	const XMFLOAT3& sun = settings.sunDirection;
+	const float horizontal = sqrtf(sun.x * sun.x + sun.z * sun.z);
+	if (sun.y > 0.0f)
+	{
+		// the sun is below the horizon
+		sunShadow.assign(count, 0.0f);
+	}
+	else if (horizontal < 1e-6f)
+	{
+		// the sun is straight above, nothing casts a shadow
+		sunShadow.assign(count, 1.0f);
+	}
+	else
+	{
+		sunShadow.assign(count, 1.0f);
+		const float sunAngle = atan2f(-sun.y, horizontal);
+		const float penumbra = XMConvertToRadians(settings.penumbra);
+		Sweep(sun.x / horizontal, sun.z / horizontal, [this, sunAngle, penumbra](int index, float tangent)
+		{
+			float horizon = tangent == -FLT_MAX ? -XM_PIDIV2 : atanf(tangent);
+			float lit;
+			if (penumbra > 0.0f)
+			{
+				lit = 0.5f + (sunAngle - horizon) / penumbra;
+				lit = lit < 0.0f ? 0.0f : (lit > 1.0f ? 1.0f : lit);
+			}
+			else
+			{
+				lit = sunAngle > horizon ? 1.0f : 0.0f;
+			}
+			sunShadow[index] = lit;
+		});
+	}
+
+	heights = nullptr;
+	return true;
+}
+
+void HorizonBaker::PackTexture(std::vector<unsigned char>& texels)const
+{
+	texels.resize(ambientOcclusion.size() * 2);
+	for (size_t i = 0; i < ambientOcclusion.size(); i++)
+	{
+		texels[i * 2] = ToByte(ambientOcclusion[i]);
+		texels[i * 2 + 1] = ToByte(sunShadow[i]);
+	}
+}
+
+bool HorizonBaker::SaveAmbientOcclusion(const char* filename)const
+{
+	return SaveMap(filename, ambientOcclusion, resolution);
+}
+
+bool HorizonBaker::SaveSunShadow(const char* filename)const
+{
+	return SaveMap(filename, sunShadow, resolution);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "HeightMap.h"
+
+using namespace DirectX;
+
+// What HorizonBaker bakes
+struct HorizonBakeSettings
+{
+	HorizonBakeSettings()
+	{
+		directions = 16;
+		sunDirection = XMFLOAT3(1.0f, -1.0f, 0.0f);
+		penumbra = 2.0f;
+	}
+
+	int directions;			// horizon directions around every point for the ambient occlusion
+	XMFLOAT3 sunDirection;	// direction the sunlight travels, as Light::getDirection (it does not need to be normalised)
+	float penumbra;			// angle in degrees over which the shadow fades around the horizon, 0 for hard shadows
+};
+
+// Bakes the ambient occlusion and the sun shadow of a height map on the CPU, one value per point, so the terrain
+// can be lit with them at no cost per frame (as a vertex channel, or as a texture with PackTexture).
+// Both come from the horizon of every point: the highest elevation angle of the terrain seen in a direction.
+// The grid is swept along parallel lines in every direction, keeping the upper convex hull of the points already
+// passed on a stack, so the horizon of a point is found by popping the hull points it hides and the sweep is O(n)
+// per line. The lines of a direction are split between the threads of the shared RowBandPool.
+// The ambient occlusion is 1 - the mean sine of the horizon angle over the directions (an open sky is 1), and a point
+// is in the sun when the sun is higher than its horizon in the sun direction
+class HorizonBaker
+{
+public:
+	HorizonBaker();
+
+	// Threads used to sweep the lines, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+
+	// Bake the maps of the height map, whose points are 'spacing' apart. Returns false if the map is empty
+	bool Bake(const HeightMap& map, float spacing, const HorizonBakeSettings& settings);
+
+	// True if the maps have been baked for a height map of this resolution
+	bool IsBaked(int mapResolution)const { return resolution == mapResolution && !ambientOcclusion.empty(); }
+	int GetResolution()const { return resolution; }
+	// One value per height map point, in the same order, from 0 (fully occluded) to 1 (open sky)
+	const std::vector<float>& GetAmbientOcclusion()const { return ambientOcclusion; }
+	// One value per height map point, from 0 (in shadow) to 1 (in the sun)
+	const std::vector<float>& GetSunShadow()const { return sunShadow; }
+
+	// Replace 'texels' with the two maps as the rows of an R8G8_UNORM texture of resolution * resolution texels:
+	// ambient occlusion in red and sun shadow in green. Texel (0.5 + n) / resolution covers point (m, n)
+	void PackTexture(std::vector<unsigned char>& texels)const;
+	// Save a map as a greyscale PNG
+	bool SaveAmbientOcclusion(const char* filename)const;
+	bool SaveSunShadow(const char* filename)const;
+
+	// Release the maps
+	void Release();
+
+private:
+	// Sweep the grid along the direction (directionX, directionZ) and call
+	// visit(pointIndex, horizonTangent) for every point with the tangent of its horizon angle looking back along the
+	// direction (-infinity when there is nothing behind it)
+	template <class Visit>
+	void Sweep(float directionX, float directionZ, const Visit& visit);
+
+	int threadCount;
+
+	// Height map being baked
+	const float* heights;
+	int resolution;
+	float spacing;
+
+	std::vector<float> ambientOcclusion;
+	std::vector<float> sunShadow;
+};
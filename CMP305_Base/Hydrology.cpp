@@ -0,0 +1,492 @@
+#include "Hydrology.h"
+#include "PngWriter.h"
+#include "RowBandPool.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const size_t kThreadedTexels = 128 * 128; // smaller maps are processed on one thread
+	const float kQuarterPi = 0.785398163f;
+	const float kInvSqrt2 = 0.707106781f;
+
+	inline int BitLength(uint32_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanReverse(&index, value) ? (int)index + 1 : 0;
+#else
+		return value ? 32 - __builtin_clz(value) : 0;
+#endif
+	}
+
+	// Priority queue of the flood, the lowest point first. The heights pushed are never below the last one popped,
+	// so it is a radix heap (Ahuja et al. 1990): the points are kept in buckets by the highest bit in which their key
+	// differs from the last key popped, and a bucket is only split again when the ones below it are empty
+	class FloodQueue
+	{
+	public:
+		struct Point
+		{
+			uint32_t key;
+			int index;
+		};
+
+		FloodQueue() : last(0), size(0) {}
+
+		bool IsEmpty()const { return size == 0; }
+
+		void Push(float height, int index)
+		{
+			uint32_t key = ToKey(height);
+			// rounding can not make the flood level go down, but a lower key would break the buckets
+			key = key < last ? last : key;
+			Point point = { key, index };
+			buckets[BitLength(key ^ last)].push_back(point);
+			size++;
+		}
+
+		// The lowest point, it stays in the queue
+		const Point& Top()
+		{
+			if (buckets[0].empty())
+			{
+				Refill();
+			}
+			return buckets[0].back();
+		}
+
+		void Pop()
+		{
+			Top();
+			buckets[0].pop_back();
+			size--;
+		}
+
+		// Key with the same order as the height: the sign bit flipped for the positive heights, all the bits for the negative ones
+		static uint32_t ToKey(float height)
+		{
+			uint32_t bits;
+			memcpy(&bits, &height, sizeof(bits));
+			return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+		}
+
+	private:
+		// Move the lowest point of the first non-empty bucket to 'last' and spread that bucket over the lower ones
+		void Refill()
+		{
+			int bucket = 1;
+			while (buckets[bucket].empty())
+			{
+				bucket++;
+			}
+			std::vector<Point>& points = buckets[bucket];
+			uint32_t lowest = points[0].key;
+			for (const Point& point : points)
+			{
+				lowest = point.key < lowest ? point.key : lowest;
+			}
+			last = lowest;
+			for (const Point& point : points)
+			{
+				buckets[BitLength(point.key ^ last)].push_back(point);
+			}
+			points.clear();
+		}
+
+		std::vector<Point> buckets[33];
+		uint32_t last;
+		size_t size;
+	};
+}
+
+const int Hydrology::kNeighbourN[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+const int Hydrology::kNeighbourM[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+const float Hydrology::kInvDistance[8] = { 1.0f, kInvSqrt2, 1.0f, kInvSqrt2, 1.0f, kInvSqrt2, 1.0f, kInvSqrt2 };
+
+Hydrology::Hydrology()
+{
+	threadCount = 0;
+	resolution = 0;
+	routing = FlowRouting::D8;
+}
+
+void Hydrology::Release()
+{
+	std::vector<float>().swap(filled);
+	std::vector<unsigned char>().swap(directions);
+	std::vector<float>().swap(fractions);
+	std::vector<float>().swap(accumulation);
+}
+
+bool Hydrology::Analyse(const HeightMap& map, const HydrologySettings& settings)
+{
+	if (map.IsEmpty() || map.GetResolution() < 2)
+	{
+		return false;
+	}
+
+	resolution = map.GetResolution();
+	routing = settings.routing;
+	const size_t count = (size_t)resolution * resolution;
+	filled.assign(map.GetData(), map.GetData() + count);
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	if (threads < 1 || count < kThreadedTexels)
+	{
+		threads = 1;
+	}
+
+	FillDepressions(settings.epsilon);
+
+	directions.resize(count);
+	if (routing == FlowRouting::D8)
+	{
+		std::vector<float>().swap(fractions);
+	}
+	else
+	{
+		fractions.resize(count);
+	}
+	ForEachRowBand(resolution, threads, [this](int firstRow, int lastRow)
+	{
+		RouteRows(firstRow, lastRow);
+	});
+
+	Accumulate(threads);
+	return true;
+}
+
+void Hydrology::FillDepressions(float epsilon)
+{
+	// The flood runs on a copy of the heights with a frame of closed points around it, so the neighbours of every
+	// point can be read without checking the bounds
+	const int stride = resolution + 2;
+	const size_t framedCount = (size_t)stride * stride;
+	std::vector<float> framed(framedCount, 0.0f);
+	std::vector<unsigned char> closed(framedCount, 1);
+	for (int m = 0; m < resolution; m++)
+	{
+		memcpy(&framed[(size_t)(m + 1) * stride + 1], &filled[(size_t)m * resolution], resolution * sizeof(float));
+		memset(&closed[(size_t)(m + 1) * stride + 1], 0, resolution);
+	}
+	int offsets[8];
+	for (int k = 0; k < 8; k++)
+	{
+		offsets[k] = kNeighbourM[k] * stride + kNeighbourN[k];
+	}
+
+	// The border drains out of the map, the flood starts from it
+	FloodQueue open;
+	const int last = resolution - 1;
+	for (int m = 0; m < resolution; m++)
+	{
+		for (int n = 0; n < resolution; n += (m == 0 || m == last) ? 1 : last)
+		{
+			int index = (m + 1) * stride + n + 1;
+			open.Push(framed[index], index);
+			closed[index] = 1;
+		}
+	}
+
+	// Points raised to the flood level, in the order they were reached. They are never lower than the point that
+	// reached them, so they do not need the priority queue
+	std::vector<int> pit;
+	size_t pitHead = 0;
+
+	while (!open.IsEmpty() || pitHead < pit.size())
+	{
+		int index;
+		if (pitHead < pit.size() && !(!open.IsEmpty() && open.Top().key == FloodQueue::ToKey(framed[pit[pitHead]])))
+		{
+			index = pit[pitHead++];
+			if (pitHead == pit.size())
+			{
+				pit.clear();
+				pitHead = 0;
+			}
+		}
+		else
+		{
+			// the queue goes first on a tie, so a flat already at the flood level is not raised by epsilon
+			index = open.Top().index;
+			open.Pop();
+		}
+
+		const float height = framed[index];
+		float raised = height;
+		if (epsilon > 0.0f)
+		{
+			raised = height + epsilon;
+			raised = raised > height ? raised : nextafterf(height, FLT_MAX);
+		}
+
+		for (int k = 0; k < 8; k++)
+		{
+			const int neighbour = index + offsets[k];
+			if (closed[neighbour])
+			{
+				continue;
+			}
+			closed[neighbour] = 1;
+
+			if (framed[neighbour] <= height)
+			{
+				// in a depression: raise it so it drains to this point
+				framed[neighbour] = raised;
+				pit.push_back(neighbour);
+			}
+			else
+			{
+				open.Push(framed[neighbour], neighbour);
+			}
+		}
+	}
+
+	for (int m = 0; m < resolution; m++)
+	{
+		memcpy(&filled[(size_t)m * resolution], &framed[(size_t)(m + 1) * stride + 1], resolution * sizeof(float));
+	}
+}
+
+void Hydrology::RouteRows(int firstRow, int lastRow)
+{
+	const int last = resolution - 1;
+	for (int m = firstRow; m < lastRow; m++)
+	{
+		for (int n = 0; n < resolution; n++)
+		{
+			const int index = m * resolution + n;
+			const float height = filled[index];
+			const bool inside = m > 0 && m < last && n > 0 && n < last;
+
+			if (routing == FlowRouting::D8)
+			{
+				// The neighbour of steepest descent
+				float steepest = 0.0f;
+				unsigned char direction = kNoFlow;
+				for (int k = 0; k < 8; k++)
+				{
+					if (!inside && !InBounds(m + kNeighbourM[k], n + kNeighbourN[k]))
+					{
+						continue;
+					}
+					float slope = (height - filled[index + kNeighbourM[k] * resolution + kNeighbourN[k]]) * kInvDistance[k];
+					if (slope > steepest)
+					{
+						steepest = slope;
+						direction = (unsigned char)k;
+					}
+				}
+				directions[index] = direction;
+				continue;
+			}
+
+			// D-infinity: the steepest of the facets between a cardinal and a diagonal neighbour. The flow angle from the
+			// cardinal neighbour is atan(s2 / s1), clamped to the facet, with s1 the slope towards the cardinal neighbour
+			// and s2 the slope from it to the diagonal one. The slopes are compared squared, and the atan is only taken
+			// for the facet kept
+			float steepest = 0.0f;
+			int steepestFacet = -1;
+			float facetAngle = 0.0f;
+			float steepestS1 = 0.0f, steepestS2 = 0.0f;
+			for (int facet = 0; facet < 8; facet++)
+			{
+				const int cardinal = (facet & 1) ? (facet + 1) & 7 : facet;
+				const int diagonal = (facet & 1) ? facet : facet + 1;
+				if (!inside && (!InBounds(m + kNeighbourM[cardinal], n + kNeighbourN[cardinal])
+					|| !InBounds(m + kNeighbourM[diagonal], n + kNeighbourN[diagonal])))
+				{
+					continue;
+				}
+				const float cardinalHeight = filled[index + kNeighbourM[cardinal] * resolution + kNeighbourN[cardinal]];
+				const float diagonalHeight = filled[index + kNeighbourM[diagonal] * resolution + kNeighbourN[diagonal]];
+				const float s1 = height - cardinalHeight;
+				const float s2 = cardinalHeight - diagonalHeight;
+
+				float slope, angle;
+				if (s2 < 0.0f)
+				{
+					// towards the cardinal neighbour
+					slope = s1 > 0.0f ? s1 * s1 : 0.0f;
+					angle = 0.0f;
+				}
+				else if (s2 > s1)
+				{
+					// towards the diagonal neighbour
+					float drop = height - diagonalHeight;
+					slope = drop > 0.0f ? drop * drop * 0.5f : 0.0f;
+					angle = kQuarterPi;
+				}
+				else
+				{
+					slope = s1 * s1 + s2 * s2;
+					angle = -1.0f;
+				}
+				if (slope > steepest)
+				{
+					steepest = slope;
+					steepestFacet = facet;
+					facetAngle = angle;
+					steepestS1 = s1;
+					steepestS2 = s2;
+				}
+			}
+
+			if (steepestFacet < 0)
+			{
+				directions[index] = kNoFlow;
+				fractions[index] = 0.0f;
+				continue;
+			}
+			// The flow is split between the two neighbours of the facet in proportion to the angle: the even facets go
+			// from the cardinal neighbour (facet) to the diagonal one (facet + 1), the odd ones from the diagonal
+			// neighbour (facet) to the cardinal one (facet + 1)
+			facetAngle = facetAngle < 0.0f ? atan2f(steepestS2, steepestS1) : facetAngle;
+			float fraction = facetAngle / kQuarterPi;
+			fraction = (steepestFacet & 1) ? 1.0f - fraction : fraction;
+			int direction = steepestFacet;
+			if (fraction >= 1.0f)
+			{
+				direction = (direction + 1) & 7;
+				fraction = 0.0f;
+			}
+			directions[index] = (unsigned char)direction;
+			fractions[index] = fraction > 0.0f ? fraction : 0.0f;
+		}
+	}
+}
+
+int Hydrology::GetReceivers(int index, int receivers[2], float shares[2])const
+{
+	const int direction = directions[index];
+	if (direction == kNoFlow)
+	{
+		return 0;
+	}
+	receivers[0] = index + kNeighbourM[direction] * resolution + kNeighbourN[direction];
+	if (routing == FlowRouting::D8 || fractions[index] == 0.0f)
+	{
+		shares[0] = 1.0f;
+		return 1;
+	}
+	const int next = (direction + 1) & 7;
+	receivers[1] = index + kNeighbourM[next] * resolution + kNeighbourN[next];
+	shares[0] = 1.0f - fractions[index];
+	shares[1] = fractions[index];
+	return 2;
+}
+
+float Hydrology::GetFlowAngle(int index)const
+{
+	if (directions.empty() || directions[index] == kNoFlow)
+	{
+		return -1.0f;
+	}
+	float fraction = fractions.empty() ? 0.0f : fractions[index];
+	return (directions[index] + fraction) * kQuarterPi;
+}
+
+void Hydrology::Accumulate(int threads)
+{
+	const int last = resolution - 1;
+	const size_t count = (size_t)resolution * resolution;
+
+	// Number of neighbours flowing into every point, each point only reads its neighbours
+	std::vector<unsigned char> inflows(count);
+	ForEachRowBand(resolution, threads, [&](int firstRow, int lastRow)
+	{
+		for (int m = firstRow; m < lastRow; m++)
+		{
+			for (int n = 0; n < resolution; n++)
+			{
+				const int index = m * resolution + n;
+				const bool inside = m > 0 && m < last && n > 0 && n < last;
+				unsigned char flowing = 0;
+				for (int k = 0; k < 8; k++)
+				{
+					if (!inside && !InBounds(m + kNeighbourM[k], n + kNeighbourN[k]))
+					{
+						continue;
+					}
+					const int neighbour = index + kNeighbourM[k] * resolution + kNeighbourN[k];
+					// the neighbour points back at this point, or (D-infinity) the direction before it does with a share
+					// for its next direction
+					const int back = (k + 4) & 7;
+					const unsigned char direction = directions[neighbour];
+					if (direction == back)
+					{
+						flowing++;
+					}
+					else if (routing == FlowRouting::DInfinity && direction == ((back + 7) & 7) && fractions[neighbour] > 0.0f)
+					{
+						flowing++;
+					}
+				}
+				inflows[index] = flowing;
+			}
+		}
+	});
+
+	// Topological order (Kahn's algorithm): a point is passed on once every point flowing into it has been, so its
+	// accumulation is complete when it is added to its receivers. The sources are taken in row order and the flow is
+	// followed downstream from each one while it completes points, which keeps the walk near the last points touched
+	const unsigned char kPassed = 0xFF;
+	accumulation.assign(count, 1.0f);
+	std::vector<int> ready;
+	for (size_t source = 0; source < count; source++)
+	{
+		if (inflows[source] != 0)
+		{
+			continue;
+		}
+		ready.push_back((int)source);
+		while (!ready.empty())
+		{
+			const int index = ready.back();
+			ready.pop_back();
+			inflows[index] = kPassed;
+
+			int receivers[2];
+			float shares[2];
+			int receiverCount = GetReceivers(index, receivers, shares);
+			for (int i = 0; i < receiverCount; i++)
+			{
+				accumulation[receivers[i]] += accumulation[index] * shares[i];
+				if (--inflows[receivers[i]] == 0)
+				{
+					ready.push_back(receivers[i]);
+				}
+			}
+		}
+	}
+}
+
+bool Hydrology::SaveFlowAccumulation(const char* filename)const
+{
+	if (accumulation.empty())
+	{
+		return false;
+	}
+
+	float largest = 1.0f;
+	for (float value : accumulation)
+	{
+		largest = value > largest ? value : largest;
+	}
+	const float invLogLargest = largest > 1.0f ? 1.0f / logf(largest) : 0.0f;
+	std::vector<unsigned char> bytes(accumulation.size());
+	for (size_t i = 0; i < accumulation.size(); i++)
+	{
+		float value = logf(accumulation[i] > 1.0f ? accumulation[i] : 1.0f) * invLogLargest;
+		bytes[i] = (unsigned char)((value > 1.0f ? 1.0f : value) * 255.0f + 0.5f);
+	}
+	return PngWriter::Write(filename, bytes.data(), resolution, resolution, 1);
+}
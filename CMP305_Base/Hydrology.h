@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include "HeightMap.h"
+
+// How the flow leaves every point
+enum class FlowRouting
+{
+	D8,			// all the flow goes to the neighbour of steepest descent
+	DInfinity	// the flow goes along the steepest of the 8 triangular facets and is split between its two neighbours (Tarboton)
+};
+
+// What Hydrology analyses
+struct HydrologySettings
+{
+	HydrologySettings()
+	{
+		epsilon = 1e-4f;
+		routing = FlowRouting::D8;
+	}
+
+	// Height added from one point to the next across a filled depression, so every point drains to the border.
+	// 0 fills the depressions flat (the flow stops at the flats), the smallest float step is used if it is too small
+	float epsilon;
+	FlowRouting routing;
+};
+
+// Hydrology layers of a height map, one value per point in the same order as the heights:
+// - the heights with the depressions filled (Priority-Flood, Barnes et al. 2014): the points are flooded from the
+//   border inwards in height order with a priority queue, and the points found below the flood level are raised to it
+//   and go through a plain queue instead, O(n log n) overall and O(n) inside the depressions. The flood level never
+//   goes down, so the priority queue is a radix heap on the bits of the heights instead of a binary heap
+//   The filled height minus the original height is the depth of the lake at every point
+// - the flow direction of every point on the filled heights, D8 or D-infinity (as the first neighbour and the fraction
+//   of the flow going to the next one)
+// - the flow accumulation: the points draining through every point, itself included, added up in a topological
+//   order of the flow graph (every point after all the points flowing into it)
+// The flood is sequential, the flow directions and the number of points flowing into every point are computed on the
+// threads of the shared RowBandPool, split by rows
+class Hydrology
+{
+public:
+	Hydrology();
+
+	// D8 code of a point without a lower neighbour (an outlet on the border, or a flat)
+	static const unsigned char kNoFlow = 255;
+	// Column and row steps to the neighbour of code k, and 1 / the distance to it in points
+	static const int kNeighbourN[8];
+	static const int kNeighbourM[8];
+	static const float kInvDistance[8];
+
+	// Threads used by the row passes, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+
+	// Analyse the height map. The points are on a square grid, so the layers do not depend on the spacing.
+	// Returns false if the map is empty
+	bool Analyse(const HeightMap& map, const HydrologySettings& settings);
+
+	// True if the layers have been analysed for a height map of this resolution
+	bool IsAnalysed(int mapResolution)const { return resolution == mapResolution && !filled.empty(); }
+	int GetResolution()const { return resolution; }
+	FlowRouting GetRouting()const { return routing; }
+
+	// Heights with the depressions filled
+	const std::vector<float>& GetFilledHeights()const { return filled; }
+	// Code k of the neighbour every point flows to, at k * 45 degrees from +x towards +z
+	// (0 is column + 1, 2 is row + 1, 4 is column - 1, 6 is row - 1), or kNoFlow
+	const std::vector<unsigned char>& GetFlowDirections()const { return directions; }
+	// D-infinity routing: fraction of the flow of every point going to the next neighbour, (k + 1) % 8, the rest goes to k.
+	// Empty with D8
+	const std::vector<float>& GetFlowFractions()const { return fractions; }
+	// Angle in radians of the flow of a point from +x towards +z, in [0, 2 pi), or -1 without flow
+	float GetFlowAngle(int index)const;
+	// Points draining through every point, itself included. Multiply by spacing^2 for the area
+	const std::vector<float>& GetFlowAccumulation()const { return accumulation; }
+
+	// Save the flow accumulation as a greyscale PNG, on a log scale from 1 to the largest accumulation
+	bool SaveFlowAccumulation(const char* filename)const;
+
+	// Release the layers
+	void Release();
+
+private:
+	bool InBounds(int m, int n)const { return m >= 0 && m < resolution && n >= 0 && n < resolution; }
+	// Priority-Flood of 'filled', which starts as a copy of the heights
+	void FillDepressions(float epsilon);
+	// Flow directions of the rows [firstRow, lastRow)
+	void RouteRows(int firstRow, int lastRow);
+	// Neighbours the point flows to and the fraction of the flow each one gets, returns how many there are (0 to 2)
+	int GetReceivers(int index, int receivers[2], float shares[2])const;
+	// Topological order of the flow graph and the flow accumulation along it
+	void Accumulate(int threads);
+
+	int threadCount;
+
+	int resolution;
+	FlowRouting routing;
+
+	std::vector<float> filled;
+	std::vector<unsigned char> directions;
+	std::vector<float> fractions;
+	std::vector<float> accumulation;
+};
@@ -1,6 +1,6 @@
 #include "LightShader.h"
 
-LightShader::LightShader(ID3D11Device* device, HWND hwnd) : BaseShader(device, hwnd)
+LightShader::LightShader(RenderDevice* device, HWND hwnd) : BaseShader(device, hwnd)
 {
 	initShader(L"light_vs.cso", L"light_ps.cso");
 }
@@ -11,28 +11,28 @@ LightShader::~LightShader()
 	// Release the sampler state.
 	if (sampleState)
 	{
-		sampleState->Release();
+		renderer->releaseSampler(sampleState);
 		sampleState = 0;
 	}
 
 	// Release the matrix constant buffer.
 	if (matrixBuffer)
 	{
-		matrixBuffer->Release();
+		renderer->releaseBuffer(matrixBuffer);
 		matrixBuffer = 0;
 	}
 
 	// Release the layout.
 	if (layout)
 	{
-		layout->Release();
+		renderer->releaseInputLayout(layout);
 		layout = 0;
 	}
 
 	// Release the light constant buffer.
 	if (lightBuffer)
 	{
-		lightBuffer->Release();
+		renderer->releaseBuffer(lightBuffer);
 		lightBuffer = 0;
 	}
 
@@ -57,7 +57,7 @@ void LightShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilenam
 	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	matrixBufferDesc.MiscFlags = 0;
 	matrixBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&matrixBufferDesc, NULL, &matrixBuffer);
+	matrixBuffer = renderer->createBuffer(matrixBufferDesc, NULL);
 
 	// Create a texture sampler state description.
 	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
@@ -69,7 +69,7 @@ void LightShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilenam
 	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
 	samplerDesc.MinLOD = 0;
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	renderer->CreateSamplerState(&samplerDesc, &sampleState);
+	sampleState = renderer->createSampler(samplerDesc);
 
 	// Setup light buffer
 	// Setup the description of the light dynamic constant buffer that is in the pixel shader.
@@ -80,15 +80,13 @@ void LightShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilenam
 	lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	lightBufferDesc.MiscFlags = 0;
 	lightBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&lightBufferDesc, NULL, &lightBuffer);
+	lightBuffer = renderer->createBuffer(lightBufferDesc, NULL);
 
 }
 
 
-void LightShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX &worldMatrix, const XMMATRIX &viewMatrix, const XMMATRIX &projectionMatrix, ID3D11ShaderResourceView* texture, Light* light)
+void LightShader::setShaderParameters(RenderDevice* device, const XMMATRIX &worldMatrix, const XMMATRIX &viewMatrix, const XMMATRIX &projectionMatrix, GpuTexture* texture, Light* light)
 {
-	HRESULT result;
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	MatrixBufferType* dataPtr;
 	
 	XMMATRIX tworld, tview, tproj;
@@ -98,26 +96,24 @@ void LightShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	tworld = XMMatrixTranspose(worldMatrix);
 	tview = XMMatrixTranspose(viewMatrix);
 	tproj = XMMatrixTranspose(projectionMatrix);
-	result = deviceContext->Map(matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	dataPtr = (MatrixBufferType*)mappedResource.pData;
+	dataPtr = (MatrixBufferType*)device->mapBuffer(matrixBuffer);
 	dataPtr->world = tworld;// worldMatrix;
 	dataPtr->view = tview;
 	dataPtr->projection = tproj;
-	deviceContext->Unmap(matrixBuffer, 0);
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
+	device->unmapBuffer(matrixBuffer);
+	device->setConstantBuffer(kVertexShader, 0, matrixBuffer);
 
 	//Additional
 	// Send light data to pixel shader
 	LightBufferType* lightPtr;
-	deviceContext->Map(lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	lightPtr = (LightBufferType*)mappedResource.pData;
+	lightPtr = (LightBufferType*)device->mapBuffer(lightBuffer);
 	lightPtr->diffuse = light->getDiffuseColour();
 	lightPtr->direction = light->getDirection();
 	lightPtr->padding = 0.0f;
-	deviceContext->Unmap(lightBuffer, 0);
-	deviceContext->PSSetConstantBuffers(0, 1, &lightBuffer);
+	device->unmapBuffer(lightBuffer);
+	device->setConstantBuffer(kPixelShader, 0, lightBuffer);
 
 	// Set shader texture resource in the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture);
-	deviceContext->PSSetSamplers(0, 1, &sampleState);
+	device->setTexture(kPixelShader, 0, texture);
+	device->setSampler(kPixelShader, 0, sampleState);
 }
@@ -16,17 +16,17 @@ private:
 	};
 
 public:
-	LightShader(ID3D11Device* device, HWND hwnd);
+	LightShader(RenderDevice* device, HWND hwnd);
 	~LightShader();
 
-	void setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX &world, const XMMATRIX &view, const XMMATRIX &projection, ID3D11ShaderResourceView* texture, Light* light);
+	void setShaderParameters(RenderDevice* device, const XMMATRIX &world, const XMMATRIX &view, const XMMATRIX &projection, GpuTexture* texture, Light* light);
 
 private:
 	void initShader(const wchar_t* cs, const wchar_t* ps);
 
 private:
-	ID3D11Buffer * matrixBuffer;
-	ID3D11SamplerState* sampleState;
-	ID3D11Buffer* lightBuffer;
+	GpuBuffer* matrixBuffer;
+	GpuSampler* sampleState;
+	GpuBuffer* lightBuffer;
 };
 
@@ -1,9 +1,58 @@
 // Main.cpp
 #include "System.h"
+#include "HeadlessSystem.h"
 #include "App1.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	const int kHeadlessFrames = 600;		// frames of a headless run
+	const int kHeadlessResolution = 257;	// terrain resolution of a headless run
+	const int kHeadlessModifyEvery = 10;	// frames between terrain modifications of a headless run
+
+	// CMP305_Base -headless [frames] [resolution] [report.json]
+	// Runs App1 on the null render device, modifying and regenerating the terrain regularly, and writes the frame report
+	int RunHeadless(int argc, char** argv)
+	{
+		int frames = argc > 2 ? atoi(argv[2]) : kHeadlessFrames;
+		int resolution = argc > 3 ? atoi(argv[3]) : kHeadlessResolution;
+		const char* report = argc > 4 ? argv[4] : "headless.json";
+		if (frames <= 0 || resolution < 2)
+		{
+			return 1;
+		}
+
+		App1* app = new App1();
+		HeadlessSystem* system = new HeadlessSystem(app, 1200, 675);
+		app->resizeTerrain(resolution);
+		system->run(frames, [app](int frame)
+		{
+			if (frame % kHeadlessModifyEvery == 0)
+			{
+				app->modifyTerrain(frame / kHeadlessModifyEvery);
+			}
+		});
+
+		// The objects left alive on the device once the application has released everything it created are leaks
+		system->releaseApplication();
+		char label[64];
+		snprintf(label, sizeof(label), "App1 %dx%d", resolution, resolution);
+		bool written = system->writeReport(report, label);
+
+		delete system;
+		system = 0;
+		return written ? 0 : 1;
+	}
+}
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline, int iCmdshow)
 {
+	if (__argc > 1 && strcmp(__argv[1], "-headless") == 0)
+	{
+		return RunHeadless(__argc, __argv);
+	}
+
 	App1* app = new App1();
 	System* system;
 
@@ -18,4 +67,4 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline,
 	system = 0;
 
 	return 0;
-}
\ No newline at end of file
+}
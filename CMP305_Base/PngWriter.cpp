@@ -0,0 +1,341 @@
+#include "PngWriter.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const int kWindow = 32768;		// farthest distance a deflate match can reach back
+	const int kMinMatch = 3;
+	const int kMaxMatch = 258;
+	const int kHashBits = 15;
+
+	// Base length and extra bits of the deflate length codes 257 to 285
+	const int kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	// Base distance and extra bits of the deflate distance codes 0 to 29
+	const int kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+		4097, 6145, 8193, 12289, 16385, 24577 };
+	const int kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Codes of the fixed Huffman tables, bit reversed so they can be written least significant bit first,
+	// and the length code of every match length
+	struct FixedCodes
+	{
+		FixedCodes()
+		{
+			for (int symbol = 0; symbol < 288; symbol++)
+			{
+				unsigned int code;
+				int length;
+				if (symbol < 144) { code = 0x30 + symbol; length = 8; }
+				else if (symbol < 256) { code = 0x190 + (symbol - 144); length = 9; }
+				else if (symbol < 280) { code = symbol - 256; length = 7; }
+				else { code = 0xC0 + (symbol - 280); length = 8; }
+				literalCodes[symbol] = Reverse(code, length);
+				literalLengths[symbol] = length;
+			}
+			for (int code = 0; code < 30; code++)
+			{
+				distanceCodes[code] = Reverse(code, 5);
+			}
+			for (int code = 0; code < 29; code++)
+			{
+				int last = code + 1 < 29 ? kLengthBase[code + 1] : kMaxMatch + 1;
+				for (int length = kLengthBase[code]; length < last; length++)
+				{
+					lengthCodes[length] = (unsigned char)code;
+				}
+			}
+		}
+
+		static unsigned int Reverse(unsigned int code, int length)
+		{
+			unsigned int reversed = 0;
+			for (int i = 0; i < length; i++)
+			{
+				reversed = (reversed << 1) | ((code >> i) & 1u);
+			}
+			return reversed;
+		}
+
+		unsigned int literalCodes[288];
+		int literalLengths[288];
+		unsigned int distanceCodes[30];
+		unsigned char lengthCodes[kMaxMatch + 1];
+	};
+
+	// Writes deflate bit fields, least significant bit first
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<unsigned char>& out) : output(out), buffer(0), count(0) {}
+
+		void Write(unsigned int value, int bits)
+		{
+			buffer |= (uint64_t)value << count;
+			count += bits;
+			while (count >= 8)
+			{
+				output.push_back((unsigned char)buffer);
+				buffer >>= 8;
+				count -= 8;
+			}
+		}
+
+		void Flush()
+		{
+			if (count > 0)
+			{
+				output.push_back((unsigned char)buffer);
+			}
+			buffer = 0;
+			count = 0;
+		}
+
+	private:
+		std::vector<unsigned char>& output;
+		uint64_t buffer;
+		int count;
+	};
+
+	unsigned int Hash(const unsigned char* p)
+	{
+		unsigned int value = (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16);
+		return (value * 2654435761u) >> (32 - kHashBits);
+	}
+
+	int DistanceCode(int distance)
+	{
+		int low = 0, high = 29;
+		while (low < high)
+		{
+			int middle = (low + high + 1) / 2;
+			if (kDistanceBase[middle] <= distance) low = middle;
+			else high = middle - 1;
+		}
+		return low;
+	}
+
+	// Compress 'data' into a zlib stream (one final fixed Huffman block)
+	void Deflate(const std::vector<unsigned char>& data, std::vector<unsigned char>& output)
+	{
+		static const FixedCodes codes;
+
+		// zlib header: deflate with a 32K window, no dictionary, fastest compression
+		output.push_back(0x78);
+		output.push_back(0x01);
+
+		BitWriter bits(output);
+		bits.Write(1, 1);	// final block
+		bits.Write(1, 2);	// fixed Huffman codes
+
+		std::vector<int> head((size_t)1 << kHashBits, -1);
+		const int size = (int)data.size();
+		const unsigned char* bytes = data.data();
+		int i = 0;
+		while (i < size)
+		{
+			int matchLength = 0;
+			int matchDistance = 0;
+			if (i + kMinMatch <= size)
+			{
+				unsigned int hash = Hash(bytes + i);
+				int candidate = head[hash];
+				head[hash] = i;
+				if (candidate >= 0 && i - candidate <= kWindow)
+				{
+					int maxLength = size - i < kMaxMatch ? size - i : kMaxMatch;
+					int length = 0;
+					while (length < maxLength && bytes[candidate + length] == bytes[i + length])
+					{
+						length++;
+					}
+					if (length >= kMinMatch)
+					{
+						matchLength = length;
+						matchDistance = i - candidate;
+					}
+				}
+			}
+
+			if (matchLength == 0)
+			{
+				bits.Write(codes.literalCodes[bytes[i]], codes.literalLengths[bytes[i]]);
+				i++;
+				continue;
+			}
+
+			int lengthCode = codes.lengthCodes[matchLength];
+			int symbol = 257 + lengthCode;
+			bits.Write(codes.literalCodes[symbol], codes.literalLengths[symbol]);
+			bits.Write(matchLength - kLengthBase[lengthCode], kLengthExtra[lengthCode]);
+			int distanceCode = DistanceCode(matchDistance);
+			bits.Write(codes.distanceCodes[distanceCode], 5);
+			bits.Write(matchDistance - kDistanceBase[distanceCode], kDistanceExtra[distanceCode]);
+
+			// Remember the positions inside the match too, so the next matches can start from them
+			for (int k = 1; k < matchLength && i + k + kMinMatch <= size; k++)
+			{
+				head[Hash(bytes + i + k)] = i + k;
+			}
+			i += matchLength;
+		}
+		bits.Write(codes.literalCodes[256], codes.literalLengths[256]);	// end of block
+		bits.Flush();
+
+		// Adler-32 of the uncompressed data, the sums are reduced before they can overflow
+		uint32_t a = 1, b = 0;
+		for (int start = 0; start < size; start += 5552)
+		{
+			int end = start + 5552 < size ? start + 5552 : size;
+			for (int k = start; k < end; k++)
+			{
+				a += bytes[k];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		uint32_t adler = (b << 16) | a;
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			output.push_back((unsigned char)(adler >> shift));
+		}
+	}
+
+	uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc)
+	{
+		struct Table
+		{
+			Table()
+			{
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++)
+					{
+						c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					values[n] = c;
+				}
+			}
+			uint32_t values[256];
+		};
+		static const Table table;
+
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table.values[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	void PutBigEndian(std::vector<unsigned char>& output, uint32_t value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			output.push_back((unsigned char)(value >> shift));
+		}
+	}
+
+	// Append a chunk: length, type, data and the CRC of the type and the data
+	void PutChunk(std::vector<unsigned char>& png, const char* type, const unsigned char* data, size_t size)
+	{
+		PutBigEndian(png, (uint32_t)size);
+		size_t start = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data, data + size);
+		uint32_t crc = Crc32(&png[start], png.size() - start, 0xFFFFFFFFu) ^ 0xFFFFFFFFu;
+		PutBigEndian(png, crc);
+	}
+
+	// Sum of the filtered bytes as signed values, the usual estimate of how well a row compresses
+	unsigned int FilterCost(const unsigned char* row, size_t size)
+	{
+		unsigned int cost = 0;
+		for (size_t i = 0; i < size; i++)
+		{
+			cost += (unsigned int)abs((int)(signed char)row[i]);
+		}
+		return cost;
+	}
+}
+
+bool PngWriter::Encode(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& png)
+{
+	png.clear();
+	if (!pixels || width <= 0 || height <= 0 || (channels != 1 && channels != 3))
+	{
+		return false;
+	}
+
+	// Filter the rows: a filter byte, then the row with the filter applied
+	const size_t stride = (size_t)width * channels;
+	std::vector<unsigned char> filtered((stride + 1) * height);
+	std::vector<unsigned char> sub(stride), up(stride);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = pixels + stride * y;
+		const unsigned char* previous = y > 0 ? row - stride : nullptr;
+		for (size_t i = 0; i < stride; i++)
+		{
+			sub[i] = (unsigned char)(row[i] - (i >= (size_t)channels ? row[i - channels] : 0));
+			up[i] = (unsigned char)(row[i] - (previous ? previous[i] : 0));
+		}
+
+		unsigned char filter = 0;
+		const unsigned char* source = row;
+		unsigned int best = FilterCost(row, stride);
+		unsigned int cost = FilterCost(sub.data(), stride);
+		if (cost < best) { best = cost; filter = 1; source = sub.data(); }
+		cost = FilterCost(up.data(), stride);
+		if (cost < best) { best = cost; filter = 2; source = up.data(); }
+
+		unsigned char* destination = &filtered[(stride + 1) * y];
+		destination[0] = filter;
+		memcpy(destination + 1, source, stride);
+	}
+
+	std::vector<unsigned char> compressed;
+	compressed.reserve(filtered.size() / 4);
+	Deflate(filtered, compressed);
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	png.insert(png.end(), signature, signature + 8);
+
+	unsigned char header[13];
+	for (int i = 0; i < 4; i++)
+	{
+		header[i] = (unsigned char)((uint32_t)width >> (24 - 8 * i));
+		header[4 + i] = (unsigned char)((uint32_t)height >> (24 - 8 * i));
+	}
+	header[8] = 8;							// bits per channel
+	header[9] = channels == 3 ? 2 : 0;		// colour type: RGB or greyscale
+	header[10] = 0;							// deflate
+	header[11] = 0;							// adaptive filtering
+	header[12] = 0;							// not interlaced
+	PutChunk(png, "IHDR", header, sizeof(header));
+	PutChunk(png, "IDAT", compressed.data(), compressed.size());
+	PutChunk(png, "IEND", nullptr, 0);
+	return true;
+}
+
+bool PngWriter::Write(const char* filename, const unsigned char* pixels, int width, int height, int channels)
+{
+	std::vector<unsigned char> png;
+	if (!Encode(pixels, width, height, channels, png))
+	{
+		return false;
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(png.data()), (std::streamsize)png.size());
+	return file.good();
+}
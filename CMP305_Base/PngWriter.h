@@ -0,0 +1,16 @@
+#pragma once
+#include <vector>
+
+// Encodes 8-bit greyscale (1 channel) or RGB (3 channels) images as PNG without any library.
+// Every row takes the filter (none, sub or up) with the smallest sum of absolute values and the rows are
+// compressed with a single fixed Huffman deflate block and greedy LZ77 matching (one candidate per hash).
+// It compresses less than zlib, but it is fast and the smooth gradients of the terrain previews compress well
+class PngWriter
+{
+public:
+	// Replace 'png' with the PNG file of the image, 'pixels' holds 'height' rows of width * channels bytes.
+	// Returns false if the size or the channel count is not supported
+	static bool Encode(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& png);
+	// Encode the image and write it to a file. Returns false if it cannot be encoded or written
+	static bool Write(const char* filename, const unsigned char* pixels, int width, int height, int channels);
+};
@@ -0,0 +1,325 @@
+#include "PropScatter.h"
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+	const int kTileCells = 32;	// cells on each side of a tile, at least 3 so the tiles of a pass do not read each other
+
+	// Integer hash (the output function of PCG), used to seed the tiles and to pick the rotation, scale and mask test
+	unsigned int Hash(unsigned int value)
+	{
+		unsigned int state = value * 747796405u + 2891336453u;
+		unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	// Random float in [0, 1) from the top 24 bits
+	float ToUnit(unsigned int value)
+	{
+		return (float)(value >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Random numbers of one tile (xorshift32, the state is never 0)
+	struct TileRandom
+	{
+		explicit TileRandom(unsigned int seed) { state = seed | 1u; }
+
+		unsigned int NextInt()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+		float Next() { return ToUnit(NextInt()); }
+
+		unsigned int state;
+	};
+}
+
+PropScatter::PropScatter()
+{
+	threadCount = 0;
+	sampleCount = 0;
+	rules = nullptr;
+	size = 0.0f;
+	cellSize = 1.0f;
+	maxGradientSquared = 0.0f;
+	columns = 0;
+	rows = 0;
+}
+
+void PropScatter::Release()
+{
+	std::vector<XMFLOAT2>().swap(cells);
+	std::vector<std::vector<PropInstance>>().swap(tileInstances);
+	std::vector<int>().swap(tileSamples);
+}
+
+void PropScatter::Scatter(const HeightMap& heightMap, float pointSpacing, const ScatterRules& scatterRules, std::vector<PropInstance>& instances)
+{
+	instances.clear();
+	sampleCount = 0;
+	if (heightMap.IsEmpty() || heightMap.GetResolution() < 2 || pointSpacing <= 0.0f || scatterRules.minSpacing <= 0.0f)
+	{
+		return;
+	}
+
+	rules = &scatterRules;
+	heights.SetHeightMap(heightMap, pointSpacing);
+	densities.SetGrid(rules->densityMask, heightMap.GetResolution(), pointSpacing);
+	size = (float)(heightMap.GetResolution() - 1) * pointSpacing;
+
+	// A cell as wide as minSpacing / sqrt(2) holds at most one sample
+	cellSize = rules->minSpacing / sqrtf(2.0f);
+	columns = (int)(size / cellSize) + 1;
+	rows = columns;
+	cells.assign((size_t)columns * rows, XMFLOAT2(-1.0f, -1.0f));
+
+	// The slope rule compares the squared gradient of the height, so no angle is computed per sample
+	float maxSlope = rules->maxSlope < 89.9f ? rules->maxSlope : 89.9f;
+	float maxGradient = tanf(XMConvertToRadians(maxSlope > 0.0f ? maxSlope : 0.0f));
+	maxGradientSquared = maxGradient * maxGradient;
+
+	const int tileColumns = (columns + kTileCells - 1) / kTileCells;
+	const int tileRows = (rows + kTileCells - 1) / kTileCells;
+	const int tileCount = tileColumns * tileRows;
+	tileInstances.resize(tileCount);
+	for (std::vector<PropInstance>& tile : tileInstances)
+	{
+		tile.clear();
+	}
+	tileSamples.assign(tileCount, 0);
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+
+	// Four passes, one per (even or odd column, even or odd row) of tiles. Two tiles of the same pass are at
+	// least one tile apart, and a tile only reads the cells 2 cells around it, so they can be sampled in parallel
+	std::vector<Tile> passTiles;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		passTiles.clear();
+		for (int tileRow = pass >> 1; tileRow < tileRows; tileRow += 2)
+		{
+			for (int tileColumn = pass & 1; tileColumn < tileColumns; tileColumn += 2)
+			{
+				Tile tile;
+				tile.firstColumn = tileColumn * kTileCells;
+				tile.firstRow = tileRow * kTileCells;
+				tile.lastColumn = tile.firstColumn + kTileCells < columns ? tile.firstColumn + kTileCells : columns;
+				tile.lastRow = tile.firstRow + kTileCells < rows ? tile.firstRow + kTileCells : rows;
+				tile.index = tileRow * tileColumns + tileColumn;
+				passTiles.push_back(tile);
+			}
+		}
+
+		std::atomic<size_t> nextTile(0);
+		auto worker = [&]()
+		{
+			std::vector<XMFLOAT2> active;
+			for (size_t t = nextTile++; t < passTiles.size(); t = nextTile++)
+			{
+				SampleTile(passTiles[t], active);
+			}
+		};
+
+		int passThreads = threads < (int)passTiles.size() ? threads : (int)passTiles.size();
+		std::vector<std::thread> workers;
+		for (int t = 1; t < passThreads; t++)
+		{
+			workers.push_back(std::thread(worker));
+		}
+		worker();
+		for (std::thread& thread : workers)
+		{
+			thread.join();
+		}
+	}
+
+	// Join the tiles in order, the same props in the same order for any thread count
+	size_t total = 0;
+	for (int t = 0; t < tileCount; t++)
+	{
+		total += tileInstances[t].size();
+		sampleCount += tileSamples[t];
+	}
+	instances.reserve(total);
+	for (const std::vector<PropInstance>& tile : tileInstances)
+	{
+		instances.insert(instances.end(), tile.begin(), tile.end());
+	}
+}
+
+void PropScatter::SampleTile(const Tile& tile, std::vector<XMFLOAT2>& active)
+{
+	std::vector<PropInstance>& instances = tileInstances[tile.index];
+	TileRandom random(Hash(rules->seed ^ Hash((unsigned int)tile.index)));
+	const float minSpacing = rules->minSpacing;
+	const float minX = (float)tile.firstColumn * cellSize;
+	const float minZ = (float)tile.firstRow * cellSize;
+	const float maxX = tile.lastColumn == columns ? size : (float)tile.lastColumn * cellSize;
+	const float maxZ = tile.lastRow == rows ? size : (float)tile.lastRow * cellSize;
+	int samples = 0;
+
+	// Grow from the samples of the neighbouring tiles (sampled in the previous passes) next to the border,
+	// so the samples on both sides of the border are packed as tightly as the ones inside a tile
+	active.clear();
+	int firstRow = tile.firstRow - 2 > 0 ? tile.firstRow - 2 : 0;
+	int lastRow = tile.lastRow + 2 < rows ? tile.lastRow + 2 : rows;
+	int firstColumn = tile.firstColumn - 2 > 0 ? tile.firstColumn - 2 : 0;
+	int lastColumn = tile.lastColumn + 2 < columns ? tile.lastColumn + 2 : columns;
+	for (int row = firstRow; row < lastRow; row++)
+	{
+		bool insideRow = row >= tile.firstRow && row < tile.lastRow;
+		for (int column = firstColumn; column < lastColumn; column++)
+		{
+			if (insideRow && column == tile.firstColumn)
+			{
+				column = tile.lastColumn - 1;	// skip the cells of the tile
+				continue;
+			}
+			const XMFLOAT2& sample = cells[(size_t)row * columns + column];
+			if (sample.x >= 0.0f)
+			{
+				active.push_back(sample);
+			}
+		}
+	}
+
+	// Without neighbours, start from a random point of the tile
+	if (active.empty())
+	{
+		float x = minX + random.Next() * (maxX - minX);
+		float z = minZ + random.Next() * (maxZ - minZ);
+		int column = (int)(x / cellSize);
+		int row = (int)(z / cellSize);
+		if (column >= tile.lastColumn) column = tile.lastColumn - 1;
+		if (row >= tile.lastRow) row = tile.lastRow - 1;
+
+		cells[(size_t)row * columns + column] = XMFLOAT2(x, z);
+		active.push_back(XMFLOAT2(x, z));
+		samples++;
+		ApplyRules(x, z, random.NextInt(), instances);
+	}
+
+	// Bridson's algorithm: try candidates around a random active sample, keep the first one far enough from every
+	// sample, and retire the active sample when all the attempts fail. The candidates are evenly spaced on the
+	// circle just outside minSpacing, from a random angle (Roberts' variant), which packs the samples more densely
+	// and replaces the sine, cosine and square root of every candidate by a rotation
+	const float distance = minSpacing * 1.0001f;
+	const int attempts = rules->attempts > 0 ? rules->attempts : 1;
+	const float stepCos = cosf(XM_2PI / (float)attempts);
+	const float stepSin = sinf(XM_2PI / (float)attempts);
+	while (!active.empty())
+	{
+		size_t a = random.NextInt() % active.size();
+		XMFLOAT2 centre = active[a];
+		float angle = random.Next() * XM_2PI;
+		float directionX = cosf(angle);
+		float directionZ = sinf(angle);
+		bool placed = false;
+		for (int attempt = 0; attempt < attempts; attempt++)
+		{
+			float x = centre.x + distance * directionX;
+			float z = centre.y + distance * directionZ;
+			float rotatedX = directionX * stepCos - directionZ * stepSin;
+			directionZ = directionX * stepSin + directionZ * stepCos;
+			directionX = rotatedX;
+			if (x < minX || x >= maxX || z < minZ || z >= maxZ)
+			{
+				continue;
+			}
+
+			int column = (int)(x / cellSize);
+			int row = (int)(z / cellSize);
+			if (column >= tile.lastColumn) column = tile.lastColumn - 1;
+			if (row >= tile.lastRow) row = tile.lastRow - 1;
+			if (!IsFree(x, z, column, row))
+			{
+				continue;
+			}
+
+			cells[(size_t)row * columns + column] = XMFLOAT2(x, z);
+			active.push_back(XMFLOAT2(x, z));
+			samples++;
+			ApplyRules(x, z, random.NextInt(), instances);
+			placed = true;
+			break;
+		}
+
+		if (!placed)
+		{
+			active[a] = active.back();
+			active.pop_back();
+		}
+	}
+
+	tileSamples[tile.index] = samples;
+}
+
+bool PropScatter::IsFree(float x, float z, int column, int row)const
+{
+	if (cells[(size_t)row * columns + column].x >= 0.0f)
+	{
+		return false;
+	}
+
+	// Samples closer than minSpacing are at most 2 cells away, but not in the corners of the 5x5 cells:
+	// a sample there is at least one cell along both axes away, sqrt(2) * cellSize = minSpacing
+	const float minSpacingSquared = rules->minSpacing * rules->minSpacing;
+	int firstRow = row - 2 > 0 ? row - 2 : 0;
+	int lastRow = row + 2 < rows - 1 ? row + 2 : rows - 1;
+	int firstColumn = column - 2 > 0 ? column - 2 : 0;
+	int lastColumn = column + 2 < columns - 1 ? column + 2 : columns - 1;
+	for (int m = firstRow; m <= lastRow; m++)
+	{
+		bool outerRow = m == row - 2 || m == row + 2;
+		const XMFLOAT2* cell = &cells[(size_t)m * columns + firstColumn];
+		for (int n = firstColumn; n <= lastColumn; n++, cell++)
+		{
+			if (cell->x >= 0.0f && !(outerRow && (n == column - 2 || n == column + 2)))
+			{
+				float dx = cell->x - x;
+				float dz = cell->y - z;
+				if (dx * dx + dz * dz < minSpacingSquared)
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void PropScatter::ApplyRules(float x, float z, unsigned int random, std::vector<PropInstance>& instances)const
+{
+	XMFLOAT2 gradient;
+	float height = heights.GetHeight(x, z, &gradient);
+	if (height < rules->height.min || height > rules->height.max)
+	{
+		return;
+	}
+
+	if (gradient.x * gradient.x + gradient.y * gradient.y > maxGradientSquared)
+	{
+		return;
+	}
+
+	if (rules->densityMask && ToUnit(Hash(random)) >= densities.GetHeight(x, z))
+	{
+		return;
+	}
+
+	PropInstance instance;
+	instance.position = XMFLOAT3(x, height, z);
+	instance.rotation = ToUnit(Hash(random + 1u)) * XM_2PI;
+	instance.scale = rules->scale.min + (rules->scale.max - rules->scale.min) * ToUnit(Hash(random + 2u));
+	instances.push_back(instance);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "HeightMap.h"
+#include "HeightQuery.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+// Rules deciding where the props can be placed
+struct ScatterRules
+{
+	ScatterRules()
+	{
+		minSpacing = 2.0f;
+		height.min = -1000.0f;
+		height.max = 1000.0f;
+		maxSlope = 30.0f;
+		scale.min = 0.8f;
+		scale.max = 1.2f;
+		densityMask = nullptr;
+		seed = 1;
+		attempts = 12;
+	}
+
+	float minSpacing;			// minimum distance between two props on the xz plane
+	Range height;				// heights the props can be placed at
+	float maxSlope;				// steepest slope the props can be placed on, in degrees
+	Range scale;				// range of the random uniform scale of the props
+	// Optional mask with one value per height map point, from 0 (no props) to 1 (every sample kept).
+	// It is interpolated between the points
+	const float* densityMask;
+	unsigned int seed;			// the same seed, rules and height map always give the same props
+	int attempts;				// candidates tried around a sample before it stops spreading (k in Bridson's algorithm)
+								// 12 packs about 0.84 samples per minSpacing^2, 30 about 0.9 at 2.5 times the cost
+};
+
+// A placed prop, the data of one instance
+struct PropInstance
+{
+	XMFLOAT3 position;
+	float rotation;		// around the y-axis, in radians
+	float scale;
+};
+
+// Scatters props over a height map with Poisson-disk sampling (Bridson's algorithm), so no two props are closer
+// than the minimum spacing, and keeps the samples allowed by the rules.
+// Every grid cell (minSpacing / sqrt(2) wide) holds at most one sample, so checking a candidate only reads the 5x5
+// cells around it. The cells are grouped in tiles, sampled on several threads in four passes: the tiles of a pass
+// are never next to each other, and the tiles of the later passes grow from the samples of their neighbours, so
+// the spacing holds across the tile borders. Each tile has its own random numbers, so the props are the same
+// whatever the thread count
+class PropScatter
+{
+public:
+	PropScatter();
+
+	// Threads used to sample the tiles, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+
+	// Replace 'instances' with the props placed on the height map, whose points are 'spacing' apart
+	void Scatter(const HeightMap& map, float spacing, const ScatterRules& rules, std::vector<PropInstance>& instances);
+
+	// Samples of the last Scatter, before the rules removed some of them
+	int GetSampleCount()const { return sampleCount; }
+	// Release the memory kept for the next Scatter
+	void Release();
+
+private:
+	struct Tile
+	{
+		int firstColumn, firstRow;		// first cell of the tile
+		int lastColumn, lastRow;		// one past the last cell
+		int index;						// index of the tile, the order of the props
+	};
+
+	// Sample a tile and keep the samples allowed by the rules in its instances
+	void SampleTile(const Tile& tile, std::vector<XMFLOAT2>& active);
+	// True if there is no sample closer than minSpacing to the point
+	bool IsFree(float x, float z, int column, int row)const;
+	// Add the sample allowed by the rules to 'instances'
+	void ApplyRules(float x, float z, unsigned int random, std::vector<PropInstance>& instances)const;
+
+	int threadCount;
+	int sampleCount;
+
+	// State of the current Scatter
+	const ScatterRules* rules;
+	HeightQuery heights;
+	HeightQuery densities;
+	float size;					// the height map covers [0, size] on x and z
+	float cellSize;
+	float maxGradientSquared;	// tan(maxSlope)^2
+	int columns, rows;			// cells of the grid
+
+	// Sample in each cell, x < 0 for an empty cell
+	std::vector<XMFLOAT2> cells;
+	// Props of each tile, joined in tile order at the end
+	std::vector<std::vector<PropInstance>> tileInstances;
+	// Samples of each tile, before the rules
+	std::vector<int> tileSamples;
+};
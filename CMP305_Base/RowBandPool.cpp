@@ -0,0 +1,85 @@
+#include "RowBandPool.h"
+
+RowBandPool& RowBandPool::Get()
+{
+	static RowBandPool pool;
+	return pool;
+}
+
+RowBandPool::RowBandPool() : busy(false), job(nullptr), jobCount(0), jobThreads(0), pending(0), generation(0), stopping(false)
+{
+}
+
+RowBandPool::~RowBandPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+bool RowBandPool::Run(int count, int threads, const std::function<void(int, int)>& function)
+{
+	bool idle = false;
+	if (!busy.compare_exchange_strong(idle, true))
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while ((int)workers.size() < threads - 1)
+		{
+			workers.push_back(std::thread(&RowBandPool::Work, this, (int)workers.size() + 1, generation));
+		}
+		job = &function;
+		jobCount = count;
+		jobThreads = threads;
+		pending = threads - 1;
+		generation++;
+	}
+	wake.notify_all();
+
+	function(0, (int)((long long)count / threads));
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return pending == 0; });
+		job = nullptr;
+	}
+	busy = false;
+	return true;
+}
+
+void RowBandPool::Work(int band, unsigned int seen)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [&] { return stopping || generation != seen; });
+		if (stopping)
+		{
+			return;
+		}
+		seen = generation;
+		if (band >= jobThreads)
+		{
+			continue;
+		}
+
+		const std::function<void(int, int)>& function = *job;
+		int first = (int)((long long)jobCount * band / jobThreads);
+		int last = (int)((long long)jobCount * (band + 1) / jobThreads);
+		lock.unlock();
+		function(first, last);
+		lock.lock();
+		if (--pending == 0)
+		{
+			done.notify_one();
+		}
+	}
+}
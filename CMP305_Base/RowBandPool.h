@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads shared by the grid operations split in bands of rows (HeightMap, Hydrology, StreamPowerErosion,
+// HorizonBaker, ConstraintSolver). They are created on first use and kept until the program ends, so an operation
+// only wakes them instead of creating and joining threads every call.
+// One operation uses the pool at a time: Run() returns false while another one (on another thread, or the operation
+// itself from inside one of its bands) has it, and the caller then runs every band itself
+class RowBandPool
+{
+public:
+	// The pool of the program
+	static RowBandPool& Get();
+
+	~RowBandPool();
+
+	// Call function(first, last) for 'threads' bands of the items [0, count), the first band on this thread.
+	// Returns false without calling it if the pool is busy
+	bool Run(int count, int threads, const std::function<void(int, int)>& function);
+
+private:
+	RowBandPool();
+	RowBandPool(const RowBandPool&);
+	RowBandPool& operator=(const RowBandPool&);
+
+	// Worker 'band' runs that band of every operation with more threads than its index
+	void Work(int band, unsigned int seen);
+
+	std::vector<std::thread> workers;
+	std::atomic<bool> busy;		// set by the operation using the pool
+	std::mutex mutex;			// guards the job and the counters below
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)>* job;
+	int jobCount;
+	int jobThreads;
+	int pending;				// bands of the job not finished by the workers
+	unsigned int generation;	// incremented for every job
+	bool stopping;
+};
+
+// Call function(first, last) for 'threads' bands of the items (usually rows) [0, count), the first band on this
+// thread and the others on the pool, or all of them on this thread if the pool is busy
+template <class Function>
+void ForEachRowBand(int count, int threads, const Function& function)
+{
+	if (threads > count)
+	{
+		threads = count;
+	}
+	if (threads <= 1 || !RowBandPool::Get().Run(count, threads, std::function<void(int, int)>(function)))
+	{
+		function(0, count);
+	}
+}
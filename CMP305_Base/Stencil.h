@@ -0,0 +1,173 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+
+// Stencils over the square grids of heights (HeightMap): a stencil reads a fixed set of taps around every point,
+// and the boundary policy decides where the taps outside the grid read. Both are template parameters, so every
+// combination compiles to its own loops: the interior points, whose taps are all inside, read them at constant
+// offsets without any test (loops the compiler can vectorize), and only the points near the border go through
+// the boundary policy.
+
+// BOUNDARY POLICIES //
+// Map(coordinate, size) is where a coordinate along one axis of 'size' points reads, or -1 to leave the tap out.
+// The taps are never further outside than the size of the grid
+
+// The taps outside read the nearest point of the border
+struct ClampBoundary
+{
+	static int Map(int coordinate, int size) { return coordinate < 0 ? 0 : (coordinate >= size ? size - 1 : coordinate); }
+};
+
+// The grid repeats, for tileable terrain
+struct WrapBoundary
+{
+	static int Map(int coordinate, int size) { return coordinate < 0 ? coordinate + size : (coordinate >= size ? coordinate - size : coordinate); }
+};
+
+// The grid is reflected about its border points, which are not repeated
+struct MirrorBoundary
+{
+	static int Map(int coordinate, int size) { return coordinate < 0 ? -coordinate : (coordinate >= size ? 2 * (size - 1) - coordinate : coordinate); }
+};
+
+// The taps outside are left out, a point of the border has fewer taps
+struct SkipBoundary
+{
+	static int Map(int coordinate, int size) { return coordinate < 0 || coordinate >= size ? -1 : coordinate; }
+};
+
+// The boundary policies, to choose one at run time
+enum class StencilBoundary
+{
+	Skip,
+	Clamp,
+	Wrap,
+	Mirror
+};
+
+// TAP SETS //
+// kCount taps at (Row(t), Column(t)) * scale from the point, at most kReach * scale away along each axis
+
+// The 3x3 neighbourhood including the point, row by row
+struct NeighbourhoodTaps
+{
+	static const int kCount = 9;
+	static const int kReach = 1;
+	static constexpr int Row(int tap) { return tap / 3 - 1; }
+	static constexpr int Column(int tap) { return tap % 3 - 1; }
+};
+
+// The 4 points up, left, right and down (the corners of a Diamond-Square diamond)
+struct DiamondTaps
+{
+	static const int kCount = 4;
+	static const int kReach = 1;
+	static constexpr int Row(int tap) { return tap == 0 ? -1 : (tap == 3 ? 1 : 0); }
+	static constexpr int Column(int tap) { return tap == 1 ? -1 : (tap == 2 ? 1 : 0); }
+};
+
+// KERNELS //
+// Reductions of the taps left after the boundary policy, in tap order: Add(total, value) every tap into the total
+// started at Start(), then Finish(total, count)
+
+// Average of the taps
+struct AverageKernel
+{
+	float Start()const { return 0.0f; }
+	float Add(float total, float value)const { return total + value; }
+	float Finish(float total, int count)const { return total / (float)count; }
+};
+
+template <class Taps, class Boundary>
+class Stencil
+{
+public:
+	// True if every tap of (m, n) is inside a grid of resolution x resolution
+	static bool IsInterior(int resolution, int m, int n, int scale = 1)
+	{
+		const int reach = Taps::kReach * scale;
+		return m >= reach && m < resolution - reach && n >= reach && n < resolution - reach;
+	}
+
+	// Indices of the taps of point (m, n) of a grid of resolution x resolution, in tap order, with the taps 'scale'
+	// times further apart. Returns how many there are, the boundary policy may leave some out
+	static int Gather(int resolution, int m, int n, int scale, int* indices)
+	{
+		if (IsInterior(resolution, m, n, scale))
+		{
+			const int index = m * resolution + n;
+			for (int t = 0; t < Taps::kCount; t++)
+			{
+				indices[t] = index + (Taps::Row(t) * resolution + Taps::Column(t)) * scale;
+			}
+			return Taps::kCount;
+		}
+
+		int count = 0;
+		for (int t = 0; t < Taps::kCount; t++)
+		{
+			const int row = Boundary::Map(m + Taps::Row(t) * scale, resolution);
+			const int column = Boundary::Map(n + Taps::Column(t) * scale, resolution);
+			if (row >= 0 && column >= 0)
+			{
+				indices[count++] = row * resolution + column;
+			}
+		}
+		return count;
+	}
+
+	// Apply the kernel to every point of the rows [firstRow, lastRow) of 'source' into 'target', both grids of
+	// resolution x resolution. The rows can be split between threads, 'target' must not be 'source'.
+	// Both paths add the taps in the same order, so a point gives the same result whichever path it takes
+	template <class Kernel>
+	static void ApplyRows(const float* source, float* target, int resolution, int firstRow, int lastRow, const Kernel& kernel)
+	{
+		const int firstInner = Taps::kReach;
+		const int lastInner = resolution - Taps::kReach;
+
+		for (int m = firstRow; m < lastRow; m++)
+		{
+			const float* row = source + (size_t)m * resolution;
+			float* result = target + (size_t)m * resolution;
+			if (m < firstInner || m >= lastInner || lastInner <= firstInner)
+			{
+				ApplyEdge(source, result, resolution, m, 0, resolution, kernel);
+				continue;
+			}
+
+			ApplyEdge(source, result, resolution, m, 0, firstInner, kernel);
+			for (int n = firstInner; n < lastInner; n++)
+			{
+				result[n] = ReduceInterior(row + n, resolution, kernel, std::make_index_sequence<Taps::kCount>());
+			}
+			ApplyEdge(source, result, resolution, m, lastInner, resolution, kernel);
+		}
+	}
+
+private:
+	// The kernel over the taps of an interior point, expanded at compile time so the loads are at constant offsets
+	template <class Kernel, size_t... T>
+	static float ReduceInterior(const float* point, int resolution, const Kernel& kernel, std::index_sequence<T...>)
+	{
+		auto total = kernel.Start();
+		((total = kernel.Add(total, point[Taps::Row(T) * resolution + Taps::Column(T)])), ...);
+		return kernel.Finish(total, Taps::kCount);
+	}
+
+	// The points [firstColumn, lastColumn) of row m through the boundary policy
+	template <class Kernel>
+	static void ApplyEdge(const float* source, float* result, int resolution, int m, int firstColumn, int lastColumn, const Kernel& kernel)
+	{
+		int indices[Taps::kCount];
+		for (int n = firstColumn; n < lastColumn; n++)
+		{
+			const int count = Gather(resolution, m, n, 1, indices);
+			auto total = kernel.Start();
+			for (int t = 0; t < count; t++)
+			{
+				total = kernel.Add(total, source[indices[t]]);
+			}
+			result[n] = kernel.Finish(total, count);
+		}
+	}
+};
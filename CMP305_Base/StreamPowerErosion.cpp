@@ -0,0 +1,425 @@
+#include "StreamPowerErosion.h"
+#include "RowBandPool.h"
+#include "Stencil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <queue>
+#include <thread>
+
+namespace
+{
+	const size_t kThreadedTexels = 128 * 128; // smaller maps are processed on one thread
+	const float kSqrt2 = 1.414213562f;
+	const int kPitPasses = 4;			// pit filling passes of an iteration, the pits left are outlets of their own basins
+	const float kPitEpsilon = 1e-4f;	// height step across a filled pit, as HydrologySettings::epsilon
+}
+
+StreamPowerErosion::StreamPowerErosion()
+{
+	threadCount = 0;
+	resolution = 0;
+	spacing = 1.0f;
+	lastChange = 0.0f;
+	fillCount = 0;
+	pitCount = 0;
+	markStamp = 0;
+}
+
+void StreamPowerErosion::Release()
+{
+	std::vector<unsigned char>().swap(receivers);
+	std::vector<int>().swap(donorOffsets);
+	std::vector<int>().swap(donors);
+	std::vector<int>().swap(outlets);
+	std::vector<float>().swap(area);
+	std::vector<float>().swap(scratch);
+	std::vector<int>().swap(marks);
+	std::vector<int>().swap(flooded);
+	std::vector<int>().swap(pitList);
+	std::vector<int>().swap(nextPits);
+	markStamp = 0;
+	hydrology.Release();
+}
+
+bool StreamPowerErosion::Erode(HeightMap& map, float pointSpacing, const StreamPowerSettings& settings)
+{
+	if (map.IsEmpty() || map.GetResolution() < 3 || pointSpacing <= 0.0f)
+	{
+		return false;
+	}
+
+	resolution = map.GetResolution();
+	spacing = pointSpacing;
+	for (int k = 0; k < 8; k++)
+	{
+		neighbourOffsets[k] = Hydrology::kNeighbourM[k] * resolution + Hydrology::kNeighbourN[k];
+	}
+	fillCount = 0;
+	pitCount = 0;
+	const size_t count = (size_t)resolution * resolution;
+	float* heights = map.GetData();
+	receivers.resize(count);
+	donorOffsets.resize(count + 1);
+	donors.resize(count);
+	area.resize(count);
+	if (marks.size() != count)
+	{
+		marks.assign(count, 0);
+		markStamp = 0;
+	}
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	if (threads < 1 || count < kThreadedTexels)
+	{
+		threads = 1;
+	}
+
+	for (int iteration = 0; iteration < settings.iterations; iteration++)
+	{
+		if (iteration == settings.iterations - 1)
+		{
+			// the heights before the last iteration, for the change
+			previous.assign(heights, heights + count);
+		}
+
+		// Receivers, with the depressions filled if any point inside the map has none: all of them on the first
+		// iteration, then only the shallow pits the diffusion leaves, each one from itself up to where it spills
+		std::atomic<int> pits(0);
+		auto route = [&](int firstRow, int lastRow)
+		{
+			pits += RouteRows(firstRow, lastRow, heights);
+		};
+		ForEachRowBand(resolution, threads, route);
+		if (iteration == 0 && pits > 0)
+		{
+			HydrologySettings fillSettings;
+			hydrology.SetThreadCount(threadCount);
+			hydrology.Analyse(map, fillSettings);
+			const std::vector<float>& filled = hydrology.GetFilledHeights();
+			std::copy(filled.begin(), filled.end(), heights);
+			hydrology.Release();
+			fillCount++;
+
+			pits = 0;
+			ForEachRowBand(resolution, threads, route);
+		}
+		if (pits > 0)
+		{
+			pitList.clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				if (receivers[i] == Hydrology::kNoFlow && !IsBorder((int)i))
+				{
+					pitList.push_back((int)i);
+				}
+			}
+			// Filling a pit can make pits of its neighbours, they are filled in the next pass
+			for (int pass = 0; pass < kPitPasses && !pitList.empty(); pass++)
+			{
+				nextPits.clear();
+				for (int pit : pitList)
+				{
+					if (receivers[pit] == Hydrology::kNoFlow)
+					{
+						FillPit(pit, heights);
+						pitCount++;
+					}
+				}
+				pitList.swap(nextPits);
+			}
+		}
+
+		BuildDonors();
+		// The border, and any point left without a receiver, which is then a local base level
+		outlets.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (receivers[i] == Hydrology::kNoFlow)
+			{
+				outlets.push_back((int)i);
+			}
+		}
+
+		// One band per thread, every thread takes the next basin until there are none left
+		std::atomic<size_t> nextBasin(0);
+		ForEachRowBand(threads, threads, [&](int, int)
+		{
+			std::vector<int> order;
+			for (size_t basin = nextBasin++; basin < outlets.size(); basin = nextBasin++)
+			{
+				SolveBasin(outlets[basin], heights, settings, order);
+			}
+		});
+
+		const float diffusion = settings.diffusion * settings.timeStep;
+		if (diffusion > 0.0f)
+		{
+			scratch.resize(count);
+			ForEachRowBand(resolution, threads, [&](int firstRow, int lastRow)
+			{
+				DiffuseRows(firstRow, lastRow, heights, diffusion > 1.0f ? 1.0f : diffusion);
+			});
+			std::copy(scratch.begin(), scratch.end(), heights);
+		}
+	}
+
+	// Net change of the last iteration: the erosion and the diffusion pull against each other at the balance
+	double change = 0.0;
+	for (size_t i = 0; i < previous.size(); i++)
+	{
+		change += fabs(heights[i] - previous[i]);
+	}
+	lastChange = settings.iterations > 0 ? (float)(change / ((double)count * settings.timeStep)) : 0.0f;
+	std::vector<float>().swap(previous);
+	return true;
+}
+
+int StreamPowerErosion::RouteRows(int firstRow, int lastRow, const float* heights)
+{
+	const int last = resolution - 1;
+	int pits = 0;
+	for (int m = firstRow; m < lastRow; m++)
+	{
+		for (int n = 0; n < resolution; n++)
+		{
+			const int index = m * resolution + n;
+			if (m == 0 || m == last || n == 0 || n == last)
+			{
+				// base level
+				receivers[index] = Hydrology::kNoFlow;
+				continue;
+			}
+			RoutePoint(index, heights);
+			pits += receivers[index] == Hydrology::kNoFlow ? 1 : 0;
+		}
+	}
+	return pits;
+}
+
+void StreamPowerErosion::RoutePoint(int index, const float* heights)
+{
+	// The neighbour of steepest descent
+	const float height = heights[index];
+	float steepest = 0.0f;
+	unsigned char receiver = Hydrology::kNoFlow;
+	for (int k = 0; k < 8; k++)
+	{
+		float slope = (height - heights[index + neighbourOffsets[k]]) * Hydrology::kInvDistance[k];
+		if (slope > steepest)
+		{
+			steepest = slope;
+			receiver = (unsigned char)k;
+		}
+	}
+	receivers[index] = receiver;
+}
+
+void StreamPowerErosion::BuildDonors()
+{
+	// Number of donors of every point, then the end of its list, then every point put in the list of its receiver
+	// from the end, which leaves the offsets at the start of the lists. One pass over the points each, every point has
+	// one receiver at most
+	const int count = resolution * resolution;
+	std::fill(donorOffsets.begin(), donorOffsets.end(), 0);
+	for (int i = 0; i < count; i++)
+	{
+		if (receivers[i] != Hydrology::kNoFlow)
+		{
+			donorOffsets[i + neighbourOffsets[receivers[i]]]++;
+		}
+	}
+	for (int i = 1; i <= count; i++)
+	{
+		donorOffsets[i] += donorOffsets[i - 1];
+	}
+	for (int i = count - 1; i >= 0; i--)
+	{
+		if (receivers[i] != Hydrology::kNoFlow)
+		{
+			donors[--donorOffsets[i + neighbourOffsets[receivers[i]]]] = i;
+		}
+	}
+}
+
+void StreamPowerErosion::SolveBasin(int outlet, float* heights, const StreamPowerSettings& settings, std::vector<int>& order)
+{
+	// The basin from the outlet upstream, every point after its receiver
+	const float cellArea = spacing * spacing;
+	order.clear();
+	order.push_back(outlet);
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		const int point = order[k];
+		area[point] = cellArea;
+		for (int d = donorOffsets[point]; d < donorOffsets[point + 1]; d++)
+		{
+			order.push_back(donors[d]);
+		}
+	}
+
+	// Drainage area, from the top of the basin down
+	for (size_t k = order.size() - 1; k > 0; k--)
+	{
+		const int point = order[k];
+		const unsigned char receiver = receivers[point];
+		area[point + neighbourOffsets[receiver]] += area[point];
+	}
+
+	if (!IsBorder(outlet))
+	{
+		// a pit inside the map only rises
+		heights[outlet] += settings.uplift * (settings.upliftScale ? settings.upliftScale[outlet] : 1.0f) * settings.timeStep;
+	}
+
+	// Heights, from the outlet up, so the receiver of every point is already solved
+	const bool squareRoot = settings.areaExponent == 0.5f;
+	const float erosion = settings.erodibility * settings.timeStep;
+	for (size_t k = 1; k < order.size(); k++)
+	{
+		const int point = order[k];
+		const unsigned char receiver = receivers[point];
+		const int receiverIndex = point + neighbourOffsets[receiver];
+		const float distance = (receiver & 1) ? spacing * kSqrt2 : spacing;
+		const float areaTerm = squareRoot ? sqrtf(area[point]) : powf(area[point], settings.areaExponent);
+		const float f = erosion * areaTerm / distance;
+		const float rise = settings.uplift * (settings.upliftScale ? settings.upliftScale[point] : 1.0f) * settings.timeStep;
+
+		heights[point] = (heights[point] + rise + f * heights[receiverIndex]) / (1.0f + f);
+	}
+}
+
+void StreamPowerErosion::FillPit(int pit, float* heights)
+{
+	if (markStamp > INT_MAX - 3)
+	{
+		std::fill(marks.begin(), marks.end(), 0);
+		markStamp = 0;
+	}
+	const int queued = ++markStamp;
+	const int inside = ++markStamp;
+	const int raised = ++markStamp;
+
+	// Flood from the pit in height order up to the first point with a lower neighbour outside the flood, or the border.
+	// The flooded points are inside the map, so their neighbours are too
+	typedef std::pair<float, int> QueueEntry;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+	queue.push(QueueEntry(heights[pit], pit));
+	marks[pit] = queued;
+	flooded.clear();
+	int spill = -1;
+	while (!queue.empty())
+	{
+		const int point = queue.top().second;
+		queue.pop();
+		if (IsBorder(point))
+		{
+			spill = point;
+			break;
+		}
+		bool drains = false;
+		for (int k = 0; k < 8 && !drains; k++)
+		{
+			const int neighbour = point + neighbourOffsets[k];
+			drains = marks[neighbour] != inside && heights[neighbour] < heights[point];
+		}
+		if (drains)
+		{
+			spill = point;
+			break;
+		}
+
+		marks[point] = inside;
+		flooded.push_back(point);
+		for (int k = 0; k < 8; k++)
+		{
+			const int neighbour = point + neighbourOffsets[k];
+			if (marks[neighbour] != queued && marks[neighbour] != inside)
+			{
+				marks[neighbour] = queued;
+				queue.push(QueueEntry(heights[neighbour], neighbour));
+			}
+		}
+	}
+	if (spill < 0)
+	{
+		return;
+	}
+
+	// Raise the flooded points above the spill point, a step higher every point further from it, so they drain to it.
+	// The marks tell the flooded points, so 'flooded' is reused as the breadth first queue
+	flooded.clear();
+	flooded.push_back(spill);
+	for (size_t k = 0; k < flooded.size(); k++)
+	{
+		const int point = flooded[k];
+		float height = heights[point] + kPitEpsilon;
+		height = height > heights[point] ? height : nextafterf(heights[point], FLT_MAX);
+		const int m = point / resolution;
+		const int n = point - m * resolution;
+		for (int d = 0; d < 8; d++)
+		{
+			// only the spill point can be on the border
+			if (m + Hydrology::kNeighbourM[d] < 0 || m + Hydrology::kNeighbourM[d] >= resolution || n + Hydrology::kNeighbourN[d] < 0 || n + Hydrology::kNeighbourN[d] >= resolution)
+			{
+				continue;
+			}
+			const int neighbour = point + neighbourOffsets[d];
+			if (marks[neighbour] == inside)
+			{
+				marks[neighbour] = raised;
+				heights[neighbour] = height;
+				flooded.push_back(neighbour);
+			}
+		}
+	}
+
+	// The raised points and their neighbours flow somewhere else now, the ones left without a receiver are new pits
+	for (int point : flooded)
+	{
+		const int m = point / resolution;
+		const int n = point - m * resolution;
+		for (int dm = -1; dm <= 1; dm++)
+		{
+			for (int dn = -1; dn <= 1; dn++)
+			{
+				if (m + dm <= 0 || m + dm >= resolution - 1 || n + dn <= 0 || n + dn >= resolution - 1)
+				{
+					continue;
+				}
+				const int index = point + dm * resolution + dn;
+				RoutePoint(index, heights);
+				if (receivers[index] == Hydrology::kNoFlow)
+				{
+					nextPits.push_back(index);
+				}
+			}
+		}
+	}
+}
+
+void StreamPowerErosion::DiffuseRows(int firstRow, int lastRow, const float* heights, float amount)
+{
+	// Mean of the 3x3 neighbourhood, then every point inside moves towards it by 'amount'. The border is the base level
+	Stencil<NeighbourhoodTaps, SkipBoundary>::ApplyRows(heights, scratch.data(), resolution, firstRow, lastRow, AverageKernel());
+	const int last = resolution - 1;
+	for (int m = firstRow; m < lastRow; m++)
+	{
+		const float* row = heights + m * resolution;
+		float* diffused = &scratch[m * resolution];
+		if (m == 0 || m == last)
+		{
+			std::copy(row, row + resolution, diffused);
+			continue;
+		}
+		diffused[0] = row[0];
+		diffused[last] = row[last];
+		for (int n = 1; n < last; n++)
+		{
+			diffused[n] = row[n] + (diffused[n] - row[n]) * amount;
+		}
+	}
+}
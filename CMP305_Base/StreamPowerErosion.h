@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include "HeightMap.h"
+#include "Hydrology.h"
+
+// Uplift and river erosion of StreamPowerErosion
+struct StreamPowerSettings
+{
+	StreamPowerSettings()
+	{
+		iterations = 30;
+		timeStep = 1.0f;
+		uplift = 0.3f;
+		erodibility = 1.0f;
+		areaExponent = 0.5f;
+		diffusion = 0.5f;
+		upliftScale = nullptr;
+	}
+
+	int iterations;
+	float timeStep;			// time of one iteration, the solver is implicit so it can be large
+	float uplift;			// height the tectonic uplift adds to every point per unit of time
+	float erodibility;		// K of the stream power law, the erosion rate is K * A^m * S
+	float areaExponent;		// m, the exponent of the drainage area A in world units (the slope exponent n is 1)
+	// Hillslope diffusion: every iteration moves the points diffusion * timeStep of the way to the mean of their 3x3
+	// neighbourhood (as HeightMap::Smooth), up to all of it. It rounds the ridges of one point the rivers leave between them
+	float diffusion;
+	// Optional uplift multiplier of every point, in the order of the heights, to raise ranges instead of the whole map
+	const float* upliftScale;
+};
+
+// Tectonic uplift and stream power (river) erosion of a height map: dh/dt = U - K * A^m * S, with A the drainage area
+// and S the slope towards the point the water flows to. The border is the base level, it does not move.
+// Every iteration follows Braun and Willett (2013):
+// - every point flows to its neighbour of steepest descent (D8, the receiver), which makes a forest of drainage basins rooted at
+//   the border
+// - the basins are ordered from the outlet upstream (every point after its receiver), the drainage area is added up
+//   in the reverse order, and the heights are solved implicitly in order:
+//   h = (h + U dt + F * h_receiver) / (1 + F), F = K dt A^m / distance, which is stable for any time step and O(n)
+// The basins are independent, so the threads take them in turn and each one orders and solves whole basins.
+// The first iteration fills the depressions of the map (Hydrology) so every point drains to the border, and the
+// implicit solution keeps every point above its receiver. The hillslope diffusion still makes shallow pits, which the
+// following iterations fill one by one by flooding them locally instead of filling the whole map again
+class StreamPowerErosion
+{
+public:
+	StreamPowerErosion();
+
+	// Threads used by the row passes and the basins, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+
+	// Erode the height map, whose points are 'spacing' apart, for settings.iterations iterations.
+	// Returns false if the map is empty
+	bool Erode(HeightMap& map, float spacing, const StreamPowerSettings& settings);
+
+	// Mean height change per unit of time of the points in the last iteration, it goes to 0 as the terrain reaches
+	// the balance between uplift and erosion
+	float GetLastChange()const { return lastChange; }
+	// Drainage basins of the last iteration
+	int GetBasinCount()const { return (int)outlets.size(); }
+	// Iterations of the last Erode that filled all the depressions (only the first one, if any)
+	int GetFillCount()const { return fillCount; }
+	// Pits the hillslope diffusion made that were filled in the last Erode
+	int GetPitCount()const { return pitCount; }
+
+	// Release the memory kept for the next Erode
+	void Release();
+
+private:
+	// Receiver of every point of the rows [firstRow, lastRow), returns the points inside the map without one
+	int RouteRows(int firstRow, int lastRow, const float* heights);
+	// Receiver of a point inside the map
+	void RoutePoint(int index, const float* heights);
+	// Donors of every point (the points flowing into it) as lists in 'donors' starting at donorOffsets
+	void BuildDonors();
+	// Order, drainage area and implicit solution of the basin of 'outlet'
+	void SolveBasin(int outlet, float* heights, const StreamPowerSettings& settings, std::vector<int>& order);
+	// Flood a pit from itself up to where it spills, raise the flooded points so they drain to the spill point and
+	// route them again, adding the points left without a receiver to nextPits
+	void FillPit(int pit, float* heights);
+	bool IsBorder(int index)const
+	{
+		const int m = index / resolution;
+		const int n = index - m * resolution;
+		return m == 0 || m == resolution - 1 || n == 0 || n == resolution - 1;
+	}
+	// Hillslope diffusion of the rows [firstRow, lastRow) of the points inside the map, from 'heights' into 'scratch'
+	void DiffuseRows(int firstRow, int lastRow, const float* heights, float amount);
+
+	int threadCount;
+
+	int resolution;
+	float spacing;
+	float lastChange;
+	int fillCount;
+	int pitCount;
+	// Index offset of the neighbour of every D8 code
+	int neighbourOffsets[8];
+
+	// D8 code of the receiver of every point, Hydrology::kNoFlow for the outlets
+	std::vector<unsigned char> receivers;
+	std::vector<int> donorOffsets;
+	std::vector<int> donors;
+	std::vector<int> outlets;
+	std::vector<float> area;
+	// Heights after the diffusion, copied back
+	std::vector<float> scratch;
+	// Heights before the last iteration
+	std::vector<float> previous;
+	// Depression filling of the first iteration
+	Hydrology hydrology;
+	// Pit filling: the flood of a pit is marked with stamps, so the marks are only cleared when they run out
+	std::vector<int> marks;
+	std::vector<int> flooded;
+	std::vector<int> pitList;
+	std::vector<int> nextPits;
+	int markStamp;
+};
@@ -2,28 +2,25 @@
 #include "PlaneMesh.h"
 #include "Emitter.h"
 #include "Utils.h"
-
-// Frecuency, amplitude and all the data for Waves
-struct WavesData
-{
-	WavesData()
-	{ 
-		// initialise values to 0
-		frequency = XMFLOAT3(0.0f, 0.0f, 0.0f);
-		amplitude = XMFLOAT3(0.0f, 0.0f, 0.0f);
-		offset = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	}
-
-	XMFLOAT3 frequency;
-	XMFLOAT3 amplitude;
-	XMFLOAT3 offset;
-};
+#include "HeightMap.h"
+#include "PropScatter.h"
+#include "TerrainPreview.h"
+#include "HorizonBaker.h"
+#include "Hydrology.h"
+#include "StreamPowerErosion.h"
+#include "ConstraintSolver.h"
+#include "HeightQuery.h"
+#include "CompressedHeightMap.h"
+#include "TerrainVertexPacking.h"
+#include "IndexBufferBuilder.h"
+#include "UploadRing.h"
 
 class TerrainMesh : public PlaneMesh {
 
 public:
-	// Constructor Class
-	TerrainMesh( ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution);
+	// Constructor Class. The vertices are streamed through 'uploadRing' (BaseApplication::uploadRing),
+	// the terrain creates its own ring if it is null
+	TerrainMesh( RenderDevice* device, int resolution, UploadRing* uploadRing = nullptr );
 	// Destructor class:
 	// - Cleanup the heightMap
 	// - Remove all the pointers created in this function
@@ -32,8 +29,22 @@ public:
 	// Change the size of the terrain
 	void Resize( int newResolution );
 
-	// Set up the heightmap and create or update the appropriate buffers
-	void Regenerate( ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	// Build the indices after a resize on the CPU, create the missing buffers and upload the vertices.
+	// The buffers are only created when they do not exist yet, after construction, Resize or a format change,
+	// and then all the vertices are uploaded at once. Otherwise the upload is limited by the frame budget
+	// of the upload ring and continues in StreamVertices
+	void Regenerate( RenderDevice* device );
+	// Upload the vertex rows left by Regenerate, within the frame budget of the upload ring. Call it every frame.
+	// Returns true once the vertex buffer matches the height map
+	bool StreamVertices();
+	// True while there are vertex rows waiting to be uploaded
+	bool IsStreaming()const { return pendingRows > 0; }
+	// Get the ring the vertices are uploaded through
+	const UploadRing* GetUploadRing()const { return uploadRing; }
+
+	// Send the vertex buffer with the stride of the vertex format in use, and the index buffer with its index format.
+	// The topology is a triangle strip when the strips are enabled
+	void sendData(RenderDevice* device, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST) override;
 
 
 	// Get the resolution of the terrain (The number of unit quad on x-axis and z-axis subtracting One))
@@ -42,11 +53,31 @@ public:
 	WavesData GetWavesData()const { return wavesData; }
 	// Get the Max and min Height used for getting random height values
 	Range GetHeightOffsetRange()const { return heightOffsetRange; }
+	// Get the distance between two vertices of the grid
+	float GetVertexSpacing()const { return terrainSize / (float)resolution; }
+	// Get the texture coordinates step between two vertices of the grid
+	float GetUVIncrement()const { return m_UVscale / (float)resolution; }
+	// True if the vertex buffer uses CompactTerrainVertex (must be rendered with TerrainShader)
+	bool GetCompactVertices()const { return compactVertices; }
+	// Get the size in bytes of the vertex buffer
+	int GetVertexBufferSize()const { return vertexCount * (compactVertices ? sizeof(CompactTerrainVertex) : sizeof(VertexType)); }
+	// True if the index buffer holds triangle strips instead of a triangle list
+	bool GetTriangleStrips()const { return triangleStrips; }
+	// Get the size in bytes of the index buffer
+	int GetIndexBufferSize()const { return indexCount * (indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t)); }
+	// Size in bytes of the vertex and index buffers, in the formats in use
+	size_t getMemorySize() override { return GetVertexBufferSize() + GetIndexBufferSize(); }
+	// Get the index buffer chunks. Every chunk has to be drawn with its own start index and base vertex
+	const std::vector<IndexChunk>& GetIndexChunks()const { return indexChunks; }
 
 	// Set the waves Data
 	void SetWavesData(WavesData newWavesData) { wavesData = newWavesData; };
 	// Set the max height for using it in the random height map
 	void SetHeightOffsetRange(Range newHeightOffsetRange) { heightOffsetRange = newHeightOffsetRange; }
+	// Switch between the compact vertex format and BaseMesh::VertexType. The buffers are recreated in the next Regenerate
+	void SetCompactVertices(bool compact);
+	// Switch between a triangle list and triangle strips with restart indices. The index buffer is recreated in the next Regenerate
+	void SetTriangleStrips(bool strips);
 
 
 	//// TERRAIN MANIPULATION HEIGHT MAP FUNCTIONS //// 
@@ -79,25 +110,139 @@ public:
 	// It has been based on the pseudocode: https://www.youtube.com/watch?v=4GuAV1PnurU&t=796s
 	void DiamondSquareAlgorithm();
 
+	// HEIGHT QUERY FUNCTIONS //
+	// Height, normal and slope queries at world positions of the terrain (with the terrain at the origin).
+	// The queries read the height map, they are valid until it is resized, compressed or loaded again
+	HeightQuery& GetHeightQuery();
+	// Height at the world position (x, z), as GetHeightQuery().GetHeight(x, z). While the height map is compressed
+	// only the points around the position are read through the tile cache, so it can be called every frame
+	float GetGroundHeight(float x, float z);
+
+	// PROP PLACEMENT FUNCTIONS //
+	// Place props over the terrain with Poisson-disk sampling, keeping the ones allowed by the rules (see PropScatter).
+	// The instances are in world units of the terrain, with the terrain at the origin
+	void ScatterProps(const ScatterRules& rules, std::vector<PropInstance>& instances);
+	// Samples of the last ScatterProps, before the rules removed some of them
+	int GetScatterSampleCount()const { return propScatter.GetSampleCount(); }
+
+	// PREVIEW FUNCTIONS //
+	// Render the terrain on the CPU, seen from 'yaw' and 'pitch' degrees around its centre (see TerrainPreview::OrbitCamera),
+	// and save the image as PNG
+	bool SavePreview(const char* filename, const PreviewSettings& settings, float yaw, float pitch);
+
+	// LIGHTING BAKE FUNCTIONS //
+	// Bake the ambient occlusion and sun shadow of the terrain (see HorizonBaker). The maps are kept until the next bake
+	bool BakeLighting(const HorizonBakeSettings& settings);
+	const HorizonBaker& GetLightingBake()const { return horizonBaker; }
+
+	// HYDROLOGY FUNCTIONS //
+	// Fill the depressions of the terrain and compute the flow directions and accumulation (see Hydrology).
+	// The layers are kept until the next analysis
+	bool AnalyseHydrology(const HydrologySettings& settings);
+	const Hydrology& GetHydrology()const { return hydrology; }
+	// Replace the heights with the filled heights of the last analysis, so the depressions become lakes.
+	// Returns false if the terrain has not been analysed at its resolution
+	bool FillDepressions();
+
+	// EROSION FUNCTIONS //
+	// Raise the terrain with tectonic uplift while the rivers erode it (see StreamPowerErosion), the border stays.
+	// The solver keeps its buffers for the next erosion
+	bool StreamPowerErode(const StreamPowerSettings& settings);
+	const StreamPowerErosion& GetStreamPowerErosion()const { return streamPowerErosion; }
+
+	// CONSTRAINT FUNCTIONS //
+	// Pin a height at a world position (x, z) of the terrain, or along the polyline through the control points
+	// (in world units). The constraints are kept in points of the grid until ClearHeightConstraints, so they
+	// move if the resolution changes
+	void AddHeightConstraint(float x, float z, float height);
+	void AddHeightCurve(const std::vector<ControlPoint>& curve);
+	void ClearHeightConstraints() { constraintSolver.ClearConstraints(); }
+	// Replace the terrain with the smooth surface through the constraints (see ConstraintSolver).
+	// Returns false if there is no constraint on the terrain
+	bool SolveHeightConstraints(const ConstraintSettings& settings);
+	const ConstraintSolver& GetConstraintSolver()const { return constraintSolver; }
+
+	// HEIGHT MAP STORAGE FUNCTIONS //
+	// Compress the height map into quantized tiles and release the float height map.
+	// It is decompressed again the next time a function needs it
+	void CompressHeightMap();
+	// Restore the float height map from the compressed tiles (if it was compressed)
+	void DecompressHeightMap();
+	// Save the compressed height map to a file
+	bool SaveHeightMap(const char* filename);
+	// Load a compressed height map from a file, resizing the terrain if needed
+	bool LoadHeightMap(const char* filename);
+	// True while the float height map is released and only the compressed tiles are kept
+	bool IsHeightMapCompressed()const { return heightMap.IsEmpty(); }
+	// Height of the point (m, n), and the heights of the rows [firstM, firstM + rows) and columns
+	// [firstN, firstN + columns) into 'heights' (row major, 'columns' wide). While the height map is compressed they
+	// are read through the tile cache of the compressed height map, without decompressing the whole map
+	float GetPointHeight(int m, int n);
+	void ReadHeights(int firstM, int firstN, int rows, int columns, float* heights);
+	// Get the compressed height map (it is empty until the height map is compressed, saved or loaded)
+	const CompressedHeightMap* GetCompressedHeightMap()const { return compressedHeightMap; }
+
 private:
-	//Create the vertex and index buffers that will be passed along to the graphics card for rendering
-	//For CMP305, you don't need to worry so much about how or why yet, but notice the Vertex buffer is DYNAMIC here as we are changing the values often
-	void CreateBuffers( ID3D11Device* device, VertexType* vertices, unsigned long* indices );
-	int GetHeightMapIndex(int m, int n); // return the height map index
-
-	// check if a point is in the map/terrain
-	bool InBounds(int m, int n);
-	// return the height average of the neighbours to that point (inluding that point too)
-	float NeighboursAverage(int m, int n);
+	// CPU phase of Regenerate: fill the staging indices if there is no index buffer
+	void BuildGeometry();
+	// Upload phase of Regenerate: create the missing buffers and upload the vertex rows
+	void UploadBuffers( RenderDevice* device );
+	//Create the vertex buffer that will be passed along to the graphics card for rendering
+	//The vertex buffer is DEFAULT, the vertices are built straight into the upload ring and copied into it by the GPU
+	void CreateBuffers( RenderDevice* device, unsigned int vertexStride );
+	// Build the pending vertex rows into upload ring allocations and copy them to the vertex buffer,
+	// until the rows are done, or the frame budget is used if 'budgeted'
+	void UploadRows( bool budgeted );
+	// Create the static index buffer of the grid from the staging indices
+	void CreateIndexBuffer( RenderDevice* device );
+	// Release the staging arrays, they are kept between uploads so they are not allocated every time
+	void ReleaseStaging();
+	// Decompress the height map if it has been compressed, so it can be read and modified
+	void EnsureHeightMap();
+
 	// return a random position from the map
 	XMFLOAT3 GetRandomPos();
 
-	void SquareStep(int& m_start, int& m_end, int& n_start, int& n_end, int& chunkSize, Range& tmpHeightOffsetRange, int& half);
-	void DiamondStep(int& m_start, int& m_end, int& n_start, int& n_end, int& chunkSize, Range& tmpHeightOffsetRange, int& half);
-
 	const float m_UVscale = 10.0f;			//Tile the UV map 10 times across the plane
 	const float terrainSize = 100.0f;		//What is the width and height of our terrain
-	float* heightMap;
+	// Heights of the grid points and the operations on them (empty while only the compressed copy is kept)
+	HeightMap heightMap;
+	// Upload the vertices as CompactTerrainVertex instead of VertexType
+	bool compactVertices;
+	// Build the index buffer with triangle strips instead of a triangle list
+	bool triangleStrips;
+	// Ranges of the index buffer, each one addressing less than 65535 vertices from its base vertex
+	std::vector<IndexChunk> indexChunks;
+
+	// Indices built on the CPU by BuildGeometry and uploaded by UploadBuffers
+	IndexBufferBuilder stagingIndices;
+	// Vertices of the rows being packed into the compact format
+	std::vector<TerrainVertex> stagingVertices;
+
+	// Ring the vertices are streamed through, and the one created by the terrain if it was not given one
+	UploadRing* uploadRing;
+	UploadRing* ownedUploadRing;
+	// Next vertex row to upload, and the rows left to upload (they wrap around to the first row)
+	int streamRow;
+	int pendingRows;
+
+	// Queries on the height map in world units, returned by GetHeightQuery
+	HeightQuery heightQuery;
+	// Poisson-disk sampler placing the props, it keeps its grid for the next ScatterProps
+	PropScatter propScatter;
+	// CPU renderer of SavePreview, it keeps its height pyramid and image for the next preview
+	TerrainPreview preview;
+	// Ambient occlusion and sun shadow of the last BakeLighting
+	HorizonBaker horizonBaker;
+	// Hydrology layers of the last AnalyseHydrology
+	Hydrology hydrology;
+	// Solver of StreamPowerErode
+	StreamPowerErosion streamPowerErosion;
+	// Sketched constraints and multigrid solver of SolveHeightConstraints
+	ConstraintSolver constraintSolver;
+
+	// Quantized and compressed copy of the height map
+	CompressedHeightMap* compressedHeightMap;
 
 	// Object which will randomly emit particles across the terrain
 	Emitter* emitter;
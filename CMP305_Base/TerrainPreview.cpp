@@ -0,0 +1,580 @@
+#include "TerrainPreview.h"
+#include "PngWriter.h"
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+	const int kTileSize = 32;		// pixels on each side of a tile
+	const float kHeightMargin = 1e-5f;	// rounding of the cell intersection, relative to the highest absolute height
+
+
+	void Normalise(double v[3])
+	{
+		double length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length > 0.0)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	void Cross(const double a[3], const double b[3], double result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Saturate(float value)
+	{
+		return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	}
+
+	unsigned char ToByte(float value)
+	{
+		return (unsigned char)(Saturate(value) * 255.0f + 0.5f);
+	}
+
+	// 1 if a ray is in the upper half of a node along one axis at 't' (past 'middle', or on it and moving up), 0 otherwise.
+	// The border crossings are computed the same way when the ray steps from node to node, so both agree
+	int ChildSide(double origin, double direction, double middle, double t)
+	{
+		if (direction == 0.0)
+		{
+			return origin >= middle ? 1 : 0;
+		}
+		const double tMiddle = (middle - origin) / direction;
+		return direction > 0.0 ? (t >= tMiddle ? 1 : 0) : (t < tMiddle ? 1 : 0);
+	}
+
+	// Lowest and highest point of a height map
+	void HeightRange(const float* heights, size_t count, float& lowest, float& highest)
+	{
+		lowest = heights[0];
+		highest = heights[0];
+		for (size_t i = 1; i < count; i++)
+		{
+			lowest = heights[i] < lowest ? heights[i] : lowest;
+			highest = heights[i] > highest ? heights[i] : highest;
+		}
+	}
+}
+
+TerrainPreview::TerrainPreview()
+{
+	threadCount = 0;
+	skipNodes = true;
+	heights = nullptr;
+	resolution = 0;
+	cells = 0;
+	minHeight = 0.0f;
+	maxHeight = 0.0f;
+	heightMargin = 0.0f;
+	settings = nullptr;
+	for (int k = 0; k < 3; k++)
+	{
+		eye[k] = 0.0;
+		forward[k] = 0.0;
+		right[k] = 0.0;
+		up[k] = 0.0;
+	}
+	width = 0;
+	height = 0;
+}
+
+void TerrainPreview::Release()
+{
+	std::vector<float>().swap(pyramid);
+	std::vector<size_t>().swap(levelOffsets);
+	std::vector<int>().swap(levelSizes);
+	std::vector<TerrainVertex>().swap(vertices);
+	std::vector<unsigned char>().swap(pixels);
+	width = 0;
+	height = 0;
+}
+
+PreviewCamera TerrainPreview::OrbitCamera(const HeightMap& map, float spacing, float yaw, float pitch, float aspect, float fieldOfView)
+{
+	PreviewCamera camera;
+	camera.fieldOfView = fieldOfView;
+	if (map.IsEmpty() || map.GetResolution() < 2)
+	{
+		return camera;
+	}
+
+	float lowest, highest;
+	HeightRange(map.GetData(), (size_t)map.GetResolution() * map.GetResolution(), lowest, highest);
+	const float size = (float)(map.GetResolution() - 1) * spacing;
+	const float halfHeight = (highest - lowest) * 0.5f;
+	const XMFLOAT3 centre(size * 0.5f, lowest + halfHeight, size * 0.5f);
+
+	// Fit the bounding sphere of the terrain in the narrowest of the vertical and horizontal fields of view
+	float radius = sqrtf(size * size * 0.5f + halfHeight * halfHeight);
+	float halfAngle = fieldOfView * 0.5f;
+	float horizontalHalfAngle = atanf(tanf(halfAngle) * aspect);
+	float distance = radius / sinf(horizontalHalfAngle < halfAngle ? horizontalHalfAngle : halfAngle);
+
+	float yawRadians = XMConvertToRadians(yaw);
+	float pitchRadians = XMConvertToRadians(pitch);
+	camera.position = XMFLOAT3(centre.x - distance * cosf(pitchRadians) * sinf(yawRadians),
+		centre.y + distance * sinf(pitchRadians),
+		centre.z - distance * cosf(pitchRadians) * cosf(yawRadians));
+	camera.target = centre;
+	return camera;
+}
+
+void TerrainPreview::Prepare(const HeightMap& map, float spacing)
+{
+	heights = map.GetData();
+	resolution = map.GetResolution();
+	cells = resolution - 1;
+	HeightRange(heights, (size_t)resolution * resolution, minHeight, maxHeight);
+	heightMargin = kHeightMargin * (1.0f + (fabsf(minHeight) > fabsf(maxHeight) ? fabsf(minHeight) : fabsf(maxHeight)));
+
+	// Sizes of the levels, halving (rounding up) down to a single node
+	levelOffsets.clear();
+	levelSizes.clear();
+	size_t total = 0;
+	for (int size = cells; ; size = (size + 1) / 2)
+	{
+		levelOffsets.push_back(total);
+		levelSizes.push_back(size);
+		total += (size_t)size * size;
+		if (size == 1)
+		{
+			break;
+		}
+	}
+	pyramid.resize(total);
+
+	// Level 0: the highest corner of every cell
+	for (int m = 0; m < cells; m++)
+	{
+		const float* row = heights + (size_t)m * resolution;
+		const float* nextRow = row + resolution;
+		float* node = &pyramid[(size_t)m * cells];
+		for (int n = 0; n < cells; n++)
+		{
+			float highest = row[n] > row[n + 1] ? row[n] : row[n + 1];
+			highest = nextRow[n] > highest ? nextRow[n] : highest;
+			node[n] = nextRow[n + 1] > highest ? nextRow[n + 1] : highest;
+		}
+	}
+
+	// Every other level: the highest of the (up to) 2x2 nodes below
+	for (size_t level = 1; level < levelSizes.size(); level++)
+	{
+		const int size = levelSizes[level];
+		const int childSize = levelSizes[level - 1];
+		const float* children = &pyramid[levelOffsets[level - 1]];
+		float* nodes = &pyramid[levelOffsets[level]];
+		for (int m = 0; m < size; m++)
+		{
+			const int childM = m * 2;
+			const int lastChildM = childM + 1 < childSize ? childM + 1 : childM;
+			for (int n = 0; n < size; n++)
+			{
+				const int childN = n * 2;
+				const int lastChildN = childN + 1 < childSize ? childN + 1 : childN;
+				float highest = children[(size_t)childM * childSize + childN];
+				highest = children[(size_t)childM * childSize + lastChildN] > highest ? children[(size_t)childM * childSize + lastChildN] : highest;
+				highest = children[(size_t)lastChildM * childSize + childN] > highest ? children[(size_t)lastChildM * childSize + childN] : highest;
+				highest = children[(size_t)lastChildM * childSize + lastChildN] > highest ? children[(size_t)lastChildM * childSize + lastChildN] : highest;
+				nodes[(size_t)m * size + n] = highest;
+			}
+		}
+	}
+
+	// The normals of the terrain mesh
+	vertices.resize((size_t)resolution * resolution);
+	map.BuildVertices(vertices.data(), spacing, 0.0f);
+}
+
+bool TerrainPreview::Render(const HeightMap& map, float spacing, const PreviewSettings& previewSettings)
+{
+	if (map.IsEmpty() || map.GetResolution() < 2 || spacing <= 0.0f || previewSettings.width <= 0 || previewSettings.height <= 0)
+	{
+		return false;
+	}
+
+	Prepare(map, spacing);
+	settings = &previewSettings;
+	width = settings->width;
+	height = settings->height;
+	pixels.resize((size_t)width * height * 3);
+
+	// Camera basis in world units, then scaled to the grid units the rays are traced in
+	const PreviewCamera& camera = settings->camera;
+	double worldUp[3] = { 0.0, 1.0, 0.0 };
+	forward[0] = camera.target.x - camera.position.x;
+	forward[1] = camera.target.y - camera.position.y;
+	forward[2] = camera.target.z - camera.position.z;
+	Normalise(forward);
+	Cross(worldUp, forward, right);
+	if (right[0] * right[0] + right[1] * right[1] + right[2] * right[2] < 1e-12)
+	{
+		// looking straight up or down
+		right[0] = 1.0;
+		right[1] = 0.0;
+		right[2] = 0.0;
+	}
+	Normalise(right);
+	Cross(forward, right, up);
+
+	const double tanHalf = tan(camera.fieldOfView * 0.5);
+	const double aspect = (double)width / (double)height;
+	const double scale[3] = { 1.0 / spacing, 1.0, 1.0 / spacing };
+	eye[0] = camera.position.x * scale[0];
+	eye[1] = camera.position.y;
+	eye[2] = camera.position.z * scale[2];
+	for (int k = 0; k < 3; k++)
+	{
+		forward[k] *= scale[k];
+		right[k] *= tanHalf * aspect * scale[k];
+		up[k] *= tanHalf * scale[k];
+	}
+
+	// Every thread takes the next tile until there are none left
+	const int tilesX = (width + kTileSize - 1) / kTileSize;
+	const int tilesY = (height + kTileSize - 1) / kTileSize;
+	const int tileCount = tilesX * tilesY;
+	std::atomic<int> nextTile(0);
+	auto renderTiles = [&]()
+	{
+		for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+		{
+			int x = (tile % tilesX) * kTileSize;
+			int y = (tile / tilesX) * kTileSize;
+			RenderTile(x, y, x + kTileSize < width ? x + kTileSize : width, y + kTileSize < height ? y + kTileSize : height);
+		}
+	};
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = threads < tileCount ? threads : tileCount;
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++)
+	{
+		workers.push_back(std::thread(renderTiles));
+	}
+	renderTiles();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	settings = nullptr;
+	return true;
+}
+
+void TerrainPreview::RenderTile(int firstX, int firstY, int lastX, int lastY)
+{
+	for (int y = firstY; y < lastY; y++)
+	{
+		const double v = 1.0 - 2.0 * (y + 0.5) / height;
+		unsigned char* pixel = &pixels[((size_t)y * width + firstX) * 3];
+		for (int x = firstX; x < lastX; x++, pixel += 3)
+		{
+			const double u = 2.0 * (x + 0.5) / width - 1.0;
+			double direction[3];
+			for (int k = 0; k < 3; k++)
+			{
+				direction[k] = forward[k] + u * right[k] + v * up[k];
+			}
+			Normalise(direction);
+
+			Hit hit;
+			XMFLOAT3 colour = Trace(eye, direction, hit) ? Shade(hit) : settings->skyColour;
+			pixel[0] = ToByte(colour.x);
+			pixel[1] = ToByte(colour.y);
+			pixel[2] = ToByte(colour.z);
+		}
+	}
+}
+
+bool TerrainPreview::Trace(const double origin[3], const double direction[3], Hit& hit)const
+{
+	// Clip the ray to the bounding box of the terrain
+	const double boxMin[3] = { 0.0, minHeight, 0.0 };
+	const double boxMax[3] = { (double)cells, maxHeight, (double)cells };
+	double tNear = 0.0;
+	double tFar = DBL_MAX;
+	for (int k = 0; k < 3; k++)
+	{
+		if (fabs(direction[k]) < 1e-12)
+		{
+			if (origin[k] < boxMin[k] || origin[k] > boxMax[k])
+			{
+				return false;
+			}
+			continue;
+		}
+		double t0 = (boxMin[k] - origin[k]) / direction[k];
+		double t1 = (boxMax[k] - origin[k]) / direction[k];
+		if (t0 > t1)
+		{
+			double swap = t0;
+			t0 = t1;
+			t1 = swap;
+		}
+		tNear = t0 > tNear ? t0 : tNear;
+		tFar = t1 < tFar ? t1 : tFar;
+		if (tNear > tFar)
+		{
+			return false;
+		}
+	}
+
+	// Walk the nodes along the ray by their integer coordinates: descend into the nodes the ray may hit, step over the
+	// others to the next node of the same level and climb back up after every step. The nodes are entered and left
+	// exactly at their borders, so every cell the ray passes through is either intersected or inside a skipped node
+	const int top = (int)levelSizes.size() - 1;
+	int level = top;
+	int m = 0;
+	int n = 0;
+	double t = tNear;
+	for (;;)
+	{
+		const double nodeCells = (double)(1 << level);
+		const int nodes = levelSizes[level];
+
+		// Where the ray leaves the node through its x and z sides
+		double tx = DBL_MAX;
+		double tz = DBL_MAX;
+		if (direction[0] != 0.0)
+		{
+			tx = ((direction[0] > 0.0 ? n + 1 : n) * nodeCells - origin[0]) / direction[0];
+		}
+		if (direction[2] != 0.0)
+		{
+			tz = ((direction[2] > 0.0 ? m + 1 : m) * nodeCells - origin[2]) / direction[2];
+		}
+		double tExit = tx < tz ? tx : tz;
+		tExit = tExit < tFar ? tExit : tFar;
+
+		// Lowest point of the ray inside the node, against its highest point plus the rounding of IntersectCell
+		const double lowest = origin[1] + direction[1] * (direction[1] < 0.0 ? tExit : t);
+		const bool above = skipNodes && lowest > pyramid[levelOffsets[level] + (size_t)m * nodes + n] + heightMargin;
+		if (!above)
+		{
+			if (level > 0)
+			{
+				// The child the ray is in at t
+				const double childCells = nodeCells * 0.5;
+				level--;
+				n = n * 2 + ChildSide(origin[0], direction[0], (n * 2 + 1) * childCells, t);
+				m = m * 2 + ChildSide(origin[2], direction[2], (m * 2 + 1) * childCells, t);
+				n = n < levelSizes[level] ? n : levelSizes[level] - 1;
+				m = m < levelSizes[level] ? m : levelSizes[level] - 1;
+				continue;
+			}
+			if (IntersectCell(m, n, origin, direction, tNear, tFar, hit))
+			{
+				return true;
+			}
+		}
+
+		// The next node of this level, through the side the ray leaves by first (both at a corner)
+		if (tExit >= tFar)
+		{
+			return false;
+		}
+		t = tExit;
+		if (tx <= tz)
+		{
+			n += direction[0] > 0.0 ? 1 : -1;
+		}
+		if (tz <= tx)
+		{
+			m += direction[2] > 0.0 ? 1 : -1;
+		}
+		if (n < 0 || n >= nodes || m < 0 || m >= nodes)
+		{
+			return false;
+		}
+		if (skipNodes && level < top)
+		{
+			level++;
+			n >>= 1;
+			m >>= 1;
+		}
+	}
+}
+
+float TerrainPreview::SurfaceHeight(int m, int n, float fx, float fz)const
+{
+	// The triangles of IndexBufferBuilder::addGrid: (m, n), (m + 1, n + 1), (m + 1, n) and (m, n), (m, n + 1), (m + 1, n + 1)
+	const float* row = heights + (size_t)m * resolution + n;
+	const float h00 = row[0];
+	const float h01 = row[1];
+	const float h10 = row[resolution];
+	const float h11 = row[resolution + 1];
+	if (fz >= fx)
+	{
+		return h00 + (h11 - h10) * fx + (h10 - h00) * fz;
+	}
+	return h00 + (h01 - h00) * fx + (h11 - h01) * fz;
+}
+
+bool TerrainPreview::IntersectCell(int m, int n, const double origin[3], const double direction[3], double tNear, double tFar, Hit& hit)const
+{
+	// The part of the ray inside the cell, from the borders of the cell only, so the result does not depend on the
+	// path the traversal took to the cell
+	double t0 = tNear;
+	double t1 = tFar;
+	const int cellMin[3] = { n, 0, m };
+	for (int k = 0; k < 3; k += 2)
+	{
+		if (direction[k] == 0.0)
+		{
+			continue;
+		}
+		double tMin = (cellMin[k] - origin[k]) / direction[k];
+		double tMax = (cellMin[k] + 1 - origin[k]) / direction[k];
+		if (tMin > tMax)
+		{
+			double swap = tMin;
+			tMin = tMax;
+			tMax = swap;
+		}
+		t0 = tMin > t0 ? tMin : t0;
+		t1 = tMax < t1 ? tMax : t1;
+	}
+	if (t0 >= t1)
+	{
+		return false;
+	}
+
+	// The surface under the ray is linear inside each triangle, so split the segment where it crosses the diagonal
+	// and look for the first piece where the ray goes from above to below the surface.
+	// A ray below the surface sees the back of the triangles, which are culled, and the sides of the terrain are open
+	double ends[3] = { t0, t1, t1 };
+	int endCount = 2;
+	const double diagonalRate = direction[0] - direction[2];
+	if (fabs(diagonalRate) > 1e-12)
+	{
+		double tDiagonal = -((origin[0] - n) - (origin[2] - m)) / diagonalRate;
+		if (tDiagonal > t0 && tDiagonal < t1)
+		{
+			ends[1] = tDiagonal;
+			endCount = 3;
+		}
+	}
+
+	// Height of the ray above the surface at 't', and the position inside the cell
+	auto gap = [&](double t, float& fx, float& fz)
+	{
+		fx = Saturate((float)(origin[0] + direction[0] * t - n));
+		fz = Saturate((float)(origin[2] + direction[2] * t - m));
+		return (float)(origin[1] + direction[1] * t) - SurfaceHeight(m, n, fx, fz);
+	};
+
+	float fx, fz;
+	double start = ends[0];
+	float startGap = gap(start, fx, fz);
+	double tHit = start;
+	bool found = false;
+	for (int i = 1; i < endCount && !found; i++)
+	{
+		float endGap = gap(ends[i], fx, fz);
+		if (startGap > 0.0f && endGap <= 0.0f)
+		{
+			tHit = start + (ends[i] - start) * (startGap / (startGap - endGap));
+			found = true;
+		}
+		start = ends[i];
+		startGap = endGap;
+	}
+	if (!found)
+	{
+		return false;
+	}
+
+	gap(tHit, fx, fz);
+	hit.m = m;
+	hit.n = n;
+	hit.fx = fx;
+	hit.fz = fz;
+	hit.height = SurfaceHeight(m, n, fx, fz);
+	return true;
+}
+
+XMFLOAT3 TerrainPreview::Shade(const Hit& hit)const
+{
+	// Interpolate the vertex normals of the triangle as the rasteriser does
+	const TerrainVertex* v00 = &vertices[(size_t)hit.m * resolution + hit.n];
+	const TerrainVertex* v01 = v00 + 1;
+	const TerrainVertex* v10 = v00 + resolution;
+	const TerrainVertex* v11 = v10 + 1;
+	const TerrainVertex* corners[3];
+	float weights[3];
+	if (hit.fz >= hit.fx)
+	{
+		corners[0] = v00; weights[0] = 1.0f - hit.fz;
+		corners[1] = v10; weights[1] = hit.fz - hit.fx;
+		corners[2] = v11; weights[2] = hit.fx;
+	}
+	else
+	{
+		corners[0] = v00; weights[0] = 1.0f - hit.fx;
+		corners[1] = v01; weights[1] = hit.fx - hit.fz;
+		corners[2] = v11; weights[2] = hit.fz;
+	}
+	float x = 0.0f, y = 0.0f, z = 0.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		x += corners[i]->normal.x * weights[i];
+		y += corners[i]->normal.y * weights[i];
+		z += corners[i]->normal.z * weights[i];
+	}
+	float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+
+	// Baked lighting at the hit point, from the same corners
+	float occlusion = 1.0f;
+	float shadow = 1.0f;
+	if (settings->ambientOcclusion || settings->sunShadow)
+	{
+		size_t indices[3];
+		for (int i = 0; i < 3; i++)
+		{
+			indices[i] = (size_t)(corners[i] - vertices.data());
+		}
+		if (settings->ambientOcclusion)
+		{
+			const float* values = settings->ambientOcclusion;
+			occlusion = values[indices[0]] * weights[0] + values[indices[1]] * weights[1] + values[indices[2]] * weights[2];
+		}
+		if (settings->sunShadow)
+		{
+			const float* values = settings->sunShadow;
+			shadow = values[indices[0]] * weights[0] + values[indices[1]] * weights[1] + values[indices[2]] * weights[2];
+		}
+	}
+
+	// light_ps.hlsl: saturate(diffuse * saturate(dot(normal, -lightDirection))) * texture, plus the baked ambient light
+	const XMFLOAT3& light = settings->lightDirection;
+	float intensity = Saturate(-(x * light.x + y * light.y + z * light.z) * invLength) * shadow;
+	const XMFLOAT4& diffuse = settings->diffuseColour;
+	const XMFLOAT4& ambient = settings->ambientColour;
+
+	float heightRange = maxHeight - minHeight;
+	float blend = heightRange > 0.0f ? (hit.height - minHeight) / heightRange : 0.5f;
+	const XMFLOAT3& low = settings->lowColour;
+	const XMFLOAT3& high = settings->highColour;
+	return XMFLOAT3(Saturate(ambient.x * occlusion + diffuse.x * intensity) * (low.x + (high.x - low.x) * blend),
+		Saturate(ambient.y * occlusion + diffuse.y * intensity) * (low.y + (high.y - low.y) * blend),
+		Saturate(ambient.z * occlusion + diffuse.z * intensity) * (low.z + (high.z - low.z) * blend));
+}
+
+bool TerrainPreview::Save(const char* filename)const
+{
+	if (pixels.empty())
+	{
+		return false;
+	}
+	return PngWriter::Write(filename, pixels.data(), width, height, 3);
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "HeightMap.h"
+
+using namespace DirectX;
+
+// Point of view of a preview, in world units of the height map
+struct PreviewCamera
+{
+	PreviewCamera()
+	{
+		position = XMFLOAT3(50.0f, 60.0f, -40.0f);
+		target = XMFLOAT3(50.0f, 0.0f, 50.0f);
+		fieldOfView = XM_PI / 4.0f;
+	}
+
+	XMFLOAT3 position;
+	XMFLOAT3 target;
+	float fieldOfView;	// vertical, in radians (the same as the projection of the application)
+};
+
+// Image size, camera and lighting of a preview
+struct PreviewSettings
+{
+	PreviewSettings()
+	{
+		width = 512;
+		height = 512;
+		lightDirection = XMFLOAT3(1.0f, -1.0f, 0.0f);
+		diffuseColour = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		ambientColour = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		ambientOcclusion = nullptr;
+		sunShadow = nullptr;
+		lowColour = XMFLOAT3(0.33f, 0.45f, 0.2f);
+		highColour = XMFLOAT3(0.85f, 0.82f, 0.75f);
+		skyColour = XMFLOAT3(0.39f, 0.58f, 0.92f);
+	}
+
+	int width;
+	int height;
+	PreviewCamera camera;
+	// The directional light of light_ps.hlsl: saturate(diffuse * saturate(dot(normal, -direction))) * albedo.
+	// The direction is not normalised, as in the shader
+	XMFLOAT3 lightDirection;
+	XMFLOAT4 diffuseColour;
+	// Optional baked lighting (see HorizonBaker), one value per height map point, interpolated like the normals.
+	// With them the light is saturate(ambient * occlusion + diffuse * saturate(dot(normal, -direction)) * shadow) * albedo,
+	// the same as above with the default black ambient and without the maps
+	XMFLOAT4 ambientColour;
+	const float* ambientOcclusion;
+	const float* sunShadow;
+	// There is no texture, the albedo goes from lowColour at the lowest point of the terrain to highColour at the highest
+	XMFLOAT3 lowColour;
+	XMFLOAT3 highColour;
+	// Colour of the pixels that do not see the terrain (the clear colour of the application)
+	XMFLOAT3 skyColour;
+};
+
+// CPU renderer of a height map, to make preview images of terrains without a GPU.
+// It draws the same triangles as TerrainMesh with the smooth vertex normals of HeightMap::BuildVertices.
+// Every pixel casts a ray through a pyramid of maximum heights: level 0 holds the highest corner of every cell
+// and every level above the highest of 2x2 nodes below, so a ray skips a whole node while it stays above its
+// maximum and only the cells it can hit are intersected. The skip is conservative and a cell gives the same hit however
+// the ray reached it, so the image is the same as with every cell intersected. The image is split in tiles rendered on
+// several threads
+class TerrainPreview
+{
+public:
+	TerrainPreview();
+
+	// Threads used to render the tiles, 0 uses one per hardware thread
+	void SetThreadCount(int count) { threadCount = count; }
+	int GetThreadCount()const { return threadCount; }
+	// Skip the nodes of the pyramid the rays pass above (the default). Without it every cell along a ray is intersected,
+	// the reference the skipping is checked against
+	void SetNodeSkipping(bool enabled) { skipNodes = enabled; }
+
+	// Camera looking at the centre of the height map from 'yaw' degrees around the y-axis (0 looks along +z)
+	// and 'pitch' degrees above the horizon, far enough for the whole terrain to fit in the view
+	static PreviewCamera OrbitCamera(const HeightMap& map, float spacing, float yaw, float pitch, float aspect, float fieldOfView = XM_PI / 4.0f);
+
+	// Render the height map, whose points are 'spacing' apart, into GetPixels(). Returns false if there is nothing to render
+	bool Render(const HeightMap& map, float spacing, const PreviewSettings& settings);
+
+	// RGB pixels of the last Render, the rows from the top of the image
+	const std::vector<unsigned char>& GetPixels()const { return pixels; }
+	int GetWidth()const { return width; }
+	int GetHeight()const { return height; }
+	// Save the last Render as a PNG file
+	bool Save(const char* filename)const;
+
+	// Release the memory kept for the next Render
+	void Release();
+
+private:
+	// First point of the terrain along a ray, in grid units (x in columns, y in world units, z in rows)
+	struct Hit
+	{
+		int m, n;		// cell
+		float fx, fz;	// position inside the cell
+		float height;
+	};
+
+	// Build the maximum height pyramid and the vertex normals
+	void Prepare(const HeightMap& map, float spacing);
+	// Render the pixels [firstX, lastX) of the rows [firstY, lastY)
+	void RenderTile(int firstX, int firstY, int lastX, int lastY);
+	// Walk the pyramid from 'origin' along 'direction' (normalised), returns false if the ray misses the terrain
+	bool Trace(const double origin[3], const double direction[3], Hit& hit)const;
+	// Intersect the two triangles of cell (m, n) with the part of the ray inside the cell, between tNear and tFar
+	bool IntersectCell(int m, int n, const double origin[3], const double direction[3], double tNear, double tFar, Hit& hit)const;
+	// Height of the triangle of cell (m, n) under (fx, fz)
+	float SurfaceHeight(int m, int n, float fx, float fz)const;
+	// Colour of the terrain at the hit point
+	XMFLOAT3 Shade(const Hit& hit)const;
+
+	int threadCount;
+	bool skipNodes;
+
+	// Height map of the render in progress
+	const float* heights;
+	int resolution;
+	int cells;	// cells on each side, resolution - 1
+	float minHeight;
+	float maxHeight;
+	float heightMargin;	// added to the nodes before a ray skips them, for the rounding of IntersectCell
+
+	// Levels of the maximum height pyramid one after another, from the cells to a single node
+	std::vector<float> pyramid;
+	std::vector<size_t> levelOffsets;
+	std::vector<int> levelSizes;
+	// Vertices of the height map, only the normals are read
+	std::vector<TerrainVertex> vertices;
+
+	// Settings and camera of the render in progress, the camera in grid units
+	const PreviewSettings* settings;
+	double eye[3];
+	double forward[3];
+	double right[3];
+	double up[3];
+
+	std::vector<unsigned char> pixels;
+	int width;
+	int height;
+};
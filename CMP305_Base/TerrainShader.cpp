@@ -0,0 +1,162 @@
+#include "TerrainShader.h"
+
+TerrainShader::TerrainShader(RenderDevice* device, HWND hwnd) : BaseShader(device, hwnd)
+{
+	grid.resolution = 0.0f;
+	grid.scale = 0.0f;
+	grid.uvIncrement = 0.0f;
+	grid.baseVertex = 0;
+	initShader(L"terrain_vs.cso", L"light_ps.cso");
+}
+
+
+TerrainShader::~TerrainShader()
+{
+	// Release the sampler state.
+	if (sampleState)
+	{
+		renderer->releaseSampler(sampleState);
+		sampleState = 0;
+	}
+
+	// Release the matrix constant buffer.
+	if (matrixBuffer)
+	{
+		renderer->releaseBuffer(matrixBuffer);
+		matrixBuffer = 0;
+	}
+
+	// Release the layout.
+	if (layout)
+	{
+		renderer->releaseInputLayout(layout);
+		layout = 0;
+	}
+
+	// Release the light constant buffer.
+	if (lightBuffer)
+	{
+		renderer->releaseBuffer(lightBuffer);
+		lightBuffer = 0;
+	}
+
+	// Release the terrain constant buffer.
+	if (terrainBuffer)
+	{
+		renderer->releaseBuffer(terrainBuffer);
+		terrainBuffer = 0;
+	}
+
+	//Release base shader components
+	BaseShader::~BaseShader();
+}
+
+void TerrainShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilename)
+{
+	D3D11_BUFFER_DESC matrixBufferDesc;
+	D3D11_SAMPLER_DESC samplerDesc;
+	D3D11_BUFFER_DESC lightBufferDesc;
+	D3D11_BUFFER_DESC terrainBufferDesc;
+
+	// This layout needs to match the CompactTerrainVertex structure and terrain_vs.
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+
+	// Load (+ compile) shader files
+	loadVertexShader(vsFilename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
+	loadPixelShader(psFilename);
+
+	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
+	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
+	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	matrixBufferDesc.MiscFlags = 0;
+	matrixBufferDesc.StructureByteStride = 0;
+	matrixBuffer = renderer->createBuffer(matrixBufferDesc, NULL);
+
+	// Setup the description of the terrain grid constant buffer that is in the vertex shader.
+	terrainBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	terrainBufferDesc.ByteWidth = sizeof(TerrainBufferType);
+	terrainBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	terrainBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	terrainBufferDesc.MiscFlags = 0;
+	terrainBufferDesc.StructureByteStride = 0;
+	terrainBuffer = renderer->createBuffer(terrainBufferDesc, NULL);
+
+	// Create a texture sampler state description.
+	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.MipLODBias = 0.0f;
+	samplerDesc.MaxAnisotropy = 1;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+	samplerDesc.MinLOD = 0;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	sampleState = renderer->createSampler(samplerDesc);
+
+	// Setup the description of the light dynamic constant buffer that is in the pixel shader.
+	lightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	lightBufferDesc.ByteWidth = sizeof(LightBufferType);
+	lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	lightBufferDesc.MiscFlags = 0;
+	lightBufferDesc.StructureByteStride = 0;
+	lightBuffer = renderer->createBuffer(lightBufferDesc, NULL);
+}
+
+
+void TerrainShader::setShaderParameters(RenderDevice* device, const XMMATRIX &worldMatrix, const XMMATRIX &viewMatrix, const XMMATRIX &projectionMatrix, GpuTexture* texture, Light* light, int resolution, float scale, float uvIncrement)
+{
+	MatrixBufferType* dataPtr;
+
+	// Transpose the matrices to prepare them for the shader.
+	XMMATRIX tworld = XMMatrixTranspose(worldMatrix);
+	XMMATRIX tview = XMMatrixTranspose(viewMatrix);
+	XMMATRIX tproj = XMMatrixTranspose(projectionMatrix);
+	dataPtr = (MatrixBufferType*)device->mapBuffer(matrixBuffer);
+	dataPtr->world = tworld;
+	dataPtr->view = tview;
+	dataPtr->projection = tproj;
+	device->unmapBuffer(matrixBuffer);
+	device->setConstantBuffer(kVertexShader, 0, matrixBuffer);
+
+	// Send the grid layout to the vertex shader, the first chunk starts at vertex 0
+	grid.resolution = (float)resolution;
+	grid.scale = scale;
+	grid.uvIncrement = uvIncrement;
+	sendTerrainBuffer(device, 0);
+
+	// Send light data to pixel shader
+	LightBufferType* lightPtr;
+	lightPtr = (LightBufferType*)device->mapBuffer(lightBuffer);
+	lightPtr->diffuse = light->getDiffuseColour();
+	lightPtr->direction = light->getDirection();
+	lightPtr->padding = 0.0f;
+	device->unmapBuffer(lightBuffer);
+	device->setConstantBuffer(kPixelShader, 0, lightBuffer);
+
+	// Set shader texture resource in the pixel shader.
+	device->setTexture(kPixelShader, 0, texture);
+	device->setSampler(kPixelShader, 0, sampleState);
+}
+
+void TerrainShader::render(RenderDevice* device, int indexCount, int startIndex, int baseVertex)
+{
+	// the chunk indices are relative to its base vertex, terrain_vs adds it back to find the grid position
+	sendTerrainBuffer(device, baseVertex);
+	BaseShader::render(device, indexCount, startIndex, baseVertex);
+}
+
+void TerrainShader::sendTerrainBuffer(RenderDevice* device, int baseVertex)
+{
+	TerrainBufferType* terrainPtr;
+	terrainPtr = (TerrainBufferType*)device->mapBuffer(terrainBuffer);
+	*terrainPtr = grid;
+	terrainPtr->baseVertex = (unsigned int)baseVertex;
+	device->unmapBuffer(terrainBuffer);
+	device->setConstantBuffer(kVertexShader, 1, terrainBuffer);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "DXF.h"
+
+using namespace std;
+using namespace DirectX;
+
+// Light shader for the compact terrain vertex format (see TerrainVertexPacking.h).
+// Uses terrain_vs to rebuild the grid position/UVs and the same pixel shader as LightShader
+class TerrainShader : public BaseShader
+{
+private:
+	struct LightBufferType
+	{
+		XMFLOAT4 diffuse;
+		XMFLOAT3 direction;
+		float padding;
+	};
+
+	struct TerrainBufferType
+	{
+		float resolution;
+		float scale;
+		float uvIncrement;
+		unsigned int baseVertex;
+	};
+
+public:
+	TerrainShader(RenderDevice* device, HWND hwnd);
+	~TerrainShader();
+
+	void setShaderParameters(RenderDevice* device, const XMMATRIX &world, const XMMATRIX &view, const XMMATRIX &projection, GpuTexture* texture, Light* light, int resolution, float scale, float uvIncrement);
+
+	using BaseShader::render;
+	// Draw an index buffer chunk. SV_VertexID does not include the base vertex of the draw, so it is sent to terrain_vs
+	// with the grid layout before every chunk
+	void render(RenderDevice* device, int indexCount, int startIndex, int baseVertex) override;
+
+private:
+	void initShader(const wchar_t* cs, const wchar_t* ps);
+	// Send the grid layout and the base vertex of the next draw to the vertex shader
+	void sendTerrainBuffer(RenderDevice* device, int baseVertex);
+
+private:
+	GpuBuffer* matrixBuffer;
+	GpuSampler* sampleState;
+	GpuBuffer* lightBuffer;
+	GpuBuffer* terrainBuffer;
+	// Grid layout of the last setShaderParameters
+	TerrainBufferType grid;
+};
@@ -0,0 +1,158 @@
+#include "TerrainVertexPacking.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define TERRAIN_PACKING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float kSnormScale = 32767.0f;
+
+	inline const XMFLOAT3& NormalAt(const XMFLOAT3* normals, int normalStride, int i)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(normals) + (size_t)i * normalStride);
+	}
+
+	inline float SignNotZero(float v)
+	{
+		return v < 0.0f ? -1.0f : 1.0f;
+	}
+
+#ifdef TERRAIN_PACKING_SSE2
+	// Encode four normals, returning the (x, z) int16 pairs packed in four 32 bit lanes
+	inline __m128i EncodeFour(const XMFLOAT3* normals, int normalStride, int first)
+	{
+		const XMFLOAT3& n0 = NormalAt(normals, normalStride, first);
+		const XMFLOAT3& n1 = NormalAt(normals, normalStride, first + 1);
+		const XMFLOAT3& n2 = NormalAt(normals, normalStride, first + 2);
+		const XMFLOAT3& n3 = NormalAt(normals, normalStride, first + 3);
+
+		// transpose to structure of arrays
+		__m128 x = _mm_set_ps(n3.x, n2.x, n1.x, n0.x);
+		__m128 y = _mm_set_ps(n3.y, n2.y, n1.y, n0.y);
+		__m128 z = _mm_set_ps(n3.z, n2.z, n1.z, n0.z);
+
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		// project onto the octahedron |x| + |y| + |z| = 1
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+		__m128 inv = _mm_div_ps(one, _mm_max_ps(sum, _mm_set1_ps(1e-20f)));
+		x = _mm_mul_ps(x, inv);
+		z = _mm_mul_ps(z, inv);
+
+		// fold the lower hemisphere (y < 0) over the diagonals
+		__m128 foldX = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, z)), _mm_and_ps(x, signMask));
+		__m128 foldZ = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_and_ps(z, signMask));
+		__m128 lower = _mm_cmplt_ps(y, _mm_setzero_ps());
+		x = _mm_or_ps(_mm_and_ps(lower, foldX), _mm_andnot_ps(lower, x));
+		z = _mm_or_ps(_mm_and_ps(lower, foldZ), _mm_andnot_ps(lower, z));
+
+		// convert to snorm16 and interleave x0 z0 x1 z1 ...
+		const __m128 scale = _mm_set1_ps(kSnormScale);
+		__m128i xi = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+		__m128i zi = _mm_cvtps_epi32(_mm_mul_ps(z, scale));
+		return _mm_unpacklo_epi16(_mm_packs_epi32(xi, xi), _mm_packs_epi32(zi, zi));
+	}
+#endif
+}
+
+void TerrainVertexPacking::EncodeNormal(const XMFLOAT3& normal, int16_t out[2])
+{
+	float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (sum < 1e-20f)
+	{
+		sum = 1e-20f;
+	}
+	float inv = 1.0f / sum;
+	float x = normal.x * inv;
+	float z = normal.z * inv;
+
+	if (normal.y < 0.0f)
+	{
+		float foldX = (1.0f - fabsf(z)) * SignNotZero(x);
+		float foldZ = (1.0f - fabsf(x)) * SignNotZero(z);
+		x = foldX;
+		z = foldZ;
+	}
+
+	// round to nearest (even), the same as the SSE2 conversion
+	out[0] = (int16_t)lrintf(x * kSnormScale);
+	out[1] = (int16_t)lrintf(z * kSnormScale);
+}
+
+XMFLOAT3 TerrainVertexPacking::DecodeNormal(const int16_t in[2])
+{
+	float x = fmaxf(in[0] / kSnormScale, -1.0f);
+	float z = fmaxf(in[1] / kSnormScale, -1.0f);
+	float y = 1.0f - fabsf(x) - fabsf(z);
+
+	if (y < 0.0f)
+	{
+		float unfoldX = (1.0f - fabsf(z)) * SignNotZero(x);
+		float unfoldZ = (1.0f - fabsf(x)) * SignNotZero(z);
+		x = unfoldX;
+		z = unfoldZ;
+	}
+
+	float length = sqrtf(x * x + y * y + z * z);
+	return XMFLOAT3(x / length, y / length, z / length);
+}
+
+void TerrainVertexPacking::EncodeNormals(const XMFLOAT3* normals, int normalStride, int count, int16_t* out)
+{
+	int i = 0;
+
+#ifdef TERRAIN_PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), EncodeFour(normals, normalStride, i));
+	}
+#endif
+
+	// remaining normals
+	for (; i < count; i++)
+	{
+		EncodeNormal(NormalAt(normals, normalStride, i), out + i * 2);
+	}
+}
+
+void TerrainVertexPacking::PackVertices(const float* heights, const XMFLOAT3* normals, int normalStride, int count, CompactTerrainVertex* out)
+{
+	int i = 0;
+
+#ifdef TERRAIN_PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		// one vertex is {height, normal.xz}, so interleave the heights with the packed normals
+		__m128i packedNormals = EncodeFour(normals, normalStride, i);
+		__m128i packedHeights = _mm_castps_si128(_mm_loadu_ps(heights + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi32(packedHeights, packedNormals));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 2), _mm_unpackhi_epi32(packedHeights, packedNormals));
+	}
+#endif
+
+	// remaining vertices
+	for (; i < count; i++)
+	{
+		out[i].height = heights[i];
+		EncodeNormal(NormalAt(normals, normalStride, i), out[i].normal);
+	}
+}
+
+TerrainVertex TerrainVertexPacking::UnpackVertex(const CompactTerrainVertex& vertex, int vertexIndex, int resolution, float spacing, float uvIncrement)
+{
+	// position in the grid (i along x-axis, j along z-axis)
+	float i = (float)(vertexIndex % resolution);
+	float j = (float)(vertexIndex / resolution);
+
+	TerrainVertex result;
+	result.position = XMFLOAT3(i * spacing, vertex.height, j * spacing);
+	result.texture = XMFLOAT2(i * uvIncrement, j * uvIncrement);
+	result.normal = DecodeNormal(vertex.normal);
+	return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <DirectXMath.h>
+#include "HeightMap.h"
+
+using namespace DirectX;
+
+// Compact vertex for the terrain grid (8 bytes instead of the 32 bytes of BaseMesh::VertexType).
+// The x, z position and the UVs are implied by the vertex index in the grid and rebuilt in terrain_vs.hlsl,
+// so only the height and an octahedral encoded normal are stored.
+struct CompactTerrainVertex
+{
+	float height;
+	int16_t normal[2]; // octahedral encoded normal (x, z) as R16G16_SNORM
+};
+
+class TerrainVertexPacking
+{
+public:
+	// Encode a unit normal with the octahedral mapping around the y-axis (the terrain "up").
+	// The result are the folded (x, z) coordinates as signed 16 bit normalised values
+	static void EncodeNormal(const XMFLOAT3& normal, int16_t out[2]);
+	// Decode a normal encoded with EncodeNormal (the inverse, as done by terrain_vs.hlsl)
+	static XMFLOAT3 DecodeNormal(const int16_t in[2]);
+
+	// Encode 'count' normals. The normals are read every 'normalStride' bytes so they can be taken
+	// straight from an interleaved vertex array. Four normals are encoded at a time with SSE2
+	static void EncodeNormals(const XMFLOAT3* normals, int normalStride, int count, int16_t* out);
+
+	// Fill 'count' compact vertices from the height map and the (strided) vertex normals
+	static void PackVertices(const float* heights, const XMFLOAT3* normals, int normalStride, int count, CompactTerrainVertex* out);
+	// Rebuild the full vertex 'vertexIndex' of a grid of resolution * resolution vertices from its compact vertex,
+	// the same way as terrain_vs: the position and UVs come from the index, the normal is decoded
+	static TerrainVertex UnpackVertex(const CompactTerrainVertex& vertex, int vertexIndex, int resolution, float spacing, float uvIncrement);
+};
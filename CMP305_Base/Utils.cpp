@@ -1,15 +1,6 @@
 #include "Utils.h"
 
-#include <cstdlib>
-#include <ctime>
-
-#include <iostream>
 #include <random>
-#include <iomanip>
-
-using std::cout;
-using std::endl;
-using std::setprecision;
 
 
 float Utils::GetRandom(Range range)
@@ -20,7 +11,6 @@ float Utils::GetRandom(Range range)
 float Utils::GetRandom(float from, float to)
 {
 	float min, max;
-	float randomNum;
 
 	if (from < to)
 	{
@@ -33,14 +23,11 @@ float Utils::GetRandom(float from, float to)
 		max = from;
 	}
 
-	std::random_device rd;
-	std::default_random_engine eng(rd());
+	// Seeding an engine from std::random_device costs far more than drawing a number,
+	// so every thread seeds its own engine once. The engines are per thread so the
+	// height map operations can draw numbers from several threads
+	static thread_local std::default_random_engine eng(std::random_device{}());
 	std::uniform_real_distribution<float> distr(min, max);
 
-	randomNum = distr(eng);
-	cout << "Random Num:" << randomNum << "\n";
-
-	return randomNum;
+	return distr(eng);
 }
-
-
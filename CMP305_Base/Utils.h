@@ -1,5 +1,4 @@
 #pragma once
-#include <d3d11.h>
 #include <DirectXMath.h>
 
 using namespace DirectX;
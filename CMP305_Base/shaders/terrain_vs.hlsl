@@ -0,0 +1,67 @@
+// Terrain vertex shader
+// Variant of light_vs for the compact terrain vertex (height + octahedral normal).
+// The x, z position and texture coordinates are rebuilt from the vertex index in the grid.
+cbuffer MatrixBuffer : register(b0)
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+};
+
+cbuffer TerrainBuffer : register(b1)
+{
+	float resolution;	// number of vertices along x-axis and z-axis
+	float scale;		// distance between two vertices
+	float uvIncrement;	// texture coordinate step between two vertices
+	uint baseVertex;	// base vertex of the index chunk being drawn, SV_VertexID does not include it
+};
+
+struct InputType
+{
+	float height : POSITION;
+	float2 normal : NORMAL;	// octahedral encoded (x, z), y is the up axis
+};
+
+struct OutputType
+{
+	float4 position : SV_POSITION;
+	float2 tex : TEXCOORD0;
+	float3 normal : NORMAL;
+};
+
+// Inverse of the octahedral mapping done by TerrainVertexPacking::EncodeNormal
+float3 decodeNormal(float2 encoded)
+{
+	float3 normal = float3(encoded.x, 1.0f - abs(encoded.x) - abs(encoded.y), encoded.y);
+	if (normal.y < 0.0f)
+	{
+		float2 signNotZero = float2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		normal.xz = (1.0f - abs(encoded.yx)) * signNotZero;
+	}
+	return normalize(normal);
+}
+
+OutputType main(InputType input, uint vertexID : SV_VertexID)
+{
+	OutputType output;
+
+	// Position in the grid (i along x-axis, j along z-axis)
+	uint res = (uint)resolution;
+	uint index = vertexID + baseVertex;
+	float i = (float)(index % res);
+	float j = (float)(index / res);
+
+	// Calculate the position of the vertex against the world, view, and projection matrices.
+	output.position = mul(float4(i * scale, input.height, j * scale, 1.0f), worldMatrix);
+	output.position = mul(output.position, viewMatrix);
+	output.position = mul(output.position, projectionMatrix);
+
+	// Store the texture coordinates for the pixel shader.
+	output.tex = float2(i, j) * uvIncrement;
+
+	// Calculate the normal vector against the world matrix only and normalise.
+	output.normal = mul(decodeNormal(input.normal), (float3x3)worldMatrix);
+	output.normal = normalize(output.normal);
+
+	return output;
+}
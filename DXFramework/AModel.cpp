@@ -1,8 +1,45 @@
 #include "AModel.h"
+#include "BaseShader.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const unsigned int AModel::importFlags =
+	aiProcess_CalcTangentSpace |
+	aiProcess_Triangulate |
+	aiProcess_JoinIdenticalVertices |
+	aiProcess_SortByPType |
+	aiProcess_MakeLeftHanded |
+	aiProcess_FlipUVs;
+
+namespace
+{
+	// Bump when the processing below changes, so old caches are rebuilt
+	const uint32_t cacheLayoutVersion = 2;
+
+	// Sections of an AModel cache file
+	enum CacheSection
+	{
+		CacheStats,
+		CacheSubMeshes,
+		CacheVertices,
+		CacheIndices,
+		CacheSectionCount
+	};
+}
+
+AModel::AModel(RenderDevice* device, const std::string& file)
+{
+	renderer = device;
+	fromCache = false;
+	importModel(file);
+	initBuffers(device);
+}
 
-AModel::AModel(ID3D11Device* ldevice, const std::string& file)
+AModel::AModel(const std::string& file)
 {
-	device = ldevice;
+	fromCache = false;
 	importModel(file);
 }
 
@@ -11,25 +48,74 @@ AModel::~AModel()
 
 }
 
-void AModel::initBuffers(ID3D11Device* device)
+void AModel::initBuffers(RenderDevice* device)
 {
-	
+	// Set up the description of the static vertex buffer.
+	D3D11_BUFFER_DESC vertexBufferDesc;
+	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vertexBufferDesc.ByteWidth = sizeof(VertexType)* (int)vertices.size();
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.MiscFlags = 0;
+	vertexBufferDesc.StructureByteStride = 0;
+	// Now create the vertex buffer.
+	vertexBuffer = device->createBuffer(vertexBufferDesc, vertices.data());
+
+	// Build the index buffer, one chunk per submesh. It uses 16 bit indices when every submesh has less than 65535 vertices
+	IndexBufferBuilder builder;
+	for (size_t m = 0; m < subMeshes.size(); m++)
+	{
+		const SubMesh& subMesh = subMeshes[m];
+		const uint32_t* meshIndices = indices.data() + subMesh.indexStart;
+
+		builder.beginChunk(subMesh.baseVertex, subMesh.vertexCount);
+		for (unsigned int i = 0; i < subMesh.indexCount; i += 3)
+		{
+			builder.addTriangle(subMesh.baseVertex + meshIndices[i], subMesh.baseVertex + meshIndices[i + 1], subMesh.baseVertex + meshIndices[i + 2]);
+		}
+	}
+	indexFormat = builder.getFormat();
+	// Create the index buffer.
+	builder.createBuffer(device, &indexBuffer);
+
+	vertexCount = (int)vertices.size();
+	indexCount = (int)indices.size();
+}
+
+void AModel::render(RenderDevice* device, BaseShader* shader)
+{
+	sendData(device);
+	for (size_t m = 0; m < subMeshes.size(); m++)
+	{
+		const SubMesh& subMesh = subMeshes[m];
+		shader->render(device, (int)subMesh.indexCount, (int)subMesh.indexStart, subMesh.baseVertex);
+	}
 }
 
 void AModel::importModel(const std::string& pFile)
 {
+	PROFILE_FUNCTION();
+	// The cache key covers the file contents, the import flags and the layout of the cached data
+	const std::string cacheFile = pFile + ".meshcache";
+	uint64_t key = 0;
+	bool hashed = MeshCache::hashFile(pFile.c_str(), key);
+	if (hashed)
+	{
+		const uint32_t settings[4] = { importFlags, cacheLayoutVersion, (uint32_t)sizeof(VertexType), (uint32_t)sizeof(SubMesh) };
+		key = MeshCache::hash(settings, sizeof(settings), key);
+		if (loadCache(cacheFile, key))
+		{
+			fromCache = true;
+			return;
+		}
+	}
+
 	// Create an instance of the Importer class
 	Assimp::Importer importer;
 	// And have it read the given file with some example postprocessing
 	// Usually - if speed is not the most important aspect for you - you'll
 	// probably to request more postprocessing than we do in this example.
-	const aiScene* scene = importer.ReadFile(pFile,
-		aiProcess_CalcTangentSpace |
-		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_SortByPType|
-		aiProcess_MakeLeftHanded|
-		aiProcess_FlipUVs);
+	const aiScene* scene = importer.ReadFile(pFile, importFlags);
 	// If the import failed, report it
 	/*if (!scene)
 	{
@@ -39,52 +125,77 @@ void AModel::importModel(const std::string& pFile)
 	// Now we can access the file's contents.
 	//modelProcessing(scene);#
 
-	if (scene)
+	if (!scene)
 	{
-		processNode(scene->mRootNode, scene);
+		return;
 	}
+	processNode(scene->mRootNode, scene, aiMatrix4x4());
 
-	// Set up the description of the static vertex buffer.
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType)* (int)vertices.size();
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices.data();
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* (int)indices.size();
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices.data();
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	// Group the draws by material and move the index ranges into the sorted order
+	std::stable_sort(subMeshes.begin(), subMeshes.end(), [](const SubMesh& a, const SubMesh& b) { return a.material < b.material; });
+	std::vector<uint32_t> sortedIndices;
+	sortedIndices.reserve(indices.size());
+	for (size_t m = 0; m < subMeshes.size(); m++)
+	{
+		SubMesh& subMesh = subMeshes[m];
+		const uint32_t* meshIndices = indices.data() + subMesh.indexStart;
+		subMesh.indexStart = (unsigned int)sortedIndices.size();
+		sortedIndices.insert(sortedIndices.end(), meshIndices, meshIndices + subMesh.indexCount);
+	}
+	indices.swap(sortedIndices);
 
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	//delete vertices;
-	//vertices = 0;
+	if (hashed)
+	{
+		writeCache(cacheFile, key);
+	}
+}
 
-	//delete indices;
-	//indices = 0;
-	vertexCount = (int)vertices.size();
-	indexCount = (int)indices.size();
+bool AModel::loadCache(const std::string& cacheFile, uint64_t key)
+{
+	MeshCache cache;
+	if (!cache.open(cacheFile.c_str(), key) || cache.getSectionCount() != CacheSectionCount ||
+		cache.getSectionSize(CacheStats) != sizeof(MeshOptimizerStats) ||
+		cache.getSectionSize(CacheSubMeshes) % sizeof(SubMesh) != 0 ||
+		cache.getSectionSize(CacheVertices) % sizeof(VertexType) != 0 ||
+		cache.getSectionSize(CacheIndices) % sizeof(uint32_t) != 0)
+	{
+		return false;
+	}
+
+	const SubMesh* cachedSubMeshes = static_cast<const SubMesh*>(cache.getSection(CacheSubMeshes));
+	const VertexType* cachedVertices = static_cast<const VertexType*>(cache.getSection(CacheVertices));
+	const uint32_t* cachedIndices = static_cast<const uint32_t*>(cache.getSection(CacheIndices));
+	memcpy(&optimizerStats, cache.getSection(CacheStats), sizeof(MeshOptimizerStats));
+	subMeshes.assign(cachedSubMeshes, cachedSubMeshes + cache.getSectionSize(CacheSubMeshes) / sizeof(SubMesh));
+	vertices.assign(cachedVertices, cachedVertices + cache.getSectionSize(CacheVertices) / sizeof(VertexType));
+	indices.assign(cachedIndices, cachedIndices + cache.getSectionSize(CacheIndices) / sizeof(uint32_t));
+
+	// Reject submesh ranges outside the buffers rather than drawing garbage
+	for (size_t m = 0; m < subMeshes.size(); m++)
+	{
+		const SubMesh& subMesh = subMeshes[m];
+		if ((size_t)subMesh.indexStart + subMesh.indexCount > indices.size() || subMesh.baseVertex < 0 ||
+			(size_t)subMesh.baseVertex + subMesh.vertexCount > vertices.size())
+		{
+			subMeshes.clear();
+			vertices.clear();
+			indices.clear();
+			optimizerStats = MeshOptimizerStats();
+			return false;
+		}
+	}
+	return true;
+}
 
-	//vertices.clear();
-	//indices.clear();
+void AModel::writeCache(const std::string& cacheFile, uint64_t key)
+{
+	std::vector<MeshCache::Section> sections(CacheSectionCount);
+	sections[CacheStats] = { &optimizerStats, sizeof(MeshOptimizerStats) };
+	sections[CacheSubMeshes] = { subMeshes.data(), subMeshes.size() * sizeof(SubMesh) };
+	sections[CacheVertices] = { vertices.data(), vertices.size() * sizeof(VertexType) };
+	sections[CacheIndices] = { indices.data(), indices.size() * sizeof(uint32_t) };
+	// A cache that cannot be written (e.g. read only folder) only means the next load imports again
+	MeshCache::write(cacheFile.c_str(), key, sections);
 }
 
 void AModel::modelProcessing(const aiScene* scene)
@@ -189,21 +300,24 @@ void AModel::processScene(const aiScene* scene)
 {
 
 }
-void AModel::processNode(const aiNode* node, const aiScene* scene)
+void AModel::processNode(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform)
 {
+	// Node transforms are relative to the parent node
+	aiMatrix4x4 transform = parentTransform * node->mTransformation;
+
 	for (UINT i = 0; i < node->mNumMeshes; i++)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 		//meshes.push_back(this->processMesh(mesh, scene));
-		processMesh(mesh, scene);
+		processMesh(mesh, scene, transform);
 	}
 
 	for (UINT i = 0; i < node->mNumChildren; i++)
 	{
-		this->processNode(node->mChildren[i], scene);
+		this->processNode(node->mChildren[i], scene, transform);
 	}
 }
-void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
+void AModel::processMesh(const aiMesh* mesh, const aiScene* scene, const aiMatrix4x4& transform)
 {
 	/*for (UINT i = 0; i < mesh->mNumVertices; i++)
 	{
@@ -232,15 +346,24 @@ void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 
 	//---------------------------------
 
+	std::vector<VertexType> meshVertices;
+	std::vector<uint32_t> meshIndices;
+	meshVertices.reserve(mesh->mNumVertices);
+
+	// The node transform is baked into the vertices, normals go through its inverse transpose
+	aiMatrix3x3 normalTransform(transform);
+	normalTransform.Inverse().Transpose();
+
 	for (UINT i = 0; i < mesh->mNumVertices; i++)
 	{
 		XMFLOAT3 vert;
-		XMFLOAT2 text;
-		XMFLOAT3 norm;
+		XMFLOAT2 text(0.0f, 0.0f);
+		XMFLOAT3 norm(0.0f, 0.0f, 0.0f);
 
-		vert.x = mesh->mVertices[i].x;
-		vert.y = mesh->mVertices[i].y;
-		vert.z = mesh->mVertices[i].z;
+		aiVector3D position = transform * mesh->mVertices[i];
+		vert.x = position.x;
+		vert.y = position.y;
+		vert.z = position.z;
 
 		if (mesh->HasTextureCoords(0))
 		{
@@ -250,16 +373,18 @@ void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 
 		if (mesh->HasNormals())
 		{
-			norm.x = mesh->mNormals[i].x;
-			norm.y = mesh->mNormals[i].y;
-			norm.z = mesh->mNormals[i].z;
+			aiVector3D normal = normalTransform * mesh->mNormals[i];
+			normal.Normalize();
+			norm.x = normal.x;
+			norm.y = normal.y;
+			norm.z = normal.z;
 		}
 
 		VertexType vertex;
 		vertex.position = vert;
 		vertex.texture = text;
 		vertex.normal = norm;
-		vertices.push_back(vertex);
+		meshVertices.push_back(vertex);
 	}
 
 	for (UINT i = 0; i < mesh->mNumFaces; i++)
@@ -267,8 +392,47 @@ void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 		aiFace face = mesh->mFaces[i];
 
 		for (UINT j = 0; j < face.mNumIndices; j++)
-			indices.push_back(face.mIndices[j]);
+			meshIndices.push_back(face.mIndices[j]);
 	}
+
+	// The faces are in file order, weld the duplicated vertices and reorder for the vertex caches
+	MeshOptimizerStats stats = MeshOptimizer::optimize(meshVertices, meshIndices);
+	float totalTriangles = (float)(optimizerStats.indexCount + stats.indexCount) / 3.0f;
+	if (totalTriangles > 0.0f)
+	{
+		// ACMR of the whole model, weighted by the triangles of each submesh
+		optimizerStats.acmrBefore = (optimizerStats.acmrBefore * optimizerStats.indexCount + stats.acmrBefore * stats.indexCount) / (totalTriangles * 3.0f);
+		optimizerStats.acmrAfter = (optimizerStats.acmrAfter * optimizerStats.indexCount + stats.acmrAfter * stats.indexCount) / (totalTriangles * 3.0f);
+	}
+	optimizerStats.verticesBefore += stats.verticesBefore;
+	optimizerStats.verticesAfter += stats.verticesAfter;
+	optimizerStats.indexCount += stats.indexCount;
+
+	SubMesh subMesh;
+	subMesh.indexStart = (unsigned int)indices.size();
+	subMesh.indexCount = (unsigned int)meshIndices.size();
+	subMesh.baseVertex = (int)vertices.size();
+	subMesh.vertexCount = (unsigned int)meshVertices.size();
+	subMesh.material = mesh->mMaterialIndex;
+
+	subMesh.boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	subMesh.boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i < meshVertices.size(); i++)
+	{
+		const XMFLOAT3& p = meshVertices[i].position;
+		if (i == 0)
+		{
+			subMesh.boundsMin = p;
+			subMesh.boundsMax = p;
+		}
+		subMesh.boundsMin = XMFLOAT3(fminf(subMesh.boundsMin.x, p.x), fminf(subMesh.boundsMin.y, p.y), fminf(subMesh.boundsMin.z, p.z));
+		subMesh.boundsMax = XMFLOAT3(fmaxf(subMesh.boundsMax.x, p.x), fmaxf(subMesh.boundsMax.y, p.y), fmaxf(subMesh.boundsMax.z, p.z));
+	}
+	subMeshes.push_back(subMesh);
+
+	// Merge into the model buffers, the indices stay relative to the base vertex
+	vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+	indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
 }
 
 //vector<Texture> ModelLoader::loadMaterialTextures(aiMaterial * mat, aiTextureType type, string typeName, const aiScene * scene)
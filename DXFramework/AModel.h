@@ -4,6 +4,10 @@
 * \brief Improved model loader, using the assimp library
 *
 * Inherits from Base Mesh, read a provided file and builds a mesh from the file data.
+* Every aiMesh of the scene becomes a submesh of a single merged vertex/index buffer, with its node transform applied to
+* its vertices. The indices of a submesh are relative to its base vertex, so each submesh is drawn with
+* shader->render(device, indexCount, indexStart, baseVertex): use render(device, shader) rather than a single draw of
+* getIndexCount() indices, which is only the total.
 *
 * \author Paul Robertson
 */
@@ -11,6 +15,9 @@
 #pragma once
 
 #include "BaseMesh.h"
+#include "MeshOptimizer.h"
+#include "IndexBufferBuilder.h"
+#include "MeshCache.h"
 #include "assimp\Importer.hpp"      // C++ importer interface
 #include "assimp\scene.h"           // Output data structure
 #include "assimp\postprocess.h"     // Post processing flags
@@ -18,27 +25,65 @@
 
 using namespace DirectX;
 
+class BaseShader;
+
 class AModel : public BaseMesh
 {
 public:
+	/// Draw range of one imported mesh in the merged buffers
+	struct SubMesh
+	{
+		unsigned int indexStart;	///< First index of the submesh in the index buffer
+		unsigned int indexCount;	///< Number of indices of the submesh
+		int baseVertex;				///< First vertex of the submesh, its indices are relative to it
+		unsigned int vertexCount;	///< Number of vertices of the submesh
+		unsigned int material;		///< Material index in the imported scene
+		XMFLOAT3 boundsMin;			///< Bounding box of the submesh vertices, in model space
+		XMFLOAT3 boundsMax;
+	};
+
 	/** \brief Imports model and builds mesh representation.
 	*
 	* Loads a sub-set of model. Tested with single mesh FBX and OBJ. Currently does not auto load textures. 
 	* @param device is the renderer device
 	* @param file path to model file
 	*/
-	AModel(ID3D11Device* device, const std::string& file);
+	AModel(RenderDevice* device, const std::string& file);
+	/** \brief Imports the model without creating GPU buffers, so it can run on a worker thread
+	* Call createBuffers() on the render thread before the model is drawn.
+	*/
+	AModel(const std::string& file);
 	~AModel();
 
+	/// Create the vertex and index buffers of a model constructed without a device
+	void createBuffers(RenderDevice* device) { renderer = device; initBuffers(device); }
+
+	/// Send the buffers and draw every submesh with the shader, once its parameters are set
+	void render(RenderDevice* device, BaseShader* shader);
+
+	/// Vertex counts and ACMR before and after the mesh optimisation
+	const MeshOptimizerStats& getOptimizerStats() const { return optimizerStats; }
+	/// Submesh draw ranges, sorted by material so consecutive draws can share material state
+	const std::vector<SubMesh>& getSubMeshes() const { return subMeshes; }
+	/// True if the mesh was read from the binary cache instead of imported
+	bool isFromCache() const { return fromCache; }
+
+	/// assimp post processing applied on import, part of the cache key
+	static const unsigned int importFlags;
+
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	void importModel(const std::string& pFile);
+	bool loadCache(const std::string& cacheFile, uint64_t key);
+	void writeCache(const std::string& cacheFile, uint64_t key);
 	void modelProcessing(const aiScene* scene);
 
 	void processScene(const aiScene* scene);
-	void processNode(const aiNode* node, const aiScene* scene);
-	void processMesh(const aiMesh* mesh, const aiScene* scene);
-	ID3D11Device* device;
+	void processNode(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform);
+	void processMesh(const aiMesh* mesh, const aiScene* scene, const aiMatrix4x4& transform);
 	std::vector<VertexType> vertices;
-	std::vector<unsigned long> indices;
+	std::vector<uint32_t> indices;		///< Relative to the base vertex of their submesh
+	std::vector<SubMesh> subMeshes;
+	MeshOptimizerStats optimizerStats;
+	bool fromCache;
 };
\ No newline at end of file
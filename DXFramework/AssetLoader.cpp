@@ -0,0 +1,341 @@
+// Asset loader
+// Reads and decodes assets on worker threads, creates their GPU objects on the render thread within a time budget.
+#include "AssetLoader.h"
+#include "Profiler.h"
+#include <wincodec.h>
+#include <chrono>
+#include <fstream>
+
+namespace
+{
+	template <class T> void safeRelease(T*& object)
+	{
+		if (object)
+		{
+			object->Release();
+			object = nullptr;
+		}
+	}
+
+	// Decode an image to RGBA8 with WIC, the same pixel format the WIC texture loader uses for common images
+	bool decodeImage(const wchar_t* filename, std::vector<unsigned char>& pixels, unsigned int& width, unsigned int& height)
+	{
+		IWICImagingFactory* factory = nullptr;
+		IWICBitmapDecoder* decoder = nullptr;
+		IWICBitmapFrameDecode* frame = nullptr;
+		IWICFormatConverter* converter = nullptr;
+
+		HRESULT result = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+		if (SUCCEEDED(result))
+		{
+			result = factory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+		}
+		if (SUCCEEDED(result))
+		{
+			result = decoder->GetFrame(0, &frame);
+		}
+		if (SUCCEEDED(result))
+		{
+			result = frame->GetSize(&width, &height);
+		}
+		if (SUCCEEDED(result))
+		{
+			result = factory->CreateFormatConverter(&converter);
+		}
+		if (SUCCEEDED(result))
+		{
+			result = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+		}
+		if (SUCCEEDED(result))
+		{
+			pixels.resize((size_t)width * height * 4);
+			result = converter->CopyPixels(nullptr, width * 4, (UINT)pixels.size(), pixels.data());
+		}
+
+		safeRelease(converter);
+		safeRelease(frame);
+		safeRelease(decoder);
+		safeRelease(factory);
+		return SUCCEEDED(result) && width > 0 && height > 0;
+	}
+
+	bool readFile(const wchar_t* filename, std::vector<unsigned char>& data)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		return (bool)file;
+	}
+}
+
+AssetLoader::AssetLoader(RenderDevice* ldevice, TextureManager* ltextureManager, int threadCount)
+{
+	device = ldevice;
+	textureManager = ltextureManager;
+	stopping = false;
+
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+	}
+	if (threadCount < 1)
+	{
+		threadCount = 1;
+	}
+	for (int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&AssetLoader::workerLoop, this));
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		delete assets[i]->model;
+		delete assets[i]->amodel;
+	}
+}
+
+AssetLoader::Handle AssetLoader::loadTexture(const wchar_t* uid, const wchar_t* filename)
+{
+	Asset* asset = new Asset();
+	asset->uid = uid ? uid : L"";
+	asset->textureFile = filename ? filename : L"";
+
+	// DDS files are already in GPU formats, the DDS loader only needs the file contents
+	std::wstring::size_type dot = asset->textureFile.rfind(L'.');
+	bool dds = dot != std::wstring::npos && _wcsicmp(asset->textureFile.c_str() + dot + 1, L"dds") == 0;
+	asset->type = dds ? DDSTextureAsset : TextureAsset;
+	return queue(asset);
+}
+
+AssetLoader::Handle AssetLoader::loadModel(const char* filename)
+{
+	Asset* asset = new Asset();
+	asset->type = ModelAsset;
+	asset->modelFile = filename;
+	return queue(asset);
+}
+
+AssetLoader::Handle AssetLoader::loadAModel(const std::string& filename)
+{
+	Asset* asset = new Asset();
+	asset->type = AModelAsset;
+	asset->modelFile = filename;
+	return queue(asset);
+}
+
+AssetLoader::Handle AssetLoader::queue(Asset* asset)
+{
+	asset->state = Queued;
+	asset->width = 0;
+	asset->height = 0;
+	asset->model = nullptr;
+	asset->amodel = nullptr;
+
+	Handle handle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handle = (Handle)assets.size();
+		assets.push_back(std::unique_ptr<Asset>(asset));
+		pending.push_back(asset);
+	}
+	wake.notify_one();
+	return handle;
+}
+
+void AssetLoader::workerLoop()
+{
+	Profiler::setThreadName("Asset loader");
+
+	// WIC needs COM on every thread that uses it
+	HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	for (;;)
+	{
+		Asset* asset;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+			if (stopping)
+			{
+				break;
+			}
+			asset = pending.front();
+			pending.pop_front();
+			asset->state = Loading;
+		}
+
+		loadAsset(*asset);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (asset->state != Failed)
+		{
+			asset->state = Loaded;
+			loaded.push_back(asset);
+		}
+	}
+
+	if (SUCCEEDED(comResult))
+	{
+		CoUninitialize();
+	}
+}
+
+// Worker side: everything that does not need the device
+void AssetLoader::loadAsset(Asset& asset)
+{
+	PROFILE_FUNCTION();
+	bool succeeded = false;
+	switch (asset.type)
+	{
+	case TextureAsset:
+		// Build the mips here, so the render thread only creates an immutable texture
+		succeeded = decodeImage(asset.textureFile.c_str(), asset.data, asset.width, asset.height);
+		if (succeeded)
+		{
+			asset.mips.build(asset.data.data(), asset.width, asset.height, MipChain::RGBA8, MipChain::BoxFilter, false, 0, 0, 1);
+			std::vector<unsigned char>().swap(asset.data);
+		}
+		break;
+	case DDSTextureAsset:
+		succeeded = readFile(asset.textureFile.c_str(), asset.data);
+		break;
+	case ModelAsset:
+		asset.model = new Model(asset.modelFile.c_str());
+		succeeded = asset.model->getIndexCount() > 0;
+		break;
+	case AModelAsset:
+		asset.amodel = new AModel(asset.modelFile);
+		succeeded = asset.amodel->getIndexCount() > 0;
+		break;
+	}
+
+	if (!succeeded)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		asset.state = Failed;
+		asset.data.clear();
+	}
+}
+
+int AssetLoader::update(float budgetMs)
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+	int created = 0;
+
+	for (;;)
+	{
+		Asset* asset;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (loaded.empty())
+			{
+				break;
+			}
+			asset = loaded.front();
+			loaded.pop_front();
+		}
+
+		createGPUObjects(*asset);
+		created++;
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= budgetMs)
+		{
+			break;
+		}
+	}
+	return created;
+}
+
+// Render thread side: create the buffers and textures
+void AssetLoader::createGPUObjects(Asset& asset)
+{
+	State state = Ready;
+	GpuTexture* textureView = nullptr;
+
+	switch (asset.type)
+	{
+	case TextureAsset:
+		if (!textureManager->addTexture(asset.uid.c_str(), asset.mips))
+		{
+			state = Failed;
+		}
+		asset.mips = MipChain();
+		break;
+	case DDSTextureAsset:
+		textureView = device->loadTexture(asset.data.data(), asset.data.size(), true);
+		if (!textureView)
+		{
+			state = Failed;
+		}
+		break;
+	case ModelAsset:
+		asset.model->createBuffers(device);
+		break;
+	case AModelAsset:
+		asset.amodel->createBuffers(device);
+		break;
+	}
+
+	if (textureView)
+	{
+		textureManager->addTexture(asset.uid.c_str(), textureView);
+	}
+	std::vector<unsigned char>().swap(asset.data);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	asset.state = state;
+}
+
+AssetLoader::State AssetLoader::getState(Handle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return assets[handle]->state;
+}
+
+Model* AssetLoader::getModel(Handle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const Asset& asset = *assets[handle];
+	return asset.state == Ready ? asset.model : nullptr;
+}
+
+AModel* AssetLoader::getAModel(Handle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const Asset& asset = *assets[handle];
+	return asset.state == Ready ? asset.amodel : nullptr;
+}
+
+int AssetLoader::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	int count = 0;
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		if (assets[i]->state != Ready && assets[i]->state != Failed)
+		{
+			count++;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,110 @@
+/**
+* \class AssetLoader
+*
+* \brief Asynchronous loading of textures and models
+*
+* File reads, image decoding, mip generation and model parsing run on worker threads. The GPU objects are created on the render thread
+* by update(), which stops once its per frame time budget is used, so loading hundreds of assets never stalls a frame.
+* Textures go into the TextureManager under their uid when ready, until then getTexture(uid) returns the default white
+* texture. Meshes are returned through a handle and getModel()/getAModel() return nullptr until they are ready.
+* The loader owns the meshes it creates.
+*/
+
+#ifndef _ASSETLOADER_H_
+#define _ASSETLOADER_H_
+
+#include "RenderDevice.h"
+#include "TextureManager.h"
+#include "Model.h"
+#include "AModel.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AssetLoader
+{
+public:
+	/// Identifies a queued asset, valid for the lifetime of the loader
+	typedef unsigned int Handle;
+
+	enum State
+	{
+		Queued,		///< Waiting for a worker
+		Loading,	///< Being read or parsed on a worker
+		Loaded,		///< CPU data ready, waiting for update() to create the GPU objects
+		Ready,		///< Usable
+		Failed		///< Could not be read or decoded, textures keep the placeholder
+	};
+
+	/// threadCount 0 uses one worker per hardware thread, minus the render thread
+	AssetLoader(RenderDevice* device, TextureManager* textureManager, int threadCount = 0);
+	~AssetLoader();
+
+	/// Queue a .png/.jpg/.bmp (decoded with WIC) or .dds texture, stored in the texture manager as uid when ready
+	Handle loadTexture(const wchar_t* uid, const wchar_t* filename);
+	/// Queue an OBJ model (Model)
+	Handle loadModel(const char* filename);
+	/// Queue a model imported with assimp (AModel)
+	Handle loadAModel(const std::string& filename);
+
+	/** \brief Create the GPU objects of loaded assets, call once per frame on the render thread
+	* Creates at least one asset per call, then stops when budgetMs milliseconds have passed.
+	* @return the number of assets that became ready
+	*/
+	int update(float budgetMs = 2.0f);
+
+	State getState(Handle handle) const;
+	Model* getModel(Handle handle) const;		///< nullptr until ready (or if the handle is not a Model)
+	AModel* getAModel(Handle handle) const;		///< nullptr until ready (or if the handle is not an AModel)
+	int getPendingCount() const;				///< Assets not yet ready or failed
+
+private:
+	enum Type
+	{
+		TextureAsset,
+		DDSTextureAsset,
+		ModelAsset,
+		AModelAsset
+	};
+
+	struct Asset
+	{
+		Type type;
+		State state;
+		std::wstring uid;					///< Copied, the caller's string may be gone when the texture is added
+		std::wstring textureFile;
+		std::string modelFile;
+
+		// Worker results
+		std::vector<unsigned char> data;	///< RGBA8 pixels, or the raw file for DDS
+		unsigned int width, height;
+		MipChain mips;						///< Decoded image with its mips
+		Model* model;
+		AModel* amodel;
+	};
+
+	AssetLoader(const AssetLoader&);
+	AssetLoader& operator=(const AssetLoader&);
+
+	Handle queue(Asset* asset);
+	void workerLoop();
+	void loadAsset(Asset& asset);
+	void createGPUObjects(Asset& asset);
+
+	RenderDevice* device;
+	TextureManager* textureManager;
+
+	std::vector<std::unique_ptr<Asset>> assets;	// indexed by handle
+	std::deque<Asset*> pending;					// queued for the workers
+	std::deque<Asset*> loaded;					// waiting for update()
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<std::thread> workers;
+	bool stopping;
+};
+
+#endif
@@ -1,15 +1,32 @@
 // BaseApplication.cpp
 // Base application functionality for inheritnace.
 #include "BaseApplication.h"
+#include "Profiler.h"
 
 
 BaseApplication::BaseApplication()
 {
+	renderer = nullptr;
+	assetLoader = nullptr;
+	uploadRing = nullptr;
+	headless = false;
 }
 
 // Release resources.
 BaseApplication::~BaseApplication()
 {
+	// Stop the loader threads first, the loader uses the device and texture manager
+	if (assetLoader)
+	{
+		delete assetLoader;
+		assetLoader = 0;
+	}
+
+	if (uploadRing)
+	{
+		delete uploadRing;
+		uploadRing = 0;
+	}
 
 	if (timer)
 	{
@@ -23,17 +40,18 @@ BaseApplication::~BaseApplication()
 		camera = 0;
 	}
 
-	if (renderer)
-	{
-		delete renderer;
-		renderer = 0;
-	}
-
+	// The textures are released through the renderer, delete it last
 	if (textureMgr)
 	{
 		delete textureMgr;
 		textureMgr = 0;
 	}
+
+	if (renderer)
+	{
+		delete renderer;
+		renderer = 0;
+	}
 }
 
 // Default application initialisation. Create renderer, camera, timer and imGUI objects.
@@ -44,8 +62,11 @@ void BaseApplication::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int
 	sWidth = screenWidth;
 	sHeight = screenHeight;
 
-	// Create the Direct3D renderer.
-	renderer = new D3D(screenWidth, screenHeight, VSYNC, hwnd, FULL_SCREEN, SCREEN_DEPTH, SCREEN_NEAR);
+	// Create the Direct3D renderer, unless a device was given by setRenderDevice().
+	if (!renderer)
+	{
+		renderer = new D3D(screenWidth, screenHeight, VSYNC, hwnd, FULL_SCREEN, SCREEN_DEPTH, SCREEN_NEAR);
+	}
 	if (!renderer)
 	{
 		MessageBox(hwnd, L"Could not initialize DirectX 11.", L"Error", MB_OK);
@@ -62,15 +83,29 @@ void BaseApplication::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int
 	timer = new Timer();
 
 	// Initialise texture manager
-	textureMgr = new TextureManager(renderer->getDevice(), renderer->getDeviceContext());
+	textureMgr = new TextureManager(renderer);
 	//textureMgr->loadTexture(L"default", L"res/DefaultDiffuse.png");
+	assetLoader = new AssetLoader(renderer, textureMgr);
+	uploadRing = new UploadRing(renderer->createUploadBackend(), UPLOAD_RING_SIZE, UPLOAD_FRAME_BUDGET);
 
 	//Initialise ImGUI
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 	//io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;  // Enable Keyboard Controls
-	ImGui_ImplWin32_Init(hwnd);
-	ImGui_ImplDX11_Init(/*hwnd,*/ renderer->getDevice(), renderer->getDeviceContext());
+	D3D* d3d = dynamic_cast<D3D*>(renderer);
+	headless = !hwnd || !d3d;
+	if (headless)
+	{
+		// Nothing to draw the UI into, only build the font atlas NewFrame() needs
+		unsigned char* pixels;
+		int width, height;
+		io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+	}
+	else
+	{
+		ImGui_ImplWin32_Init(hwnd);
+		ImGui_ImplDX11_Init(/*hwnd,*/ d3d->getDevice(), d3d->getDeviceContext());
+	}
 
 	wireframeToggle = false;
 }
@@ -78,17 +113,31 @@ void BaseApplication::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int
 // Default frame processing. Check for escape key to exit, update timer, handle input and start UI.
 bool BaseApplication::frame()
 {
+	PROFILE_FUNCTION();
 	if (input->isKeyDown(VK_ESCAPE) == true)
 	{
 		return false;
 	}
 
 	timer->frame();
+	uploadRing->beginFrame();
+
+	// Create the GPU objects of assets finished by the loader threads
+	assetLoader->update(ASSET_UPLOAD_BUDGET);
 
 	handleInput(timer->getTime());
 
-	ImGui_ImplDX11_NewFrame();
-	ImGui_ImplWin32_NewFrame();
+	if (headless)
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		io.DisplaySize = ImVec2((float)sWidth, (float)sHeight);
+		io.DeltaTime = timer->getTime() > 0.0f ? timer->getTime() : 1.0f / 60.0f;
+	}
+	else
+	{
+		ImGui_ImplDX11_NewFrame();
+		ImGui_ImplWin32_NewFrame();
+	}
 	ImGui::NewFrame();
 
 	renderer->setWireframeMode(wireframeToggle);
@@ -97,6 +146,15 @@ bool BaseApplication::frame()
 }
 
 
+void BaseApplication::renderGui()
+{
+	ImGui::Render();
+	if (!headless)
+	{
+		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	}
+}
+
 void BaseApplication::handleInput(float frameTime)
 {
 	camera->move(frameTime);
@@ -2,51 +2,76 @@
 // Base mesh class, for inheriting base mesh functionality.
 
 #include "basemesh.h"
+#include "GeometryBuilder.h"
 
 BaseMesh::BaseMesh()
 {
+	renderer = nullptr;
 	vertexBuffer = nullptr;
 	indexBuffer = nullptr;
 	vertexCount = 0;
 	indexCount = 0;
+	indexFormat = DXGI_FORMAT_R32_UINT;
 
 }
 
 // Release base objects (index, vertex buffers and texture object.
 BaseMesh::~BaseMesh()
+{
+	releaseBuffers();
+}
+
+void BaseMesh::releaseBuffers()
 {
 	if (indexBuffer)
 	{
-		indexBuffer->Release();
+		renderer->releaseBuffer(indexBuffer);
 		indexBuffer = 0;
 	}
 
 	if (vertexBuffer)
 	{
-		vertexBuffer->Release();
+		renderer->releaseBuffer(vertexBuffer);
 		vertexBuffer = 0;
 	}
 }
 
+// Upload phase of the meshes built with a GeometryBuilder, the only place their GPU memory is allocated
+void BaseMesh::uploadGeometry(RenderDevice* device, GeometryBuilder& geometry)
+{
+	static_assert(sizeof(GeometryVertex) == sizeof(VertexType), "GeometryVertex is uploaded as a VertexType");
+
+	releaseBuffers();
+	renderer = device;
+	vertexCount = geometry.getVertexCount();
+	indexCount = geometry.getIndexCount();
+	indexFormat = geometry.getIndexFormat();
+	geometry.createBuffers(device, &vertexBuffer, &indexBuffer);
+}
+
 int BaseMesh::getIndexCount()
 {
 	return indexCount;
 }
 
+int BaseMesh::getVertexCount()
+{
+	return vertexCount;
+}
+
+size_t BaseMesh::getMemorySize()
+{
+	size_t indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
+	return (size_t)vertexCount * sizeof(VertexType) + (size_t)indexCount * indexSize;
+}
+
 // Sends geometry data to the GPU. Default primitive topology is TriangleList.
 // To render alternative topologies this function needs to be overwritten.
-void BaseMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top)
-{
-	unsigned int stride;
-	unsigned int offset;
-	
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
-	offset = 0;
-
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	deviceContext->IASetPrimitiveTopology(top);
+void BaseMesh::sendData(RenderDevice* device, D3D_PRIMITIVE_TOPOLOGY top)
+{
+	device->setVertexBuffer(vertexBuffer, sizeof(VertexType));
+	device->setIndexBuffer(indexBuffer, indexFormat);
+	device->setPrimitiveTopology(top);
 }
 
 
@@ -12,11 +12,14 @@
 #ifndef _BASEMESH_H_
 #define _BASEMESH_H_
 
-#include <d3d11.h>
-#include <directxmath.h>
+#include "RenderDevice.h"
+#include <cstddef>
+#include <cstdint>
 
 using namespace DirectX;
 
+class GeometryBuilder;
+
 class BaseMesh
 {
 protected:
@@ -49,16 +52,25 @@ public:
 	~BaseMesh();
 
 	/// Transfers mesh data to the GPU.
-	virtual void sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	virtual void sendData(RenderDevice* device, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	int getIndexCount();			///< Returns total index value of the mesh
+	int getVertexCount();			///< Returns the number of vertices in the vertex buffer
+	virtual size_t getMemorySize();	///< Returns the size in bytes of the vertex and index buffers
 	//D3D11_INPUT_ELEMENT_DESC getInputLayout();
 
 protected:
-	virtual void initBuffers(ID3D11Device*) = 0;
+	/// Build the geometry on the CPU and upload it. Called once, by the constructor of the mesh building the geometry
+	virtual void initBuffers(RenderDevice*) = 0;
+	/// Upload geometry built on the CPU: sets the counts and index format and creates the buffers (releasing any previous ones)
+	void uploadGeometry(RenderDevice* device, GeometryBuilder& geometry);
+	/// Release the vertex and index buffers, until they are created again
+	void releaseBuffers();
 
-	ID3D11Buffer *vertexBuffer, *indexBuffer;
+	RenderDevice* renderer;		///< Device the buffers were created by, and are released through
+	GpuBuffer *vertexBuffer, *indexBuffer;
 	//D3D11_INPUT_ELEMENT_DESC *inputLayout;
 	int vertexCount, indexCount;
+	DXGI_FORMAT indexFormat;	///< DXGI_FORMAT_R32_UINT for uint32_t indices (default) or DXGI_FORMAT_R16_UINT for uint16_t
 };
 
 #endif
\ No newline at end of file
@@ -4,10 +4,20 @@
 #include "baseshader.h"
 
 // Store pointer to render device and handle to window.
-BaseShader::BaseShader(ID3D11Device* device, HWND lhwnd)
+BaseShader::BaseShader(RenderDevice* device, HWND lhwnd)
 {
 	renderer = device;
-	hwnd = hwnd;
+	hwnd = lhwnd;
+
+	vertexShader = nullptr;
+	pixelShader = nullptr;
+	hullShader = nullptr;
+	domainShader = nullptr;
+	geometryShader = nullptr;
+	computeShader = nullptr;
+	layout = nullptr;
+	matrixBuffer = nullptr;
+	sampleState = nullptr;
 }
 
 // Release resources (if used).
@@ -15,37 +25,37 @@ BaseShader::~BaseShader()
 {
 	if (pixelShader)
 	{
-		pixelShader->Release();
+		renderer->releaseShader(pixelShader);
 		pixelShader = 0;
 	}
 
 	if (vertexShader)
 	{
-		vertexShader->Release();
+		renderer->releaseShader(vertexShader);
 		vertexShader = 0;
 	}
 
 	if (hullShader)
 	{
-		hullShader->Release();
+		renderer->releaseShader(hullShader);
 		hullShader = 0;
 	}
 
 	if (domainShader)
 	{
-		domainShader->Release();
+		renderer->releaseShader(domainShader);
 		domainShader = 0;
 	}
 
 	if (geometryShader)
 	{
-		geometryShader->Release();
+		renderer->releaseShader(geometryShader);
 		geometryShader = 0;
 	}
 
 	if (computeShader)
 	{
-		computeShader->Release();
+		renderer->releaseShader(computeShader);
 		computeShader = 0;
 	}
 }
@@ -93,7 +103,7 @@ void BaseShader::loadVertexShader(const wchar_t* filename)
 	}
 	
 	// Create the vertex shader from the buffer.
-	renderer->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &vertexShader);
+	vertexShader = renderer->createShader(kVertexShader, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
 	
 	// Create the vertex input layout description.
 	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
@@ -107,7 +117,7 @@ void BaseShader::loadVertexShader(const wchar_t* filename)
 	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	// Create the vertex input layout.
-	renderer->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
+	layout = renderer->createInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
 	
 	// Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
 	vertexShaderBuffer->Release();
@@ -157,7 +167,7 @@ void BaseShader::loadTextureVertexShader(const wchar_t* filename)
 	}
 
 	// Create the vertex shader from the buffer.
-	renderer->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &vertexShader);
+	vertexShader = renderer->createShader(kVertexShader, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
 
 	// Create the vertex input layout description.
 	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
@@ -171,13 +181,65 @@ void BaseShader::loadTextureVertexShader(const wchar_t* filename)
 	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	// Create the vertex input layout.
-	renderer->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
+	layout = renderer->createInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
 
 	// Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
 	vertexShaderBuffer->Release();
 	vertexShaderBuffer = 0;
 }
 
+// Given pre-compiled file, load and create vertex shader with the provided input layout.
+// The layout needs to match the vertex structure of the mesh that is rendered with it.
+void BaseShader::loadVertexShader(const wchar_t* filename, const D3D11_INPUT_ELEMENT_DESC* polygonLayout, unsigned int numElements)
+{
+	ID3DBlob* vertexShaderBuffer;
+
+	vertexShaderBuffer = 0;
+
+	// check file extension for correct loading function.
+	std::wstring fn(filename);
+	std::string::size_type idx;
+	std::wstring extension;
+
+	idx = fn.rfind('.');
+
+	if (idx != std::string::npos)
+	{
+		extension = fn.substr(idx + 1);
+	}
+	else
+	{
+		// No extension found
+		MessageBox(hwnd, L"Error finding vertex shader file", L"ERROR", MB_OK);
+		exit(0);
+	}
+
+	// Load the texture in.
+	if (extension != L"cso")
+	{
+		MessageBox(hwnd, L"Incorrect vertex shader file type", L"ERROR", MB_OK);
+		exit(0);
+	}
+
+	// Reads compiled shader into buffer (bytecode).
+	HRESULT result = D3DReadFileToBlob(filename, &vertexShaderBuffer);
+	if (result != S_OK)
+	{
+		MessageBox(NULL, filename, L"File ERROR", MB_OK);
+		exit(0);
+	}
+
+	// Create the vertex shader from the buffer.
+	vertexShader = renderer->createShader(kVertexShader, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
+
+	// Create the vertex input layout.
+	layout = renderer->createInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
+
+	// Release the vertex shader buffer since it is no longer needed.
+	vertexShaderBuffer->Release();
+	vertexShaderBuffer = 0;
+}
+
 void BaseShader::loadColourVertexShader(const wchar_t* filename)
 {
 	ID3DBlob* vertexShaderBuffer;
@@ -220,7 +282,7 @@ void BaseShader::loadColourVertexShader(const wchar_t* filename)
 	}
 
 	// Create the vertex shader from the buffer.
-	renderer->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &vertexShader);
+	vertexShader = renderer->createShader(kVertexShader, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
 
 	// Create the vertex input layout description.
 	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
@@ -233,7 +295,7 @@ void BaseShader::loadColourVertexShader(const wchar_t* filename)
 	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	// Create the vertex input layout.
-	renderer->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
+	layout = renderer->createInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize());
 
 	// Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
 	vertexShaderBuffer->Release();
@@ -280,7 +342,7 @@ void BaseShader::loadPixelShader(const wchar_t* filename)
 		exit(0);
 	}
 	// Create the pixel shader from the buffer.
-	renderer->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(), NULL, &pixelShader);
+	pixelShader = renderer->createShader(kPixelShader, pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize());
 	
 	pixelShaderBuffer->Release();
 	pixelShaderBuffer = 0;
@@ -324,7 +386,7 @@ void BaseShader::loadHullShader(const wchar_t* filename)
 		exit(0);
 	}
 	// Create the hull shader from the buffer.
-	renderer->CreateHullShader(hullShaderBuffer->GetBufferPointer(), hullShaderBuffer->GetBufferSize(), NULL, &hullShader);
+	hullShader = renderer->createShader(kHullShader, hullShaderBuffer->GetBufferPointer(), hullShaderBuffer->GetBufferSize());
 	
 	hullShaderBuffer->Release();
 	hullShaderBuffer = 0;
@@ -368,7 +430,7 @@ void BaseShader::loadDomainShader(const wchar_t* filename)
 		exit(0);
 	}
 	// Create the domain shader from the buffer.
-	renderer->CreateDomainShader(domainShaderBuffer->GetBufferPointer(), domainShaderBuffer->GetBufferSize(), NULL, &domainShader);
+	domainShader = renderer->createShader(kDomainShader, domainShaderBuffer->GetBufferPointer(), domainShaderBuffer->GetBufferSize());
 	
 	domainShaderBuffer->Release();
 	domainShaderBuffer = 0;
@@ -412,7 +474,7 @@ void BaseShader::loadGeometryShader(const wchar_t* filename)
 		exit(0);
 	}
 	// Create the domain shader from the buffer.
-	renderer->CreateGeometryShader(geometryShaderBuffer->GetBufferPointer(), geometryShaderBuffer->GetBufferSize(), NULL, &geometryShader);
+	geometryShader = renderer->createShader(kGeometryShader, geometryShaderBuffer->GetBufferPointer(), geometryShaderBuffer->GetBufferSize());
 
 	geometryShaderBuffer->Release();
 	geometryShaderBuffer = 0;
@@ -456,51 +518,42 @@ void BaseShader::loadComputeShader(const wchar_t* filename)
 		exit(0);
 	}
 	// Create the domain shader from the buffer.
-	renderer->CreateComputeShader(computeShaderBuffer->GetBufferPointer(), computeShaderBuffer->GetBufferSize(), NULL, &computeShader);
+	computeShader = renderer->createShader(kComputeShader, computeShaderBuffer->GetBufferPointer(), computeShaderBuffer->GetBufferSize());
 
 	computeShaderBuffer->Release();
 }
 
 // De/Activate shader stages and send shaders to GPU.
-void BaseShader::render(ID3D11DeviceContext* deviceContext, int indexCount)
+void BaseShader::render(RenderDevice* device, int indexCount)
+{
+	render(device, indexCount, 0, 0);
+}
+
+// De/Activate shader stages and draw a range of the index buffer.
+void BaseShader::render(RenderDevice* device, int indexCount, int startIndex, int baseVertex)
 {
 	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(layout);
+	device->setInputLayout(layout);
 
 	// Set the vertex and pixel shaders that will be used to render.
-	deviceContext->VSSetShader(vertexShader, NULL, 0);
-	deviceContext->PSSetShader(pixelShader, NULL, 0);
-	deviceContext->CSSetShader(NULL, NULL, 0);
-	
-	// if Hull shader is not null then set HS and DS
-	if (hullShader)
-	{
-		deviceContext->HSSetShader(hullShader, NULL, 0);
-		deviceContext->DSSetShader(domainShader, NULL, 0);
-	}
-	else
-	{
-		deviceContext->HSSetShader(NULL, NULL, 0);
-		deviceContext->DSSetShader(NULL, NULL, 0);
-	}
+	device->setShader(kVertexShader, vertexShader);
+	device->setShader(kPixelShader, pixelShader);
+	device->setShader(kComputeShader, nullptr);
+
+	// if Hull shader is not null then set HS and DS, otherwise they are disabled
+	device->setShader(kHullShader, hullShader);
+	device->setShader(kDomainShader, hullShader ? domainShader : nullptr);
 
 	// if geometry shader is not null then set GS
-	if (geometryShader)
-	{
-		deviceContext->GSSetShader(geometryShader, NULL, 0);
-	}
-	else
-	{
-		deviceContext->GSSetShader(NULL, NULL, 0);
-	}
+	device->setShader(kGeometryShader, geometryShader);
 
 	// Render the triangle.
-	deviceContext->DrawIndexed(indexCount, 0, 0);
+	device->drawIndexed(indexCount, startIndex, baseVertex);
 }
 
 // Dispatch the compute shader.
-void BaseShader::compute(ID3D11DeviceContext* dc, int x, int y, int z)
+void BaseShader::compute(RenderDevice* device, int x, int y, int z)
 {
-	dc->CSSetShader(computeShader, NULL, 0);
-	dc->Dispatch(x, y, z);
-}
\ No newline at end of file
+	device->setShader(kComputeShader, computeShader);
+	device->dispatch(x, y, z);
+}
@@ -14,7 +14,7 @@
 #ifndef _BASESHADER_H_
 #define _BASESHADER_H_
 
-#include <d3d11.h>
+#include "RenderDevice.h"
 #include <D3Dcompiler.h>
 #include <dxgi.h>
 #include <DirectXMath.h>
@@ -47,20 +47,25 @@ public:
 		_mm_free(p);
 	}
 
-	BaseShader(ID3D11Device* device, HWND hwnd);
+	BaseShader(RenderDevice* device, HWND hwnd);
 	~BaseShader();
 
 	/** \Brief render function
 	* Sets shader stages and draws the indexed data
 	*/
-	virtual void render(ID3D11DeviceContext* deviceContext, int vertexCount);
-	void compute(ID3D11DeviceContext* dc, int x, int y, int z);
+	virtual void render(RenderDevice* device, int vertexCount);
+	/** \Brief render a range of the index buffer
+	* Sets shader stages and draws indexCount indices from startIndex, adding baseVertex to every index (for chunked index buffers)
+	*/
+	virtual void render(RenderDevice* device, int indexCount, int startIndex, int baseVertex);
+	void compute(RenderDevice* device, int x, int y, int z);
 
 protected:
 	virtual void initShader(const wchar_t*, const wchar_t*) = 0;
 	void loadVertexShader(const wchar_t* filename);		///< Load Vertex shader, for stand position, tex, normal geomtry
 	void loadColourVertexShader(const wchar_t* filename);		///< Load Vertex shader, pre-made for position and colour only
 	void loadTextureVertexShader(const wchar_t* filename);		///< Load Vertex shader, pre-made for position and tex only
+	void loadVertexShader(const wchar_t* filename, const D3D11_INPUT_ELEMENT_DESC* polygonLayout, unsigned int numElements);	///< Load Vertex shader, with a custom input layout
 	void loadHullShader(const wchar_t* filename);		///< Load Hull shader
 	void loadDomainShader(const wchar_t* filename);		///< Load Domain shader
 	void loadGeometryShader(const wchar_t* filename);	///< Load Geometry shader
@@ -68,18 +73,18 @@ protected:
 	void loadComputeShader(const wchar_t* filename);	///< Load computer shader
 
 protected:
-	ID3D11Device* renderer;
+	RenderDevice* renderer;		///< Device the shader objects are created by, and released through
 	HWND hwnd;
 	
-	ID3D11VertexShader* vertexShader;
-	ID3D11PixelShader* pixelShader;
-	ID3D11HullShader* hullShader;
-	ID3D11DomainShader* domainShader;
-	ID3D11GeometryShader* geometryShader;
-	ID3D11ComputeShader* computeShader;
-	ID3D11InputLayout* layout;
-	ID3D11Buffer* matrixBuffer;
-	ID3D11SamplerState* sampleState;
+	GpuShader* vertexShader;
+	GpuShader* pixelShader;
+	GpuShader* hullShader;
+	GpuShader* domainShader;
+	GpuShader* geometryShader;
+	GpuShader* computeShader;
+	GpuInputLayout* layout;
+	GpuBuffer* matrixBuffer;
+	GpuSampler* sampleState;
 };
 
 #endif
\ No newline at end of file
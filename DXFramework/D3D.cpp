@@ -1,25 +1,21 @@
 // D3D.cpp
 // Direct3D setup
 #include "d3d.h"
+#include "D3D11UploadBackend.h"
+#include "DTK\include\DDSTextureLoader.h"
+#include "DTK\include\WICTextureLoader.h"
 #include <string>
 
 // Configures and initilises a DirectX renderer.
 // Including render states for wireframe, alpha blending and orthographics rendering.
-D3D::D3D(int screenWidth, int screenHeight, bool vsync, HWND hwnd, bool fullscreen, float screenDepth, float screenNear)
+D3D::D3D(int screenWidth, int screenHeight, bool vsync, HWND hwnd, bool fullscreen, float screenDepth, float screenNear) :
+	RenderDevice(screenWidth, screenHeight, screenDepth, screenNear)
 {
 	// Store rendering control variables.
 	vsync_enabled = vsync;
-	wireframeState = false;
-	zbufferState = true;
-	alphaBlendState = false;
 
 	wnd = &hwnd;
 	isFullscreen = fullscreen;
-	screenheight = screenHeight;
-	screenwidth = screenWidth;
-
-	nearPlane = screenNear;
-	farPlane = screenDepth;
 
 	// Configure and create DirectX 11 renderer
 	// include z buffer for 2D rendering and alpha blend state.
@@ -229,20 +225,6 @@ void D3D::createDefaultRasterState()
 
 	// Create the viewport.
 	deviceContext->RSSetViewports(1, &viewport);
-
-	// Setup the projection matrix.
-	fieldOfView = (float)XM_PI / 4.0f;
-	screenAspect = (float)screenwidth / (float)screenheight;
-
-	// Create the projection matrix for 3D rendering.
-	projectionMatrix = XMMatrixPerspectiveFovLH(fieldOfView, screenAspect, nearPlane, farPlane);
-
-	// Initialize the world matrix to the identity matrix.
-	worldMatrix = XMMatrixIdentity();
-
-	// Create an orthographic projection matrix for 2D rendering.
-	orthoMatrix = XMMatrixOrthographicLH((float)screenwidth, (float)screenheight, nearPlane, farPlane);
-
 }
 
 // Creates additional raster state, in this case for depth disabled 2D rendering.
@@ -398,7 +380,7 @@ void D3D::endScene()
 		swapChain->Present(0, 0);
 	}
 
-	return;
+	finishFrameStats();
 }
 
 // Get 3D device
@@ -414,23 +396,6 @@ ID3D11DeviceContext* D3D::getDeviceContext()
 }
 
 
-XMMATRIX D3D::getProjectionMatrix()
-{
-	return projectionMatrix;
-}
-
-
-XMMATRIX D3D::getWorldMatrix()
-{
-	return worldMatrix;
-}
-
-
-XMMATRIX D3D::getOrthoMatrix()
-{
-	return orthoMatrix;
-}
-
 // Enable/disable the ZBuffer. Uses previously created depth states.
 void D3D::setZBuffer(bool b)
 {
@@ -445,11 +410,6 @@ void D3D::setZBuffer(bool b)
 	}
 }
 
-bool D3D::getZBufferState()
-{
-	return zbufferState;
-}
-
 // Sets the blending state, to enable/disable alphablending
 void D3D::setAlphaBlending(bool b)
 {
@@ -473,11 +433,6 @@ void D3D::setAlphaBlending(bool b)
 	}
 }
 
-bool D3D::getAlphaBlendingState()
-{
-	return alphaBlendState;
-}
-
 // Set the back buffer as the render target
 void D3D::setBackBufferRenderTarget()
 {
@@ -506,7 +461,305 @@ void D3D::setWireframeMode(bool b)
 	}
 }
 
-bool D3D::getWireframeState() 
+GpuBuffer* D3D::createBuffer(const D3D11_BUFFER_DESC& desc, const void* data)
+{
+	D3D11_SUBRESOURCE_DATA initialData;
+	initialData.pSysMem = data;
+	initialData.SysMemPitch = 0;
+	initialData.SysMemSlicePitch = 0;
+
+	ID3D11Buffer* buffer = nullptr;
+	if (FAILED(device->CreateBuffer(&desc, data ? &initialData : NULL, &buffer)))
+	{
+		return nullptr;
+	}
+	frameStats.creations++;
+	return toBuffer(buffer);
+}
+
+// Map a dynamic buffer, the previous contents are discarded
+void* D3D::mapBuffer(GpuBuffer* buffer)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(deviceContext->Map(toBuffer(buffer), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		return nullptr;
+	}
+
+	D3D11_BUFFER_DESC desc;
+	toBuffer(buffer)->GetDesc(&desc);
+	frameStats.bufferWrites++;
+	frameStats.bufferWriteBytes += desc.ByteWidth;
+	return mappedResource.pData;
+}
+
+void D3D::unmapBuffer(GpuBuffer* buffer)
+{
+	deviceContext->Unmap(toBuffer(buffer), 0);
+}
+
+void D3D::releaseBuffer(GpuBuffer* buffer)
+{
+	if (buffer)
+	{
+		toBuffer(buffer)->Release();
+	}
+}
+
+GpuTexture* D3D::createTexture(const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* data)
+{
+	ID3D11Texture2D* texture = nullptr;
+	ID3D11ShaderResourceView* view = nullptr;
+	HRESULT result = device->CreateTexture2D(&desc, data, &texture);
+	if (SUCCEEDED(result))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = desc.Format;
+		if (desc.ArraySize > 1)
+		{
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			viewDesc.Texture2DArray.MipLevels = (UINT)-1;
+			viewDesc.Texture2DArray.ArraySize = desc.ArraySize;
+		}
+		else
+		{
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			viewDesc.Texture2D.MipLevels = (UINT)-1;
+		}
+		result = device->CreateShaderResourceView(texture, &viewDesc, &view);
+		// The view keeps the texture alive
+		texture->Release();
+	}
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+	frameStats.creations++;
+	return toTexture(view);
+}
+
+GpuTexture* D3D::loadTexture(const void* fileData, size_t size, bool dds)
+{
+	ID3D11ShaderResourceView* view = nullptr;
+	HRESULT result;
+	if (dds)
+	{
+		result = CreateDDSTextureFromMemory(device, deviceContext, static_cast<const uint8_t*>(fileData), size, NULL, &view);
+	}
+	else
+	{
+		result = CreateWICTextureFromMemory(device, deviceContext, static_cast<const uint8_t*>(fileData), size, NULL, &view, 0);
+	}
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+	frameStats.creations++;
+	return toTexture(view);
+}
+
+size_t D3D::getTextureSize(GpuTexture* texture)
+{
+	ID3D11Resource* resource = nullptr;
+	ID3D11Texture2D* texture2D = nullptr;
+	toView(texture)->GetResource(&resource);
+	HRESULT result = resource->QueryInterface(IID_PPV_ARGS(&texture2D));
+	resource->Release();
+	if (FAILED(result))
+	{
+		return 0;
+	}
+	D3D11_TEXTURE2D_DESC desc;
+	texture2D->GetDesc(&desc);
+	texture2D->Release();
+	return RenderDevice::getTextureSize(desc);
+}
+
+void D3D::releaseTexture(GpuTexture* texture)
+{
+	if (texture)
+	{
+		toView(texture)->Release();
+	}
+}
+
+GpuShader* D3D::createShader(ShaderStage stage, const void* bytecode, size_t size)
 {
-	return wireframeState;
-}
\ No newline at end of file
+	ID3D11DeviceChild* shader = nullptr;
+	HRESULT result = E_INVALIDARG;
+	switch (stage)
+	{
+	case kVertexShader: result = device->CreateVertexShader(bytecode, size, NULL, reinterpret_cast<ID3D11VertexShader**>(&shader)); break;
+	case kHullShader: result = device->CreateHullShader(bytecode, size, NULL, reinterpret_cast<ID3D11HullShader**>(&shader)); break;
+	case kDomainShader: result = device->CreateDomainShader(bytecode, size, NULL, reinterpret_cast<ID3D11DomainShader**>(&shader)); break;
+	case kGeometryShader: result = device->CreateGeometryShader(bytecode, size, NULL, reinterpret_cast<ID3D11GeometryShader**>(&shader)); break;
+	case kPixelShader: result = device->CreatePixelShader(bytecode, size, NULL, reinterpret_cast<ID3D11PixelShader**>(&shader)); break;
+	case kComputeShader: result = device->CreateComputeShader(bytecode, size, NULL, reinterpret_cast<ID3D11ComputeShader**>(&shader)); break;
+	default: break;
+	}
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+	frameStats.creations++;
+	return reinterpret_cast<GpuShader*>(shader);
+}
+
+GpuInputLayout* D3D::createInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void* bytecode, size_t size)
+{
+	ID3D11InputLayout* layout = nullptr;
+	if (FAILED(device->CreateInputLayout(elements, count, bytecode, size, &layout)))
+	{
+		return nullptr;
+	}
+	frameStats.creations++;
+	return reinterpret_cast<GpuInputLayout*>(layout);
+}
+
+GpuSampler* D3D::createSampler(const D3D11_SAMPLER_DESC& desc)
+{
+	ID3D11SamplerState* sampler = nullptr;
+	if (FAILED(device->CreateSamplerState(&desc, &sampler)))
+	{
+		return nullptr;
+	}
+	frameStats.creations++;
+	return reinterpret_cast<GpuSampler*>(sampler);
+}
+
+void D3D::releaseShader(GpuShader* shader)
+{
+	if (shader)
+	{
+		reinterpret_cast<ID3D11DeviceChild*>(shader)->Release();
+	}
+}
+
+void D3D::releaseInputLayout(GpuInputLayout* layout)
+{
+	if (layout)
+	{
+		reinterpret_cast<ID3D11InputLayout*>(layout)->Release();
+	}
+}
+
+void D3D::releaseSampler(GpuSampler* sampler)
+{
+	if (sampler)
+	{
+		reinterpret_cast<ID3D11SamplerState*>(sampler)->Release();
+	}
+}
+
+void D3D::setVertexBuffer(GpuBuffer* buffer, unsigned int stride)
+{
+	ID3D11Buffer* vertexBuffer = toBuffer(buffer);
+	unsigned int offset = 0;
+	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	frameStats.bindings++;
+}
+
+void D3D::setIndexBuffer(GpuBuffer* buffer, DXGI_FORMAT format)
+{
+	deviceContext->IASetIndexBuffer(toBuffer(buffer), format, 0);
+	frameStats.bindings++;
+}
+
+void D3D::setPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology)
+{
+	deviceContext->IASetPrimitiveTopology(topology);
+}
+
+void D3D::setInputLayout(GpuInputLayout* layout)
+{
+	deviceContext->IASetInputLayout(reinterpret_cast<ID3D11InputLayout*>(layout));
+	frameStats.bindings++;
+}
+
+void D3D::setShader(ShaderStage stage, GpuShader* shader)
+{
+	switch (stage)
+	{
+	case kVertexShader: deviceContext->VSSetShader(reinterpret_cast<ID3D11VertexShader*>(shader), NULL, 0); break;
+	case kHullShader: deviceContext->HSSetShader(reinterpret_cast<ID3D11HullShader*>(shader), NULL, 0); break;
+	case kDomainShader: deviceContext->DSSetShader(reinterpret_cast<ID3D11DomainShader*>(shader), NULL, 0); break;
+	case kGeometryShader: deviceContext->GSSetShader(reinterpret_cast<ID3D11GeometryShader*>(shader), NULL, 0); break;
+	case kPixelShader: deviceContext->PSSetShader(reinterpret_cast<ID3D11PixelShader*>(shader), NULL, 0); break;
+	case kComputeShader: deviceContext->CSSetShader(reinterpret_cast<ID3D11ComputeShader*>(shader), NULL, 0); break;
+	default: break;
+	}
+	frameStats.bindings++;
+}
+
+void D3D::setConstantBuffer(ShaderStage stage, unsigned int slot, GpuBuffer* buffer)
+{
+	ID3D11Buffer* constantBuffer = toBuffer(buffer);
+	switch (stage)
+	{
+	case kVertexShader: deviceContext->VSSetConstantBuffers(slot, 1, &constantBuffer); break;
+	case kHullShader: deviceContext->HSSetConstantBuffers(slot, 1, &constantBuffer); break;
+	case kDomainShader: deviceContext->DSSetConstantBuffers(slot, 1, &constantBuffer); break;
+	case kGeometryShader: deviceContext->GSSetConstantBuffers(slot, 1, &constantBuffer); break;
+	case kPixelShader: deviceContext->PSSetConstantBuffers(slot, 1, &constantBuffer); break;
+	case kComputeShader: deviceContext->CSSetConstantBuffers(slot, 1, &constantBuffer); break;
+	default: break;
+	}
+	frameStats.bindings++;
+}
+
+void D3D::setTexture(ShaderStage stage, unsigned int slot, GpuTexture* texture)
+{
+	ID3D11ShaderResourceView* view = toView(texture);
+	switch (stage)
+	{
+	case kVertexShader: deviceContext->VSSetShaderResources(slot, 1, &view); break;
+	case kHullShader: deviceContext->HSSetShaderResources(slot, 1, &view); break;
+	case kDomainShader: deviceContext->DSSetShaderResources(slot, 1, &view); break;
+	case kGeometryShader: deviceContext->GSSetShaderResources(slot, 1, &view); break;
+	case kPixelShader: deviceContext->PSSetShaderResources(slot, 1, &view); break;
+	case kComputeShader: deviceContext->CSSetShaderResources(slot, 1, &view); break;
+	default: break;
+	}
+	frameStats.bindings++;
+}
+
+void D3D::setSampler(ShaderStage stage, unsigned int slot, GpuSampler* sampler)
+{
+	ID3D11SamplerState* state = reinterpret_cast<ID3D11SamplerState*>(sampler);
+	switch (stage)
+	{
+	case kVertexShader: deviceContext->VSSetSamplers(slot, 1, &state); break;
+	case kHullShader: deviceContext->HSSetSamplers(slot, 1, &state); break;
+	case kDomainShader: deviceContext->DSSetSamplers(slot, 1, &state); break;
+	case kGeometryShader: deviceContext->GSSetSamplers(slot, 1, &state); break;
+	case kPixelShader: deviceContext->PSSetSamplers(slot, 1, &state); break;
+	case kComputeShader: deviceContext->CSSetSamplers(slot, 1, &state); break;
+	default: break;
+	}
+	frameStats.bindings++;
+}
+
+void D3D::draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	deviceContext->Draw(vertexCount, startVertex);
+	frameStats.drawCalls++;
+	frameStats.vertices += vertexCount;
+}
+
+void D3D::drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	deviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+	frameStats.drawCalls++;
+	frameStats.vertices += indexCount;
+}
+
+void D3D::dispatch(unsigned int x, unsigned int y, unsigned int z)
+{
+	deviceContext->Dispatch(x, y, z);
+	frameStats.dispatches++;
+}
+
+UploadBackend* D3D::createUploadBackend()
+{
+	return new D3D11UploadBackend(device, deviceContext);
+}
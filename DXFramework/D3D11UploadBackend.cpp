@@ -0,0 +1,66 @@
+// Direct3D 11 upload backend
+// Dynamic ring buffer mapped without overwriting, copied into the destination buffers on the GPU.
+#include "D3D11UploadBackend.h"
+#include "D3D.h"
+
+D3D11UploadBackend::D3D11UploadBackend(ID3D11Device* ldevice, ID3D11DeviceContext* ldeviceContext)
+{
+	device = ldevice;
+	deviceContext = ldeviceContext;
+	ring = nullptr;
+}
+
+D3D11UploadBackend::~D3D11UploadBackend()
+{
+	if (ring)
+	{
+		ring->Release();
+		ring = nullptr;
+	}
+}
+
+bool D3D11UploadBackend::createRing(size_t size)
+{
+	if (ring)
+	{
+		ring->Release();
+		ring = nullptr;
+	}
+
+	// A dynamic buffer needs a bind flag, it is never bound but the vertex buffer flag allows any size
+	D3D11_BUFFER_DESC ringDesc;
+	ringDesc.Usage = D3D11_USAGE_DYNAMIC;
+	ringDesc.ByteWidth = (UINT)size;
+	ringDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	ringDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ringDesc.MiscFlags = 0;
+	ringDesc.StructureByteStride = 0;
+	return SUCCEEDED(device->CreateBuffer(&ringDesc, nullptr, &ring));
+}
+
+void* D3D11UploadBackend::mapRing(bool discard)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (!ring || FAILED(deviceContext->Map(ring, 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mappedResource)))
+	{
+		return nullptr;
+	}
+	return mappedResource.pData;
+}
+
+void D3D11UploadBackend::unmapRing()
+{
+	deviceContext->Unmap(ring, 0);
+}
+
+void D3D11UploadBackend::copyToBuffer(GpuBuffer* destination, size_t destinationOffset, size_t ringOffset, size_t size)
+{
+	D3D11_BOX box;
+	box.left = (UINT)ringOffset;
+	box.right = (UINT)(ringOffset + size);
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+	deviceContext->CopySubresourceRegion(D3D::toBuffer(destination), 0, (UINT)destinationOffset, 0, 0, ring, 0, &box);
+}
@@ -0,0 +1,34 @@
+/**
+* \class D3D11UploadBackend
+*
+* \brief Upload backend writing to a dynamic Direct3D 11 buffer
+*
+* The ring is a D3D11_USAGE_DYNAMIC buffer mapped with D3D11_MAP_WRITE_NO_OVERWRITE, or D3D11_MAP_WRITE_DISCARD when
+* the ring wraps around. Ranges are copied into the destination buffers (D3D11_USAGE_DEFAULT) with CopySubresourceRegion.
+*/
+
+#ifndef _D3D11UPLOADBACKEND_H_
+#define _D3D11UPLOADBACKEND_H_
+
+#include <d3d11.h>
+#include "UploadBackend.h"
+
+class D3D11UploadBackend : public UploadBackend
+{
+public:
+	D3D11UploadBackend(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	~D3D11UploadBackend();
+
+	bool createRing(size_t size) override;
+	void* mapRing(bool discard) override;
+	void unmapRing() override;
+	/// 'destination' is a buffer of a D3D device created with D3D11_USAGE_DEFAULT
+	void copyToBuffer(GpuBuffer* destination, size_t destinationOffset, size_t ringOffset, size_t size) override;
+
+private:
+	ID3D11Device* device;
+	ID3D11DeviceContext* deviceContext;
+	ID3D11Buffer* ring;
+};
+
+#endif
@@ -27,6 +27,21 @@
 #include "SphereMesh.h"
 #include "TessellationMesh.h"
 #include "TriangleMesh.h"
+#include "IndexBufferBuilder.h"
+#include "GeometryBuilder.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "AssetLoader.h"
+#include "UploadRing.h"
+#include "D3D11UploadBackend.h"
+#include "RecordingUploadBackend.h"
+#include "RenderDevice.h"
+#include "NullRenderDevice.h"
+#include "FrameReport.h"
+#include "HeadlessSystem.h"
+#include "MipChain.h"
+#include "Profiler.h"
 #include "AModel.h"
 
 // Include additional rendering headers
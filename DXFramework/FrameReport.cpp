@@ -0,0 +1,73 @@
+// Frame report
+// Summary and JSON report of frame records.
+#include "FrameReport.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+FrameReport::Summary FrameReport::summarise(const std::vector<FrameRecord>& frames)
+{
+	Summary summary = {};
+	if (frames.empty())
+	{
+		return summary;
+	}
+
+	std::vector<double> times;
+	double totalMs = 0.0;
+	double drawCalls = 0.0;
+	double bindings = 0.0;
+	for (const FrameRecord& frame : frames)
+	{
+		times.push_back(frame.cpuMs);
+		totalMs += frame.cpuMs;
+		drawCalls += frame.stats.drawCalls;
+		bindings += frame.stats.bindings;
+		summary.uploadBytes += frame.uploadBytes;
+		summary.bufferWriteBytes += frame.stats.bufferWriteBytes;
+	}
+	std::sort(times.begin(), times.end());
+	const double count = (double)frames.size();
+
+	summary.frames = (int)frames.size();
+	summary.meanMs = totalMs / count;
+	summary.p50Ms = times[times.size() / 2];
+	summary.p95Ms = times[(times.size() * 95) / 100];
+	summary.maxMs = times.back();
+	summary.drawCallsPerFrame = drawCalls / count;
+	summary.bindingsPerFrame = bindings / count;
+	return summary;
+}
+
+bool FrameReport::write(const char* filename, const char* label, const std::vector<FrameRecord>& frames, int liveObjects, size_t liveBufferBytes)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file || frames.empty())
+	{
+		return false;
+	}
+
+	const Summary summary = summarise(frames);
+	char line[512];
+	snprintf(line, sizeof(line), "{\n\t\"benchmark\": \"headless\",\n\t\"label\": \"%s\",\n\t\"frames\": %d,\n"
+		"\t\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"max_ms\": %.4f,\n"
+		"\t\"draw_calls_per_frame\": %.2f, \"bindings_per_frame\": %.2f, \"upload_bytes\": %llu, \"buffer_write_bytes\": %llu,\n"
+		"\t\"live_objects\": %d, \"live_buffer_bytes\": %llu,\n\t\"frame_records\": [\n",
+		label, summary.frames, summary.meanMs, summary.p50Ms, summary.p95Ms, summary.maxMs,
+		summary.drawCallsPerFrame, summary.bindingsPerFrame, summary.uploadBytes, summary.bufferWriteBytes,
+		liveObjects, (unsigned long long)liveBufferBytes);
+	file << line;
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		const FrameRecord& frame = frames[i];
+		snprintf(line, sizeof(line),
+			"\t\t{ \"frame\": %d, \"cpu_ms\": %.4f, \"draw_calls\": %u, \"vertices\": %llu, \"dispatches\": %u, \"buffer_writes\": %u, "
+			"\"buffer_write_bytes\": %llu, \"bindings\": %u, \"creations\": %u, \"upload_bytes\": %llu }%s\n",
+			(int)i, frame.cpuMs, frame.stats.drawCalls, frame.stats.vertices, frame.stats.dispatches, frame.stats.bufferWrites,
+			frame.stats.bufferWriteBytes, frame.stats.bindings, frame.stats.creations, (unsigned long long)frame.uploadBytes,
+			i + 1 < frames.size() ? "," : "");
+		file << line;
+	}
+	file << "\t]\n}\n";
+	return file.good();
+}
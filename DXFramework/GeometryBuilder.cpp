@@ -0,0 +1,224 @@
+// Geometry builder
+// Generates the shared vertex, indexed geometry of the primitive meshes.
+#include "GeometryBuilder.h"
+#include <cmath>
+
+namespace
+{
+	// Cube coordinate of grid line k out of resolution, from -1 to 1. Computed from integers so that
+	// Coordinate(resolution - k) is exactly -Coordinate(k) and the faces meet without cracks
+	float Coordinate(int k, int resolution)
+	{
+		return (float)(2 * k - resolution) / (float)resolution;
+	}
+}
+
+GeometryBuilder::GeometryBuilder()
+{
+}
+
+GeometryBuilder::~GeometryBuilder()
+{
+}
+
+GeometryBuilder& GeometryBuilder::getStaging()
+{
+	static thread_local GeometryBuilder staging;
+	return staging;
+}
+
+void GeometryBuilder::clear()
+{
+	vertices.clear();
+	indices.clear();
+}
+
+void GeometryBuilder::addPlane(int resolution)
+{
+	if (resolution < 2)
+	{
+		return;
+	}
+
+	const uint32_t first = (uint32_t)vertices.size();
+	const float increment = 1.0f / resolution;
+
+	for (int j = 0; j < resolution; j++)
+	{
+		for (int i = 0; i < resolution; i++)
+		{
+			GeometryVertex vertex;
+			vertex.position = XMFLOAT3((float)i, 0.0f, (float)j);
+			vertex.texture = XMFLOAT2(i * increment, j * increment);
+			vertex.normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertices.push_back(vertex);
+		}
+	}
+
+	// One chunk for the whole grid, so the mesh is drawn with a single call
+	indices.beginChunk(0, (unsigned int)vertices.size());
+	for (int j = 0; j < resolution - 1; j++)
+	{
+		for (int i = 0; i < resolution - 1; i++)
+		{
+			uint32_t upperLeft = first + j * resolution + i;
+			uint32_t bottomRight = upperLeft + 1;
+			uint32_t lowerLeft = upperLeft + resolution;
+			uint32_t upperRight = lowerLeft + 1;
+
+			indices.addTriangle(upperLeft, upperRight, lowerLeft);
+			indices.addTriangle(upperLeft, bottomRight, upperRight);
+		}
+	}
+}
+
+void GeometryBuilder::addCube(int resolution)
+{
+	if (resolution < 1)
+	{
+		return;
+	}
+
+	indices.beginChunk(0, (unsigned int)(vertices.size() + 6 * (resolution + 1) * (resolution + 1)));
+	addCubeFaces(resolution);
+}
+
+void GeometryBuilder::addSphere(int resolution)
+{
+	if (resolution < 1)
+	{
+		return;
+	}
+
+	const size_t first = vertices.size();
+	indices.beginChunk(0, (unsigned int)(first + 6 * (resolution + 1) * (resolution + 1)));
+	addCubeFaces(resolution);
+
+	// Bend the cube into a sphere, the mapping spreads the vertices more evenly than normalising them
+	for (size_t i = first; i < vertices.size(); i++)
+	{
+		XMFLOAT3& position = vertices[i].position;
+		float x = position.x;
+		float y = position.y;
+		float z = position.z;
+
+		position.x = x * sqrtf(1.0f - (y*y / 2.0f) - (z*z / 2.0f) + (y*y*z*z / 3.0f));
+		position.y = y * sqrtf(1.0f - (z*z / 2.0f) - (x*x / 2.0f) + (z*z*x*x / 3.0f));
+		position.z = z * sqrtf(1.0f - (x*x / 2.0f) - (y*y / 2.0f) + (x*x*y*y / 3.0f));
+		vertices[i].normal = position;
+	}
+}
+
+void GeometryBuilder::addQuad(float left, float top, float right, float bottom)
+{
+	const uint32_t first = (uint32_t)vertices.size();
+	const GeometryVertex corners[4] =
+	{
+		{ XMFLOAT3(left, bottom, 0.0f), XMFLOAT2(0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },		// bottom left
+		{ XMFLOAT3(left, top, 0.0f), XMFLOAT2(0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },		// top left
+		{ XMFLOAT3(right, top, 0.0f), XMFLOAT2(1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },		// top right
+		{ XMFLOAT3(right, bottom, 0.0f), XMFLOAT2(1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },	// bottom right
+	};
+	vertices.insert(vertices.end(), corners, corners + 4);
+
+	indices.beginChunk(0, (unsigned int)vertices.size());
+	indices.addTriangle(first, first + 2, first + 1);
+	indices.addTriangle(first, first + 3, first + 2);
+}
+
+void GeometryBuilder::addTriangle(const XMFLOAT2& topTexture, const XMFLOAT2& leftTexture, const XMFLOAT2& rightTexture)
+{
+	const uint32_t first = (uint32_t)vertices.size();
+	const GeometryVertex corners[3] =
+	{
+		{ XMFLOAT3(0.0f, 1.0f, 0.0f), topTexture, XMFLOAT3(0.0f, 0.0f, -1.0f) },
+		{ XMFLOAT3(-1.0f, 0.0f, 0.0f), leftTexture, XMFLOAT3(0.0f, 0.0f, -1.0f) },
+		{ XMFLOAT3(1.0f, 0.0f, 0.0f), rightTexture, XMFLOAT3(0.0f, 0.0f, -1.0f) },
+	};
+	vertices.insert(vertices.end(), corners, corners + 3);
+
+	indices.beginChunk(0, (unsigned int)vertices.size());
+	indices.addTriangle(first, first + 1, first + 2);
+}
+
+// Front, back, right, left, top and bottom faces, with the orientation and UVs of the previous CubeMesh
+void GeometryBuilder::addCubeFaces(int resolution)
+{
+	static const Face faces[6] =
+	{
+		{ 2, -1.0f, 0, 1.0f, 1, -1.0f },	// front: columns along +x, rows along -y
+		{ 2, 1.0f, 0, -1.0f, 1, -1.0f },	// back
+		{ 0, 1.0f, 2, 1.0f, 1, -1.0f },		// right
+		{ 0, -1.0f, 2, -1.0f, 1, -1.0f },	// left
+		{ 1, 1.0f, 0, 1.0f, 2, -1.0f },		// top
+		{ 1, -1.0f, 0, 1.0f, 2, 1.0f },		// bottom
+	};
+
+	vertices.reserve(vertices.size() + 6 * (resolution + 1) * (resolution + 1));
+	for (const Face& face : faces)
+	{
+		addFace(face, resolution);
+	}
+}
+
+// Add a face as a (resolution + 1)^2 grid of vertices, with UVs from (0, 0) at the first vertex to (1, 1) at the last
+void GeometryBuilder::addFace(const Face& face, int resolution)
+{
+	const uint32_t first = (uint32_t)vertices.size();
+	const int side = resolution + 1;
+	const float increment = 1.0f / resolution;
+
+	for (int row = 0; row <= resolution; row++)
+	{
+		for (int column = 0; column <= resolution; column++)
+		{
+			float position[3];
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			position[face.normalAxis] = face.normalSign;
+			position[face.columnAxis] = face.columnSign * Coordinate(column, resolution);
+			position[face.rowAxis] = face.rowSign * Coordinate(row, resolution);
+			normal[face.normalAxis] = face.normalSign;
+
+			GeometryVertex vertex;
+			vertex.position = XMFLOAT3(position[0], position[1], position[2]);
+			vertex.texture = XMFLOAT2(column * increment, row * increment);
+			vertex.normal = XMFLOAT3(normal[0], normal[1], normal[2]);
+			vertices.push_back(vertex);
+		}
+	}
+
+	for (int row = 0; row < resolution; row++)
+	{
+		for (int column = 0; column < resolution; column++)
+		{
+			uint32_t topLeft = first + row * side + column;
+			uint32_t topRight = topLeft + 1;
+			uint32_t bottomLeft = topLeft + side;
+			uint32_t bottomRight = bottomLeft + 1;
+
+			indices.addTriangle(bottomLeft, topRight, topLeft);
+			indices.addTriangle(bottomLeft, bottomRight, topRight);
+		}
+	}
+}
+
+bool GeometryBuilder::createBuffers(RenderDevice* renderer, GpuBuffer** vertexBuffer, GpuBuffer** indexBuffer)
+{
+	D3D11_BUFFER_DESC vertexBufferDesc;
+
+	// Set up the description of the static vertex buffer.
+	vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	vertexBufferDesc.ByteWidth = (UINT)getVertexByteSize();
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.MiscFlags = 0;
+	vertexBufferDesc.StructureByteStride = 0;
+	// Now create the vertex buffer.
+	*vertexBuffer = renderer->createBuffer(vertexBufferDesc, vertices.data());
+	if (!*vertexBuffer)
+	{
+		return false;
+	}
+
+	return indices.createBuffer(renderer, indexBuffer);
+}
@@ -0,0 +1,89 @@
+/**
+* \class GeometryBuilder
+*
+* \brief Builds indexed geometry for the built-in primitives on the CPU
+*
+* Planes, cubes and cube spheres are generated as grids of shared vertices and a triangle list indexing them.
+* Vertices are only duplicated where their UVs or normals differ, at the edges between the faces of the cube (and
+* the UV seams of the sphere), so a sphere needs about 5.4 times fewer vertices than one vertex per triangle corner.
+* The quads and triangles of the small meshes (QuadMesh, OrthoMesh, TriangleMesh, PointMesh, TessellationMesh) are built
+* the same way, so every primitive mesh uploads its geometry through BaseMesh::uploadGeometry.
+* The index buffer uses 16 bit indices when the vertex count allows it.
+* The arrays are kept between builds, clear() does not release them, so a builder can be reused as a staging buffer.
+* getStaging() returns one builder per thread for the meshes to share.
+*/
+
+#ifndef _GEOMETRYBUILDER_H_
+#define _GEOMETRYBUILDER_H_
+
+#include "IndexBufferBuilder.h"
+#include <directxmath.h>
+#include <vector>
+
+using namespace DirectX;
+
+/// Vertex of a built primitive, the same layout as BaseMesh::VertexType
+struct GeometryVertex
+{
+	XMFLOAT3 position;
+	XMFLOAT2 texture;
+	XMFLOAT3 normal;
+};
+
+class GeometryBuilder
+{
+public:
+	GeometryBuilder();
+	~GeometryBuilder();
+
+	/// Builder reused by the primitive meshes created on the calling thread
+	static GeometryBuilder& getStaging();
+
+	void clear();	///< Remove the vertices and indices, keeping the memory for the next build
+
+	/// Grid of resolution * resolution vertices one unit apart on the xz plane, the same layout as PlaneMesh
+	void addPlane(int resolution);
+	/// Cube from -1 to 1 with resolution * resolution quads per face
+	void addCube(int resolution);
+	/// Cube sphere of radius 1, the cube vertices moved onto the sphere
+	void addSphere(int resolution);
+	/// Rectangle on the xy plane facing -z, UVs from (0, 0) at the top left to (1, 1) at the bottom right (QuadMesh, OrthoMesh)
+	void addQuad(float left, float top, float right, float bottom);
+	/// Triangle on the xy plane facing -z with the corners top (0, 1), bottom left (-1, 0) and bottom right (1, 0),
+	/// and these UVs at the corners in that order
+	void addTriangle(const XMFLOAT2& topTexture, const XMFLOAT2& leftTexture, const XMFLOAT2& rightTexture);
+
+	const std::vector<GeometryVertex>& getVertices() const { return vertices; }
+	IndexBufferBuilder& getIndices() { return indices; }
+
+	unsigned int getVertexCount() const { return (unsigned int)vertices.size(); }
+	unsigned int getIndexCount() const { return indices.getIndexCount(); }
+	DXGI_FORMAT getIndexFormat() const { return indices.getFormat(); }
+	size_t getVertexByteSize() const { return vertices.size() * sizeof(GeometryVertex); }
+	size_t getIndexByteSize() const { return indices.getByteSize(); }
+	/// Bytes the same triangles take with one vertex per triangle corner and 32 bit indices (the previous primitives)
+	size_t getUnindexedByteSize() const { return (size_t)getIndexCount() * (sizeof(GeometryVertex) + sizeof(uint32_t)); }
+
+	/// Create an immutable vertex buffer and index buffer from the geometry. Returns false if a buffer could not be created
+	bool createBuffers(RenderDevice* renderer, GpuBuffer** vertexBuffer, GpuBuffer** indexBuffer);
+
+private:
+	/// One face of the cube: the axis it faces and the axes (with their direction) along its columns and rows
+	struct Face
+	{
+		int normalAxis;
+		float normalSign;
+		int columnAxis;
+		float columnSign;
+		int rowAxis;
+		float rowSign;
+	};
+
+	void addCubeFaces(int resolution);
+	void addFace(const Face& face, int resolution);
+
+	std::vector<GeometryVertex> vertices;
+	IndexBufferBuilder indices;
+};
+
+#endif
@@ -0,0 +1,83 @@
+// Headless system
+// Runs the frames of an application on a null render device and records their cost.
+#include "HeadlessSystem.h"
+#include "Profiler.h"
+
+HeadlessSystem::HeadlessSystem(BaseApplication* application, int screenWidth, int screenHeight)
+{
+	Profiler::setThreadName("Main");
+
+	app = application;
+	device = new NullRenderDevice(screenWidth, screenHeight, SCREEN_DEPTH, SCREEN_NEAR);
+	liveObjects = -1;
+	liveBufferBytes = 0;
+	app->setRenderDevice(device);
+	app->init(GetModuleHandle(NULL), NULL, screenWidth, screenHeight, &input, false, false);
+}
+
+// Release resources, the device after the application.
+HeadlessSystem::~HeadlessSystem()
+{
+	releaseApplication();
+	if (device)
+	{
+		delete device;
+		device = 0;
+	}
+}
+
+void HeadlessSystem::releaseApplication()
+{
+	if (app)
+	{
+		// The device is not the application's to delete, so its objects can be counted after the application is gone
+		app->setRenderDevice(nullptr);
+		delete app;
+		app = 0;
+		liveObjects = device->getLiveObjectCount();
+		liveBufferBytes = device->getLiveBufferBytes();
+	}
+}
+
+int HeadlessSystem::run(int frameCount, const FrameCallback& callback)
+{
+	if (!app)
+	{
+		return 0;
+	}
+	frames.reserve(frames.size() + frameCount);
+	for (int i = 0; i < frameCount; i++)
+	{
+		unsigned long long uploaded = app->getUploadRing()->getTotalBytes();
+		uint64_t start = Profiler::now();
+
+		Profiler::beginFrame();
+		if (callback)
+		{
+			callback(i);
+		}
+		bool result = app->frame();
+		Profiler::endFrame();
+
+		FrameRecord record;
+		record.cpuMs = (double)(Profiler::now() - start) / 1e6;
+		record.stats = device->getLastFrameStats();
+		record.uploadBytes = (size_t)(app->getUploadRing()->getTotalBytes() - uploaded);
+		frames.push_back(record);
+
+		if (!result)
+		{
+			return i + 1;
+		}
+	}
+	return frameCount;
+}
+
+bool HeadlessSystem::writeReport(const char* filename, const char* label) const
+{
+	if (app)
+	{
+		return false;
+	}
+	return FrameReport::write(filename, label, frames, liveObjects, liveBufferBytes);
+}
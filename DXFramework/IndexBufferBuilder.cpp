@@ -0,0 +1,186 @@
+// Index buffer builder
+// Builds chunked index buffers, using 16 bit indices whenever the chunks allow it.
+#include "IndexBufferBuilder.h"
+
+const uint16_t IndexBufferBuilder::restartIndex16;
+const uint32_t IndexBufferBuilder::restartIndex32;
+const unsigned int IndexBufferBuilder::maxVertices16;
+
+IndexBufferBuilder::IndexBufferBuilder()
+{
+	maxIndex = 0;
+}
+
+IndexBufferBuilder::~IndexBufferBuilder()
+{
+}
+
+void IndexBufferBuilder::clear()
+{
+	indices.clear();
+	indices16.clear();
+	chunks.clear();
+	maxIndex = 0;
+}
+
+// Following indices are stored relative to baseVertex.
+void IndexBufferBuilder::beginChunk(int baseVertex, unsigned int vertexCount)
+{
+	IndexChunk chunk;
+	chunk.indexStart = (unsigned int)indices.size();
+	chunk.indexCount = 0;
+	chunk.baseVertex = baseVertex;
+	chunk.vertexCount = vertexCount;
+	chunks.push_back(chunk);
+
+	if (vertexCount > 0 && vertexCount - 1 > maxIndex)
+	{
+		maxIndex = vertexCount - 1;
+	}
+}
+
+void IndexBufferBuilder::addTriangle(uint32_t a, uint32_t b, uint32_t c)
+{
+	addStripIndex(a);
+	addStripIndex(b);
+	addStripIndex(c);
+}
+
+void IndexBufferBuilder::addStripIndex(uint32_t index)
+{
+	// Indices added without a chunk go to a single chunk starting at vertex 0
+	if (chunks.empty())
+	{
+		beginChunk(0, 0);
+	}
+
+	IndexChunk& chunk = chunks.back();
+	uint32_t relative = index - (uint32_t)chunk.baseVertex;
+	if (relative >= chunk.vertexCount)
+	{
+		chunk.vertexCount = relative + 1;
+	}
+	if (relative > maxIndex)
+	{
+		maxIndex = relative;
+	}
+
+	indices.push_back(relative);
+	chunk.indexCount++;
+}
+
+void IndexBufferBuilder::restartStrip()
+{
+	if (chunks.empty())
+	{
+		return;
+	}
+
+	indices.push_back(restartIndex32);
+	chunks.back().indexCount++;
+}
+
+void IndexBufferBuilder::addGrid(int width, int height, bool strips, int baseVertex)
+{
+	if (width < 2 || height < 2)
+	{
+		return;
+	}
+
+	// A band of n rows of quads uses (n + 1) * width vertices
+	int rowsPerChunk = (int)(maxVertices16 / (unsigned int)width) - 1;
+	if (rowsPerChunk < 1)
+	{
+		// A single row does not fit in 16 bits, so 32 bit indices are needed anyway
+		rowsPerChunk = height - 1;
+	}
+
+	for (int firstRow = 0; firstRow < height - 1; firstRow += rowsPerChunk)
+	{
+		int rows = (height - 1) - firstRow;
+		if (rows > rowsPerChunk)
+		{
+			rows = rowsPerChunk;
+		}
+
+		int chunkBase = baseVertex + firstRow * width;
+		beginChunk(chunkBase, (unsigned int)((rows + 1) * width));
+
+		for (int j = 0; j < rows; j++)
+		{
+			uint32_t row = (uint32_t)(chunkBase + j * width);
+			uint32_t nextRow = row + (uint32_t)width;
+
+			if (strips)
+			{
+				// Alternating next row / row gives the same triangles and winding as the list below
+				if (j > 0)
+				{
+					restartStrip();
+				}
+				for (int i = 0; i < width; i++)
+				{
+					addStripIndex(nextRow + i);
+					addStripIndex(row + i);
+				}
+			}
+			else
+			{
+				for (int i = 0; i < width - 1; i++)
+				{
+					addTriangle(row + i, nextRow + i + 1, nextRow + i);
+					addTriangle(row + i, row + i + 1, nextRow + i + 1);
+				}
+			}
+		}
+	}
+}
+
+bool IndexBufferBuilder::is16Bit() const
+{
+	return maxIndex < maxVertices16;
+}
+
+DXGI_FORMAT IndexBufferBuilder::getFormat() const
+{
+	return is16Bit() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+unsigned int IndexBufferBuilder::getIndexSize() const
+{
+	return is16Bit() ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+const void* IndexBufferBuilder::getData()
+{
+	if (!is16Bit())
+	{
+		return indices.data();
+	}
+
+	// Narrow the indices, the 32 bit restart becomes the 16 bit restart
+	if (indices16.size() != indices.size())
+	{
+		indices16.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			indices16[i] = indices[i] == restartIndex32 ? restartIndex16 : (uint16_t)indices[i];
+		}
+	}
+	return indices16.data();
+}
+
+bool IndexBufferBuilder::createBuffer(RenderDevice* renderer, GpuBuffer** buffer)
+{
+	D3D11_BUFFER_DESC indexBufferDesc;
+
+	indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	indexBufferDesc.ByteWidth = (UINT)getByteSize();
+	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.CPUAccessFlags = 0;
+	indexBufferDesc.MiscFlags = 0;
+	indexBufferDesc.StructureByteStride = 0;
+
+	*buffer = renderer->createBuffer(indexBufferDesc, getData());
+	return *buffer != nullptr;
+}
@@ -0,0 +1,43 @@
+/**
+* \class MappedFile
+*
+* \brief Read only memory mapped file
+*
+* Maps a whole file into the address space, so it can be parsed in place without reading it into a buffer.
+* The mapping is released by close() or the destructor.
+*/
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <cstddef>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char* filename);	///< Map the file, returns false if it cannot be opened or mapped
+	void close();						///< Unmap the file
+
+	const char* getData() const { return data; }	///< Start of the file contents (nullptr if not open)
+	size_t getSize() const { return size; }			///< Size of the file in bytes
+	bool isOpen() const { return opened; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const char* data;
+	size_t size;
+	bool opened;	// an empty file is open but has no mapping
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
+
+#endif
@@ -57,7 +57,7 @@ ID3D11ShaderResourceView* Mesh::GetTexture()
 bool Mesh::InitBuffers(ID3D11Device* device)
 {
 	VertexType* vertices;
-	unsigned long* indices;
+	uint32_t* indices;
 	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
 	D3D11_SUBRESOURCE_DATA vertexData, indexData;
 	HRESULT result;
@@ -71,7 +71,7 @@ bool Mesh::InitBuffers(ID3D11Device* device)
 	vertices = new VertexType[m_vertexCount];
 	
 	// Create the index array.
-	indices = new unsigned long[m_indexCount];
+	indices = new uint32_t[m_indexCount];
 	
 	// Load the vertex array with data.
 	vertices[0].position = XMFLOAT3(-1.0f, -1.0f, 0.0f);  // Bottom left.
@@ -121,7 +121,7 @@ bool Mesh::InitBuffers(ID3D11Device* device)
 
 	// Set up the description of the static index buffer.
 	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* m_indexCount;
+	indexBufferDesc.ByteWidth = sizeof(uint32_t)* m_indexCount;
 	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	indexBufferDesc.CPUAccessFlags = 0;
 	indexBufferDesc.MiscFlags = 0;
@@ -0,0 +1,153 @@
+// Mesh cache
+// Writes and maps binary cache files of processed mesh data.
+#include "MeshCache.h"
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const uint32_t cacheMagic = 0x4843534D;	// "MSCH"
+	const uint32_t cacheVersion = 1;
+	const size_t sectionAlignment = 16;
+
+	// Layout of the start of a cache file, followed by sectionCount 64 bit section sizes and then the sections,
+	// each one starting on a sectionAlignment boundary
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint64_t sectionCount;
+	};
+
+	size_t alignSize(size_t size)
+	{
+		return (size + sectionAlignment - 1) & ~(sectionAlignment - 1);
+	}
+
+	uint64_t mix(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xFF51AFD7ED558CCDull;
+		value ^= value >> 33;
+		value *= 0xC4CEB9FE1A85EC53ull;
+		value ^= value >> 33;
+		return value;
+	}
+}
+
+uint64_t MeshCache::hash(const void* data, size_t size, uint64_t seed)
+{
+	// Four independent lanes of 8 bytes, so the multiplies of one block overlap
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	const uint64_t prime = 0x9E3779B97F4A7C15ull;
+	uint64_t lanes[4] = { seed ^ prime, seed + 0x632BE59BD9B4E019ull, seed ^ 0x8CB92BA72F3D8DD7ull, seed - prime };
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i + lane * 8, 8);
+			lanes[lane] = (lanes[lane] ^ word) * prime;
+			lanes[lane] ^= lanes[lane] >> 29;
+		}
+	}
+
+	uint64_t result = mix(lanes[0]) ^ mix(lanes[1] + 1) ^ mix(lanes[2] + 2) ^ mix(lanes[3] + 3);
+	for (; i < size; i++)
+	{
+		result = (result ^ bytes[i]) * 0x100000001B3ull;
+	}
+	return mix(result ^ size);
+}
+
+bool MeshCache::hashFile(const char* filename, uint64_t& fileHash)
+{
+	MappedFile source;
+	if (!source.open(filename))
+	{
+		return false;
+	}
+	fileHash = hash(source.getData(), source.getSize());
+	return true;
+}
+
+bool MeshCache::write(const char* filename, uint64_t key, const std::vector<Section>& sections)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	CacheHeader header;
+	header.magic = cacheMagic;
+	header.version = cacheVersion;
+	header.key = key;
+	header.sectionCount = sections.size();
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		uint64_t size = sections[i].size;
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	}
+
+	const char padding[sectionAlignment] = {};
+	size_t offset = sizeof(CacheHeader) + sections.size() * sizeof(uint64_t);
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		file.write(padding, alignSize(offset) - offset);
+		offset = alignSize(offset);
+		file.write(static_cast<const char*>(sections[i].data), sections[i].size);
+		offset += sections[i].size;
+	}
+	return (bool)file;
+}
+
+bool MeshCache::open(const char* filename, uint64_t key)
+{
+	close();
+	if (!file.open(filename) || file.getSize() < sizeof(CacheHeader))
+	{
+		close();
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(&header, file.getData(), sizeof(header));
+	size_t tableEnd = sizeof(CacheHeader) + (size_t)header.sectionCount * sizeof(uint64_t);
+	if (header.magic != cacheMagic || header.version != cacheVersion || header.key != key || header.sectionCount > 1024 || tableEnd > file.getSize())
+	{
+		close();
+		return false;
+	}
+
+	// Walk the section table, a truncated file (e.g. an interrupted write) fails the size check
+	const char* data = file.getData();
+	size_t offset = tableEnd;
+	sections.resize((size_t)header.sectionCount);
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		uint64_t size;
+		memcpy(&size, data + sizeof(CacheHeader) + i * sizeof(uint64_t), sizeof(size));
+		offset = alignSize(offset);
+		if (offset > file.getSize() || size > file.getSize() - offset)
+		{
+			close();
+			return false;
+		}
+		sections[i].data = data + offset;
+		sections[i].size = (size_t)size;
+		offset += (size_t)size;
+	}
+	return true;
+}
+
+void MeshCache::close()
+{
+	file.close();
+	sections.clear();
+}
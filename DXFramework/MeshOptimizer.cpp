@@ -0,0 +1,309 @@
+// Mesh optimizer
+// Vertex welding, vertex cache and vertex fetch optimisation of indexed triangle lists.
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+#include <cmath>
+#include <cstring>
+
+const int MeshOptimizer::forsythCacheSize;
+const int MeshOptimizer::fifoCacheSize;
+
+namespace
+{
+	// Forsyth scoring constants (https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html)
+	const float cacheDecayPower = 1.5f;
+	const float lastTriScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+	const int maxValenceTable = 64;
+
+	struct ScoreTables
+	{
+		float cache[MeshOptimizer::forsythCacheSize];
+		float valence[maxValenceTable];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < MeshOptimizer::forsythCacheSize; i++)
+			{
+				if (i < 3)
+				{
+					// The three vertices of the last triangle get a fixed score, so it does not matter in which order they were added
+					cache[i] = lastTriScore;
+				}
+				else
+				{
+					float scaler = 1.0f / (MeshOptimizer::forsythCacheSize - 3);
+					cache[i] = powf(1.0f - (i - 3) * scaler, cacheDecayPower);
+				}
+			}
+			for (int i = 0; i < maxValenceTable; i++)
+			{
+				valence[i] = i == 0 ? 0.0f : valenceBoostScale * powf((float)i, -valenceBoostPower);
+			}
+		}
+	};
+
+	float VertexScore(const ScoreTables& tables, int cachePosition, int remainingValence)
+	{
+		if (remainingValence == 0)
+		{
+			// No triangle needs this vertex anymore
+			return -1.0f;
+		}
+
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		// Boost vertices with few triangles left, so lone triangles do not get left behind
+		score += remainingValence < maxValenceTable ? tables.valence[remainingValence] : valenceBoostScale * powf((float)remainingValence, -valenceBoostPower);
+		return score;
+	}
+
+	// 32 bit FNV-1a over the bytes of a vertex
+	uint32_t HashVertex(const unsigned char* vertex, int vertexStride)
+	{
+		uint32_t hash = 2166136261u;
+		for (int i = 0; i < vertexStride; i++)
+		{
+			hash ^= vertex[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+}
+
+int MeshOptimizer::weldVertices(void* vertices, int vertexStride, int vertexCount, uint32_t* indices, int indexCount)
+{
+	unsigned char* data = static_cast<unsigned char*>(vertices);
+
+	// Open addressing hash table of the unique vertices, sized to a power of two at least twice the vertex count
+	size_t tableSize = 1;
+	while (tableSize < (size_t)vertexCount * 2)
+	{
+		tableSize <<= 1;
+	}
+	const uint32_t empty = 0xFFFFFFFF;
+	std::vector<uint32_t> table(tableSize, empty);
+	std::vector<uint32_t> remap(vertexCount);
+
+	int uniqueCount = 0;
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const unsigned char* vertex = data + (size_t)i * vertexStride;
+		size_t slot = HashVertex(vertex, vertexStride) & (tableSize - 1);
+
+		while (table[slot] != empty && memcmp(data + (size_t)table[slot] * vertexStride, vertex, vertexStride) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] == empty)
+		{
+			// First time this vertex is seen, move it to the end of the unique vertices
+			if (uniqueCount != i)
+			{
+				memcpy(data + (size_t)uniqueCount * vertexStride, vertex, vertexStride);
+			}
+			table[slot] = uniqueCount;
+			uniqueCount++;
+		}
+		remap[i] = table[slot];
+	}
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		indices[i] = remap[indices[i]];
+	}
+	return uniqueCount;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, int indexCount, int vertexCount)
+{
+	PROFILE_FUNCTION();
+	static const ScoreTables tables;
+	const int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles using each vertex, stored contiguously per vertex (the first 'remaining' of them are not emitted yet)
+	std::vector<int> remaining(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+	std::vector<int> adjacencyStart(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+	}
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> filled(vertexCount, 0);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			adjacency[adjacencyStart[v] + filled[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = VertexScore(tables, -1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	// The cache holds three extra entries for the vertices pushed out by the last triangle
+	int cache[forsythCacheSize + 3];
+	int cacheCount = 0;
+
+	std::vector<uint32_t> output(triangleCount * 3);
+	int bestTriangle = -1;
+	int nextUnemitted = 0;
+
+	for (int outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		if (bestTriangle < 0)
+		{
+			// Nothing in the cache touches a remaining triangle, continue with the next one in the original order
+			while (emitted[nextUnemitted])
+			{
+				nextUnemitted++;
+			}
+			bestTriangle = nextUnemitted;
+		}
+
+		const uint32_t* triangle = indices + bestTriangle * 3;
+		output[outputTriangle * 3] = triangle[0];
+		output[outputTriangle * 3 + 1] = triangle[1];
+		output[outputTriangle * 3 + 2] = triangle[2];
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from the remaining triangles of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = triangle[k];
+			int* list = &adjacency[adjacencyStart[v]];
+			for (int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[remaining[v] - 1];
+					list[remaining[v] - 1] = bestTriangle;
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// Move the triangle vertices to the front of the cache, the others keep their order
+		int newCache[forsythCacheSize + 3];
+		int newCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			newCache[newCount++] = triangle[k];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != (int)triangle[0] && v != (int)triangle[1] && v != (int)triangle[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore the vertices of the cache (and those that just fell out of it), then their remaining triangles
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			cachePosition[v] = i < forsythCacheSize ? i : -1;
+			float newScore = VertexScore(tables, cachePosition[v], remaining[v]);
+			float delta = newScore - vertexScore[v];
+			vertexScore[v] = newScore;
+
+			const int* list = &adjacency[adjacencyStart[v]];
+			for (int j = 0; j < remaining[v]; j++)
+			{
+				triangleScore[list[j]] += delta;
+			}
+		}
+
+		cacheCount = newCount < forsythCacheSize ? newCount : forsythCacheSize;
+		memcpy(cache, newCache, sizeof(int) * cacheCount);
+
+		// The next triangle is the best one among those using a cached vertex
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			const int* list = &adjacency[adjacencyStart[v]];
+			for (int j = 0; j < remaining[v]; j++)
+			{
+				if (triangleScore[list[j]] > bestScore)
+				{
+					bestScore = triangleScore[list[j]];
+					bestTriangle = list[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output.data(), sizeof(uint32_t) * triangleCount * 3);
+}
+
+int MeshOptimizer::optimizeVertexFetch(void* vertices, int vertexStride, int vertexCount, uint32_t* indices, int indexCount)
+{
+	const unsigned char* data = static_cast<const unsigned char*>(vertices);
+	const uint32_t unused = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	std::vector<unsigned char> reordered((size_t)vertexCount * vertexStride);
+
+	uint32_t nextVertex = 0;
+	for (int i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (remap[v] == unused)
+		{
+			remap[v] = nextVertex;
+			memcpy(&reordered[(size_t)nextVertex * vertexStride], data + (size_t)v * vertexStride, vertexStride);
+			nextVertex++;
+		}
+		indices[i] = remap[v];
+	}
+
+	memcpy(vertices, reordered.data(), (size_t)nextVertex * vertexStride);
+	return (int)nextVertex;
+}
+
+float MeshOptimizer::computeACMR(const uint32_t* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	const int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return 0.0f;
+	}
+
+	// FIFO cache: a vertex is in the cache if it was added less than cacheSize misses ago
+	std::vector<int> insertedAt(vertexCount, -cacheSize - 1);
+	int misses = 0;
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		uint32_t v = indices[i];
+		if (misses - insertedAt[v] > cacheSize)
+		{
+			insertedAt[v] = misses;
+			misses++;
+		}
+	}
+	return (float)misses / (float)triangleCount;
+}
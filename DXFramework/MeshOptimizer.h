@@ -0,0 +1,74 @@
+/**
+* \class MeshOptimizer
+*
+* \brief Post import optimisation of indexed triangle lists
+*
+* Welds duplicate vertices, reorders the triangles for the post-transform vertex cache (Tom Forsyth's linear-speed
+* vertex cache optimisation) and reorders the vertices in the order they are first used, for vertex fetch locality.
+* The vertex functions work on any vertex struct, vertices are compared and moved as raw bytes of vertexStride.
+* The ACMR (average cache miss ratio, vertex shader runs per triangle) is measured before and after.
+*/
+
+#ifndef _MESHOPTIMIZER_H_
+#define _MESHOPTIMIZER_H_
+
+#include <cstdint>
+#include <vector>
+
+/// Result of MeshOptimizer::optimize
+struct MeshOptimizerStats
+{
+	int verticesBefore = 0;		///< Vertex count before welding
+	int verticesAfter = 0;		///< Vertex count after welding (and removing unused vertices)
+	int indexCount = 0;			///< Number of indices (unchanged)
+	float acmrBefore = 0.0f;	///< ACMR of the imported triangle order
+	float acmrAfter = 0.0f;		///< ACMR after the vertex cache optimisation
+};
+
+class MeshOptimizer
+{
+public:
+	static const int forsythCacheSize = 32;	///< Cache size modelled by the triangle scoring
+	static const int fifoCacheSize = 16;	///< Size of the FIFO cache used to measure ACMR
+
+	/// Merge bitwise identical vertices and remap the indices. The unique vertices are compacted at the front of the array.
+	/// Returns the new vertex count
+	static int weldVertices(void* vertices, int vertexStride, int vertexCount, uint32_t* indices, int indexCount);
+
+	/// Reorder the triangles of the index list for the post-transform vertex cache
+	static void optimizeVertexCache(uint32_t* indices, int indexCount, int vertexCount);
+
+	/// Reorder the vertices in the order the indices first use them and remap the indices.
+	/// Unused vertices are dropped, returns the new vertex count
+	static int optimizeVertexFetch(void* vertices, int vertexStride, int vertexCount, uint32_t* indices, int indexCount);
+
+	/// Average number of cache misses per triangle for a FIFO cache of cacheSize entries (0.5 is the best possible for a grid, 3 the worst)
+	static float computeACMR(const uint32_t* indices, int indexCount, int vertexCount, int cacheSize = fifoCacheSize);
+
+	/// Run every pass (weld, vertex cache, vertex fetch) on a triangle list, resizing the vertex vector
+	template <class Vertex>
+	static MeshOptimizerStats optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		MeshOptimizerStats stats;
+		stats.verticesBefore = (int)vertices.size();
+		stats.indexCount = (int)indices.size();
+		if (vertices.empty() || indices.empty())
+		{
+			stats.verticesAfter = stats.verticesBefore;
+			return stats;
+		}
+
+		stats.acmrBefore = computeACMR(indices.data(), (int)indices.size(), (int)vertices.size());
+
+		int count = weldVertices(vertices.data(), sizeof(Vertex), (int)vertices.size(), indices.data(), (int)indices.size());
+		optimizeVertexCache(indices.data(), (int)indices.size(), count);
+		count = optimizeVertexFetch(vertices.data(), sizeof(Vertex), count, indices.data(), (int)indices.size());
+		vertices.resize(count);
+
+		stats.verticesAfter = count;
+		stats.acmrAfter = computeACMR(indices.data(), (int)indices.size(), count);
+		return stats;
+	}
+};
+
+#endif
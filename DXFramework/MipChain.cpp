@@ -0,0 +1,562 @@
+// Mip chain
+// Builds filtered mip levels of an image on the CPU.
+#include "MipChain.h"
+#include "Profiler.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float kPi = 3.14159265358979f;
+	const float kKaiserWidth = 3.0f;		// support of the Kaiser filter, in texels of the smaller level
+	const float kKaiserAlpha = 4.0f;
+	const size_t kThreadedTexels = 128 * 128;	// smaller levels are filtered on one thread
+
+	// Source texels and weights of every texel of a resampled row or column
+	struct FilterTaps
+	{
+		std::vector<int> first;			// first source texel of each destination texel
+		std::vector<int> count;			// number of weights of each destination texel
+		std::vector<int> start;			// offset of its weights in the weights array
+		std::vector<float> weights;
+	};
+
+	float Sinc(float x)
+	{
+		if (fabsf(x) < 1e-5f)
+		{
+			return 1.0f;
+		}
+		return sinf(kPi * x) / (kPi * x);
+	}
+
+	// Modified Bessel function of the first kind, order 0 (series expansion)
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 20; k++)
+		{
+			float factor = x / (2.0f * k);
+			term *= factor * factor;
+			sum += term;
+			if (term < sum * 1e-7f)
+			{
+				break;
+			}
+		}
+		return sum;
+	}
+
+	float Kaiser(float x)
+	{
+		float t = x / kKaiserWidth;
+		if (t * t >= 1.0f)
+		{
+			return 0.0f;
+		}
+		return Sinc(x) * BesselI0(kKaiserAlpha * sqrtf(1.0f - t * t)) / BesselI0(kKaiserAlpha);
+	}
+
+	// Weights to resample srcSize texels to dstSize texels, with clamped edges
+	void BuildTaps(int srcSize, int dstSize, MipChain::Filter filter, FilterTaps& taps)
+	{
+		const float scale = (float)srcSize / (float)dstSize;
+		taps.first.resize(dstSize);
+		taps.count.resize(dstSize);
+		taps.start.resize(dstSize);
+		taps.weights.clear();
+
+		std::vector<float> weights;
+		for (int i = 0; i < dstSize; i++)
+		{
+			const float center = (i + 0.5f) * scale;
+			float radius = filter == MipChain::BoxFilter ? scale * 0.5f : kKaiserWidth * scale;
+			int first = (int)floorf(center - radius);
+			int last = (int)ceilf(center + radius) - 1;
+
+			// Accumulate the weights of texels outside the image on the edge texels
+			int clampedFirst = first < 0 ? 0 : first;
+			int clampedLast = last > srcSize - 1 ? srcSize - 1 : last;
+			weights.assign(clampedLast - clampedFirst + 1, 0.0f);
+			float total = 0.0f;
+			for (int j = first; j <= last; j++)
+			{
+				float weight;
+				if (filter == MipChain::BoxFilter)
+				{
+					// Overlap of the source texel with the footprint of the destination texel
+					float from = fmaxf((float)j, center - radius);
+					float to = fminf((float)(j + 1), center + radius);
+					weight = fmaxf(to - from, 0.0f);
+				}
+				else
+				{
+					weight = Kaiser((j + 0.5f - center) / scale);
+				}
+				int clamped = j < clampedFirst ? clampedFirst : (j > clampedLast ? clampedLast : j);
+				weights[clamped - clampedFirst] += weight;
+				total += weight;
+			}
+
+			taps.first[i] = clampedFirst;
+			taps.count[i] = (int)weights.size();
+			taps.start[i] = (int)taps.weights.size();
+			for (size_t k = 0; k < weights.size(); k++)
+			{
+				taps.weights.push_back(weights[k] / total);
+			}
+		}
+	}
+
+	// dst[i] = sum of weights[k] * rows[k][i]
+	void BlendRows(const float* const* rows, const float* weights, int rowCount, float* dst, size_t length)
+	{
+		size_t i = 0;
+#ifdef MIP_CHAIN_SSE2
+		for (; i + 4 <= length; i += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < rowCount; k++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+			}
+			_mm_storeu_ps(dst + i, sum);
+		}
+#endif
+		for (; i < length; i++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < rowCount; k++)
+			{
+				sum += weights[k] * rows[k][i];
+			}
+			dst[i] = sum;
+		}
+	}
+
+	// Horizontal resampling of one row
+	void FilterRow(const float* src, int channels, const FilterTaps& taps, float* dst)
+	{
+		const int dstWidth = (int)taps.first.size();
+		if (channels == 4)
+		{
+			for (int x = 0; x < dstWidth; x++)
+			{
+				const float* texel = src + (size_t)taps.first[x] * 4;
+				const float* weights = taps.weights.data() + taps.start[x];
+#ifdef MIP_CHAIN_SSE2
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < taps.count[x]; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(texel + k * 4)));
+				}
+				_mm_storeu_ps(dst + (size_t)x * 4, sum);
+#else
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int k = 0; k < taps.count[x]; k++)
+				{
+					for (int c = 0; c < 4; c++)
+					{
+						sum[c] += weights[k] * texel[k * 4 + c];
+					}
+				}
+				memcpy(dst + (size_t)x * 4, sum, sizeof(sum));
+#endif
+			}
+		}
+		else
+		{
+			for (int x = 0; x < dstWidth; x++)
+			{
+				const float* texel = src + taps.first[x];
+				const float* weights = taps.weights.data() + taps.start[x];
+				float sum = 0.0f;
+				for (int k = 0; k < taps.count[x]; k++)
+				{
+					sum += weights[k] * texel[k];
+				}
+				dst[x] = sum;
+			}
+		}
+	}
+
+	float SRGBToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSRGB(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	// Conversion tables between 8 bit sRGB and linear float
+	struct SRGBTables
+	{
+		float toLinear[256];
+		unsigned char fromLinear[4096 + 1];		// indexed by the square root of the linear value, finer in the dark range
+
+		SRGBTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				toLinear[i] = SRGBToLinear(i / 255.0f);
+			}
+			for (int i = 0; i <= 4096; i++)
+			{
+				float root = i / 4096.0f;
+				fromLinear[i] = (unsigned char)(LinearToSRGB(root * root) * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SRGBTables& GetSRGBTables()
+	{
+		static const SRGBTables tables;
+		return tables;
+	}
+
+	unsigned char EncodeUnorm8(float value)
+	{
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return (unsigned char)(value * 255.0f + 0.5f);
+	}
+
+	unsigned char EncodeSRGB8(float value, const SRGBTables& tables)
+	{
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return tables.fromLinear[(int)(sqrtf(value) * 4096.0f + 0.5f)];
+	}
+
+	// 8 bit row to linear float, colour channels through the sRGB table when srgb is set
+	void DecodeRow(const unsigned char* src, float* dst, size_t length, int channels, bool srgb, const SRGBTables& tables)
+	{
+		size_t i = 0;
+		if (srgb)
+		{
+			for (; i < length; i++)
+			{
+				bool colour = channels == 1 || (i & 3) != 3;
+				dst[i] = colour ? tables.toLinear[src[i]] : src[i] * (1.0f / 255.0f);
+			}
+			return;
+		}
+#ifdef MIP_CHAIN_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i low = _mm_unpacklo_epi8(bytes, zero);
+			__m128i high = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+			_mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+			_mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+		}
+#endif
+		for (; i < length; i++)
+		{
+			dst[i] = src[i] * (1.0f / 255.0f);
+		}
+	}
+
+	// Linear float row to 8 bit, colour channels sRGB encoded when srgb is set
+	void EncodeRow(const float* src, unsigned char* dst, size_t length, int channels, bool srgb, const SRGBTables& tables)
+	{
+		size_t i = 0;
+		if (srgb)
+		{
+			for (; i < length; i++)
+			{
+				bool colour = channels == 1 || (i & 3) != 3;
+				dst[i] = colour ? EncodeSRGB8(src[i], tables) : EncodeUnorm8(src[i]);
+			}
+			return;
+		}
+#ifdef MIP_CHAIN_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f);
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i values[4];
+			for (int k = 0; k < 4; k++)
+			{
+				__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + k * 4), zero), one);
+				values[k] = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+			}
+			__m128i words = _mm_packs_epi32(values[0], values[1]);
+			__m128i words2 = _mm_packs_epi32(values[2], values[3]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words2));
+		}
+#endif
+		for (; i < length; i++)
+		{
+			dst[i] = EncodeUnorm8(src[i]);
+		}
+	}
+
+	// Everything needed to filter one level from the one above it
+	struct LevelJob
+	{
+		const unsigned char* src;	// texels of the source level, linear float or (top level only) 8 bit
+		size_t srcPitch;			// bytes per source row
+		bool srcBytes;				// source is 8 bit and decoded while filtering
+		int srcWidth, srcHeight;
+		float* dst;				// linear float texels of the new level
+		int dstWidth, dstHeight;
+		int channels;
+		const FilterTaps* columns;	// horizontal taps
+		const FilterTaps* rows;		// vertical taps
+		unsigned char* output;	// the new level in the chain format
+		MipChain::PixelFormat format;
+		bool srgb;
+	};
+
+	void FilterRows(const LevelJob& job, int firstRow, int lastRow)
+	{
+		const size_t srcRowLength = (size_t)job.srcWidth * job.channels;
+		const size_t dstRowLength = (size_t)job.dstWidth * job.channels;
+		const SRGBTables& tables = GetSRGBTables();
+		std::vector<float> column(srcRowLength);
+		std::vector<const float*> rowPointers;
+
+		// 8 bit source rows are decoded to linear float in a ring of rows. The window of source rows only moves
+		// down, so a ring one row larger than the widest window decodes every row once
+		int ringSize = 0;
+		if (job.srcBytes)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				ringSize = job.rows->count[y] + 1 > ringSize ? job.rows->count[y] + 1 : ringSize;
+			}
+		}
+		std::vector<float> ring((size_t)ringSize * srcRowLength);
+		std::vector<int> ringRows(ringSize, -1);
+
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			// Vertical pass into one full width row, then horizontal pass into the level
+			int count = job.rows->count[y];
+			rowPointers.resize(count);
+			for (int k = 0; k < count; k++)
+			{
+				int sourceRow = job.rows->first[y] + k;
+				const unsigned char* source = job.src + (size_t)sourceRow * job.srcPitch;
+				if (!job.srcBytes)
+				{
+					rowPointers[k] = reinterpret_cast<const float*>(source);
+					continue;
+				}
+
+				int slot = sourceRow % ringSize;
+				float* decoded = ring.data() + (size_t)slot * srcRowLength;
+				if (ringRows[slot] != sourceRow)
+				{
+					DecodeRow(source, decoded, srcRowLength, job.channels, job.srgb, tables);
+					ringRows[slot] = sourceRow;
+				}
+				rowPointers[k] = decoded;
+			}
+			BlendRows(rowPointers.data(), job.rows->weights.data() + job.rows->start[y], count, column.data(), srcRowLength);
+
+			float* dstRow = job.dst + (size_t)y * dstRowLength;
+			FilterRow(column.data(), job.channels, *job.columns, dstRow);
+
+			// Store in the chain format
+			switch (job.format)
+			{
+			case MipChain::RGBA8:
+			case MipChain::R8:
+				EncodeRow(dstRow, job.output + (size_t)y * dstRowLength, dstRowLength, job.channels, job.srgb, tables);
+				break;
+			default:
+				memcpy(job.output + (size_t)y * dstRowLength * sizeof(float), dstRow, dstRowLength * sizeof(float));
+				break;
+			}
+		}
+	}
+}
+
+MipChain::MipChain()
+{
+	format = RGBA8;
+	srgb = false;
+}
+
+size_t MipChain::getTexelSize() const
+{
+	size_t channelSize = format == RGBA8 || format == R8 ? 1 : sizeof(float);
+	return channelSize * getChannelCount();
+}
+
+void MipChain::build(const void* pixels, unsigned int width, unsigned int height, PixelFormat lformat, Filter filter,
+	bool lsrgb, int maxLevels, size_t rowPitch, int threadCount)
+{
+	PROFILE_FUNCTION();
+	format = lformat;
+	srgb = lsrgb && (format == RGBA8 || format == R8);
+	levels.clear();
+	data.clear();
+	if (width == 0 || height == 0)
+	{
+		return;
+	}
+
+	// Level sizes, halving down to 1x1
+	const size_t texelSize = getTexelSize();
+	const int channels = getChannelCount();
+	size_t offset = 0;
+	unsigned int levelWidth = width, levelHeight = height;
+	for (;;)
+	{
+		Level level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.offset = offset;
+		level.rowPitch = levelWidth * texelSize;
+		level.size = level.rowPitch * levelHeight;
+		levels.push_back(level);
+		offset += level.size;
+
+		if ((levelWidth == 1 && levelHeight == 1) || (maxLevels > 0 && (int)levels.size() >= maxLevels))
+		{
+			break;
+		}
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
+	data.resize(offset);
+
+	// Copy the top level, it is filtered from the caller's pixels
+	if (rowPitch == 0)
+	{
+		rowPitch = levels[0].rowPitch;
+	}
+	for (unsigned int y = 0; y < height; y++)
+	{
+		memcpy(data.data() + y * levels[0].rowPitch, static_cast<const unsigned char*>(pixels) + y * rowPitch, levels[0].rowPitch);
+	}
+
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency();
+	}
+
+	// Each level is filtered from the linear float texels of the level above
+	std::vector<float> current, next;
+	FilterTaps columns, rows;
+	for (size_t l = 1; l < levels.size(); l++)
+	{
+		const Level& above = levels[l - 1];
+		const Level& level = levels[l];
+		next.resize((size_t)level.width * level.height * channels);
+		BuildTaps(above.width, level.width, filter, columns);
+		BuildTaps(above.height, level.height, filter, rows);
+
+		LevelJob job;
+		if (l == 1)
+		{
+			job.src = static_cast<const unsigned char*>(pixels);
+			job.srcPitch = rowPitch;
+			job.srcBytes = format == RGBA8 || format == R8;
+		}
+		else
+		{
+			job.src = reinterpret_cast<const unsigned char*>(current.data());
+			job.srcPitch = (size_t)above.width * channels * sizeof(float);
+			job.srcBytes = false;
+		}
+		job.srcWidth = above.width;
+		job.srcHeight = above.height;
+		job.dst = next.data();
+		job.dstWidth = level.width;
+		job.dstHeight = level.height;
+		job.channels = channels;
+		job.columns = &columns;
+		job.rows = &rows;
+		job.output = data.data() + level.offset;
+		job.format = format;
+		job.srgb = srgb;
+
+		// Split the rows of large levels between threads
+		int threads = (size_t)level.width * level.height >= kThreadedTexels ? threadCount : 1;
+		if (threads > (int)level.height)
+		{
+			threads = (int)level.height;
+		}
+		if (threads <= 1)
+		{
+			FilterRows(job, 0, level.height);
+		}
+		else
+		{
+			std::vector<std::thread> workers;
+			for (int t = 0; t < threads; t++)
+			{
+				int firstRow = (int)((size_t)level.height * t / threads);
+				int lastRow = (int)((size_t)level.height * (t + 1) / threads);
+				workers.push_back(std::thread(FilterRows, std::cref(job), firstRow, lastRow));
+			}
+			for (size_t t = 0; t < workers.size(); t++)
+			{
+				workers[t].join();
+			}
+		}
+
+		current.swap(next);
+	}
+}
+
+bool MipChain::writeDDS(const char* filename) const
+{
+	if (levels.empty())
+	{
+		return false;
+	}
+
+	// DXGI_FORMAT values of the pixel formats
+	uint32_t dxgiFormat;
+	switch (format)
+	{
+	case RGBA8: dxgiFormat = srgb ? 29 : 28; break;	// R8G8B8A8_UNORM(_SRGB)
+	case R8: dxgiFormat = 61; break;				// R8_UNORM
+	case RGBA32F: dxgiFormat = 2; break;			// R32G32B32A32_FLOAT
+	default: dxgiFormat = 41; break;				// R32_FLOAT
+	}
+
+	// DDS_HEADER followed by DDS_HEADER_DXT10
+	uint32_t header[31 + 5] = {};
+	header[0] = 124;										// size
+	header[1] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000;	// caps, height, width, pitch, pixel format, mip count
+	header[2] = levels[0].height;
+	header[3] = levels[0].width;
+	header[4] = (uint32_t)levels[0].rowPitch;
+	header[6] = (uint32_t)levels.size();
+	header[18] = 32;										// pixel format size
+	header[19] = 0x4;										// four CC
+	header[20] = 0x30315844;								// "DX10"
+	header[26] = 0x1000 | (levels.size() > 1 ? 0x400000 | 0x8 : 0);	// texture, mip map, complex
+	header[31] = dxgiFormat;
+	header[32] = 3;											// texture 2D
+	header[34] = 1;											// array size
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	file.write("DDS ", 4);
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return (bool)file;
+}
@@ -0,0 +1,239 @@
+// Null render device
+// Accepts and counts the calls of a frame without drawing anything, the buffers are kept in system memory.
+#include "NullRenderDevice.h"
+#include "RecordingUploadBackend.h"
+#include <cstring>
+
+NullRenderDevice::NullRenderDevice(int screenWidth, int screenHeight, float screenDepth, float screenNear) :
+	RenderDevice(screenWidth, screenHeight, screenDepth, screenNear)
+{
+	liveObjects = 0;
+	liveBufferBytes = 0;
+	frameCount = 0;
+}
+
+NullRenderDevice::~NullRenderDevice()
+{
+}
+
+void NullRenderDevice::beginScene(float, float, float, float)
+{
+}
+
+void NullRenderDevice::endScene()
+{
+	frameCount++;
+	finishFrameStats();
+}
+
+void NullRenderDevice::setBackBufferRenderTarget()
+{
+}
+
+void NullRenderDevice::resetViewport()
+{
+}
+
+void NullRenderDevice::setZBuffer(bool b)
+{
+	zbufferState = b;
+}
+
+void NullRenderDevice::setAlphaBlending(bool b)
+{
+	alphaBlendState = b;
+}
+
+void NullRenderDevice::setWireframeMode(bool b)
+{
+	wireframeState = b;
+}
+
+GpuBuffer* NullRenderDevice::createBuffer(const D3D11_BUFFER_DESC& desc, const void* data)
+{
+	if (desc.ByteWidth == 0 || (desc.Usage == D3D11_USAGE_IMMUTABLE && !data))
+	{
+		return nullptr;
+	}
+
+	std::vector<unsigned char>* buffer = new std::vector<unsigned char>(desc.ByteWidth);
+	if (data)
+	{
+		memcpy(buffer->data(), data, desc.ByteWidth);
+	}
+	liveObjects++;
+	liveBufferBytes += desc.ByteWidth;
+	frameStats.creations++;
+	return toBuffer(buffer);
+}
+
+void* NullRenderDevice::mapBuffer(GpuBuffer* buffer)
+{
+	if (!buffer)
+	{
+		return nullptr;
+	}
+	frameStats.bufferWrites++;
+	frameStats.bufferWriteBytes += toData(buffer)->size();
+	return toData(buffer)->data();
+}
+
+void NullRenderDevice::unmapBuffer(GpuBuffer*)
+{
+}
+
+void NullRenderDevice::releaseBuffer(GpuBuffer* buffer)
+{
+	if (buffer)
+	{
+		liveObjects--;
+		liveBufferBytes -= toData(buffer)->size();
+		delete toData(buffer);
+	}
+}
+
+GpuTexture* NullRenderDevice::createTexture(const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA*)
+{
+	if (desc.Width == 0 || desc.Height == 0)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<GpuTexture*>(createObject(RenderDevice::getTextureSize(desc)));
+}
+
+// The image is not decoded, the texture counts as the size of the file
+GpuTexture* NullRenderDevice::loadTexture(const void* fileData, size_t size, bool)
+{
+	if (!fileData || size == 0)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<GpuTexture*>(createObject(size));
+}
+
+size_t NullRenderDevice::getTextureSize(GpuTexture* texture)
+{
+	return texture ? reinterpret_cast<NullObject*>(texture)->size : 0;
+}
+
+void NullRenderDevice::releaseTexture(GpuTexture* texture)
+{
+	releaseObject(texture);
+}
+
+GpuShader* NullRenderDevice::createShader(ShaderStage stage, const void* bytecode, size_t size)
+{
+	if (!bytecode || size == 0 || stage >= kShaderStageCount)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<GpuShader*>(createObject(size));
+}
+
+GpuInputLayout* NullRenderDevice::createInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void*, size_t)
+{
+	if (!elements || count == 0)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<GpuInputLayout*>(createObject(count * sizeof(D3D11_INPUT_ELEMENT_DESC)));
+}
+
+GpuSampler* NullRenderDevice::createSampler(const D3D11_SAMPLER_DESC&)
+{
+	return reinterpret_cast<GpuSampler*>(createObject(sizeof(D3D11_SAMPLER_DESC)));
+}
+
+void NullRenderDevice::releaseShader(GpuShader* shader)
+{
+	releaseObject(shader);
+}
+
+void NullRenderDevice::releaseInputLayout(GpuInputLayout* layout)
+{
+	releaseObject(layout);
+}
+
+void NullRenderDevice::releaseSampler(GpuSampler* sampler)
+{
+	releaseObject(sampler);
+}
+
+void NullRenderDevice::setVertexBuffer(GpuBuffer*, unsigned int)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::setIndexBuffer(GpuBuffer*, DXGI_FORMAT)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::setPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY)
+{
+}
+
+void NullRenderDevice::setInputLayout(GpuInputLayout*)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::setShader(ShaderStage, GpuShader*)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::setConstantBuffer(ShaderStage, unsigned int, GpuBuffer*)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::setTexture(ShaderStage, unsigned int, GpuTexture*)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::setSampler(ShaderStage, unsigned int, GpuSampler*)
+{
+	frameStats.bindings++;
+}
+
+void NullRenderDevice::draw(unsigned int vertexCount, unsigned int)
+{
+	frameStats.drawCalls++;
+	frameStats.vertices += vertexCount;
+}
+
+void NullRenderDevice::drawIndexed(unsigned int indexCount, unsigned int, int)
+{
+	frameStats.drawCalls++;
+	frameStats.vertices += indexCount;
+}
+
+void NullRenderDevice::dispatch(unsigned int, unsigned int, unsigned int)
+{
+	frameStats.dispatches++;
+}
+
+UploadBackend* NullRenderDevice::createUploadBackend()
+{
+	return new RecordingUploadBackend();
+}
+
+NullRenderDevice::NullObject* NullRenderDevice::createObject(size_t size)
+{
+	NullObject* object = new NullObject();
+	object->size = size;
+	liveObjects++;
+	frameStats.creations++;
+	return object;
+}
+
+void NullRenderDevice::releaseObject(void* object)
+{
+	if (object)
+	{
+		liveObjects--;
+		delete static_cast<NullObject*>(object);
+	}
+}
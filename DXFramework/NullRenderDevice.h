@@ -0,0 +1,86 @@
+/**
+* \class NullRenderDevice
+*
+* \brief Render device without a window or a GPU, for headless runs, tests and profiling
+*
+* Every call is accepted and counted in the frame stats, nothing is drawn. Buffers are kept in system memory
+* (a GpuBuffer is a std::vector<unsigned char>), so the data written to them can be read back with getBufferData() and
+* the upload backend is a RecordingUploadBackend copying into them. Textures, shaders, layouts and samplers only
+* record their size. The device counts the objects alive, so a run can check that everything it created was released.
+*/
+
+#ifndef _NULLRENDERDEVICE_H_
+#define _NULLRENDERDEVICE_H_
+
+#include "RenderDevice.h"
+#include <vector>
+
+class NullRenderDevice : public RenderDevice
+{
+public:
+	NullRenderDevice(int screenWidth, int screenHeight, float screenDepth, float screenNear);
+	~NullRenderDevice();
+
+	void beginScene(float r, float g, float b, float a) override;
+	void endScene() override;
+	void setBackBufferRenderTarget() override;
+	void resetViewport() override;
+
+	void setZBuffer(bool b) override;
+	void setAlphaBlending(bool b) override;
+	void setWireframeMode(bool b) override;
+
+	GpuBuffer* createBuffer(const D3D11_BUFFER_DESC& desc, const void* data) override;
+	void* mapBuffer(GpuBuffer* buffer) override;
+	void unmapBuffer(GpuBuffer* buffer) override;
+	void releaseBuffer(GpuBuffer* buffer) override;
+	GpuTexture* createTexture(const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* data) override;
+	GpuTexture* loadTexture(const void* fileData, size_t size, bool dds) override;
+	size_t getTextureSize(GpuTexture* texture) override;
+	void releaseTexture(GpuTexture* texture) override;
+	GpuShader* createShader(ShaderStage stage, const void* bytecode, size_t size) override;
+	GpuInputLayout* createInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void* bytecode, size_t size) override;
+	GpuSampler* createSampler(const D3D11_SAMPLER_DESC& desc) override;
+	void releaseShader(GpuShader* shader) override;
+	void releaseInputLayout(GpuInputLayout* layout) override;
+	void releaseSampler(GpuSampler* sampler) override;
+
+	void setVertexBuffer(GpuBuffer* buffer, unsigned int stride) override;
+	void setIndexBuffer(GpuBuffer* buffer, DXGI_FORMAT format) override;
+	void setPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology) override;
+	void setInputLayout(GpuInputLayout* layout) override;
+	void setShader(ShaderStage stage, GpuShader* shader) override;
+	void setConstantBuffer(ShaderStage stage, unsigned int slot, GpuBuffer* buffer) override;
+	void setTexture(ShaderStage stage, unsigned int slot, GpuTexture* texture) override;
+	void setSampler(ShaderStage stage, unsigned int slot, GpuSampler* sampler) override;
+	void draw(unsigned int vertexCount, unsigned int startVertex) override;
+	void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void dispatch(unsigned int x, unsigned int y, unsigned int z) override;
+
+	/// A RecordingUploadBackend, whose copies write into the buffers of this device
+	UploadBackend* createUploadBackend() override;
+
+	/// Contents of a buffer created by this device
+	static const std::vector<unsigned char>& getBufferData(GpuBuffer* buffer) { return *reinterpret_cast<std::vector<unsigned char>*>(buffer); }
+	int getLiveObjectCount() const { return liveObjects; }	///< Objects created and not released yet
+	size_t getLiveBufferBytes() const { return liveBufferBytes; }	///< Memory of the buffers alive
+	unsigned int getFrameCount() const { return frameCount; }		///< endScene() calls
+
+private:
+	// Texture, shader, layout or sampler, only its size is known
+	struct NullObject
+	{
+		size_t size;
+	};
+
+	GpuBuffer* toBuffer(std::vector<unsigned char>* data) { return reinterpret_cast<GpuBuffer*>(data); }
+	std::vector<unsigned char>* toData(GpuBuffer* buffer) { return reinterpret_cast<std::vector<unsigned char>*>(buffer); }
+	NullObject* createObject(size_t size);
+	void releaseObject(void* object);
+
+	int liveObjects;
+	size_t liveBufferBytes;
+	unsigned int frameCount;
+};
+
+#endif
@@ -0,0 +1,466 @@
+// OBJ parser
+// Multithreaded, in place parsing of Wavefront OBJ files into indexed meshes.
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include <cmath>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	const int32_t missingIndex = INT32_MIN;
+	// Chunks smaller than this are not worth a thread
+	const size_t minChunkSize = 1 << 20;
+
+	// One corner of a triangle. Indices are 0 based, or relative to the counts of the chunk when the relative bit is set
+	struct Corner
+	{
+		int32_t v, vt, vn;
+		uint8_t relative; // bit 0: v, bit 1: vt, bit 2: vn
+	};
+
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT2> texCoords;
+		std::vector<XMFLOAT3> normals;
+		std::vector<Corner> corners; // three per triangle
+		bool valid;
+	};
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const char* newLine = static_cast<const char*>(memchr(p, '\n', end - p));
+		return newLine ? newLine + 1 : end;
+	}
+
+	// Powers of ten for the float parser (doubles, so the 19 digit mantissa keeps its precision)
+	struct PowersOfTen
+	{
+		double positive[309];
+		double negative[309];
+		PowersOfTen()
+		{
+			positive[0] = negative[0] = 1.0;
+			for (int i = 1; i < 309; i++)
+			{
+				positive[i] = positive[i - 1] * 10.0;
+				negative[i] = negative[i - 1] / 10.0;
+			}
+		}
+	};
+	const PowersOfTen powersOfTen;
+
+	// Parse a decimal float ([+-]digits[.digits][(e|E)[+-]digits]). Returns nullptr if there is no number
+	const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		p = SkipSpaces(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		// Integer part, digits past what fits in the mantissa only scale it
+		for (; p < end && (unsigned)(*p - '0') < 10; p++, digits++)
+		{
+			if (mantissa < 1000000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (p < end && *p == '.')
+		{
+			p++;
+			for (; p < end && (unsigned)(*p - '0') < 10; p++, digits++)
+			{
+				if (mantissa < 1000000000000000000ull)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					exponent--;
+				}
+			}
+		}
+		if (digits == 0)
+		{
+			return nullptr;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = *e == '-';
+				e++;
+			}
+			if (e < end && (unsigned)(*e - '0') < 10)
+			{
+				int value = 0;
+				for (; e < end && (unsigned)(*e - '0') < 10; e++)
+				{
+					if (value < 10000)
+					{
+						value = value * 10 + (*e - '0');
+					}
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (exponent < 0)
+		{
+			result = exponent < -308 ? 0.0 : result * powersOfTen.negative[-exponent];
+		}
+		else if (exponent > 0)
+		{
+			result = exponent > 308 ? HUGE_VAL : result * powersOfTen.positive[exponent];
+		}
+		out = (float)(negative ? -result : result);
+		return p;
+	}
+
+	// Parse a signed integer, returns nullptr if there is none
+	const char* ParseInt(const char* p, const char* end, int32_t& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+		if (p >= end || (unsigned)(*p - '0') >= 10)
+		{
+			return nullptr;
+		}
+		int64_t value = 0;
+		for (; p < end && (unsigned)(*p - '0') < 10; p++)
+		{
+			if (value < INT32_MAX)
+			{
+				value = value * 10 + (*p - '0');
+			}
+		}
+		if (value > INT32_MAX)
+		{
+			value = INT32_MAX;
+		}
+		out = (int32_t)(negative ? -value : value);
+		return p;
+	}
+
+	// Turn an OBJ index (1 based, or negative from the current end of the list) into a 0 based index
+	inline int32_t ResolveIndex(int32_t index, size_t localCount, uint8_t bit, uint8_t& relative)
+	{
+		if (index > 0)
+		{
+			return index - 1;
+		}
+		// negative indices count back from the elements read so far, which are only known relative to this chunk
+		relative |= bit;
+		return (int32_t)localCount + index;
+	}
+
+	void ParseChunk(Chunk& chunk)
+	{
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+		chunk.valid = true;
+
+		std::vector<Corner> polygon;
+
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+			if (p >= end)
+			{
+				break;
+			}
+
+			if (p[0] == 'v' && p + 1 < end)
+			{
+				if (IsSpace(p[1]))
+				{
+					XMFLOAT3 position(0.0f, 0.0f, 0.0f);
+					const char* q = p + 2;
+					q = q ? ParseFloat(q, end, position.x) : nullptr;
+					q = q ? ParseFloat(q, end, position.y) : nullptr;
+					q = q ? ParseFloat(q, end, position.z) : nullptr;
+					chunk.positions.push_back(position);
+				}
+				else if (p[1] == 't' && p + 2 < end && IsSpace(p[2]))
+				{
+					XMFLOAT2 texCoord(0.0f, 0.0f);
+					const char* q = p + 3;
+					q = q ? ParseFloat(q, end, texCoord.x) : nullptr;
+					q = q ? ParseFloat(q, end, texCoord.y) : nullptr;
+					chunk.texCoords.push_back(texCoord);
+				}
+				else if (p[1] == 'n' && p + 2 < end && IsSpace(p[2]))
+				{
+					XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+					const char* q = p + 3;
+					q = q ? ParseFloat(q, end, normal.x) : nullptr;
+					q = q ? ParseFloat(q, end, normal.y) : nullptr;
+					q = q ? ParseFloat(q, end, normal.z) : nullptr;
+					chunk.normals.push_back(normal);
+				}
+			}
+			else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1]))
+			{
+				// Corners are v, v/vt, v//vn or v/vt/vn
+				polygon.clear();
+				const char* q = p + 2;
+				while (true)
+				{
+					q = SkipSpaces(q, end);
+					Corner corner;
+					corner.vt = missingIndex;
+					corner.vn = missingIndex;
+					corner.relative = 0;
+
+					int32_t index;
+					const char* next = ParseInt(q, end, index);
+					if (next == nullptr || index == 0)
+					{
+						break;
+					}
+					corner.v = ResolveIndex(index, chunk.positions.size(), 1, corner.relative);
+					q = next;
+
+					if (q < end && *q == '/')
+					{
+						q++;
+						next = ParseInt(q, end, index);
+						if (next)
+						{
+							corner.vt = ResolveIndex(index, chunk.texCoords.size(), 2, corner.relative);
+							q = next;
+						}
+						if (q < end && *q == '/')
+						{
+							q++;
+							next = ParseInt(q, end, index);
+							if (next)
+							{
+								corner.vn = ResolveIndex(index, chunk.normals.size(), 4, corner.relative);
+								q = next;
+							}
+						}
+					}
+					polygon.push_back(corner);
+				}
+
+				// Triangulate as a fan around the first corner
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i - 1]);
+					chunk.corners.push_back(polygon[i]);
+				}
+			}
+
+			p = SkipLine(p, end);
+		}
+	}
+}
+
+bool ObjParser::load(const char* filename, ObjMesh& mesh, int threadCount)
+{
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		return false;
+	}
+	return parse(file.getData(), file.getSize(), mesh, threadCount);
+}
+
+bool ObjParser::parse(const char* data, size_t size, ObjMesh& mesh, int threadCount)
+{
+	PROFILE_FUNCTION();
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency();
+	}
+	size_t maxChunks = size / minChunkSize + 1;
+	int chunkCount = threadCount < 1 ? 1 : ((size_t)threadCount < maxChunks ? threadCount : (int)maxChunks);
+
+	// Split in line aligned chunks of about the same size
+	std::vector<Chunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* begin = data;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = i == chunkCount - 1 ? end : data + size / chunkCount * (i + 1);
+		if (chunkEnd < begin)
+		{
+			chunkEnd = begin;
+		}
+		if (chunkEnd < end)
+		{
+			chunkEnd = SkipLine(chunkEnd, end);
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = chunkEnd;
+		begin = chunkEnd;
+	}
+
+	// Parse every chunk on its own thread (the first one on this thread)
+	std::vector<std::thread> threads;
+	for (int i = 1; i < chunkCount; i++)
+	{
+		threads.push_back(std::thread(ParseChunk, std::ref(chunks[i])));
+	}
+	ParseChunk(chunks[0]);
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+
+	// Merge the vertex attributes
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> texCoords;
+	std::vector<XMFLOAT3> normals;
+	size_t cornerCount = 0;
+	std::vector<size_t> positionOffset(chunkCount), texCoordOffset(chunkCount), normalOffset(chunkCount);
+	for (int i = 0; i < chunkCount; i++)
+	{
+		positionOffset[i] = positions.size();
+		texCoordOffset[i] = texCoords.size();
+		normalOffset[i] = normals.size();
+		positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+		texCoords.insert(texCoords.end(), chunks[i].texCoords.begin(), chunks[i].texCoords.end());
+		normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+		cornerCount += chunks[i].corners.size();
+
+		std::vector<XMFLOAT3>().swap(chunks[i].positions);
+		std::vector<XMFLOAT2>().swap(chunks[i].texCoords);
+		std::vector<XMFLOAT3>().swap(chunks[i].normals);
+	}
+
+	// Deduplicate the v/vt/vn combinations. Every position keeps a list of the vertices made from it
+	// (nearly always one), faces use nearby positions so this is much more cache friendly than a hash table
+	const uint32_t noVertex = 0xFFFFFFFF;
+	std::vector<uint32_t> firstVertex(positions.size(), noVertex);
+	std::vector<uint32_t> nextVertex;
+	std::vector<uint32_t> vertexPosition;
+	std::vector<int32_t> vertexTexCoord, vertexNormal;
+	nextVertex.reserve(positions.size());
+	vertexPosition.reserve(positions.size());
+	vertexTexCoord.reserve(positions.size());
+	vertexNormal.reserve(positions.size());
+	mesh.vertices.reserve(positions.size());
+	mesh.indices.reserve(cornerCount);
+
+	bool missingNormals = false;
+	for (int c = 0; c < chunkCount; c++)
+	{
+		const std::vector<Corner>& corners = chunks[c].corners;
+		for (size_t i = 0; i < corners.size(); i++)
+		{
+			const Corner& corner = corners[i];
+			int64_t v = corner.v + ((corner.relative & 1) ? (int64_t)positionOffset[c] : 0);
+			int64_t vt = corner.vt == missingIndex ? -1 : corner.vt + ((corner.relative & 2) ? (int64_t)texCoordOffset[c] : 0);
+			int64_t vn = corner.vn == missingIndex ? -1 : corner.vn + ((corner.relative & 4) ? (int64_t)normalOffset[c] : 0);
+
+			if (v < 0 || v >= (int64_t)positions.size() || vt < -1 || vt >= (int64_t)texCoords.size() || vn < -1 || vn >= (int64_t)normals.size())
+			{
+				// Index out of range
+				mesh.vertices.clear();
+				mesh.indices.clear();
+				return false;
+			}
+
+			uint32_t vertex = firstVertex[(size_t)v];
+			while (vertex != noVertex && (vertexTexCoord[vertex] != vt || vertexNormal[vertex] != vn))
+			{
+				vertex = nextVertex[vertex];
+			}
+
+			if (vertex == noVertex)
+			{
+				vertex = (uint32_t)mesh.vertices.size();
+				nextVertex.push_back(firstVertex[(size_t)v]);
+				firstVertex[(size_t)v] = vertex;
+				vertexPosition.push_back((uint32_t)v);
+				vertexTexCoord.push_back((int32_t)vt);
+				vertexNormal.push_back((int32_t)vn);
+
+				ObjVertex newVertex;
+				newVertex.position = positions[(size_t)v];
+				newVertex.texture = vt >= 0 ? texCoords[(size_t)vt] : XMFLOAT2(0.0f, 0.0f);
+				newVertex.normal = vn >= 0 ? normals[(size_t)vn] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+				missingNormals |= vn < 0;
+				mesh.vertices.push_back(newVertex);
+			}
+			mesh.indices.push_back(vertex);
+		}
+	}
+
+	if (missingNormals)
+	{
+		// Area weighted normals accumulated per position, so vertices split by texture seams stay smooth
+		std::vector<XMFLOAT3> smooth(positions.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const XMFLOAT3& a = mesh.vertices[mesh.indices[i]].position;
+			const XMFLOAT3& b = mesh.vertices[mesh.indices[i + 1]].position;
+			const XMFLOAT3& c = mesh.vertices[mesh.indices[i + 2]].position;
+			XMFLOAT3 ab(b.x - a.x, b.y - a.y, b.z - a.z);
+			XMFLOAT3 ac(c.x - a.x, c.y - a.y, c.z - a.z);
+			XMFLOAT3 cross(ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x);
+			for (int k = 0; k < 3; k++)
+			{
+				XMFLOAT3& n = smooth[vertexPosition[mesh.indices[i + k]]];
+				n.x += cross.x;
+				n.y += cross.y;
+				n.z += cross.z;
+			}
+		}
+
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			if (vertexNormal[i] < 0)
+			{
+				XMFLOAT3 n = smooth[vertexPosition[i]];
+				float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+				mesh.vertices[i].normal = length > 0.0f ? XMFLOAT3(n.x / length, n.y / length, n.z / length) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,47 @@
+/**
+* \class ObjParser
+*
+* \brief Fast Wavefront OBJ loader
+*
+* Memory maps the file, splits it in line aligned chunks that are parsed on several threads with a hand written
+* number parser, then merges the chunks into an indexed mesh with one vertex per unique v/vt/vn combination.
+* Polygons with more than three corners are triangulated as fans, faces without vt get (0, 0) texture coordinates
+* and faces without vn get smooth normals built from the triangles. Negative (relative) indices are supported.
+* Only geometry is read, materials, groups and smoothing groups are skipped.
+*/
+
+#ifndef _OBJPARSER_H_
+#define _OBJPARSER_H_
+
+#include <directxmath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+/// Vertex of a parsed OBJ, the same layout as BaseMesh::VertexType
+struct ObjVertex
+{
+	XMFLOAT3 position;
+	XMFLOAT2 texture;
+	XMFLOAT3 normal;
+};
+
+/// Indexed triangle list produced by ObjParser
+struct ObjMesh
+{
+	std::vector<ObjVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+class ObjParser
+{
+public:
+	/// Load an OBJ file. threadCount 0 uses one thread per hardware thread. Returns false if the file cannot be read or has invalid indices
+	static bool load(const char* filename, ObjMesh& mesh, int threadCount = 0);
+	/// Parse OBJ text already in memory (it does not need to be null terminated)
+	static bool parse(const char* data, size_t size, ObjMesh& mesh, int threadCount = 0);
+};
+
+#endif
@@ -2,10 +2,12 @@
 // For geometry shader demonstration.
 // Note sendData() override.
 #include "pointmesh.h"
+#include "GeometryBuilder.h"
 
 // Initialise buffers and load texture.
-PointMesh::PointMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+PointMesh::PointMesh(RenderDevice* device)
 {
+	renderer = device;
 	initBuffers(device);
 }
 
@@ -16,88 +18,21 @@ PointMesh::~PointMesh()
 	BaseMesh::~BaseMesh();
 }
 
-// Generate point mesh. Simple triangle.
-void PointMesh::initBuffers(ID3D11Device* device)
+// Generate point mesh. Simple triangle, drawn as its 3 points.
+void PointMesh::initBuffers(RenderDevice* device)
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-
-	vertexCount = 3;
-	indexCount = 3;
-
-
-	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-
-	// Load the vertex array with data.
-	vertices[0].position = XMFLOAT3(0.0f, 1.0f, 0.0f);  // Top.
-	vertices[0].texture = XMFLOAT2(0.0f, 1.0f);
-	vertices[0].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	vertices[1].position = XMFLOAT3(-1.0f, 0.0f, 0.0f);  // Bottom left.
-	vertices[1].texture = XMFLOAT2(0.0f, 0.0f);
-	vertices[1].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	vertices[2].position = XMFLOAT3(1.0f, 0.0f, 0.0f);  // Bottom right.
-	vertices[2].texture = XMFLOAT2(1.0f, 0.0f);
-	vertices[2].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	// Load the index array with data.
-	indices[0] = 0;  // Top/
-	indices[1] = 1;  // Bottom left.
-	indices[2] = 2;  // Bottom right.
-
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType)* vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
-
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-
-	delete[] indices;
-	indices = 0;
+	GeometryBuilder& geometry = GeometryBuilder::getStaging();
+	geometry.clear();
+	geometry.addTriangle(XMFLOAT2(0.0f, 1.0f), XMFLOAT2(0.0f, 0.0f), XMFLOAT2(1.0f, 0.0f));
+	uploadGeometry(device, geometry);
 }
 
 // Override sendData()
 // Change in primitive topology (pointlist instead of trianglelist) for geometry shader use.
-void PointMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top)
+void PointMesh::sendData(RenderDevice* device, D3D_PRIMITIVE_TOPOLOGY top)
 {
-	unsigned int stride;
-	unsigned int offset;
-
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
-	offset = 0;
-
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	deviceContext->IASetPrimitiveTopology(top);
+	device->setVertexBuffer(vertexBuffer, sizeof(VertexType));
+	device->setIndexBuffer(indexBuffer, indexFormat);
+	device->setPrimitiveTopology(top);
 }
 
@@ -0,0 +1,364 @@
+// Profiler
+// Scoped CPU zones recorded in per thread ring buffers, gathered per frame and exported as Chrome traces.
+#include "Profiler.h"
+#include "imGUI/imgui.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+
+namespace
+{
+	const uint64_t kRingSize = 1 << 16;		// zones kept per thread, a power of two
+
+	struct ZoneEvent
+	{
+		const char* name;
+		uint64_t start, end;
+		uint32_t depth;
+	};
+
+	// Ring of the finished zones of one thread. Only its thread writes it, readers check written to detect overwrites
+	struct ThreadLog
+	{
+		ZoneEvent events[kRingSize];
+		std::atomic<uint64_t> written;
+		uint32_t depth;
+		uint32_t id;
+		const char* name;
+	};
+
+	// Logs are kept after their thread exits, so traces still show its zones
+	std::mutex logsMutex;
+	std::vector<ThreadLog*> logs;
+	thread_local ThreadLog* threadLog = nullptr;
+
+	const uint64_t clockStart = Profiler::now();
+
+	// Frame state, only used by the thread calling beginFrame()/endFrame()
+	uint64_t frameStart = 0;
+	uint64_t frameFirstEvent = 0;
+	uint32_t frameDepth = 0;
+	double frameMilliseconds = 0.0;
+	std::vector<Profiler::FrameZone> frameZones;
+
+	ThreadLog* GetThreadLog()
+	{
+		if (!threadLog)
+		{
+			threadLog = new ThreadLog();
+			threadLog->written = 0;
+			threadLog->depth = 0;
+			threadLog->name = nullptr;
+			std::lock_guard<std::mutex> lock(logsMutex);
+			threadLog->id = (uint32_t)logs.size();
+			logs.push_back(threadLog);
+		}
+		return threadLog;
+	}
+
+	// Copy the events of a log written since first (or the ones still in the ring), safe while its thread writes
+	void CopyEvents(const ThreadLog& log, uint64_t first, std::vector<ZoneEvent>& events)
+	{
+		uint64_t written = log.written.load(std::memory_order_acquire);
+		// Skip the oldest part of a full ring, the writer may be overwriting it during the copy
+		if (written > kRingSize && first < written - kRingSize + kRingSize / 8)
+		{
+			first = written - kRingSize + kRingSize / 8;
+		}
+		size_t copied = events.size();
+		for (uint64_t i = first; i < written; i++)
+		{
+			events.push_back(log.events[i & (kRingSize - 1)]);
+		}
+
+		// Drop anything that was overwritten while copying
+		uint64_t writtenAfter = log.written.load(std::memory_order_acquire);
+		if (writtenAfter > kRingSize && writtenAfter - kRingSize > first)
+		{
+			size_t overwritten = (size_t)std::min<uint64_t>(writtenAfter - kRingSize - first, events.size() - copied);
+			events.erase(events.begin() + copied, events.begin() + copied + overwritten);
+		}
+	}
+
+	struct TreeNode
+	{
+		const char* name;
+		int depth;
+		int calls;
+		uint64_t time;
+		uint64_t childTime;
+		std::vector<int> children;
+	};
+
+	void Flatten(const std::vector<TreeNode>& nodes, int node, std::vector<Profiler::FrameZone>& zones)
+	{
+		const TreeNode& tree = nodes[node];
+		Profiler::FrameZone zone;
+		zone.name = tree.name;
+		zone.depth = tree.depth;
+		zone.calls = tree.calls;
+		zone.milliseconds = tree.time / 1e6;
+		zone.selfMilliseconds = (tree.time - std::min(tree.childTime, tree.time)) / 1e6;
+		zones.push_back(zone);
+		for (size_t i = 0; i < tree.children.size(); i++)
+		{
+			Flatten(nodes, tree.children[i], zones);
+		}
+	}
+
+	void WriteJSONString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (; *text; text++)
+		{
+			if (*text == '"' || *text == '\\')
+			{
+				file << '\\';
+			}
+			if ((unsigned char)*text >= 0x20)
+			{
+				file << *text;
+			}
+		}
+		file << '"';
+	}
+}
+
+uint64_t Profiler::now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::beginZone()
+{
+	GetThreadLog()->depth++;
+}
+
+void Profiler::endZone(const char* name, uint64_t start)
+{
+	uint64_t end = now();
+	ThreadLog* log = threadLog;
+	log->depth--;
+
+	uint64_t index = log->written.load(std::memory_order_relaxed);
+	ZoneEvent& event = log->events[index & (kRingSize - 1)];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	event.depth = log->depth;
+	log->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::beginFrame()
+{
+	ThreadLog* log = GetThreadLog();
+	frameStart = now();
+	frameFirstEvent = log->written.load(std::memory_order_relaxed);
+	frameDepth = log->depth;
+}
+
+void Profiler::endFrame()
+{
+	ThreadLog* log = GetThreadLog();
+	uint64_t frameEnd = now();
+	frameMilliseconds = (frameEnd - frameStart) / 1e6;
+
+	std::vector<ZoneEvent> events;
+	CopyEvents(*log, frameFirstEvent, events);
+
+	// Zones are recorded when they end, sort them by start to rebuild the nesting (outer zones first on ties)
+	std::sort(events.begin(), events.end(), [](const ZoneEvent& a, const ZoneEvent& b)
+	{
+		return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+	});
+
+	// Node 0 is the frame, parents[d] is the last node opened at depth d
+	std::vector<TreeNode> nodes(1);
+	nodes[0].name = "Frame";
+	nodes[0].depth = 0;
+	nodes[0].calls = 1;
+	nodes[0].time = frameEnd - frameStart;
+	nodes[0].childTime = 0;
+	std::vector<int> parents(1, 0);
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const ZoneEvent& event = events[i];
+		if (event.depth < frameDepth)
+		{
+			continue;
+		}
+		size_t depth = event.depth - frameDepth + 1;
+		if (depth > parents.size())
+		{
+			depth = parents.size();		// parent lost from the ring, attach to the deepest known node
+		}
+		int parent = parents[depth - 1];
+
+		// Merge repeated zones with the same parent
+		int node = -1;
+		for (size_t c = 0; c < nodes[parent].children.size(); c++)
+		{
+			if (nodes[nodes[parent].children[c]].name == event.name)
+			{
+				node = nodes[parent].children[c];
+				break;
+			}
+		}
+		if (node < 0)
+		{
+			TreeNode child;
+			child.name = event.name;
+			child.depth = (int)depth;
+			child.calls = 0;
+			child.time = 0;
+			child.childTime = 0;
+			node = (int)nodes.size();
+			nodes.push_back(child);
+			nodes[parent].children.push_back(node);
+		}
+
+		uint64_t duration = event.end - event.start;
+		nodes[node].calls++;
+		nodes[node].time += duration;
+		nodes[parent].childTime += duration;
+
+		parents.resize(depth + 1);
+		parents[depth] = node;
+	}
+
+	frameZones.clear();
+	Flatten(nodes, 0, frameZones);
+}
+
+const std::vector<Profiler::FrameZone>& Profiler::getFrameZones()
+{
+	return frameZones;
+}
+
+double Profiler::getFrameMilliseconds()
+{
+	return frameMilliseconds;
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	GetThreadLog()->name = name;
+}
+
+void Profiler::drawGui(bool* open)
+{
+	static bool paused = false;
+	static bool treeView = false;
+	static std::vector<FrameZone> shownZones;
+	static double shownMilliseconds = 0.0;
+	static const char* exportResult = "";
+
+	if (!paused)
+	{
+		shownZones = frameZones;
+		shownMilliseconds = frameMilliseconds;
+	}
+
+	if (!ImGui::Begin("Profiler", open))
+	{
+		ImGui::End();
+		return;
+	}
+	ImGui::Text("Frame: %.2f ms", shownMilliseconds);
+	ImGui::Checkbox("Pause", &paused);
+	ImGui::SameLine();
+	ImGui::Checkbox("Tree", &treeView);
+	ImGui::SameLine();
+	if (ImGui::Button("Export trace"))
+	{
+		exportResult = writeChromeTrace("profile.json") ? "Saved profile.json" : "Could not write profile.json";
+	}
+	ImGui::SameLine();
+	ImGui::Text("%s", exportResult);
+	ImGui::Separator();
+
+	if (treeView)
+	{
+		for (size_t i = 0; i < shownZones.size(); i++)
+		{
+			const FrameZone& zone = shownZones[i];
+			ImGui::Text("%*s%s  %.3f ms (self %.3f) x%d", zone.depth * 2, "", zone.name, zone.milliseconds, zone.selfMilliseconds, zone.calls);
+		}
+	}
+	else
+	{
+		// Self time per zone name over the whole frame, the top of this list is where the frame goes
+		std::vector<FrameZone> totals;
+		for (size_t i = 1; i < shownZones.size(); i++)
+		{
+			const FrameZone& zone = shownZones[i];
+			size_t t = 0;
+			while (t < totals.size() && totals[t].name != zone.name)
+			{
+				t++;
+			}
+			if (t == totals.size())
+			{
+				totals.push_back(zone);
+				totals[t].depth = 0;
+				continue;
+			}
+			totals[t].calls += zone.calls;
+			totals[t].milliseconds += zone.milliseconds;
+			totals[t].selfMilliseconds += zone.selfMilliseconds;
+		}
+		std::sort(totals.begin(), totals.end(), [](const FrameZone& a, const FrameZone& b) { return a.selfMilliseconds > b.selfMilliseconds; });
+
+		ImGui::Text("%-32s %9s %9s %6s", "Zone", "Self ms", "Total ms", "Calls");
+		for (size_t i = 0; i < totals.size() && i < 20; i++)
+		{
+			ImGui::Text("%-32.32s %9.3f %9.3f %6d", totals[i].name, totals[i].selfMilliseconds, totals[i].milliseconds, totals[i].calls);
+		}
+	}
+	ImGui::End();
+}
+
+bool Profiler::writeChromeTrace(const char* filename)
+{
+	std::ofstream file(filename);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(logsMutex);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	char buffer[128];
+	std::vector<ZoneEvent> events;
+	for (size_t l = 0; l < logs.size(); l++)
+	{
+		const ThreadLog& log = *logs[l];
+		if (log.name)
+		{
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log.id << ",\"args\":{\"name\":";
+			WriteJSONString(file, log.name);
+			file << "}}";
+			first = false;
+		}
+
+		events.clear();
+		CopyEvents(log, 0, events);
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			// Complete events, timestamps in microseconds since the profiler started
+			const ZoneEvent& event = events[i];
+			file << (first ? "" : ",\n") << "{\"name\":";
+			WriteJSONString(file, event.name);
+			snprintf(buffer, sizeof(buffer), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				(double)(event.start - std::min(event.start, clockStart)) / 1000.0, (double)(event.end - event.start) / 1000.0, log.id);
+			file << buffer;
+			first = false;
+		}
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
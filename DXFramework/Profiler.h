@@ -0,0 +1,94 @@
+/**
+* \class Profiler
+*
+* \brief Low overhead hierarchical CPU profiler
+*
+* Code is instrumented with scoped zones (PROFILE_ZONE("name") or PROFILE_FUNCTION()), a zone measures the time until
+* the end of its scope. Each thread records its finished zones into its own ring buffer, without locks, so zones
+* can be placed in worker threads too. Zone names must be string literals (only the pointer is stored).
+* Once per frame (endFrame()) the zones of the main thread are gathered into a tree of the frame, which drawGui()
+* shows as an ImGui window with the most expensive zones. writeChromeTrace() saves what the ring buffers hold, for
+* every thread, as a Chrome trace_event JSON file (open it in chrome://tracing or https://ui.perfetto.dev).
+* Define DISABLE_PROFILER to compile the zones out.
+*/
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <cstdint>
+#include <vector>
+
+class Profiler
+{
+public:
+	/// One node of the frame tree, zones with the same name under the same parent are merged
+	struct FrameZone
+	{
+		const char* name;
+		int depth;
+		int calls;
+		double milliseconds;		///< Time inside the zone, children included
+		double selfMilliseconds;	///< Time inside the zone, children excluded
+	};
+
+	/// Nanoseconds of a monotonic clock (std::chrono::steady_clock)
+	static uint64_t now();
+
+	/// Mark the start of a frame on the main thread, its zones are gathered by endFrame()
+	static void beginFrame();
+	/// Build the frame tree of the zones recorded on this thread since beginFrame()
+	static void endFrame();
+
+	/// Tree of the last frame, in depth first order
+	static const std::vector<FrameZone>& getFrameZones();
+	/// Duration of the last frame
+	static double getFrameMilliseconds();
+
+	/// ImGui window with the frame time and the zones of the last frame, sorted by self time or as a tree
+	static void drawGui(bool* open = nullptr);
+
+	/// Write every zone still held in the ring buffers of all threads, returns false if the file cannot be written
+	static bool writeChromeTrace(const char* filename);
+
+	/// Name of the current thread in traces
+	static void setThreadName(const char* name);
+
+	// Used by ProfileZone
+	static void beginZone();
+	static void endZone(const char* name, uint64_t start);
+};
+
+/// Measures the time from its construction to the end of its scope
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* lname) : name(lname)
+	{
+		Profiler::beginZone();
+		start = Profiler::now();
+	}
+	~ProfileZone()
+	{
+		Profiler::endZone(name, start);
+	}
+
+private:
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	const char* name;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef DISABLE_PROFILER
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#endif
+
+#endif
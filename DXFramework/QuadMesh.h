@@ -12,11 +12,11 @@ class QuadMesh : public BaseMesh
 {
 
 public:
-	QuadMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	QuadMesh(RenderDevice* device);
 	~QuadMesh();
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	
 };
 
@@ -0,0 +1,48 @@
+// Recording upload backend
+// System memory ring buffer that logs the calls, for running the uploads without a device.
+#include "RecordingUploadBackend.h"
+#include <cstring>
+
+RecordingUploadBackend::RecordingUploadBackend()
+{
+	mapped = false;
+}
+
+RecordingUploadBackend::~RecordingUploadBackend()
+{
+}
+
+bool RecordingUploadBackend::createRing(size_t size)
+{
+	ring.assign(size, 0);
+	mapped = false;
+	return true;
+}
+
+void* RecordingUploadBackend::mapRing(bool discard)
+{
+	UploadRecord record = { discard ? UploadRecord::kMapDiscard : UploadRecord::kMapNoOverwrite, nullptr, 0, 0, 0 };
+	records.push_back(record);
+	mapped = true;
+	return ring.data();
+}
+
+void RecordingUploadBackend::unmapRing()
+{
+	UploadRecord record = { UploadRecord::kUnmap, nullptr, 0, 0, 0 };
+	records.push_back(record);
+	mapped = false;
+}
+
+void RecordingUploadBackend::copyToBuffer(GpuBuffer* destination, size_t destinationOffset, size_t ringOffset, size_t size)
+{
+	UploadRecord record = { UploadRecord::kCopy, destination, destinationOffset, ringOffset, size };
+	records.push_back(record);
+
+	std::vector<unsigned char>* buffer = reinterpret_cast<std::vector<unsigned char>*>(destination);
+	if (buffer->size() < destinationOffset + size)
+	{
+		buffer->resize(destinationOffset + size);
+	}
+	memcpy(buffer->data() + destinationOffset, ring.data() + ringOffset, size);
+}
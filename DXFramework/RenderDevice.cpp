@@ -0,0 +1,90 @@
+// Render device
+// State shared by the render device backends: screen, default matrices, render state flags and frame statistics.
+#include "RenderDevice.h"
+
+void RenderStats::reset()
+{
+	drawCalls = 0;
+	vertices = 0;
+	dispatches = 0;
+	bufferWrites = 0;
+	bufferWriteBytes = 0;
+	bindings = 0;
+	creations = 0;
+}
+
+RenderDevice::RenderDevice(int screenWidth, int screenHeight, float screenDepth, float screenNear)
+{
+	wireframeState = false;
+	zbufferState = true;
+	alphaBlendState = false;
+
+	screenheight = screenHeight;
+	screenwidth = screenWidth;
+	nearPlane = screenNear;
+	farPlane = screenDepth;
+
+	// Setup the projection matrix.
+	fieldOfView = (float)XM_PI / 4.0f;
+	screenAspect = (float)screenwidth / (float)screenheight;
+
+	// Create the projection matrix for 3D rendering.
+	projectionMatrix = XMMatrixPerspectiveFovLH(fieldOfView, screenAspect, nearPlane, farPlane);
+
+	// Initialize the world matrix to the identity matrix.
+	worldMatrix = XMMatrixIdentity();
+
+	// Create an orthographic projection matrix for 2D rendering.
+	orthoMatrix = XMMatrixOrthographicLH((float)screenwidth, (float)screenheight, nearPlane, farPlane);
+}
+
+RenderDevice::~RenderDevice()
+{
+}
+
+void RenderDevice::finishFrameStats()
+{
+	lastFrameStats = frameStats;
+	frameStats.reset();
+}
+
+size_t RenderDevice::getTextureSize(const D3D11_TEXTURE2D_DESC& desc)
+{
+	// Bits per texel of the common formats, block compressed formats are counted per 4x4 block
+	size_t bits = 32;
+	bool blockCompressed = false;
+	switch (desc.Format)
+	{
+	case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+		bits = 4; blockCompressed = true; break;
+	case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB: case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM: case DXGI_FORMAT_BC6H_UF16: case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB:
+		bits = 8; blockCompressed = true; break;
+	case DXGI_FORMAT_R8_UNORM:
+		bits = 8; break;
+	case DXGI_FORMAT_R8G8_UNORM: case DXGI_FORMAT_R16_UNORM: case DXGI_FORMAT_R16_FLOAT:
+		bits = 16; break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: case DXGI_FORMAT_R16G16B16A16_UNORM: case DXGI_FORMAT_R32G32_FLOAT:
+		bits = 64; break;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		bits = 128; break;
+	default:
+		break;
+	}
+
+	size_t size = 0;
+	UINT mipLevels = desc.MipLevels > 0 ? desc.MipLevels : 1;
+	for (UINT mip = 0; mip < mipLevels; mip++)
+	{
+		size_t width = desc.Width >> mip > 0 ? desc.Width >> mip : 1;
+		size_t height = desc.Height >> mip > 0 ? desc.Height >> mip : 1;
+		if (blockCompressed)
+		{
+			width = (width + 3) & ~(size_t)3;
+			height = (height + 3) & ~(size_t)3;
+		}
+		size += width * height * bits / 8;
+	}
+	return size * (desc.ArraySize > 0 ? desc.ArraySize : 1);
+}
@@ -0,0 +1,175 @@
+/**
+* \class RenderDevice
+*
+* \brief Thin interface over the graphics API: buffers, textures, shaders, render states and draw calls
+*
+* The meshes, shaders, texture manager and applications only talk to a RenderDevice, so the same frame runs on
+* Direct3D 11 (D3D) or without a window and a GPU (NullRenderDevice, which keeps the buffers in memory and counts the work).
+* The objects it creates are opaque handles only the device that created them understands, and have to be released
+* through it. The descriptions and enums are the Direct3D 11 ones: the layer hides the device objects and the device
+* context, not the concepts of the API.
+* The device also holds the state shared by every backend: screen size, default matrices and render state flags.
+*/
+
+#ifndef _RENDERDEVICE_H_
+#define _RENDERDEVICE_H_
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <cstddef>
+
+using namespace DirectX;
+
+class UploadBackend;
+
+// Objects created by a render device
+struct GpuBuffer;		///< Vertex, index or constant buffer
+struct GpuTexture;		///< Texture, as read by the shaders (a shader resource view)
+struct GpuShader;		///< Compiled shader of any stage
+struct GpuInputLayout;	///< Vertex layout of a vertex shader
+struct GpuSampler;		///< Sampler state
+
+enum ShaderStage
+{
+	kVertexShader = 0,
+	kHullShader,
+	kDomainShader,
+	kGeometryShader,
+	kPixelShader,
+	kComputeShader,
+	kShaderStageCount
+};
+
+/// Work submitted to a device, per frame
+struct RenderStats
+{
+	RenderStats() { reset(); }
+	void reset();
+
+	unsigned int drawCalls;				///< draw and drawIndexed calls
+	unsigned long long vertices;		///< Vertices (or indices) drawn
+	unsigned int dispatches;
+	unsigned int bufferWrites;			///< mapBuffer calls
+	unsigned long long bufferWriteBytes;	///< Size of the mapped buffers
+	unsigned int bindings;				///< Buffers, shaders, layouts, textures and samplers bound
+	unsigned int creations;				///< Objects created
+};
+
+class RenderDevice
+{
+public:
+	void* operator new(size_t i)
+	{
+		return _mm_malloc(i, 16);
+	}
+
+	void operator delete(void* p)
+	{
+		_mm_free(p);
+	}
+
+	/** \brief Set up the state shared by the backends
+	* @param screenWidth
+	* @param screenHeight
+	* @param screenDepth is the distance of the far plane for projection matrix generation
+	* @param screenNear is the near plane for projection matrix generation
+	*/
+	RenderDevice(int screenWidth, int screenHeight, float screenDepth, float screenNear);
+	virtual ~RenderDevice();
+
+	// Frame
+	virtual void beginScene(float r, float g, float b, float a) = 0;	///< Begin rendering frame, set background colour
+	virtual void endScene() = 0;							///< End scene rendering, present the frame
+	virtual void setBackBufferRenderTarget() = 0;			///< Sets the back buffer as the render target
+	virtual void resetViewport() = 0;						///< Restores the viewport of the back buffer
+
+	// Render states
+	virtual void setZBuffer(bool b) = 0;			///< Sets z-buffer on/off for orthographic rendering
+	virtual void setAlphaBlending(bool b) = 0;		///< Sets the alpha blending state on/off for transparent rendering
+	virtual void setWireframeMode(bool b) = 0;		///< Set wireframe render mode on/off
+	bool getZBufferState() const { return zbufferState; }
+	bool getAlphaBlendingState() const { return alphaBlendState; }
+	bool getWireframeState() const { return wireframeState; }
+
+	XMMATRIX getProjectionMatrix() const { return projectionMatrix; }	///< Returns default projection matrix
+	XMMATRIX getWorldMatrix() const { return worldMatrix; }				///< Returns identity world matrix
+	XMMATRIX getOrthoMatrix() const { return orthoMatrix; }				///< Returns default orthographic matrix
+	int getScreenWidth() const { return screenwidth; }
+	int getScreenHeight() const { return screenheight; }
+
+	// Buffers
+	/// Create a buffer, 'data' (desc.ByteWidth bytes) can be null unless the buffer is immutable. Returns nullptr on failure
+	virtual GpuBuffer* createBuffer(const D3D11_BUFFER_DESC& desc, const void* data) = 0;
+	/// Map a dynamic buffer for writing, discarding its contents. Returns nullptr on failure
+	virtual void* mapBuffer(GpuBuffer* buffer) = 0;
+	virtual void unmapBuffer(GpuBuffer* buffer) = 0;
+	virtual void releaseBuffer(GpuBuffer* buffer) = 0;
+
+	// Textures
+	/// Create a 2D texture (array) and its view, 'data' has one entry per mip and slice or is null. Returns nullptr on failure
+	virtual GpuTexture* createTexture(const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* data) = 0;
+	/// Create a texture from an image file in memory, a DDS file or any format WIC decodes. Returns nullptr on failure
+	virtual GpuTexture* loadTexture(const void* fileData, size_t size, bool dds) = 0;
+	/// Approximate GPU memory of a texture (all mips and array slices)
+	virtual size_t getTextureSize(GpuTexture* texture) = 0;
+	virtual void releaseTexture(GpuTexture* texture) = 0;
+
+	// Shaders
+	/// Create a shader from its compiled bytecode (a .cso file). Returns nullptr on failure
+	virtual GpuShader* createShader(ShaderStage stage, const void* bytecode, size_t size) = 0;
+	/// Create the layout mapping the vertex elements to the inputs of a vertex shader. Returns nullptr on failure
+	virtual GpuInputLayout* createInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void* bytecode, size_t size) = 0;
+	virtual GpuSampler* createSampler(const D3D11_SAMPLER_DESC& desc) = 0;
+	virtual void releaseShader(GpuShader* shader) = 0;
+	virtual void releaseInputLayout(GpuInputLayout* layout) = 0;
+	virtual void releaseSampler(GpuSampler* sampler) = 0;
+
+	// Pipeline
+	virtual void setVertexBuffer(GpuBuffer* buffer, unsigned int stride) = 0;
+	virtual void setIndexBuffer(GpuBuffer* buffer, DXGI_FORMAT format) = 0;
+	virtual void setPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void setInputLayout(GpuInputLayout* layout) = 0;
+	/// Set the shader of a stage, nullptr disables the stage
+	virtual void setShader(ShaderStage stage, GpuShader* shader) = 0;
+	virtual void setConstantBuffer(ShaderStage stage, unsigned int slot, GpuBuffer* buffer) = 0;
+	virtual void setTexture(ShaderStage stage, unsigned int slot, GpuTexture* texture) = 0;
+	virtual void setSampler(ShaderStage stage, unsigned int slot, GpuSampler* sampler) = 0;
+
+	// Work
+	virtual void draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void dispatch(unsigned int x, unsigned int y, unsigned int z) = 0;
+
+	/// Create an upload backend copying into the buffers of this device, for an UploadRing (which deletes it)
+	virtual UploadBackend* createUploadBackend() = 0;
+
+	const RenderStats& getFrameStats() const { return frameStats; }		///< Work since the last endScene()
+	const RenderStats& getLastFrameStats() const { return lastFrameStats; }	///< Work of the previous frame
+
+	/// Memory of a texture with this description, block compressed formats are counted per 4x4 block
+	static size_t getTextureSize(const D3D11_TEXTURE2D_DESC& desc);
+
+protected:
+	/// Called by endScene(): the stats of the frame become the last frame stats
+	void finishFrameStats();
+
+	bool zbufferState;		///< Variable tracks z-buffer state
+	bool wireframeState;	///< Variable tracks wireframe state
+	bool alphaBlendState;	///< Variable tracks alpha blending state
+
+	int screenheight;
+	int screenwidth;
+	float fieldOfView;
+	float screenAspect;
+	float nearPlane;
+	float farPlane;
+
+	XMMATRIX projectionMatrix;	///< Default perspective projection matrix
+	XMMATRIX worldMatrix;		///< Identity world matrix
+	XMMATRIX orthoMatrix;		///< Default orthographic matrix
+
+	RenderStats frameStats;
+	RenderStats lastFrameStats;
+};
+
+#endif
@@ -1,5 +1,6 @@
 //System.cpp
 #include "system.h"
+#include "Profiler.h"
 
 // Initialise the window and application.
 System::System(BaseApplication* application, int screenWidth, int screenHeight, bool VSYNC, bool lFULL_SCREEN)
@@ -9,6 +10,7 @@ System::System(BaseApplication* application, int screenWidth, int screenHeight,
 	//screenHeight = 0;
 
 	FULL_SCREEN = lFULL_SCREEN;
+	Profiler::setThreadName("Main");
 
 	initialiseWindows(screenWidth, screenHeight);
 
@@ -84,7 +86,9 @@ void System::run()
 bool System::frame()
 {
 	bool result;
+	Profiler::beginFrame();
 	result = app->frame();
+	Profiler::endFrame();
 	if (!result)
 	{
 		return false;
@@ -0,0 +1,216 @@
+// Texture cache
+// Keyed texture storage with a memory budget and LRU eviction.
+#include "TextureCache.h"
+#include <cwctype>
+#include <iterator>
+
+TextureCache::TextureCache(size_t budgetBytes, ReleaseFunction lreleaseFunction, void* user)
+{
+	budget = budgetBytes;
+	usedBytes = 0;
+	evictions = 0;
+	releaseFunction = lreleaseFunction;
+	releaseUser = user;
+}
+
+TextureCache::~TextureCache()
+{
+	clear();
+}
+
+TextureCache::Key TextureCache::hashName(const wchar_t* name)
+{
+	// FNV-1a over the UTF-16 code units
+	Key hash = 0xCBF29CE484222325ull;
+	for (; *name; name++)
+	{
+		hash = (hash ^ (Key)*name) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+TextureCache::Key TextureCache::hashPath(const wchar_t* path)
+{
+	Key hash = 0xCBF29CE484222325ull;
+	for (; *path; path++)
+	{
+		wchar_t c = *path == L'\\' ? L'/' : (wchar_t)towlower(*path);
+		hash = (hash ^ (Key)c) * 0x100000001B3ull;
+	}
+	// Different seed from names, so a uid equal to a path does not collide with it
+	return hash ^ 0x9E3779B97F4A7C15ull;
+}
+
+bool TextureCache::contains(Key content) const
+{
+	return entries.find(content) != entries.end();
+}
+
+void TextureCache::insert(Key content, void* texture, size_t bytes)
+{
+	auto found = entries.find(content);
+	if (found != entries.end())
+	{
+		if (found->second.texture == texture)
+		{
+			return;
+		}
+		erase(found);
+	}
+
+	lru.push_front(content);
+	Entry entry;
+	entry.texture = texture;
+	entry.bytes = bytes;
+	entry.pins = countPins(content);
+	entry.use = lru.begin();
+	entries[content] = entry;
+	usedBytes += bytes;
+
+	evict(content);
+}
+
+void TextureCache::bind(Key name, Key content)
+{
+	auto found = names.find(name);
+	if (found == names.end())
+	{
+		Name newName;
+		newName.content = content;
+		newName.references = 0;
+		names[name] = newName;
+		return;
+	}
+
+	// Move the references of the name to its new texture
+	Name& current = found->second;
+	if (current.content == content)
+	{
+		return;
+	}
+	auto oldEntry = entries.find(current.content);
+	if (oldEntry != entries.end())
+	{
+		oldEntry->second.pins -= current.references;
+	}
+	auto newEntry = entries.find(content);
+	if (newEntry != entries.end())
+	{
+		newEntry->second.pins += current.references;
+	}
+	current.content = content;
+
+	// The old texture may now be unpinned
+	evict(content);
+}
+
+void* TextureCache::get(Key name)
+{
+	auto found = names.find(name);
+	if (found == names.end())
+	{
+		return nullptr;
+	}
+	auto entry = entries.find(found->second.content);
+	if (entry == entries.end())
+	{
+		return nullptr;
+	}
+
+	lru.splice(lru.begin(), lru, entry->second.use);
+	return entry->second.texture;
+}
+
+void TextureCache::acquire(Key name)
+{
+	// A name can be pinned before it is bound (e.g. while its texture is loading)
+	auto found = names.find(name);
+	if (found == names.end())
+	{
+		Name newName;
+		newName.content = 0;
+		newName.references = 0;
+		found = names.insert(std::make_pair(name, newName)).first;
+	}
+	found->second.references++;
+
+	auto entry = entries.find(found->second.content);
+	if (entry != entries.end())
+	{
+		entry->second.pins++;
+	}
+}
+
+void TextureCache::release(Key name)
+{
+	auto found = names.find(name);
+	if (found == names.end() || found->second.references == 0)
+	{
+		return;
+	}
+	found->second.references--;
+
+	auto entry = entries.find(found->second.content);
+	if (entry != entries.end())
+	{
+		entry->second.pins--;
+	}
+	evict(0);
+}
+
+void TextureCache::setBudget(size_t budgetBytes)
+{
+	budget = budgetBytes;
+	evict(0);
+}
+
+void TextureCache::clear()
+{
+	while (!entries.empty())
+	{
+		erase(entries.begin());
+	}
+}
+
+// Release least recently used, unpinned textures until the budget is met. keep is never evicted (the texture just inserted)
+void TextureCache::evict(Key keep)
+{
+	auto use = lru.end();
+	while (usedBytes > budget && use != lru.begin())
+	{
+		// Erasing the candidate does not invalidate use, which is the next less recently used node
+		auto candidate = std::prev(use);
+		auto entry = entries.find(*candidate);
+		if (entry->first == keep || entry->second.pins > 0)
+		{
+			use = candidate;
+			continue;
+		}
+		erase(entry);
+		evictions++;
+	}
+}
+
+void TextureCache::erase(std::unordered_map<Key, Entry>::iterator entry)
+{
+	if (releaseFunction)
+	{
+		releaseFunction(entry->second.texture, releaseUser);
+	}
+	usedBytes -= entry->second.bytes;
+	lru.erase(entry->second.use);
+	entries.erase(entry);
+}
+
+int TextureCache::countPins(Key content) const
+{
+	int pins = 0;
+	for (auto name = names.begin(); name != names.end(); name++)
+	{
+		if (name->second.content == content)
+		{
+			pins += name->second.references;
+		}
+	}
+	return pins;
+}
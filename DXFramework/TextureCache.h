@@ -0,0 +1,93 @@
+/**
+* \class TextureCache
+*
+* \brief Budgeted texture cache with LRU eviction, independent of the graphics device
+*
+* Textures are stored under a content key (e.g. the hash of the file contents) and looked up through name keys
+* (e.g. the hash of a uid). Several names can share one texture, so identical files are only loaded once.
+* When the memory used goes over the budget the least recently used textures are released, except the ones
+* pinned by a reference (acquire()/release()). A name whose texture was evicted stays bound to its content key,
+* so reinserting the same content makes it valid again.
+* Textures are opaque pointers, freed through the release function given to the constructor.
+*/
+
+#ifndef _TEXTURECACHE_H_
+#define _TEXTURECACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+class TextureCache
+{
+public:
+	typedef uint64_t Key;
+	/// Called when the cache drops a texture
+	typedef void (*ReleaseFunction)(void* texture, void* user);
+
+	TextureCache(size_t budgetBytes, ReleaseFunction releaseFunction, void* user = nullptr);
+	~TextureCache();
+
+	/// Hash of a uid string (exact)
+	static Key hashName(const wchar_t* name);
+	/// Hash of a file path, case and slash direction do not matter
+	static Key hashPath(const wchar_t* path);
+
+	/// True if a texture with this content key is stored (does not count as a use)
+	bool contains(Key content) const;
+	/// Store a texture, replacing (and releasing) any texture with the same content key, then evict to fit the budget
+	void insert(Key content, void* texture, size_t bytes);
+	/// Make a name refer to a content key
+	void bind(Key name, Key content);
+	/// Texture of a name, marked as most recently used. nullptr if the name is unknown or its texture was evicted
+	void* get(Key name);
+
+	/// Pin the texture of a name so it is not evicted, counted per call
+	void acquire(Key name);
+	/// Undo one acquire()
+	void release(Key name);
+
+	/// Change the budget, evicting textures if needed
+	void setBudget(size_t budgetBytes);
+	size_t getBudget() const { return budget; }
+	size_t getUsedBytes() const { return usedBytes; }		///< Can be over the budget when pinned textures do not fit
+	size_t getTextureCount() const { return entries.size(); }
+	size_t getEvictionCount() const { return evictions; }	///< Textures evicted since the cache was created
+
+	/// Release every texture
+	void clear();
+
+private:
+	struct Entry
+	{
+		void* texture;
+		size_t bytes;
+		int pins;						// sum of the references of the names bound to it
+		std::list<Key>::iterator use;	// position in the LRU list
+	};
+
+	struct Name
+	{
+		Key content;
+		int references;
+	};
+
+	TextureCache(const TextureCache&);
+	TextureCache& operator=(const TextureCache&);
+
+	void evict(Key keep);
+	void erase(std::unordered_map<Key, Entry>::iterator entry);
+	int countPins(Key content) const;
+
+	std::unordered_map<Key, Entry> entries;
+	std::unordered_map<Key, Name> names;
+	std::list<Key> lru;		// most recently used first
+	size_t budget;
+	size_t usedBytes;
+	size_t evictions;
+	ReleaseFunction releaseFunction;
+	void* releaseUser;
+};
+
+#endif
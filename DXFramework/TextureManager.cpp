@@ -2,21 +2,22 @@
 // Loads and stores a single texture.
 // Handles .dds, .png and .jpg (probably).
 #include "TextureManager.h"
+#include "MeshCache.h"
+#include "Profiler.h"
 
 
  //Attempt to load texture. If load fails use default texture.
  //Based on extension, uses slightly different loading function for different image types .dds vs .png/.jpg.
-TextureManager::TextureManager(ID3D11Device* ldevice, ID3D11DeviceContext* ldeviceContext)
+TextureManager::TextureManager(RenderDevice* ldevice, size_t budgetBytes)
+	: cache(budgetBytes, releaseTexture, ldevice)
 {
 	device = ldevice;
-	deviceContext = ldeviceContext;
+	texture = nullptr;
 	addDefaultTexture();
 }
 
 void TextureManager::loadTexture(const wchar_t* uid, const wchar_t* filename)
 {
-	HRESULT result;
-
 	// check if file exists
 	if (!filename)
 	{
@@ -24,13 +25,48 @@ void TextureManager::loadTexture(const wchar_t* uid, const wchar_t* filename)
 		MessageBox(NULL, L"Texture filename does not exist", L"ERROR", MB_OK);
 		return;
 	}
+
+	TextureCache::Key name = TextureCache::hashName(uid);
+	if (loadFile(name, filename))
+	{
+		// Remember the file, so the texture can be loaded again if it is evicted
+		sourceFiles[name] = filename;
+	}
+}
+
+bool TextureManager::loadFile(TextureCache::Key name, const wchar_t* filename)
+{
+	PROFILE_FUNCTION();
+
 	// if not set default texture
 	if (!does_file_exist(filename))
 	{
 		// change default texture
 		//filename = L"../res/DefaultDiffuse.png";
 		MessageBox(NULL, L"Texture filename does not exist", L"ERROR", MB_OK);
-		return;
+		return false;
+	}
+
+	// The same file loaded under another uid, share its texture
+	TextureCache::Key path = TextureCache::hashPath(filename);
+	auto loadedFile = fileContents.find(path);
+	if (loadedFile != fileContents.end() && cache.contains(loadedFile->second))
+	{
+		cache.bind(name, loadedFile->second);
+		return true;
+	}
+
+	// Key the texture by the file contents, so copies of a file under other names are shared too
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	std::vector<uint8_t> data((size_t)file.tellg());
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	TextureCache::Key content = MeshCache::hash(data.data(), data.size());
+	fileContents[path] = content;
+	if (cache.contains(content))
+	{
+		cache.bind(name, content);
+		return true;
 	}
 
 	// check file extension for correct loading function.
@@ -50,69 +86,125 @@ void TextureManager::loadTexture(const wchar_t* uid, const wchar_t* filename)
 	}
 
 	// Load the texture in.
-	if (extension == L"dds")
-	{
-		result = CreateDDSTextureFromFile(device, deviceContext, filename, NULL, &texture);
-	}
-	else
-	{
-		result = CreateWICTextureFromFile(device, deviceContext, filename, NULL, &texture, 0);
-	}
-	
-	if (FAILED(result))
+	GpuTexture* newTexture = device->loadTexture(data.data(), data.size(), extension == L"dds");
+	if (!newTexture)
 	{
 		MessageBox(NULL, L"Texture loading error", L"ERROR", MB_OK);
+		return false;
 	}
-	else
-	{
-		textureMap.insert(std::make_pair(const_cast<wchar_t*>(uid), texture));
-	}
+	cache.insert(content, newTexture, device->getTextureSize(newTexture));
+	cache.bind(name, content);
+	return true;
 }
 
 // Release resource.
 TextureManager::~TextureManager()
 {
+	cache.clear();
 	if (texture)
 	{
-		texture->Release();
+		device->releaseTexture(texture);
 		texture = 0;
 	}
 }
 
 // Return texture as a shader resource.
-ID3D11ShaderResourceView* TextureManager::getTexture(const wchar_t* uid)
+GpuTexture* TextureManager::getTexture(const wchar_t* uid)
 {
-	if (textureMap.find(const_cast<wchar_t*>(uid)) != textureMap.end())
-	{
-		// texture exists
-		return textureMap.at(const_cast<wchar_t*>(uid));
-	}
-	else
+	return getTexture(TextureCache::hashName(uid));
+}
+
+GpuTexture* TextureManager::getTexture(TextureCache::Key name)
+{
+	GpuTexture* found = static_cast<GpuTexture*>(cache.get(name));
+	if (!found)
 	{
-		return textureMap.at(L"default");
+		// Evicted, load its file again. If that fails the file is forgotten, so it is not retried every frame
+		auto source = sourceFiles.find(name);
+		if (source != sourceFiles.end())
+		{
+			if (loadFile(name, source->second.c_str()))
+			{
+				found = static_cast<GpuTexture*>(cache.get(name));
+			}
+			else
+			{
+				sourceFiles.erase(source);
+			}
+		}
 	}
+	// Not loaded (yet), or evicted and not loaded from a file
+	return found ? found : texture;
 }
 
-bool TextureManager::does_file_exist(const wchar_t *fname)
+void TextureManager::addTexture(const wchar_t* uid, GpuTexture* newTexture)
 {
-	std::ifstream infile(fname);
-	return infile.good();
+	// No file contents to key it by, the uid is its content key
+	TextureCache::Key name = TextureCache::hashName(uid);
+	sourceFiles.erase(name);
+	cache.insert(name, newTexture, device->getTextureSize(newTexture));
+	cache.bind(name, name);
 }
 
-void TextureManager::generateTexture(ID3D11Device* device)
+bool TextureManager::addTexture(const wchar_t* uid, const MipChain& mips)
 {
-	D3D11_TEXTURE2D_DESC desc;
-	desc.Width = 256;
-	desc.Height = 256;
-	desc.MipLevels = desc.ArraySize = 1;
-	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	if (mips.getLevelCount() == 0)
+	{
+		return false;
+	}
+
+	DXGI_FORMAT format;
+	switch (mips.getFormat())
+	{
+	case MipChain::RGBA8: format = mips.isSRGB() ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM; break;
+	case MipChain::R8: format = DXGI_FORMAT_R8_UNORM; break;
+	case MipChain::RGBA32F: format = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
+	default: format = DXGI_FORMAT_R32_FLOAT; break;
+	}
+
+	// All levels are uploaded at creation, nothing is generated on the GPU
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(mips.getLevelCount());
+	for (int level = 0; level < mips.getLevelCount(); level++)
+	{
+		initData[level].pSysMem = mips.getLevelData(level);
+		initData[level].SysMemPitch = (UINT)mips.getLevel(level).rowPitch;
+		initData[level].SysMemSlicePitch = (UINT)mips.getLevel(level).size;
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = mips.getLevel(0).width;
+	desc.Height = mips.getLevel(0).height;
+	desc.MipLevels = mips.getLevelCount();
+	desc.ArraySize = 1;
+	desc.Format = format;
 	desc.SampleDesc.Count = 1;
-	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
 	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	desc.MiscFlags = 0;
 
-	device->CreateTexture2D(&desc, NULL, &pTexture);
+	GpuTexture* newTexture = device->createTexture(desc, initData.data());
+	if (!newTexture)
+	{
+		return false;
+	}
+
+	addTexture(uid, newTexture);
+	return true;
+}
+
+TextureHandle TextureManager::acquireTexture(const wchar_t* uid)
+{
+	return TextureHandle(this, TextureCache::hashName(uid));
+}
+
+void TextureManager::releaseTexture(void* texture, void* user)
+{
+	static_cast<RenderDevice*>(user)->releaseTexture(static_cast<GpuTexture*>(texture));
+}
+
+bool TextureManager::does_file_exist(const wchar_t *fname)
+{
+	std::ifstream infile(fname);
+	return infile.good();
 }
 
 void TextureManager::addDefaultTexture()
@@ -129,17 +221,56 @@ void TextureManager::addDefaultTexture()
 	desc.Usage = D3D11_USAGE_IMMUTABLE;
 	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
-	HRESULT hr = device->CreateTexture2D(&desc, &initData, &pTexture);
+	texture = device->createTexture(desc, &initData);
+}
 
-	if (SUCCEEDED(hr))
+TextureHandle::TextureHandle()
+{
+	manager = nullptr;
+	name = 0;
+}
+
+TextureHandle::TextureHandle(TextureManager* lmanager, TextureCache::Key lname)
+{
+	manager = lmanager;
+	name = lname;
+	manager->cache.acquire(name);
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other)
+{
+	manager = other.manager;
+	name = other.name;
+	if (manager)
 	{
-		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
-		SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVDesc.Texture2D.MipLevels = 1;
+		manager->cache.acquire(name);
+	}
+}
 
-		hr = device->CreateShaderResourceView(pTexture, &SRVDesc, &texture);
-		textureMap.insert(std::make_pair(const_cast < wchar_t*>(L"default"), texture));
+TextureHandle& TextureHandle::operator=(const TextureHandle& other)
+{
+	if (other.manager)
+	{
+		other.manager->cache.acquire(other.name);
 	}
-	
+	if (manager)
+	{
+		manager->cache.release(name);
+	}
+	manager = other.manager;
+	name = other.name;
+	return *this;
+}
+
+TextureHandle::~TextureHandle()
+{
+	if (manager)
+	{
+		manager->cache.release(name);
+	}
+}
+
+GpuTexture* TextureHandle::get() const
+{
+	return manager ? manager->getTexture(name) : nullptr;
 }
\ No newline at end of file
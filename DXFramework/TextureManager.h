@@ -2,43 +2,82 @@
 // Texture
 // Loads and stores a texture ready for rendering.
 // Handles mipmap generation on load.
+// Textures are looked up by hashed uid strings and kept in a TextureCache: files with identical contents are loaded
+// once, and the least recently used textures are released when the memory budget is exceeded (unless a
+// TextureHandle holds them). A texture evicted from a file is loaded again the next time it is read; one added from
+// memory (addTexture) reads as the default texture until it is added again, so pin those with a TextureHandle.
 
 #ifndef _TEXTUREMANAGER_H_
 #define _TEXTUREMANAGER_H_
 
-#include <d3d11.h>
-//#include "../DirectXTK/Inc/DDSTextureLoader.h"
-//#include "../DirectXTK/Inc/WICTextureLoader.h"
-#include "DTK\include\DDSTextureLoader.h"
-#include "DTK\include\WICTextureLoader.h"
+#include "RenderDevice.h"
 #include <string>
 #include <fstream>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include "TextureCache.h"
+#include "MipChain.h"
 //#include "Texture.h"
 
 using namespace DirectX;
 
+const size_t DEFAULT_TEXTURE_BUDGET = 256 * 1024 * 1024;	// bytes of texture memory kept by the texture manager
+
+class TextureManager;
+
+// Counted reference to a managed texture, the texture is not evicted while a handle to it exists
+class TextureHandle
+{
+public:
+	TextureHandle();
+	TextureHandle(const TextureHandle& other);
+	TextureHandle& operator=(const TextureHandle& other);
+	~TextureHandle();
+
+	GpuTexture* get() const;	// the texture, or the default texture while it is not loaded
+	bool isValid() const { return manager != nullptr; }
+
+private:
+	friend class TextureManager;
+	TextureHandle(TextureManager* manager, TextureCache::Key name);
+
+	TextureManager* manager;
+	TextureCache::Key name;
+};
+
 class TextureManager
 {
 public:
-	TextureManager(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	TextureManager(RenderDevice* device, size_t budgetBytes = DEFAULT_TEXTURE_BUDGET);
 	~TextureManager();
 
 	void loadTexture(const wchar_t* uid, const wchar_t* filename);
-	ID3D11ShaderResourceView* getTexture(const wchar_t* uid);
+	GpuTexture* getTexture(const wchar_t* uid);
+	/// Store a texture created elsewhere (e.g. by the AssetLoader), the manager takes ownership of the reference
+	void addTexture(const wchar_t* uid, GpuTexture* texture);
+	/// Create an immutable texture with every level of a mip chain (e.g. a generated splat map) and store it as uid
+	bool addTexture(const wchar_t* uid, const MipChain& mips);
+	/// Reference to a texture that keeps it loaded, can be taken before the texture is loaded
+	TextureHandle acquireTexture(const wchar_t* uid);
+
+	void setBudget(size_t budgetBytes) { cache.setBudget(budgetBytes); }
+	const TextureCache& getCache() const { return cache; }	///< Memory use and eviction statistics
 
 private:
+	friend class TextureHandle;
+
 	bool does_file_exist(const wchar_t *fileName);
-	void generateTexture(ID3D11Device* device);
+	bool loadFile(TextureCache::Key name, const wchar_t* filename);	// load (or share) the texture of a file and bind the name to it
 	void addDefaultTexture();
+	GpuTexture* getTexture(TextureCache::Key name);
+	static void releaseTexture(void* texture, void* user);
 
-	ID3D11ShaderResourceView* texture;
-	ID3D11Device* device;
-	ID3D11DeviceContext* deviceContext;
+	GpuTexture* texture;	// default texture
+	RenderDevice* device;
 
-	std::map<wchar_t*, ID3D11ShaderResourceView*> textureMap;
-	ID3D11Texture2D *pTexture;
+	TextureCache cache;
+	std::unordered_map<TextureCache::Key, TextureCache::Key> fileContents;	// path key to content key of loaded files
+	std::unordered_map<TextureCache::Key, std::wstring> sourceFiles;		// name key to the file it was loaded from, to reload it after eviction
 };
 
 #endif
\ No newline at end of file
@@ -1,20 +1,13 @@
 // Timer object.
 // Calculate delta/frame time and FPS.
 #include "timer.h"
+#include "Profiler.h"
 
-// Initialise timer. Check for high performance timers.
+// Initialise timer. Uses the same monotonic clock as the profiler, so frame times and zones agree.
 Timer::Timer()
 {
-	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
-	if (frequency == 0)
-	{
-		MessageBox(NULL, L"No support for high performance timer", L"ERROR", MB_OK);
-	}
-
-	// Find out how many times the frequency counter ticks every second.
-	ticksPerS = (float)(frequency);
-
-	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+	startTime = Profiler::now();
+	frameTime = 0.f;
 
 	elapsedTime = 0.f;
 	frames = 0.f;
@@ -29,13 +22,11 @@ Timer::~Timer()
 // Once per frame calculate delta timer and update FPS calculation.
 void Timer::frame()
 {
-	INT64 currentTime;
-	float timeDifference;
+	uint64_t currentTime;
 
-	// Query the current time.
-	QueryPerformanceCounter((LARGE_INTEGER*)&currentTime);
-	timeDifference = (float)(currentTime - startTime);
-	frameTime = timeDifference / ticksPerS;
+	// Query the current time (nanoseconds).
+	currentTime = Profiler::now();
+	frameTime = (float)((double)(currentTime - startTime) * 1e-9);
 
 	// Calc FPS
 	frames += 1.f;
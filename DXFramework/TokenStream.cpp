@@ -7,8 +7,17 @@
 
 
 #include<string>
+#include<cstring>
 #include"TokenStream.h"
 
+#if defined( _M_X64 ) || defined( _M_AMD64 ) || defined( __SSE2__ )
+#define TOKEN_STREAM_SSE2
+#include<emmintrin.h>
+#ifdef _MSC_VER
+#include<intrin.h>
+#endif
+#endif
+
 
 bool isValidIdentifier( char c )
 {
@@ -38,12 +47,14 @@ bool isValidIdentifier( char c, char* delimiters, int totalDelimiters )
 TokenStream::TokenStream( )
 {
     ResetStream( );
+    SetDelimiters( 0, 0 );
 }
 
 
 void TokenStream::ResetStream( )
 {
     startIndex_ = endIndex_ = 0;
+    position_ = 0;
 }
 
 
@@ -150,4 +161,196 @@ bool TokenStream::MoveToNextLine( std::string* buffer )
     startIndex_ = endIndex_ + 1;
 
    return true;
-}
\ No newline at end of file
+}
+
+
+#ifdef TOKEN_STREAM_SSE2
+static inline int firstSetBit( unsigned int mask )
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return ( int )index;
+#else
+    return __builtin_ctz( mask );
+#endif
+}
+#endif
+
+
+void TokenStream::SetTokenStream( std::string_view data )
+{
+    ResetStream( );
+    view_ = data;
+}
+
+
+void TokenStream::SetDelimiters( const char* delimiters, int totalDelimiters )
+{
+    if( delimiters == 0 || totalDelimiters <= 0 )
+    {
+        // Same rule as isValidIdentifier( c )
+        for( int c = 0; c < 256; c++ )
+            isDelimiter_[c] = !( c > 32 && c < 127 );
+
+        totalDelimiters_ = 0;
+        return;
+    }
+
+    memset( isDelimiter_, 0, sizeof( isDelimiter_ ) );
+    for( int i = 0; i < totalDelimiters; i++ )
+        isDelimiter_[( unsigned char )delimiters[i]] = true;
+
+    // Up to 16 delimiters are compared 16 characters at a time, more than that only use the table
+    if( totalDelimiters <= 16 )
+    {
+        memcpy( delimiters_, delimiters, totalDelimiters );
+        totalDelimiters_ = totalDelimiters;
+    }
+    else
+    {
+        totalDelimiters_ = -1;
+    }
+}
+
+
+// Return the first delimiter in [p, end), or end.
+const char* TokenStream::FindDelimiter( const char* p, const char* end ) const
+{
+#ifdef TOKEN_STREAM_SSE2
+    if( totalDelimiters_ >= 0 )
+    {
+        const __m128i below = _mm_set1_epi8( 33 );
+        const __m128i del = _mm_set1_epi8( 127 );
+
+        for( ; p + 16 <= end; p += 16 )
+        {
+            __m128i chars = _mm_loadu_si128( ( const __m128i* )p );
+            __m128i match;
+
+            if( totalDelimiters_ == 0 )
+            {
+                // Signed compare, so the characters from 128 are below 33 too
+                match = _mm_or_si128( _mm_cmplt_epi8( chars, below ), _mm_cmpeq_epi8( chars, del ) );
+            }
+            else
+            {
+                match = _mm_cmpeq_epi8( chars, _mm_set1_epi8( delimiters_[0] ) );
+                for( int i = 1; i < totalDelimiters_; i++ )
+                    match = _mm_or_si128( match, _mm_cmpeq_epi8( chars, _mm_set1_epi8( delimiters_[i] ) ) );
+            }
+
+            unsigned int mask = ( unsigned int )_mm_movemask_epi8( match );
+            if( mask != 0 )
+                return p + firstSetBit( mask );
+        }
+    }
+#endif
+
+    while( p < end && !isDelimiter_[( unsigned char )*p] )
+        p++;
+
+    return p;
+}
+
+
+// Return the first character in [p, end) that is not a delimiter, or end.
+const char* TokenStream::SkipDelimiters( const char* p, const char* end ) const
+{
+    // Tokens are usually separated by a single delimiter, check a few characters before going wide
+    for( int i = 0; i < 4 && p < end; i++, p++ )
+    {
+        if( !isDelimiter_[( unsigned char )*p] )
+            return p;
+    }
+
+#ifdef TOKEN_STREAM_SSE2
+    if( totalDelimiters_ >= 0 )
+    {
+        const __m128i below = _mm_set1_epi8( 33 );
+        const __m128i del = _mm_set1_epi8( 127 );
+
+        for( ; p + 16 <= end; p += 16 )
+        {
+            __m128i chars = _mm_loadu_si128( ( const __m128i* )p );
+            __m128i match;
+
+            if( totalDelimiters_ == 0 )
+            {
+                match = _mm_or_si128( _mm_cmplt_epi8( chars, below ), _mm_cmpeq_epi8( chars, del ) );
+            }
+            else
+            {
+                match = _mm_cmpeq_epi8( chars, _mm_set1_epi8( delimiters_[0] ) );
+                for( int i = 1; i < totalDelimiters_; i++ )
+                    match = _mm_or_si128( match, _mm_cmpeq_epi8( chars, _mm_set1_epi8( delimiters_[i] ) ) );
+            }
+
+            unsigned int mask = ~( unsigned int )_mm_movemask_epi8( match ) & 0xFFFF;
+            if( mask != 0 )
+                return p + firstSetBit( mask );
+        }
+    }
+#endif
+
+    while( p < end && isDelimiter_[( unsigned char )*p] )
+        p++;
+
+    return p;
+}
+
+
+bool TokenStream::GetNextToken( std::string_view* token )
+{
+    const char* begin = view_.data( );
+    const char* end = begin + view_.size( );
+
+    const char* start = SkipDelimiters( begin + position_, end );
+    if( start >= end )
+    {
+        position_ = view_.size( );
+        return false;
+    }
+
+    const char* tokenEnd;
+    if( *start == '"' )
+    {
+        // Quoted strings run to the closing quote, delimiters included
+        const char* quote = ( const char* )memchr( start + 1, '"', end - start - 1 );
+        tokenEnd = quote ? FindDelimiter( quote + 1, end ) : end;
+    }
+    else
+    {
+        tokenEnd = FindDelimiter( start + 1, end );
+    }
+
+    if( token != 0 )
+        *token = std::string_view( start, tokenEnd - start );
+
+    position_ = tokenEnd - begin;
+    return true;
+}
+
+
+bool TokenStream::MoveToNextLine( std::string_view* line )
+{
+    if( position_ >= view_.size( ) )
+        return false;
+
+    const char* begin = view_.data( ) + position_;
+    size_t remaining = view_.size( ) - position_;
+
+    // memchr is already vectorised by the C runtime
+    const char* newLine = ( const char* )memchr( begin, '\n', remaining );
+    size_t length = newLine ? ( size_t )( newLine - begin ) : remaining;
+
+    position_ += newLine ? length + 1 : length;
+
+    if( length > 0 && begin[length - 1] == '\r' )
+        length--;
+
+    if( line != 0 )
+        *line = std::string_view( begin, length );
+
+    return true;
+}
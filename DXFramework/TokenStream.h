@@ -9,6 +9,7 @@
 #ifndef _TOKEN_STREAM_H_
 #define _TOKEN_STREAM_H_
 #include <string>
+#include <string_view>
 
 class TokenStream
 {
@@ -21,9 +22,28 @@ class TokenStream
       bool GetNextToken( std::string* buffer, char* delimiters, int totalDelimiters );
       bool MoveToNextLine( std::string *buffer );
 
+      // Borrowing mode: the stream points into data instead of copying it, so data must
+      // outlive the stream. Tokens and lines are views into data, nothing is allocated.
+      void SetTokenStream( std::string_view data );
+      // Delimiters used by GetNextToken( std::string_view* ). With no delimiters every
+      // character outside '!'..'~' is a delimiter, the same as the copying mode.
+      void SetDelimiters( const char* delimiters, int totalDelimiters );
+      bool GetNextToken( std::string_view* token );
+      // Return the rest of the current line (without "\n" or "\r\n") and move to the next one.
+      bool MoveToNextLine( std::string_view* line );
+
    private:
+      const char* FindDelimiter( const char* p, const char* end ) const;
+      const char* SkipDelimiters( const char* p, const char* end ) const;
+
       int startIndex_, endIndex_;
       std::string data_;
+
+      std::string_view view_;
+      size_t position_;
+      bool isDelimiter_[256];
+      char delimiters_[16];
+      int totalDelimiters_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,10 +1,12 @@
 // TriangleMesh.cpp
 // Simple triangle mesh for example purposes. With texture cooridnates and normals.
 #include "TriangleMesh.h"
+#include "GeometryBuilder.h"
 
 // Initialise buffers and load texture.
-TriangleMesh::TriangleMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+TriangleMesh::TriangleMesh(RenderDevice* device)
 {
+	renderer = device;
 	initBuffers(device);
 
 	/*inputLayout = new D3D11_INPUT_ELEMENT_DESC[3];
@@ -22,75 +24,12 @@ TriangleMesh::~TriangleMesh()
 }
 
 // Build shape and fill buffers.
-void TriangleMesh::initBuffers(ID3D11Device* device)
+void TriangleMesh::initBuffers(RenderDevice* device)
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	
-	vertexCount = 3;
-	indexCount = 3;
-
-	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-
-	// Load the vertex array with data.
-	vertices[0].position = XMFLOAT3(0.0f, 1.0f, 0.0f);  // Top.
-	vertices[0].texture = XMFLOAT2(0.5f, 0.0f);
-	vertices[0].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	vertices[1].position = XMFLOAT3(-1.0f, 0.0f, 0.0f);  // bottom left.
-	vertices[1].texture = XMFLOAT2(0.0f, 1.0f);
-	vertices[1].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	vertices[2].position = XMFLOAT3(1.0f, 0.0f, 0.0f);  // bottom right.
-	vertices[2].texture = XMFLOAT2(1.0f, 1.0f);
-	vertices[2].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	// Load the index array with data.
-	indices[0] = 0;  // Top/
-	indices[1] = 1;  // Bottom left.
-	indices[2] = 2;  // Bottom right.
-
-	vertexBufferDesc = { sizeof(VertexType) * vertexCount, D3D11_USAGE_DEFAULT, D3D11_BIND_VERTEX_BUFFER, 0, 0, 0 };
-	vertexData = {vertices, 0 , 0};
-
-	// Set up the description of the static vertex buffer.
-	//vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	//vertexBufferDesc.ByteWidth = sizeof(VertexType)* vertexCount;
-	//vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	//vertexBufferDesc.CPUAccessFlags = 0;
-	//vertexBufferDesc.MiscFlags = 0;
-	//vertexBufferDesc.StructureByteStride = 0;
-	//// Give the subresource structure a pointer to the vertex data.
-	//vertexData.pSysMem = vertices;
-	//vertexData.SysMemPitch = 0;
-	//vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-	
-	indexBufferDesc = {sizeof(unsigned long) * indexCount, D3D11_USAGE_DEFAULT, D3D11_BIND_INDEX_BUFFER, 0, 0, 0};
-	indexData = {indices, 0, 0};
-	// Set up the description of the static index buffer.
-	//indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	//indexBufferDesc.ByteWidth = sizeof(unsigned long)* indexCount;
-	//indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	//indexBufferDesc.CPUAccessFlags = 0;
-	//indexBufferDesc.MiscFlags = 0;
-	//indexBufferDesc.StructureByteStride = 0;
-	//// Give the subresource structure a pointer to the index data.
-	//indexData.pSysMem = indices;
-	//indexData.SysMemPitch = 0;
-	//indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
-	
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-	delete[] indices;
-	indices = 0;
+	GeometryBuilder& geometry = GeometryBuilder::getStaging();
+	geometry.clear();
+	geometry.addTriangle(XMFLOAT2(0.5f, 0.0f), XMFLOAT2(0.0f, 1.0f), XMFLOAT2(1.0f, 1.0f));
+	uploadGeometry(device, geometry);
 }
 
 
@@ -13,11 +13,11 @@ class TriangleMesh : public BaseMesh
 {
 
 public:
-	TriangleMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	TriangleMesh(RenderDevice* device);
 	~TriangleMesh();
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	
 };
 
@@ -0,0 +1,106 @@
+// Upload ring
+// Sub-allocates a ring buffer mapped without overwriting, and copies the allocations into their destination buffers.
+#include "UploadRing.h"
+
+UploadRing::UploadRing(UploadBackend* lbackend, size_t lsize, size_t lframeBudget)
+{
+	backend = lbackend;
+	size = lsize - lsize % alignment;
+	frameBudget = lframeBudget;
+	// The first allocation does not fit before the end, so it discards the ring as the first map has to
+	head = size;
+	mapped = nullptr;
+	pendingOffset = 0;
+	pendingSize = 0;
+
+	frameBytes = 0;
+	lastFrameBytes = 0;
+	peakFrameBytes = 0;
+	totalBytes = 0;
+	discardCount = 0;
+
+	if (!backend->createRing(size))
+	{
+		size = 0;
+	}
+}
+
+UploadRing::~UploadRing()
+{
+	if (mapped)
+	{
+		backend->unmapRing();
+		mapped = nullptr;
+	}
+
+	delete backend;
+	backend = nullptr;
+}
+
+void UploadRing::beginFrame()
+{
+	lastFrameBytes = frameBytes;
+	if (frameBytes > peakFrameBytes)
+	{
+		peakFrameBytes = frameBytes;
+	}
+	frameBytes = 0;
+}
+
+size_t UploadRing::getMaxAllocation(bool budgeted) const
+{
+	// An allocation that does not fit before the end of the ring wraps around, so the whole ring is available
+	size_t maxBytes = size;
+	if (budgeted)
+	{
+		size_t budgetLeft = frameBytes < frameBudget ? frameBudget - frameBytes : 0;
+		if (budgetLeft < maxBytes)
+		{
+			maxBytes = budgetLeft;
+		}
+	}
+	return maxBytes;
+}
+
+void* UploadRing::allocate(size_t bytes, bool budgeted)
+{
+	if (mapped || bytes == 0 || bytes > getMaxAllocation(budgeted))
+	{
+		return nullptr;
+	}
+
+	size_t alignedBytes = (bytes + alignment - 1) / alignment * alignment;
+	bool discard = head + alignedBytes > size;
+	if (discard)
+	{
+		head = 0;
+		discardCount++;
+	}
+
+	mapped = static_cast<unsigned char*>(backend->mapRing(discard));
+	if (!mapped)
+	{
+		head = size;	// discard again next time
+		return nullptr;
+	}
+
+	pendingOffset = head;
+	pendingSize = bytes;
+	head += alignedBytes;
+	return mapped + pendingOffset;
+}
+
+void UploadRing::upload(GpuBuffer* destination, size_t destinationOffset)
+{
+	if (!mapped)
+	{
+		return;
+	}
+
+	backend->unmapRing();
+	mapped = nullptr;
+	backend->copyToBuffer(destination, destinationOffset, pendingOffset, pendingSize);
+
+	frameBytes += pendingSize;
+	totalBytes += pendingSize;
+}
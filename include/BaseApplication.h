@@ -4,7 +4,9 @@
 * \brief Default application setup, inherit from this
 *
 * This class is the parent application to inherit from when creating a new application.
-* Handles the default configuration of the renderer, camera, input, timer and texture manager.
+* Handles the default configuration of the renderer, camera, input, timer, texture manager and asset loader.
+* The application renders through a RenderDevice: a D3D device created by init(), or the device given to setRenderDevice(),
+* e.g. a NullRenderDevice to run the frames headless (without a window, see HeadlessSystem).
 *
 * \author Paul Robertson
 */
@@ -17,6 +19,9 @@
 //const bool VSYNC_ENABLED = true;
 const float SCREEN_DEPTH = 200.0f;	// 1000.0f
 const float SCREEN_NEAR = 0.1f;		//0.1f
+const float ASSET_UPLOAD_BUDGET = 2.0f;	// milliseconds per frame spent creating GPU objects of loaded assets
+const unsigned int UPLOAD_RING_SIZE = 16 * 1024 * 1024;	// bytes of the ring buffer streaming data to the GPU
+const unsigned int UPLOAD_FRAME_BUDGET = 4 * 1024 * 1024;	// bytes per frame streamed through the ring by budgeted uploads
 
 // Includes
 #include "input.h"
@@ -27,6 +32,8 @@ const float SCREEN_NEAR = 0.1f;		//0.1f
 #include "imGUI/imgui_impl_dx11.h"
 #include "imGUI/imgui_impl_win32.h"
 #include "TextureManager.h"
+#include "AssetLoader.h"
+#include "UploadRing.h"
 
 
 class BaseApplication
@@ -48,12 +55,19 @@ public:
 	* @param FULL_SCREEN is a boolean for if the window is full screen
 	*/
 	virtual void init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeight, Input *in, bool VSYNC, bool FULL_SCREEN);
+	/** \brief Render with this device instead of creating a D3D device, call it before init()
+	* The application deletes the device it renders with, set nullptr before deleting the application to keep it. The UI is only drawn by a D3D device rendering to a window, otherwise it is built and discarded
+	*/
+	void setRenderDevice(RenderDevice* device) { renderer = device; }
 
 	/** \brief Virtual frame/update function.
 	* Contains default update/frame operations including calculating delta time, calling handle input and starting UI rendering
 	*/
 	virtual bool frame();
 
+	RenderDevice* getRenderDevice() const { return renderer; }
+	const UploadRing* getUploadRing() const { return uploadRing; }
+
 protected:
 	/** \brief Protected Virtual function for handling input
 	* Function provides default input handling for camera and UI functions. 
@@ -63,6 +77,8 @@ protected:
 	virtual void handleInput(float dt);
 	/// Pure virtual function for render. Make your own.
 	virtual bool render() = 0;
+	/// End the UI frame and draw it, when there is a window to draw it into
+	void renderGui();
 
 protected:
 	HWND wnd;				///< handle to the window
@@ -70,11 +86,14 @@ protected:
 	int deltax, deltay;		///< for mouse movement
 	POINT cursor;			///< Used for converting mouse coordinates for client to screen space
 	Input* input;			///< Pointer to input class
-	D3D* renderer;			///< Pointer to renderer
+	RenderDevice* renderer;	///< Pointer to renderer
 	FPCamera* camera;			///< Pointer to camera object
 	Timer* timer;			///< Pointer to timer object (for delta time and FPS)
 	TextureManager* textureMgr;	///< Pointer to texture manager (handles loading and storing of textures)
+	AssetLoader* assetLoader;	///< Pointer to asset loader (loads textures and models in the background)
+	UploadRing* uploadRing;		///< Pointer to the upload ring (streams buffer data to the GPU with a budget per frame)
 	bool wireframeToggle;	///< Boolean tracking if wireframe is de/activated
+	bool headless;			///< No window or D3D device, the ImGui platform and renderer backends are not used
 };
 
 #endif
\ No newline at end of file
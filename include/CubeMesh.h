@@ -23,14 +23,13 @@ public:
 	*
 	* Can specify resolution of cube, this deteremines how many subdivisions are on each side of the cube.
 	* @param device is the renderer device
-	* @param device context is the renderer device context
 	* @param resolution is a int for subdivision of the cube. Default is 20.
 	*/
-	CubeMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 20);
+	CubeMesh(RenderDevice* device, int resolution = 20);
 	~CubeMesh();
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	int resolution;
 };
 
@@ -6,7 +6,7 @@
 * Creates a DX11 renderer, creating the required depth and stencil buffers.
 * Additionally, creating render states for alpha blended rendering.
 * Provided functions for controlling begin/end frame rendering, wireframe rendering, orthographic and alpha blended rendering.
-* Member variables for projection, ortho and identity world matrices.
+* The Direct3D 11 RenderDevice: the buffers, textures and shaders it creates are the Direct3D 11 objects.
 *
 * \author Paul Robertson
 */
@@ -19,21 +19,17 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <DirectXMath.h>
+#include <vector>
+#include <dxgi.h>
+#include <string>
+#include "RenderDevice.h"
+//#include <winerror.h>
 
 using namespace DirectX;
 
-class D3D
+class D3D : public RenderDevice
 {
 public:
-	void* operator new(size_t i)
-	{
-		return _mm_malloc(i, 16);
-	}
-
-	void operator delete(void* p)
-	{
-		_mm_free(p);
-	}
 	/** \brief Creates and initialises a DX11 renderer
 	* @param screenWidth
 	* @param screenHeight
@@ -47,39 +43,77 @@ public:
 	~D3D();
 
 	/// Begin rendering frame, set background colour
-	void beginScene(float r, float g, float b, float a);
+	void beginScene(float r, float g, float b, float a) override;
 	/// end scene rendering, do frame buffer swap
-	void endScene();
+	void endScene() override;
 
 	ID3D11Device* getDevice();	///< Returns render device
 	ID3D11DeviceContext* getDeviceContext(); ///< Returns renderer device context
 
-	XMMATRIX getProjectionMatrix();	///< Returns default projection matrix
-	XMMATRIX getWorldMatrix();		///< Returns identity world matrix
-	XMMATRIX getOrthoMatrix();		///< Returns default orthographic matrix
-
 	// Control render states
-	void setZBuffer(bool b);	///< Sets z-buffer on/off for orthographic rendering
-	bool getZBufferState();		///< Returns if the z-buffer is on/off
-
+	void setZBuffer(bool b) override;			///< Sets z-buffer on/off for orthographic rendering
+	void setAlphaBlending(bool b) override;		///< Sets the alpha blending state on/off for transparent rendering
+	void setWireframeMode(bool b) override;		///< Set wireframe render mode on/off
+
+	void setBackBufferRenderTarget() override;	///< Sets the back buffer as the render target
+	void resetViewport() override;				///< Restores viewport if dimensions of render target were different
+
+	// RenderDevice objects, the handles are the Direct3D 11 objects
+	GpuBuffer* createBuffer(const D3D11_BUFFER_DESC& desc, const void* data) override;
+	void* mapBuffer(GpuBuffer* buffer) override;
+	void unmapBuffer(GpuBuffer* buffer) override;
+	void releaseBuffer(GpuBuffer* buffer) override;
+	GpuTexture* createTexture(const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* data) override;
+	GpuTexture* loadTexture(const void* fileData, size_t size, bool dds) override;
+	size_t getTextureSize(GpuTexture* texture) override;
+	void releaseTexture(GpuTexture* texture) override;
+	GpuShader* createShader(ShaderStage stage, const void* bytecode, size_t size) override;
+	GpuInputLayout* createInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void* bytecode, size_t size) override;
+	GpuSampler* createSampler(const D3D11_SAMPLER_DESC& desc) override;
+	void releaseShader(GpuShader* shader) override;
+	void releaseInputLayout(GpuInputLayout* layout) override;
+	void releaseSampler(GpuSampler* sampler) override;
+
+	void setVertexBuffer(GpuBuffer* buffer, unsigned int stride) override;
+	void setIndexBuffer(GpuBuffer* buffer, DXGI_FORMAT format) override;
+	void setPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology) override;
+	void setInputLayout(GpuInputLayout* layout) override;
+	void setShader(ShaderStage stage, GpuShader* shader) override;
+	void setConstantBuffer(ShaderStage stage, unsigned int slot, GpuBuffer* buffer) override;
+	void setTexture(ShaderStage stage, unsigned int slot, GpuTexture* texture) override;
+	void setSampler(ShaderStage stage, unsigned int slot, GpuSampler* sampler) override;
+	void draw(unsigned int vertexCount, unsigned int startVertex) override;
+	void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void dispatch(unsigned int x, unsigned int y, unsigned int z) override;
+
+	UploadBackend* createUploadBackend() override;
+
+	/// Handles of Direct3D 11 objects created outside the device (e.g. the view of a RenderTexture or ShadowMap)
+	static GpuTexture* toTexture(ID3D11ShaderResourceView* view) { return reinterpret_cast<GpuTexture*>(view); }
+	static GpuBuffer* toBuffer(ID3D11Buffer* buffer) { return reinterpret_cast<GpuBuffer*>(buffer); }
+	/// Direct3D 11 objects of handles created by a D3D device
+	static ID3D11ShaderResourceView* toView(GpuTexture* texture) { return reinterpret_cast<ID3D11ShaderResourceView*>(texture); }
+	static ID3D11Buffer* toBuffer(GpuBuffer* buffer) { return reinterpret_cast<ID3D11Buffer*>(buffer); }
+
+private:
+	void createDevice();
+	void createSwapchain();
+	void createRenderTargetView();
+	void createDepthBuffer();
+	void createStencilBuffer();
+	void createDefaultRasterState();
+	void createDepthlDisableState();
+	void createBlendState();
 
-	void setAlphaBlending(bool b);	///< Sets the alpha blending state on/off for transparent rendering
-	bool getAlphaBlendingState();	///< Returns alphab blending state, if on/off
-	
-	void setWireframeMode(bool b);	///< Set wireframe render mode on/off
-	bool getWireframeState();		///< Returns currect wireframe state on/off
-
-	void setBackBufferRenderTarget();	///< Sets the back buffer as the render target
-	void resetViewport();				///< Restores viewport if dimensions of render target were different
 
 protected:
 	bool vsync_enabled;	
 	bool isWirefameEnabled;
-	
-	bool zbufferState;		///< Variable tracks z-buffer state
-	bool wireframeState;	///< Variable tracks wireframe state
-	bool alphaBlendState;	///< Variable tracks alpha blending state
 
+	bool isFullscreen;
+	HWND* wnd;
+
+	IDXGIFactory1* pFactory;
 	IDXGISwapChain* swapChain;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
@@ -89,9 +123,6 @@ protected:
 	ID3D11DepthStencilView* depthStencilView;
 	ID3D11RasterizerState* rasterState;			///< Default FILL raster state
 	ID3D11RasterizerState* rasterStateWF;		///< Wireframe raster state
-	XMMATRIX projectionMatrix;					///< Identity projection matrix
-	XMMATRIX worldMatrix;						///< Identity world matrix
-	XMMATRIX orthoMatrix;						///< Identity orthographic matrix
 	ID3D11DepthStencilState* depthDisabledStencilState;
 	ID3D11BlendState* alphaEnableBlendingState;	///< Alpha blend enabled state
 	ID3D11BlendState* alphaDisableBlendingState;///< Alpha blend disabled state
@@ -0,0 +1,50 @@
+/**
+* \class FrameReport
+*
+* \brief Summary and JSON report of the frames of a headless run
+*
+* Does not depend on a device or an application, so HeadlessSystem and the headless benchmark write the same report
+* from their frame records. The report also holds the objects left alive on the device once the application (or the
+* benchmark scene) is released, which are leaks.
+*/
+
+#ifndef _FRAMEREPORT_H_
+#define _FRAMEREPORT_H_
+
+#include "RenderDevice.h"
+#include <vector>
+
+/// Measurements of one frame
+struct FrameRecord
+{
+	double cpuMs;				///< Script and application frame
+	RenderStats stats;			///< Work submitted to the device
+	size_t uploadBytes;			///< Bytes streamed through the upload ring
+};
+
+class FrameReport
+{
+public:
+	/// CPU time percentiles and the mean work per frame
+	struct Summary
+	{
+		int frames;
+		double meanMs;
+		double p50Ms;
+		double p95Ms;
+		double maxMs;
+		double drawCallsPerFrame;
+		double bindingsPerFrame;
+		unsigned long long uploadBytes;			///< All the frames
+		unsigned long long bufferWriteBytes;	///< All the frames
+	};
+
+	/// Summary of the frames, all zero if there are none
+	static Summary summarise(const std::vector<FrameRecord>& frames);
+
+	/** Save the frame records and their summary as JSON, with the objects and buffer bytes left alive on the device after
+	* the release. Returns false if there are no frames or the file could not be written */
+	static bool write(const char* filename, const char* label, const std::vector<FrameRecord>& frames, int liveObjects, size_t liveBufferBytes);
+};
+
+#endif
@@ -0,0 +1,53 @@
+/**
+* \class HeadlessSystem
+*
+* \brief Runs an application without a window or a GPU, for profiling and automated runs
+*
+* The counterpart of System: the application renders through a NullRenderDevice and gets no input, and a fixed number of
+* frames are run as fast as possible. A callback can script each frame (e.g. modify and regenerate the terrain) before the
+* application frame runs. Every frame records its CPU time, the work submitted to the device and the bytes streamed
+* through the upload ring. Once the application is released (releaseApplication), writeReport() saves the records as JSON
+* (FrameReport) with the objects the application left alive on the device.
+*/
+
+#ifndef _HEADLESSSYSTEM_H_
+#define _HEADLESSSYSTEM_H_
+
+#include "BaseApplication.h"
+#include "NullRenderDevice.h"
+#include "Input.h"
+#include "FrameReport.h"
+#include <functional>
+#include <vector>
+
+class HeadlessSystem
+{
+public:
+	/// Called before the application frame, with the index of the frame
+	typedef std::function<void(int frame)> FrameCallback;
+
+	/** Initialises the application with a NullRenderDevice of the screen size. The system deletes the application, then the device */
+	HeadlessSystem(BaseApplication* application, int screenWidth, int screenHeight);
+	~HeadlessSystem();
+
+	/// Run 'frameCount' frames, or until the application frame returns false. Returns the number of frames run (0 once released)
+	int run(int frameCount, const FrameCallback& callback = FrameCallback());
+
+	const std::vector<FrameRecord>& getFrames() const { return frames; }
+	NullRenderDevice* getRenderDevice() const { return device; }
+	/// Delete the application and count the objects it left alive on the device. Done by the destructor if not called before
+	void releaseApplication();
+	/** Save the frame records, their summary and the objects left alive as JSON (FrameReport::write). Returns false if the
+	* application has not been released or the file could not be written */
+	bool writeReport(const char* filename, const char* label) const;
+
+private:
+	BaseApplication* app;		///< Application to run
+	NullRenderDevice* device;	///< Used by the application, deleted after it
+	Input input;				///< Never receives events
+	std::vector<FrameRecord> frames;
+	int liveObjects;			///< Left on the device by the application, -1 until it is released
+	size_t liveBufferBytes;
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+* \class IndexBufferBuilder
+*
+* \brief Builds index buffers with explicit 16 or 32 bit indices, split in chunks
+*
+* Indices are stored relative to the base vertex of their chunk, so a chunk only needs 16 bit indices when it addresses
+* fewer than 65535 vertices. The buffer uses uint16_t indices when every chunk allows it and uint32_t otherwise.
+* Every chunk is drawn with DrawIndexed(indexCount, indexStart, baseVertex).
+* Triangle lists and triangle strips are supported, strips are cut with the restart index (0xFFFF or 0xFFFFFFFF).
+*/
+
+#ifndef _INDEXBUFFERBUILDER_H_
+#define _INDEXBUFFERBUILDER_H_
+
+#include "RenderDevice.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Range of the index buffer that is drawn with a single DrawIndexed call
+struct IndexChunk
+{
+	unsigned int indexStart;	///< First index of the chunk in the index buffer
+	unsigned int indexCount;	///< Number of indices in the chunk
+	int baseVertex;				///< Added to every index of the chunk when drawing
+	unsigned int vertexCount;	///< Number of vertices addressed from baseVertex
+};
+
+class IndexBufferBuilder
+{
+public:
+	static const uint16_t restartIndex16 = 0xFFFF;		///< Strip cut value for uint16_t indices
+	static const uint32_t restartIndex32 = 0xFFFFFFFF;	///< Strip cut value for uint32_t indices
+	static const unsigned int maxVertices16 = 0xFFFF;	///< Vertices a chunk can address with uint16_t indices (0xFFFF is kept for the restart)
+
+	IndexBufferBuilder();
+	~IndexBufferBuilder();
+
+	void clear();	///< Remove all indices and chunks
+
+	void beginChunk(int baseVertex, unsigned int vertexCount);	///< Start a chunk addressing the vertices [baseVertex, baseVertex + vertexCount)
+	void addTriangle(uint32_t a, uint32_t b, uint32_t c);		///< Add a triangle to the current chunk (absolute vertex indices)
+	void addStripIndex(uint32_t index);							///< Add a vertex to the current triangle strip (absolute vertex index)
+	void restartStrip();										///< Cut the current triangle strip
+
+	/// Add a grid of width * height vertices (row major, as PlaneMesh and TerrainMesh) split in bands of rows that fit uint16_t indices.
+	/// The triangles keep the winding of the PlaneMesh triangle list, with strips one strip is emitted per row of quads
+	void addGrid(int width, int height, bool strips, int baseVertex = 0);
+
+	bool is16Bit() const;				///< True if every chunk fits uint16_t indices
+	DXGI_FORMAT getFormat() const;		///< DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+	unsigned int getIndexSize() const;	///< Size of an index in bytes (2 or 4)
+	unsigned int getIndexCount() const { return (unsigned int)indices.size(); }
+	size_t getByteSize() const { return (size_t)getIndexCount() * getIndexSize(); }
+	const std::vector<IndexChunk>& getChunks() const { return chunks; }
+
+	/// Index data in the format returned by getFormat(), valid until the builder is modified
+	const void* getData();
+
+	/// Create an immutable index buffer from the indices. Returns false if the buffer could not be created
+	bool createBuffer(RenderDevice* renderer, GpuBuffer** buffer);
+
+private:
+	std::vector<uint32_t> indices;		// relative to the base vertex of their chunk, restarts are restartIndex32
+	std::vector<uint16_t> indices16;	// packed copy of indices, built by getData()
+	std::vector<IndexChunk> chunks;
+	uint32_t maxIndex;					// biggest relative index (without the restarts)
+};
+
+#endif
@@ -4,6 +4,7 @@
 
 #include <d3d11.h>
 #include <directxmath.h>
+#include <cstdint>
 #include "texture.h"
 
 using namespace DirectX;
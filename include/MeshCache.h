@@ -0,0 +1,51 @@
+/**
+* \class MeshCache
+*
+* \brief Binary cache of processed mesh data
+*
+* A cache file holds a header with a 64 bit key followed by raw data sections (vertices, indices, submesh tables...).
+* The key is built from everything the cached data depends on, usually the hash of the source file contents and the
+* import settings, so a cache made from an older file or different settings is rejected by open().
+* Sections are read in place from a memory mapped file and stay valid until close().
+*/
+
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MeshCache
+{
+public:
+	/// Data written as one section of a cache file
+	struct Section
+	{
+		const void* data;
+		size_t size;
+	};
+
+	/// 64 bit hash of a block of memory, chain calls with the previous hash as seed
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+	/// Hash of the whole contents of a file, returns false if it cannot be read
+	static bool hashFile(const char* filename, uint64_t& fileHash);
+
+	/// Write a cache file, returns false if it cannot be written
+	static bool write(const char* filename, uint64_t key, const std::vector<Section>& sections);
+
+	/// Map a cache file, returns false if it does not exist, is damaged or was written with another key
+	bool open(const char* filename, uint64_t key);
+	void close();
+
+	size_t getSectionCount() const { return sections.size(); }
+	const void* getSection(size_t index) const { return sections[index].data; }	///< Start of a section, 16 byte aligned in the file
+	size_t getSectionSize(size_t index) const { return sections[index].size; }	///< Size of a section in bytes
+
+private:
+	MappedFile file;
+	std::vector<Section> sections;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/**
+* \class MipChain
+*
+* \brief CPU mip map generation for loaded and generated images
+*
+* Builds every mip level of an 8 bit or float image, each level filtered from the one above it in linear float
+* precision. The box filter averages the exact footprint of each texel (also correct for odd sizes), the Kaiser filter
+* is a windowed sinc that keeps more detail in the smaller levels. 8 bit colour can be filtered gamma correct, decoding
+* sRGB to linear before filtering and encoding after (alpha is always linear).
+* Rows are filtered with SSE2 where available and large levels are split over several threads.
+* The levels are stored one after the other with tightly packed rows, the layout of a DDS file (see writeDDS()),
+* ready to be used as the initial data of an immutable texture (TextureManager::addTexture()).
+*/
+
+#ifndef _MIPCHAIN_H_
+#define _MIPCHAIN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MipChain
+{
+public:
+	enum PixelFormat
+	{
+		RGBA8,		///< 4 x 8 bit unsigned normalised
+		R8,			///< 1 x 8 bit unsigned normalised
+		RGBA32F,	///< 4 x 32 bit float
+		R32F		///< 1 x 32 bit float
+	};
+
+	enum Filter
+	{
+		BoxFilter,
+		KaiserFilter
+	};
+
+	/// Position of one level in the chain data
+	struct Level
+	{
+		unsigned int width, height;
+		size_t offset;		///< Byte offset of the level in getData()
+		size_t rowPitch;	///< Bytes per row
+		size_t size;		///< Bytes of the level
+	};
+
+	MipChain();
+
+	/** \brief Build the mip chain of an image
+	* @param pixels is the top level image
+	* @param width, height are the size of the top level
+	* @param format is the pixel format of the image and of every level
+	* @param filter is the downsampling filter
+	* @param srgb marks 8 bit colour as sRGB encoded, so it is filtered in linear space. Ignored for float formats
+	* @param maxLevels limits the number of levels, 0 builds the full chain down to 1x1
+	* @param rowPitch is the bytes per row of pixels, 0 if the rows are tightly packed
+	* @param threadCount is the number of threads for large levels, 0 uses one per hardware thread
+	*/
+	void build(const void* pixels, unsigned int width, unsigned int height, PixelFormat format, Filter filter = BoxFilter,
+		bool srgb = false, int maxLevels = 0, size_t rowPitch = 0, int threadCount = 0);
+
+	int getLevelCount() const { return (int)levels.size(); }
+	const Level& getLevel(int level) const { return levels[level]; }
+	const void* getLevelData(int level) const { return data.data() + levels[level].offset; }
+	const void* getData() const { return data.data(); }
+	size_t getDataSize() const { return data.size(); }
+	PixelFormat getFormat() const { return format; }
+	bool isSRGB() const { return srgb; }
+	int getChannelCount() const { return format == RGBA8 || format == RGBA32F ? 4 : 1; }
+	size_t getTexelSize() const;	///< Bytes per texel
+
+	/// Write the chain as a DDS file (DX10 header), returns false if the file cannot be written
+	bool writeDDS(const char* filename) const;
+
+private:
+	std::vector<unsigned char> data;
+	std::vector<Level> levels;
+	PixelFormat format;
+	bool srgb;
+};
+
+#endif
@@ -3,8 +3,8 @@
 *
 * \brief Very basic OBJ loading mesh object
 *
-* Is treated like a standard mesh object, but loads a basic OBJ file based on provided filename.
-* Future version will update/replace this model loader with something more complete.
+* Is treated like a standard mesh object, but loads an OBJ file based on provided filename.
+* The file is parsed by ObjParser (triangles, quads and n-gons, with or without texture coordinates and normals).
 *
 * \author Paul Robertson
 */
@@ -14,6 +14,8 @@
 #define _MODEL_H_
 
 #include "BaseMesh.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
 //#include "TokenStream.h"
 #include <vector>
 #include <fstream>
@@ -22,28 +24,32 @@ using namespace DirectX;
 
 class Model : public BaseMesh
 {
-	struct ModelType
-	{
-		float x, y, z;
-		float tu, tv;
-		float nx, ny, nz;
-	};
-
 public:
 	/** \brief Initialises the mesh and vertex list, but loading in from a file
 	* Provide filename to OBJ object, will be loaded and store like other mesh objects.
 	* @param device is the renderer device
-	* @param device context is the renderer device context
 	* @param filename is a char* for filename.
 	*/
-	Model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* filename);
+	Model(RenderDevice* device, const char* filename);
+	/** \brief Loads the OBJ file without creating GPU buffers, so it can run on a worker thread
+	* Call createBuffers() on the render thread before the model is drawn.
+	*/
+	Model(const char* filename);
 	~Model();
 
+	/// Create the vertex and index buffers of a model constructed without a device, then free the CPU copy
+	void createBuffers(RenderDevice* device) { renderer = device; initBuffers(device); }
+
+	/// Vertex counts and ACMR before and after the mesh optimisation
+	const MeshOptimizerStats& getOptimizerStats() const { return optimizerStats; }
+
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	void loadModel(const char* filename);
 	
-	ModelType* model;
+	std::vector<VertexType> vertices;	///< Loaded vertices, freed once the buffers are created
+	std::vector<uint32_t> indices;
+	MeshOptimizerStats optimizerStats;
 };
 
 #endif
\ No newline at end of file
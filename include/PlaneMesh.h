@@ -24,14 +24,16 @@ public:
 	*
 	* Can specify resolution of plane, this deteremines how many subdivisions of the plane.
 	* @param device is the renderer device
-	* @param device context is the renderer device context
 	* @param resolution is a int for subdivision of the plane. The number of unit quad on each axis. Default is 100.
 	*/
-	PlaneMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 100);
+	PlaneMesh(RenderDevice* device, int resolution = 100);
 	~PlaneMesh();
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	/// Stores the resolution without building the plane, for derived meshes that build and upload their own geometry
+	PlaneMesh(int resolution);
+
+	void initBuffers(RenderDevice* device);
 	int resolution;
 };
 
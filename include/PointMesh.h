@@ -15,13 +15,13 @@ class PointMesh : public BaseMesh
 {
 
 public:
-	PointMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	PointMesh(RenderDevice* device);
 	~PointMesh();
 
-	void sendData(ID3D11DeviceContext*);
+	void sendData(RenderDevice* device, D3D_PRIMITIVE_TOPOLOGY top = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST) override;
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 
 };
 
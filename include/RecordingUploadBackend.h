@@ -0,0 +1,56 @@
+/**
+* \class RecordingUploadBackend
+*
+* \brief Upload backend without a device, for tests and benchmarks
+*
+* The ring is system memory and every call is appended to a log. The destinations of copyToBuffer are
+* std::vector<unsigned char>* cast to GpuBuffer*, that receive the copied bytes (they grow as needed), so the uploaded data can be checked.
+* It is the upload backend of NullRenderDevice, whose buffers are such vectors.
+*/
+
+#ifndef _RECORDINGUPLOADBACKEND_H_
+#define _RECORDINGUPLOADBACKEND_H_
+
+#include "UploadBackend.h"
+#include <vector>
+
+/// One call made to the backend
+struct UploadRecord
+{
+	enum Type
+	{
+		kMapDiscard = 0,
+		kMapNoOverwrite = 1,
+		kUnmap = 2,
+		kCopy = 3
+	};
+
+	Type type;
+	GpuBuffer* destination;		///< kCopy only
+	size_t destinationOffset;	///< kCopy only
+	size_t ringOffset;			///< kCopy only
+	size_t size;				///< kCopy only
+};
+
+class RecordingUploadBackend : public UploadBackend
+{
+public:
+	RecordingUploadBackend();
+	~RecordingUploadBackend();
+
+	bool createRing(size_t size) override;
+	void* mapRing(bool discard) override;
+	void unmapRing() override;
+	void copyToBuffer(GpuBuffer* destination, size_t destinationOffset, size_t ringOffset, size_t size) override;
+
+	const std::vector<UploadRecord>& getRecords() const { return records; }
+	void clearRecords() { records.clear(); }	///< Forget the calls made so far
+	bool isMapped() const { return mapped; }
+
+private:
+	std::vector<unsigned char> ring;
+	std::vector<UploadRecord> records;
+	bool mapped;
+};
+
+#endif
@@ -15,11 +15,11 @@ class SphereMesh : public BaseMesh
 {
 
 public:
-	SphereMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 20);
+	SphereMesh(RenderDevice* device, int resolution = 20);
 	~SphereMesh();
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	int resolution;
 };
 
@@ -15,13 +15,13 @@ class TessellationMesh : public BaseMesh
 {
 
 public:
-	TessellationMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	TessellationMesh(RenderDevice* device);
 	~TessellationMesh();
 
-	void sendData(ID3D11DeviceContext*);
+	void sendData(RenderDevice* device, D3D_PRIMITIVE_TOPOLOGY top = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST) override;
 
 protected:
-	void initBuffers(ID3D11Device* device);
+	void initBuffers(RenderDevice* device);
 	
 };
 
@@ -12,7 +12,7 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
-#include <windows.h>
+#include <cstdint>
 
 class Timer
 {
@@ -26,9 +26,7 @@ public:
 	float getFPS();		///< Get FPS (for display)
 
 private:
-	INT64 frequency;
-	float ticksPerS;
-	INT64 startTime;
+	uint64_t startTime;
 	float frameTime;
 	float fps;
 	float frames;
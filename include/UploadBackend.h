@@ -0,0 +1,36 @@
+/**
+* \class UploadBackend
+*
+* \brief Interface between UploadRing and the graphics API
+*
+* A backend owns the ring buffer the CPU writes to, maps it and copies ranges of it into destination buffers.
+* D3D11UploadBackend implements it with a dynamic buffer and CopySubresourceRegion, RecordingUploadBackend with system
+* memory and a log of the calls, so the upload code can run and be measured without a device.
+*/
+
+#ifndef _UPLOADBACKEND_H_
+#define _UPLOADBACKEND_H_
+
+#include <cstddef>
+
+struct GpuBuffer;
+
+class UploadBackend
+{
+public:
+	virtual ~UploadBackend() {}
+
+	/// Create the ring buffer of 'size' bytes, releasing the previous one. Returns false on failure
+	virtual bool createRing(size_t size) = 0;
+	/** \brief Map the ring buffer for writing and return its first byte
+	*
+	* @param discard is true when the ring wraps around: the previous contents can be thrown away (D3D11_MAP_WRITE_DISCARD).
+	* Otherwise the caller only writes bytes it has not used since the last discard (D3D11_MAP_WRITE_NO_OVERWRITE)
+	*/
+	virtual void* mapRing(bool discard) = 0;
+	virtual void unmapRing() = 0;	///< Finish the writes started by mapRing
+	/// Copy 'size' bytes at 'ringOffset' of the ring to 'destinationOffset' of a destination buffer (a buffer of the device that created the backend)
+	virtual void copyToBuffer(GpuBuffer* destination, size_t destinationOffset, size_t ringOffset, size_t size) = 0;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/**
+* \class UploadRing
+*
+* \brief Streams data to GPU buffers through a ring buffer, with a byte budget per frame
+*
+* allocate() returns memory inside the mapped ring buffer, so the data is written there directly instead of being built
+* in a temporary array and copied. upload() unmaps it and copies it to its destination buffer. Allocations follow each
+* other in the ring, which is mapped without overwriting the ranges still in use (D3D11_MAP_WRITE_NO_OVERWRITE), and
+* is discarded when an allocation does not fit before its end. Budgeted allocations stop once the bytes allocated this
+* frame reach the frame budget, so the rest of the data is uploaded over the next frames.
+* The graphics API is behind an UploadBackend, which the ring owns.
+*/
+
+#ifndef _UPLOADRING_H_
+#define _UPLOADRING_H_
+
+#include "UploadBackend.h"
+#include <cstddef>
+
+class UploadRing
+{
+public:
+	static const size_t alignment = 16;	///< Every allocation starts at a multiple of this
+
+	/** \brief Create the ring buffer
+	*
+	* @param backend is the graphics API backend, deleted by the ring
+	* @param size is the size of the ring buffer in bytes, the largest possible allocation
+	* @param frameBudget is the number of bytes budgeted allocations can use every frame
+	*/
+	UploadRing(UploadBackend* backend, size_t size, size_t frameBudget);
+	~UploadRing();
+
+	void beginFrame();	///< Start a new frame: reset the budget and the bytes of the frame
+
+	void setFrameBudget(size_t bytes) { frameBudget = bytes; }
+	size_t getFrameBudget() const { return frameBudget; }
+	size_t getSize() const { return size; }
+	/// Largest allocation that would succeed now, limited by the ring size and, if 'budgeted', the budget left
+	size_t getMaxAllocation(bool budgeted = true) const;
+
+	/** \brief Reserve 'bytes' of the ring and return where to write them, or nullptr if they do not fit
+	*
+	* The memory is mapped until upload() is called, there is one allocation at a time.
+	* @param budgeted counts the bytes against the frame budget, otherwise only the ring size limits the allocation
+	*/
+	void* allocate(size_t bytes, bool budgeted = true);
+	/// Unmap the current allocation and copy it to 'destinationOffset' of 'destination' (see UploadBackend::copyToBuffer)
+	void upload(GpuBuffer* destination, size_t destinationOffset);
+
+	size_t getFrameBytes() const { return frameBytes; }				///< Bytes uploaded since beginFrame()
+	size_t getLastFrameBytes() const { return lastFrameBytes; }		///< Bytes uploaded during the previous frame
+	size_t getPeakFrameBytes() const { return peakFrameBytes; }		///< Most bytes uploaded in one frame
+	unsigned long long getTotalBytes() const { return totalBytes; }	///< Bytes uploaded since the ring was created
+	unsigned int getDiscardCount() const { return discardCount; }	///< Times the ring wrapped around
+	UploadBackend* getBackend() const { return backend; }
+
+private:
+	UploadBackend* backend;
+	size_t size;
+	size_t frameBudget;
+	size_t head;			// next free byte of the ring, 'size' until the first map discards it
+	unsigned char* mapped;	// mapped ring while there is an allocation
+	size_t pendingOffset;	// current allocation
+	size_t pendingSize;
+
+	size_t frameBytes;
+	size_t lastFrameBytes;
+	size_t peakFrameBytes;
+	unsigned long long totalBytes;
+	unsigned int discardCount;
+};
+
+#endif